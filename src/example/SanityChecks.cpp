@@ -19,16 +19,26 @@
  * THE SOFTWARE.
  */
 #include "common/cereal/archives/binary.hpp"
+#include "common/cereal/archives/portable_binary.hpp"
+#include "system/AlloyMemMappedFile.h"
 #include "common/cereal/archives/xml.hpp"
 #include "graphics/AlloyCamera.h"
 #include "graphics/AlloyIntersector.h"
 #include "graphics/AlloyLocator.h"
+#include "vision/AlloyDescriptorMatcher.h"
+#include "math/AlloyMatrixBatch.h"
+#include "image/AlloyConnectedComponents.h"
+#include "graphics/AlloyDelaunay.h"
+#include "math/AlloyPredicates.h"
 #include "image/AlloyDistanceField.h"
 #include "math/AlloySparseSolve.h"
 #include "math/AlloyVecMath.h"
 #include "image/AlloyImage.h"
+#include "image/AlloyPyramid.h"
 #include "math/AlloyVector.h"
 #include "system/AlloyFileUtil.h"
+#include "system/AlloyDirectoryIndex.h"
+#include "physics/fluid/FluidSimulation3D.h"
 #include "ui/AlloyUI.h"
 #include "graphics/AlloyMesh.h"
 #include "math/AlloyDenseSolve.h"
@@ -41,6 +51,10 @@
 #include <iostream>
 #include <fstream>
 #include <random>
+#include <map>
+#include <set>
+#include <sstream>
+#include <chrono>
 #ifndef ALY_WINDOWS
 #pragma GCC diagnostic ignored "-Wunused-variable"
 #pragma GCC diagnostic ignored "-Wunused-but-set-variable"
@@ -154,6 +168,67 @@ namespace aly {
 					<< std::endl;
 			}
 		}
+		{
+			int N = 10000;
+			Vector3f samples(N);
+			for (int n = 0; n < N; n++) {
+				samples[n] = float3(RandomUniform(0.0f, 1.0f),
+					RandomUniform(0.0f, 1.0f), RandomUniform(0.0f, 1.0f));
+			}
+			Locator3f locator(samples);
+			HashGrid3f grid(samples, 0.05f);
+			float3 q(0.5f, 0.2f, 0.4f);
+			std::vector<float3i> hits, gridHits;
+			locator.closest(q, 0.05f, hits);
+			grid.closest(q, 0.05f, gridHits);
+			std::cout << "[HashGrid3f] Nearest in radius: " << gridHits.size() << " Locator3f: " << hits.size() << std::endl;
+			for (int k = 0; k < (int)gridHits.size(); k++) {
+				std::cout << k << ") " << gridHits[k] << " " << distance(gridHits[k], q) << std::endl;
+			}
+			std::vector<int> hitIndexes, gridIndexes;
+			for (const float3i& hit : hits) {
+				hitIndexes.push_back(hit.index);
+			}
+			for (const float3i& hit : gridHits) {
+				gridIndexes.push_back(hit.index);
+			}
+			std::sort(hitIndexes.begin(), hitIndexes.end());
+			std::sort(gridIndexes.begin(), gridIndexes.end());
+			if (hitIndexes != gridIndexes) {
+				std::cout << "[HashGrid3f] Points in radius do not match Locator3f." << std::endl;
+				return false;
+			}
+			grid.closest(q, 5, gridHits);
+			std::cout << "[HashGrid3f] 5 nearest: " << std::endl;
+			for (int k = 0; k < (int)gridHits.size(); k++) {
+				std::cout << k << ") " << gridHits[k] << " " << distance(gridHits[k], q) << std::endl;
+			}
+			std::vector<std::pair<float, int>> sorted(N);
+			for (int n = 0; n < N; n++) {
+				sorted[n] = std::pair<float, int>(distanceSqr(samples[n], q), n);
+			}
+			std::partial_sort(sorted.begin(), sorted.begin() + 5, sorted.end());
+			std::vector<int> nearest;
+			for (int k = 0; k < 5; k++) {
+				nearest.push_back(sorted[k].second);
+			}
+			gridIndexes.clear();
+			for (const float3i& hit : gridHits) {
+				gridIndexes.push_back(hit.index);
+			}
+			std::sort(nearest.begin(), nearest.end());
+			std::sort(gridIndexes.begin(), gridIndexes.end());
+			if (nearest != gridIndexes) {
+				std::cout << "[HashGrid3f] 5 nearest do not match." << std::endl;
+				return false;
+			}
+			float3i closest = locator.closest(q);
+			std::cout << "[Locator3f] Closest: " << closest << std::endl;
+			if (grid.closest(q).index != closest.index) {
+				std::cout << "[HashGrid3f] Closest does not match Locator3f." << std::endl;
+				return false;
+			}
+		}
 		{
 			int N = 10000;
 			const int C = 64;
@@ -240,6 +315,351 @@ namespace aly {
 		}
 		return true;
 	}
+	bool SANITY_CHECK_DESCRIPTOR_MATCHER() {
+		int N = 5000;
+		int Q = 1000;
+		std::vector<SiftDescriptor> train(N), query(Q);
+		for (SiftDescriptor& desc : train) {
+			for (float& val : desc.data) {
+				val = RandomUniform(0.0f, 1.0f);
+			}
+			desc.normalize();
+		}
+		for (int q = 0; q < Q; q++) {
+			query[q] = train[(q * 7) % N];
+			for (float& val : query[q].data) {
+				val = std::max(0.0f, val + RandomUniform(-0.01f, 0.01f));
+			}
+			query[q].normalize();
+		}
+		DescriptorSet trainSet(train), querySet(query);
+		DescriptorMatcherOptions options;
+		DescriptorMatcher bruteForce(trainSet, options);
+		std::vector<DescriptorMatch> knn;
+		bruteForce.knnMatch(querySet, 2, knn);
+		for (int q = 0; q < Q; q += 50) {
+			int best = -1;
+			double bestDist = std::numeric_limits<double>::max();
+			for (int t = 0; t < N; t++) {
+				double d = 0.0;
+				for (int c = 0; c < 128; c++) {
+					d += (query[q].data[c] - train[t].data[c]) * (query[q].data[c] - train[t].data[c]);
+				}
+				if (d < bestDist) {
+					bestDist = d;
+					best = t;
+				}
+			}
+			if (knn[2 * q].train != best || std::abs(knn[2 * q].distance - std::sqrt(bestDist)) > 1E-4f) {
+				std::cout << "[DescriptorMatcher] Brute force mismatch for query " << q << ": " << knn[2 * q].train << " != " << best << std::endl;
+				return false;
+			}
+		}
+		options.backend = MatcherBackend::KdForest;
+		options.crossCheck = true;
+		DescriptorMatcher forest(trainSet, options);
+		std::vector<DescriptorMatch> matches;
+		forest.match(querySet, matches);
+		int correct = 0;
+		for (DescriptorMatch& m : matches) {
+			if (m.train == (m.query * 7) % N)
+				correct++;
+		}
+		std::cout << "[DescriptorMatcher] kd-forest matched " << correct << " / " << Q << " queries correctly" << std::endl;
+		return (correct > Q * 9 / 10);
+	}
+	bool SANITY_CHECK_MATRIX_BATCH() {
+		int N = 1003;
+		std::vector<float3x3> A(N), U, Vt, R, S, Ainv;
+		std::vector<float3> D;
+		for (float3x3& M : A) {
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++) {
+					M(i, j) = RandomUniform(-1.0f, 1.0f);
+				}
+			}
+		}
+		BatchSVD(A, U, D, Vt);
+		BatchFactorRotation(A, R);
+		BatchInverse(A, Ainv);
+		float svdError = 0.0f, rotationError = 0.0f, inverseError = 0.0f;
+		for (int n = 0; n < N; n++) {
+			float3x3 u, d, vt;
+			SVD(A[n], u, d, vt);
+			float3x3 r = FactorRotation(A[n]);
+			float3x3 I = A[n] * Ainv[n];
+			//Singular vectors of nearly equal singular values are sensitive to rounding, so compare the products instead.
+			float3x3 M = U[n] * MakeDiagonal(D[n]) * Vt[n];
+			float3x3 m = u * MakeDiagonal(diagonal(d)) * vt;
+			for (int i = 0; i < 3; i++) {
+				svdError = std::max(svdError, std::abs(d(i, i) - D[n][i]));
+				for (int j = 0; j < 3; j++) {
+					svdError = std::max(svdError, std::abs(M(i, j) - m(i, j)));
+					rotationError = std::max(rotationError, std::abs(r(i, j) - R[n](i, j)));
+				}
+			}
+			if (std::abs(determinant(A[n])) > 1E-2f) {
+				inverseError = std::max(inverseError, std::abs(I(0, 0) - 1.0f) + std::abs(I(1, 0)) + std::abs(I(2, 2) - 1.0f));
+			}
+		}
+		BatchPolarDecomposition(A, R, S);
+		float polarError = 0.0f;
+		for (int n = 0; n < N; n++) {
+			float3x3 M = R[n] * S[n];
+			for (int i = 0; i < 3; i++) {
+				for (int j = 0; j < 3; j++) {
+					polarError = std::max(polarError, std::abs(M(i, j) - A[n](i, j)));
+				}
+			}
+		}
+		std::cout << "[MatrixBatch] SVD error " << svdError << " rotation error " << rotationError << " inverse error " << inverseError
+				<< " polar error " << polarError << std::endl;
+		return (svdError < 1E-4f && rotationError < 1E-4f && inverseError < 1E-2f && polarError < 5E-2f);
+	}
+	//Serial flood fill reference, numbered in raster order like ConnectedComponents().
+	static int FloodFillComponents(const std::vector<int>& labels, std::vector<int>& out, std::vector<int>& sizes, int3 dims, int maxNonZero,
+			bool ignoreNegative) {
+		out.assign(labels.size(), -1);
+		sizes.clear();
+		for (int start = 0; start < (int)labels.size(); start++) {
+			if (out[start] >= 0 || (ignoreNegative && labels[start] < 0))
+				continue;
+			int cc = (int)sizes.size();
+			sizes.push_back(0);
+			std::vector<int> stack(1, start);
+			out[start] = cc;
+			while (!stack.empty()) {
+				int idx = stack.back();
+				stack.pop_back();
+				sizes[cc]++;
+				int3 pos(idx % dims.x, (idx / dims.x) % dims.y, idx / (dims.x * dims.y));
+				for (int dz = -1; dz <= 1; dz++) {
+					for (int dy = -1; dy <= 1; dy++) {
+						for (int dx = -1; dx <= 1; dx++) {
+							int nz = std::abs(dx) + std::abs(dy) + std::abs(dz);
+							int3 nbr = pos + int3(dx, dy, dz);
+							if (nz == 0 || nz > maxNonZero || nbr.x < 0 || nbr.y < 0 || nbr.z < 0 || nbr.x >= dims.x || nbr.y >= dims.y || nbr.z >= dims.z)
+								continue;
+							int nidx = nbr.x + (nbr.y + nbr.z * dims.y) * dims.x;
+							if (out[nidx] < 0 && labels[nidx] == labels[start]) {
+								out[nidx] = cc;
+								stack.push_back(nidx);
+							}
+						}
+					}
+				}
+			}
+		}
+		return (int)sizes.size();
+	}
+	bool SANITY_CHECK_CONNECTED_COMPONENTS() {
+		bool ok = true;
+		std::vector<int> ref, sizes;
+		for (int connectivity : {4, 8}) {
+			Image1i labels(317, 211), out;
+			for (int1& l : labels.data) {
+				l.x = RandomUniform(-1, 2);
+			}
+			std::vector<ConnectedComponent2D> stats;
+			int count = ConnectedComponents(labels, out, stats, connectivity, true);
+			std::vector<int> in(labels.size());
+			for (size_t n = 0; n < in.size(); n++) {
+				in[n] = labels.data[n].x;
+			}
+			int refCount = FloodFillComponents(in, ref, sizes, int3(labels.width, labels.height, 1), connectivity / 4, true);
+			int mismatch = (count == refCount) ? 0 : 1;
+			for (size_t n = 0; n < in.size(); n++) {
+				if (out.data[n].x != ref[n])
+					mismatch++;
+			}
+			for (int c = 0; c < std::min(count, refCount); c++) {
+				if (stats[c].size != sizes[c])
+					mismatch++;
+			}
+			std::cout << "[ConnectedComponents] 2D " << connectivity << "-connected: " << count << " components, " << mismatch << " mismatches" << std::endl;
+			ok &= (mismatch == 0);
+		}
+		for (int connectivity : {6, 18, 26}) {
+			Volume1i labels(47, 39, 33), out;
+			for (int1& l : labels.data) {
+				l.x = RandomUniform(0, 2);
+			}
+			std::vector<ConnectedComponent3D> stats;
+			int count = ConnectedComponents(labels, out, stats, connectivity);
+			std::vector<int> in(labels.size());
+			for (size_t n = 0; n < in.size(); n++) {
+				in[n] = labels.data[n].x;
+			}
+			int refCount = FloodFillComponents(in, ref, sizes, labels.dimensions(), (connectivity == 6) ? 1 : ((connectivity == 18) ? 2 : 3), false);
+			int mismatch = (count == refCount) ? 0 : 1;
+			for (size_t n = 0; n < in.size(); n++) {
+				if (out.data[n].x != ref[n])
+					mismatch++;
+			}
+			for (int c = 0; c < std::min(count, refCount); c++) {
+				if (stats[c].size != sizes[c])
+					mismatch++;
+			}
+			std::cout << "[ConnectedComponents] 3D " << connectivity << "-connected: " << count << " components, " << mismatch << " mismatches" << std::endl;
+			ok &= (mismatch == 0);
+		}
+		return ok;
+	}
+	//Counts inverted triangles, repeated edges, non-Delaunay unconstrained edges and missing constraints.
+	static int CountDelaunayErrors(const std::vector<float2>& points, const std::vector<uint3>& triangles, const std::vector<uint2>& constraints) {
+		std::map<std::pair<int, int>, int> edges;
+		int errors = 0;
+		for (int t = 0; t < (int)triangles.size(); t++) {
+			uint3 tri = triangles[t];
+			if (Orient2D(points[tri.x], points[tri.y], points[tri.z]) <= 0.0)
+				errors++;
+			for (int i = 0; i < 3; i++) {
+				std::pair<int, int> e((int)tri[i], (int)tri[(i + 1) % 3]);
+				if (edges.find(e) != edges.end())
+					errors++;
+				edges[e] = t;
+			}
+		}
+		std::set<std::pair<int, int>> fixed;
+		for (uint2 c : constraints) {
+			fixed.insert(std::pair<int, int>((int)c.x, (int)c.y));
+			fixed.insert(std::pair<int, int>((int)c.y, (int)c.x));
+			if (edges.find(std::pair<int, int>((int)c.x, (int)c.y)) == edges.end()
+					&& edges.find(std::pair<int, int>((int)c.y, (int)c.x)) == edges.end())
+				errors++;
+		}
+		for (auto e : edges) {
+			auto opposite = edges.find(std::pair<int, int>(e.first.second, e.first.first));
+			if (opposite == edges.end() || fixed.find(e.first) != fixed.end())
+				continue;
+			uint3 tri = triangles[e.second];
+			uint3 other = triangles[opposite->second];
+			int y = (int)other.x + (int)other.y + (int)other.z - e.first.first - e.first.second;
+			if (InCircle(points[tri.x], points[tri.y], points[tri.z], points[y]) > 0.0)
+				errors++;
+		}
+		return errors;
+	}
+	bool SANITY_CHECK_DELAUNAY() {
+		bool ok = true;
+		std::vector<float2> points(20000);
+		for (float2& pt : points) {
+			pt = float2(RandomUniform(0.0f, 1.0f), RandomUniform(0.0f, 1.0f));
+		}
+		std::vector<uint3> triangles;
+		MakeDelaunay(points, triangles);
+		int errors = CountDelaunayErrors(points, triangles, std::vector<uint2>());
+		std::cout << "[Delaunay] random: " << triangles.size() << " triangles, " << errors << " errors" << std::endl;
+		ok &= (errors == 0);
+		//Grid points are cocircular everywhere, and a few duplicates are added.
+		std::vector<float2> grid;
+		for (int j = 0; j < 64; j++) {
+			for (int i = 0; i < 64; i++) {
+				grid.push_back(float2((float)i, (float)j));
+			}
+		}
+		for (int n = 0; n < 100; n++) {
+			grid.push_back(grid[RandomUniform(0, 64 * 64 - 1)]);
+		}
+		MakeDelaunay(grid, triangles);
+		errors = CountDelaunayErrors(grid, triangles, std::vector<uint2>());
+		//A 64x64 grid has 2*63*63 triangles.
+		if (triangles.size() != 2 * 63 * 63)
+			errors++;
+		std::cout << "[Delaunay] grid: " << triangles.size() << " triangles, " << errors << " errors" << std::endl;
+		ok &= (errors == 0);
+		int N = (int)points.size();
+		points.push_back(float2(0.05f, 0.5f));
+		points.push_back(float2(0.95f, 0.5f));
+		points.push_back(float2(0.5f, 0.05f));
+		points.push_back(float2(0.5f, 0.45f));
+		std::vector<uint2> constraints = { uint2(N, N + 1), uint2(N + 2, N + 3) };
+		MakeDelaunay(points, constraints, triangles);
+		errors = CountDelaunayErrors(points, triangles, constraints);
+		std::cout << "[Delaunay] constrained: " << triangles.size() << " triangles, " << errors << " errors" << std::endl;
+		ok &= (errors == 0);
+		//Tetrahedra must be positive and locally Delaunay, and the hull must enclose the same volume.
+		std::vector<float3> points3d(10000);
+		for (float3& pt : points3d) {
+			pt = float3(RandomUniform(0.0f, 1.0f), RandomUniform(0.0f, 1.0f), RandomUniform(0.0f, 1.0f));
+		}
+		std::vector<uint4> tets;
+		std::vector<int4> neighbors;
+		MakeDelaunay(points3d, tets, neighbors);
+		errors = 0;
+		double volume = 0.0, hullVolume = 0.0;
+		for (int t = 0; t < (int)tets.size(); t++) {
+			uint4 tet = tets[t];
+			double o = Orient3D(points3d[tet.x], points3d[tet.y], points3d[tet.z], points3d[tet.w]);
+			if (o <= 0.0)
+				errors++;
+			volume += o / 6.0;
+			for (int i = 0; i < 4; i++) {
+				int nbr = neighbors[t][i];
+				if (nbr < 0)
+					continue;
+				uint4 other = tets[nbr];
+				int opposite = (int)(other.x + other.y + other.z + other.w) - (int)(tet.x + tet.y + tet.z + tet.w) + (int)tet[i];
+				if (InSphere(points3d[tet.x], points3d[tet.y], points3d[tet.z], points3d[tet.w], points3d[opposite]) > 0.0)
+					errors++;
+			}
+		}
+		std::vector<uint3> faces;
+		GetBoundaryFaces(tets, neighbors, faces);
+		for (uint3 face : faces) {
+			hullVolume += dot(points3d[face.x], cross(points3d[face.y], points3d[face.z])) / 6.0;
+		}
+		if (std::abs(volume - hullVolume) > 1E-4)
+			errors++;
+		std::cout << "[Delaunay] 3D: " << tets.size() << " tetrahedra, " << faces.size() << " hull faces, " << errors << " errors" << std::endl;
+		ok &= (errors == 0);
+		return ok;
+	}
+	bool SANITY_CHECK_VECTOR_SERIALIZATION() {
+		Vector3f points(100000);
+		Image4f image(512, 256);
+		for (float3& pt : points.data) {
+			pt = float3(RandomUniform(-1.0f, 1.0f), RandomUniform(-1.0f, 1.0f), RandomUniform(-1.0f, 1.0f));
+		}
+		for (float4& val : image.data) {
+			val = float4(RandomUniform(0.0f, 1.0f));
+		}
+		//Bulk blocks must produce the same bytes as archiving every element.
+		std::stringstream bulk, elements;
+		{
+			cereal::PortableBinaryOutputArchive archive(bulk);
+			archive(points);
+		}
+		{
+			cereal::PortableBinaryOutputArchive archive(elements);
+			archive(cereal::make_size_tag(static_cast<cereal::size_type>(points.size())));
+			for (const float3& pt : points.data) {
+				archive(pt);
+			}
+		}
+		bool ok = (bulk.str() == elements.str());
+		std::string file = "vector_serialization.bin";
+		auto start = std::chrono::steady_clock::now();
+		{
+			std::ofstream os(file, std::ios::binary);
+			cereal::PortableBinaryOutputArchive archive(os);
+			archive(points, image);
+		}
+		auto mid = std::chrono::steady_clock::now();
+		Vector3f pointsIn;
+		Image4f imageIn;
+		{
+			MemMapInputStream is(file);
+			cereal::PortableBinaryInputArchive archive(is);
+			archive(pointsIn, imageIn);
+		}
+		auto end = std::chrono::steady_clock::now();
+		RemoveFile(file);
+		ok &= (pointsIn.data == points.data && imageIn.data == image.data && imageIn.width == image.width && imageIn.height == image.height);
+		std::cout << "[Serialization] write " << std::chrono::duration<double>(mid - start).count() << " sec, mapped read "
+				<< std::chrono::duration<double>(end - mid).count() << " sec, " << (ok ? "matched" : "mismatched") << std::endl;
+		return ok;
+	}
 	bool SANITY_CHECK_SUBDIVIDE() {
 		Mesh mesh;
 		mesh.load(AlloyDefaultContext()->getFullPath("models/monkey.ply"));
@@ -663,7 +1083,107 @@ namespace aly {
 		std::cout << "RANSAC Solve\n" << X2 << std::endl;
 		return true;
 	}
+	//Largest violation of x - 0.25*(sum of neighbors) = b over the color channels of pixels flagged in mask.
+	static float PoissonResidual(const Image4f& x, const Image4f& b, const Image1ub& mask) {
+		float err = 0.0f;
+		for (int j = 1; j < x.height - 1; j++) {
+			for (int i = 1; i < x.width - 1; i++) {
+				if (mask(i, j).x) {
+					float4 r = x(i, j) - 0.25f * (x(i - 1, j) + x(i + 1, j) + x(i, j - 1) + x(i, j + 1)) - b(i, j);
+					err = std::max(err, max(abs(r.xyz())));
+				}
+			}
+		}
+		return err;
+	}
+	static float MaxColorDifference(const Image4f& a, const Image4f& b) {
+		float err = 0.0f;
+		for (size_t n = 0; n < a.size(); n++) {
+			err = std::max(err, max(abs(a[n].xyz() - b[n].xyz())));
+		}
+		return err;
+	}
+	//x - 0.25*(sum of neighbors) wherever x and its neighbors have positive alpha, zero elsewhere.
+	static Image4f MaskedLaplacian(const Image4f& x) {
+		Image4f div(x.width, x.height);
+		div.set(float4(0.0f));
+		for (int j = 1; j < x.height - 1; j++) {
+			for (int i = 1; i < x.width - 1; i++) {
+				if (x(i, j).w > 0 && x(i - 1, j).w > 0 && x(i + 1, j).w > 0 && x(i, j - 1).w > 0 && x(i, j + 1).w > 0) {
+					div(i, j) = x(i, j) - 0.25f * (x(i - 1, j) + x(i + 1, j) + x(i, j - 1) + x(i, j + 1));
+					div(i, j).w = 0.0f;
+				}
+			}
+		}
+		return div;
+	}
+	static bool SANITY_CHECK_MULTIGRID_SOLVE() {
+		const int w = 49, h = 41;
+		Image4f src(w, h), tar(w, h), background(w, h);
+		for (int j = 0; j < h; j++) {
+			for (int i = 0; i < w; i++) {
+				float x = i / (float) w, y = j / (float) h;
+				float inside = (length(float2(i - 0.5f * w, j - 0.5f * h)) < 0.35f * h) ? 1.0f : 0.0f;
+				src(i, j) = float4(0.5f + 0.4f * std::sin(6.0f * x) * std::cos(4.0f * y), x * y, y, inside);
+				tar(i, j) = float4(0.2f + 0.1f * x, 0.7f * y, 0.4f, inside);
+				background(i, j) = float4(0.3f * std::cos(5.0f * y), 0.6f * x, 0.2f + 0.5f * x * x, 1.0f);
+			}
+		}
+		Image1ub interior(w, h), blendMask(w, h);
+		interior.set(ubyte1((uint8_t) 0));
+		blendMask.set(ubyte1((uint8_t) 0));
+		for (int j = 1; j < h - 1; j++) {
+			for (int i = 1; i < w - 1; i++) {
+				interior(i, j).x = 1;
+				if (tar(i, j).w >= 0.5f && tar(i - 1, j).w >= 0.5f && tar(i + 1, j).w >= 0.5f && tar(i, j - 1).w >= 0.5f && tar(i, j + 1).w >= 0.5f) {
+					blendMask(i, j).x = 1;
+				}
+			}
+		}
+		//Right hand sides of the blend, fill and inpaint systems.
+		Image4f blendB = MaskedLaplacian(src);
+		Image4f backgroundB = MaskedLaplacian(background);
+		Image4f fillB = blendB, inpaintB = blendB;
+		for (size_t n = 0; n < src.size(); n++) {
+			fillB[n] *= src[n].w;
+			inpaintB[n] = mix(backgroundB[n], blendB[n], src[n].w);
+		}
+		//Iterative solutions converged far enough to compare against.
+		const int ITERATIONS = 4000;
+		Image4f blend = tar, fill = tar, inpaint = tar;
+		PoissonBlend(src, blend, ITERATIONS, 1.0f);
+		LaplaceFill(src, fill, ITERATIONS, 1.0f);
+		PoissonInpaint(src, background, inpaint, ITERATIONS, 1.0f);
+		const MultigridCycle cycles[] = { MultigridCycle::V, MultigridCycle::W, MultigridCycle::F };
+		const char* names[] = { "V", "W", "F" };
+		bool ret = true;
+		for (int k = 0; k < 3; k++) {
+			Image4f out = tar;
+			int blendCycles = PoissonBlend(src, out, cycles[k], 1E-6f);
+			float blendResidual = PoissonResidual(out, blendB, blendMask);
+			float blendError = MaxColorDifference(out, blend);
+			out = tar;
+			int fillCycles = LaplaceFill(src, out, cycles[k], 1E-6f);
+			float fillResidual = PoissonResidual(out, fillB, interior);
+			float fillError = MaxColorDifference(out, fill);
+			out = tar;
+			int inpaintCycles = PoissonInpaint(src, background, out, cycles[k], 1E-6f);
+			float inpaintResidual = PoissonResidual(out, inpaintB, interior);
+			float inpaintError = MaxColorDifference(out, inpaint);
+			std::cout << "[Multigrid " << names[k] << "] Poisson blend " << blendCycles << " cycles, residual " << blendResidual << ", error " << blendError
+					<< ". Laplace fill " << fillCycles << " cycles, residual " << fillResidual << ", error " << fillError << ". Poisson inpaint "
+					<< inpaintCycles << " cycles, residual " << inpaintResidual << ", error " << inpaintError << std::endl;
+			if (std::max(std::max(blendResidual, fillResidual), inpaintResidual) > 1E-4f || std::max(std::max(blendError, fillError), inpaintError) > 1E-3f) {
+				ret = false;
+			}
+		}
+		return ret;
+	}
 	bool SANITY_CHECK_DENSE_SOLVE() {
+		if (!SANITY_CHECK_MULTIGRID_SOLVE()) {
+			std::cout << "Multigrid solvers do not match the iterative solvers." << std::endl;
+			return false;
+		}
 		ImageRGBAf src, tar;
 		ReadImageFromFile(AlloyDefaultContext()->getFullPath("images/sfmarket.png"),
 			src);
@@ -763,6 +1283,32 @@ namespace aly {
 		Tile(ilist, compose, 4, 2);
 		WriteImageToFile("compose2.png", compose);
 		diff.writeToXML("image_diff.xml");
+
+		std::cout << "Shared pyramid" << std::endl;
+		std::shared_ptr<Pyramid4f> pyramid = Pyramid4f::Get(img, 5);
+		if (pyramid != Pyramid4f::Get(img, 5)) {
+			std::cout << "Pyramid was not shared" << std::endl;
+			return false;
+		}
+		ImageRGBAf changed = img;
+		changed[0] += float4(1.0f);
+		if (pyramid == Pyramid4f::Get(changed, 5)) {
+			std::cout << "Pyramid was shared with a different image" << std::endl;
+			return false;
+		}
+		DownSample5x5(img, imgDown);
+		ImageRGBAf level1 = pyramid->getGaussian(1);
+		for (size_t i = 0; i < level1.size(); i++) {
+			if (lengthL1(level1[i] - imgDown[i]) > 1E-4f) {
+				std::cout << "Pyramid level mismatch at " << i << std::endl;
+				return false;
+			}
+		}
+		ImageRGBAf recon;
+		pyramid->reconstruct(recon);
+		WriteImageToFile("pyramid_reconstruct.png", recon);
+		WriteImageToFile("pyramid_laplacian.png",
+				pyramid->getLaplacian(1) + float4(0.5f, 0.5f, 0.5f, 1.0f));
 		return true;
 	}
 	bool SANITY_CHECK_MESH_IO() {
@@ -1205,6 +1751,159 @@ namespace aly {
 			return false;
 		}
 	}
+	bool SANITY_CHECK_DIRECTORY_INDEX() {
+		std::string dir = ConcatPath(GetCurrentWorkingDirectory(), "directory_index_check");
+		if (FileExists(dir)) {
+			RemoveDirectoryRecursive(dir);
+		}
+		MakeDirectory(dir);
+		MakeDirectory(ConcatPath(dir, "subdir"));
+		const int N = 1000;
+		for (int i = 0; i < N; i++) {
+			WriteTextFile(ConcatPath(dir, MakeString() << "file" << i << ".txt"), "");
+		}
+		DirectoryIndex index;
+		std::mutex publishedLock;
+		std::vector<DirectoryListingPtr> published;
+		int id = index.addListener([&](const DirectoryListingPtr& listing) {
+			std::lock_guard<std::mutex> lockMe(publishedLock);
+			published.push_back(listing);
+		});
+		bool ret = true;
+		DirectoryListingPtr listing = index.waitForListing(dir);
+		if (listing.get() == nullptr || listing->partial || listing->size() != N + 1) {
+			std::cout << "Directory index listed " << ((listing.get()) ? listing->size() : 0) << " entries, expected " << N + 1 << std::endl;
+			ret = false;
+		}
+		{
+			//Streamed in doubling batches, then the complete listing.
+			std::lock_guard<std::mutex> lockMe(publishedLock);
+			const size_t batches[] = { DirectoryIndex::FIRST_BATCH, 2 * DirectoryIndex::FIRST_BATCH, (size_t) N + 1 };
+			bool streamed = (published.size() == 3);
+			for (size_t i = 0; i < published.size() && streamed; i++) {
+				streamed = (published[i]->size() == batches[i] && published[i]->partial == (i < 2));
+			}
+			if (!streamed) {
+				std::cout << "Directory index published " << published.size() << " snapshots, expected partial listings of "
+						<< batches[0] << " and " << batches[1] << " entries before the complete listing." << std::endl;
+				ret = false;
+			}
+		}
+		if (ret) {
+			std::string prefix = ConcatPath(dir, "file99");
+			std::vector<FileDescription> suggestions = listing->autoComplete(prefix);
+			std::vector<std::string> expected = AutoComplete(prefix, GetDirectoryListing(dir));
+			int count = 0;
+			for (const std::string& f : expected) {
+				if (f.compare(0, prefix.size(), prefix) == 0)
+					count++;
+			}
+			if (suggestions.size() != 11 || (int) suggestions.size() != count) {
+				std::cout << "Directory index completed " << suggestions.size() << " entries for " << prefix << ", expected " << count << std::endl;
+				ret = false;
+			}
+			std::vector<FileDescription> descriptions = listing->getDescriptions();
+			if (descriptions.front().fileType != FileType::Directory || descriptions.back().fileType != FileType::File) {
+				std::cout << "Directory index does not list directories first." << std::endl;
+				ret = false;
+			}
+		}
+		//Changed in the same second as the listing, the index must list the directory again.
+		WriteTextFile(ConcatPath(dir, "added.txt"), "");
+		listing = index.waitForListing(dir);
+		if (listing.get() == nullptr || listing->size() != N + 2) {
+			std::cout << "Directory index missed an added file." << std::endl;
+			ret = false;
+		}
+		//Overwriting a file does not change the directory's modification time, the check must not stat every file.
+		//Wait out the one second resolution so the listing is newer than the last change.
+		std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+		listing = index.waitForListing(dir);
+		std::string overwritten = ConcatPath(dir, "file0.txt");
+		WriteTextFile(overwritten, "overwritten");
+		size_t publishCount;
+		{
+			std::lock_guard<std::mutex> lockMe(publishedLock);
+			publishCount = published.size();
+		}
+		DirectoryListingPtr unchanged = index.waitForListing(dir);
+		{
+			std::lock_guard<std::mutex> lockMe(publishedLock);
+			if (unchanged != listing || published.size() != publishCount) {
+				std::cout << "Directory index read an unchanged directory again." << std::endl;
+				ret = false;
+			}
+		}
+		index.invalidate(dir);
+		listing = index.waitForListing(dir);
+		std::vector<FileDescription> matches = (listing.get() != nullptr) ? listing->autoComplete(overwritten) : std::vector<FileDescription>();
+		if (matches.size() == 0 || matches.front().fileSize != GetFileSize(overwritten)) {
+			std::cout << "Directory index missed an overwritten file after invalidate()." << std::endl;
+			ret = false;
+		}
+		index.removeListener(id);
+		RemoveDirectoryRecursive(dir);
+		return ret;
+	}
+	bool SANITY_CHECK_FLUID3D() {
+		//Falling drop in a small domain, so only the blocks around it are active.
+		const int N = 32;
+		FluidSimulation3D fluid(int3(N), 1.0f / N);
+		SphereObject3D* drop = new SphereObject3D;
+		drop->mType = ObjectType::FLUID;
+		drop->mCenter = float3(0.5f, 0.6f, 0.5f);
+		drop->mRadius = 0.15f;
+		fluid.addSimulationObject(SimulationObject3DPtr(drop));
+		bool ret = true;
+		fluid.init();
+		size_t particleCount = fluid.getParticleCount();
+		size_t blocks = (N + 1 + SparseBlockGrid3D::BLOCK_MASK) / SparseBlockGrid3D::BLOCK_SIZE;
+		if (particleCount == 0 || fluid.getActiveBlockCount() >= blocks * blocks * blocks) {
+			std::cout << "Fluid 3D seeded " << particleCount << " particles in " << fluid.getActiveBlockCount() << " active blocks." << std::endl;
+			ret = false;
+		}
+		//Long enough for the drop to hit the floor. Divergence is relative to the largest velocity per voxel.
+		const float maxDivergence = 1E-4f;
+		Volume3f velocity;
+		for (int iter = 0; iter < 25; iter++) {
+			fluid.step();
+			fluid.getVelocity(velocity);
+			float maxSpeed = 0.0f;
+			for (const float3& v : velocity.data) {
+				maxSpeed = std::max(maxSpeed, length(v));
+			}
+			float div = fluid.getMaxDivergence() * fluid.getFluidVoxelSize() / std::max(maxSpeed, 1E-6f);
+			if (div > maxDivergence) {
+				std::cout << "Fluid 3D relative divergence " << div << " after projection at step " << iter << ", expected below " << maxDivergence << std::endl;
+				ret = false;
+			}
+			if (fluid.getParticleCount() != particleCount) {
+				std::cout << "Fluid 3D has " << fluid.getParticleCount() << " particles at step " << iter << ", expected " << particleCount << std::endl;
+				ret = false;
+			}
+		}
+		fluid.updateSurface();
+		const Mesh& surface = *fluid.getSurface();
+		//Closed if every edge is shared by exactly two triangles.
+		std::map<std::pair<uint32_t, uint32_t>, int> edges;
+		for (const uint3& tri : surface.triIndexes.data) {
+			for (int e = 0; e < 3; e++) {
+				uint32_t a = tri[e];
+				uint32_t b = tri[(e + 1) % 3];
+				edges[std::make_pair(std::min(a, b), std::max(a, b))]++;
+			}
+		}
+		int openEdges = 0;
+		for (const auto& pr : edges) {
+			if (pr.second != 2)
+				openEdges++;
+		}
+		if (surface.triIndexes.size() == 0 || openEdges > 0) {
+			std::cout << "Fluid 3D surface has " << surface.triIndexes.size() << " triangles and " << openEdges << " open edges." << std::endl;
+			ret = false;
+		}
+		return ret;
+	}
 	bool SANITY_CHECK_UI() {
 		CoordPercent rel(0.5f, 0.75f);
 		CoordDP abs(40, 30);
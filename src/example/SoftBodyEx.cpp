@@ -78,9 +78,9 @@ void SoftBodyEx::addBody() {
 	float theta = RandomUniform(0.0f, 2*ALY_PI);
 	float3 randomVelocity = float3(std::cos(theta),std::sin(theta), 1.0f);
 	randomVelocity = randomVelocity*maxVelocity.toFloat()*RandomUniform(0.0f, 1.0f);
-	for(ParticlePtr particle : body.particles){
-		particle->x.z += dropHeight.toFloat();
-		particle->v += randomVelocity;
+	for(size_t i = 0; i < body.positions.size(); i++){
+		body.positions[i].z += dropHeight.toFloat();
+		body.velocities[i] += randomVelocity;
 	}
 	bodies.push_back(dbody);
 }
@@ -105,37 +105,41 @@ bool SoftBodyEx::updatePhysics(){
 		body->doFracturing();
 		// Apply gravity and check floor
 
-		for(ParticlePtr particle : body->particles){
-			particle->f += gravity;
-			if (particle->x.z < lowZ){
+#pragma omp parallel for
+		for(int i = 0; i < (int)body->positions.size(); i++){
+			float3& x = body->positions[i];
+			float3& v = body->velocities[i];
+			float3& f = body->forces[i];
+			f += gravity;
+			if (x.z < lowZ){
 				// This particle has hit the floor
-				particle->f.z -= particle->x.z- lowZ;
-				particle->v = float3(0.0f);
-				particle->x.z = lowZ;
+				f.z -= x.z- lowZ;
+				v = float3(0.0f);
+				x.z = lowZ;
 			}
-			if (particle->x.x < lowX) {
+			if (x.x < lowX) {
 				// This particle has hit wall
-				particle->f.x -= (particle->x.x - lowX);
-				particle->v = float3(0.0f);
-				particle->x.x = lowX;
+				f.x -= (x.x - lowX);
+				v = float3(0.0f);
+				x.x = lowX;
 			}
-			if (particle->x.x > hiX) {
+			if (x.x > hiX) {
 				// This particle has hit wall
-				particle->f.x -= (particle->x.x - hiX);
-				particle->v = float3(0.0f);
-				particle->x.x = hiX;
+				f.x -= (x.x - hiX);
+				v = float3(0.0f);
+				x.x = hiX;
 			}
-			if (particle->x.y < lowY) {
+			if (x.y < lowY) {
 				// This particle has hit wall
-				particle->f.y -= (particle->x.y - lowY);
-				particle->v = float3(0.0f);
-				particle->x.y = lowY;
+				f.y -= (x.y - lowY);
+				v = float3(0.0f);
+				x.y = lowY;
 			}
-			if (particle->x.y > hiY) {
+			if (x.y > hiY) {
 				// This particle has hit wall
-				particle->f.y -= (particle->x.y - hiY);
-				particle->v = float3(0.0f);
-				particle->x.y = hiY;
+				f.y -= (x.y - hiY);
+				v = float3(0.0f);
+				x.y = hiY;
 			}
 		}
 		body->updateCellPositions();
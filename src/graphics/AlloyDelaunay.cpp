@@ -22,7 +22,12 @@
 //Re-implementation of Paul Bourke's incremental Delaunay construction algorithm.
 //http://paulbourke.net/papers/triangulate/cpp.zip
 #include "graphics/AlloyDelaunay.h"
+#include "math/AlloyPredicates.h"
+#include "common/AlloyCommon.h"
 #include <algorithm>
+#include <deque>
+#include <stdexcept>
+#include <cstdint>
 namespace aly {
 	bool CircumCircle(float xp, float yp, float x1, float y1, float x2,
 		float y2, float x3, float y3, float &xc, float &yc, float &r) {
@@ -157,32 +162,884 @@ namespace aly {
 			}
 		}
 	}
-	void MakeDelaunay(const std::vector<float2>& vertexes, std::vector<uint3>& output)
-	{
+	/*
+	 * Incremental Delaunay triangulation with ghost triangles. Every hull edge
+	 * u->w has a ghost triangle (u,w,GHOST) on its outside, so points outside the
+	 * hull are inserted with the same cavity search as points inside it. Ghost
+	 * triangles always store the ghost vertex last, and neighbor i is the
+	 * triangle across the edge opposite vertex i.
+	 */
+	class DelaunayBuilder {
+	protected:
+		const std::vector<float2>& points;
+		int ghost;
+		std::vector<int3> triangles;
+		std::vector<int3> neighbors;
+		//Bit i is set if the edge opposite vertex i is constrained.
+		std::vector<uint8_t> constrained;
+		std::vector<int> vertexTriangle;
+		std::vector<int> vertexMap;
+		std::vector<int> startAt, endAt;
+		std::vector<int> marks;
+		int stamp;
+		int lastTriangle;
+		uint32_t seed;
+		std::vector<int> cavity;
+		std::vector<int> stack;
+		std::vector<int3> boundary;
+		inline uint32_t random() {
+			seed = seed * 1664525u + 1013904223u;
+			return seed >> 16;
+		}
+		inline bool isGhost(int t) const {
+			return triangles[t].z == ghost;
+		}
+		inline double orient(int a, int b, int c) const {
+			return Orient2D(points[a], points[b], points[c]);
+		}
+		inline static int next(int i) {
+			return (i == 2) ? 0 : i + 1;
+		}
+		inline static int prev(int i) {
+			return (i == 0) ? 2 : i - 1;
+		}
+		inline static int find(const int3& tri, int v) {
+			return (tri.x == v) ? 0 : ((tri.y == v) ? 1 : 2);
+		}
+		//Collinear point p lies strictly between u and w.
+		bool between(int u, int w, const float2& p) const {
+			const float2& a = points[u];
+			const float2& b = points[w];
+			if (a.x != b.x) {
+				return (a.x < b.x) ? (a.x < p.x && p.x < b.x) : (b.x < p.x && p.x < a.x);
+			} else {
+				return (a.y < b.y) ? (a.y < p.y && p.y < b.y) : (b.y < p.y && p.y < a.y);
+			}
+		}
+		bool inCavity(int t, int v) const {
+			const int3& tri = triangles[t];
+			const float2& p = points[v];
+			if (tri.z == ghost) {
+				double o = Orient2D(points[tri.x], points[tri.y], p);
+				return (o > 0.0 || (o == 0.0 && between(tri.x, tri.y, p)));
+			}
+			return InCircle(points[tri.x], points[tri.y], points[tri.z], p) > 0.0;
+		}
+		//Sets the neighbor of t across directed edge a->b.
+		void setNeighbor(int t, int a, int b, int nbr) {
+			const int3& tri = triangles[t];
+			for (int i = 0; i < 3; i++) {
+				if (tri[next(i)] == a && tri[prev(i)] == b) {
+					neighbors[t][i] = nbr;
+					return;
+				}
+			}
+		}
+		void sortPoints(std::vector<int>& order) const;
+		int locate(int v);
+		void insert(int v);
+		bool findEdge(int u, int w, int& t, int& i) const;
+		void flip(int t1, int i1);
+		void insertSegment(int a, int b);
+		void legalize(std::vector<int2>& edges);
+	public:
+		DelaunayBuilder(const std::vector<float2>& points) :
+				points(points), ghost((int) points.size()), stamp(0), lastTriangle(-1), seed(12345) {
+		}
+		bool triangulate();
+		void constrain(const std::vector<uint2>& constraints);
+		void getTriangles(std::vector<uint3>& output) const;
+	};
+	//Hilbert curve index of a point on a 2^16 x 2^16 grid.
+	static uint32_t HilbertIndex(uint32_t x, uint32_t y) {
+		uint32_t d = 0;
+		for (uint32_t s = 1 << 15; s > 0; s >>= 1) {
+			uint32_t rx = (x & s) ? 1 : 0;
+			uint32_t ry = (y & s) ? 1 : 0;
+			d += s * s * ((3 * rx) ^ ry);
+			if (ry == 0) {
+				if (rx == 1) {
+					x = 0xFFFF - x;
+					y = 0xFFFF - y;
+				}
+				std::swap(x, y);
+			}
+		}
+		return d;
+	}
+	//Hilbert curve index of a point on a 2^10 x 2^10 x 2^10 grid (Skilling 2004).
+	static uint32_t HilbertIndex(uint32_t x, uint32_t y, uint32_t z) {
+		const int BITS = 10;
+		uint32_t X[3] = { x, y, z };
+		uint32_t t;
+		for (uint32_t Q = 1u << (BITS - 1); Q > 1; Q >>= 1) {
+			uint32_t P = Q - 1;
+			for (int i = 0; i < 3; i++) {
+				if (X[i] & Q) {
+					X[0] ^= P;
+				} else {
+					t = (X[0] ^ X[i]) & P;
+					X[0] ^= t;
+					X[i] ^= t;
+				}
+			}
+		}
+		X[1] ^= X[0];
+		X[2] ^= X[1];
+		t = 0;
+		for (uint32_t Q = 1u << (BITS - 1); Q > 1; Q >>= 1) {
+			if (X[2] & Q)
+				t ^= Q - 1;
+		}
+		uint32_t d = 0;
+		for (int j = BITS - 1; j >= 0; j--) {
+			for (int i = 0; i < 3; i++) {
+				d = (d << 1) | (((X[i] ^ t) >> j) & 1);
+			}
+		}
+		return d;
+	}
+	/*
+	 * Biased randomized insertion order (Amenta, Choi and Rote 2003). Each point is
+	 * assigned to a round so that every round is about twice as large as the one
+	 * before it, and points within a round follow the Hilbert curve.
+	 */
+	static int BrioRounds(int N) {
+		int rounds = 1;
+		while ((N >> rounds) >= 1024 && rounds < 24) {
+			rounds++;
+		}
+		return rounds;
+	}
+	static uint64_t BrioRound(int i, int rounds) {
+		uint32_t h = (uint32_t) i * 2654435761u;
+		h ^= h >> 15;
+		h *= 2246822519u;
+		h ^= h >> 13;
+		int zeros = 0;
+		while (zeros < rounds - 1 && (h & (1u << zeros)) == 0) {
+			zeros++;
+		}
+		return (uint64_t) (rounds - 1 - zeros) << 32;
+	}
+	//Sorts insertion keys in parallel chunks that are then merged pairwise.
+	static void SortInsertionOrder(std::vector<std::pair<uint64_t, int>>& keys, std::vector<int>& order) {
+		const int SORT_CHUNKS = 16;
+		int N = (int) keys.size();
+		std::vector<int> bounds(SORT_CHUNKS + 1);
+		for (int c = 0; c <= SORT_CHUNKS; c++) {
+			bounds[c] = (int) (((int64_t) N * c) / SORT_CHUNKS);
+		}
+#pragma omp parallel for
+		for (int c = 0; c < SORT_CHUNKS; c++) {
+			std::sort(keys.begin() + bounds[c], keys.begin() + bounds[c + 1]);
+		}
+		for (int width = 1; width < SORT_CHUNKS; width *= 2) {
+#pragma omp parallel for
+			for (int c = 0; c < SORT_CHUNKS / (2 * width); c++) {
+				int lo = 2 * width * c;
+				std::inplace_merge(keys.begin() + bounds[lo], keys.begin() + bounds[lo + width],
+						keys.begin() + bounds[lo + 2 * width]);
+			}
+		}
+		order.resize(N);
+		for (int i = 0; i < N; i++) {
+			order[i] = keys[i].second;
+		}
+	}
+	void DelaunayBuilder::sortPoints(std::vector<int>& order) const {
+		int N = (int) points.size();
+		float2 minPt = points[0], maxPt = points[0];
+		for (int i = 1; i < N; i++) {
+			minPt = aly::min(minPt, points[i]);
+			maxPt = aly::max(maxPt, points[i]);
+		}
+		float2 scale = 65535.0f / aly::max(maxPt - minPt, float2(1E-30f));
+		int rounds = BrioRounds(N);
+		std::vector<std::pair<uint64_t, int>> keys(N);
+#pragma omp parallel for
+		for (int i = 0; i < N; i++) {
+			float2 q = (points[i] - minPt) * scale;
+			uint32_t x = (uint32_t) aly::clamp(q.x, 0.0f, 65535.0f);
+			uint32_t y = (uint32_t) aly::clamp(q.y, 0.0f, 65535.0f);
+			keys[i] = std::pair<uint64_t, int>(BrioRound(i, rounds) | HilbertIndex(x, y), i);
+		}
+		SortInsertionOrder(keys, order);
+	}
+	//Walks from the last inserted triangle toward v. Returns a real triangle containing v or a ghost triangle visible from it.
+	int DelaunayBuilder::locate(int v) {
+		const float2& p = points[v];
+		int t = lastTriangle;
+		int from = -1;
+		while (!isGhost(t)) {
+			const int3& tri = triangles[t];
+			int r = (int) (random() % 3);
+			int nt = -1;
+			for (int e = 0; e < 3; e++) {
+				int i = (r + e) % 3;
+				int nbr = neighbors[t][i];
+				if (nbr != from && Orient2D(points[tri[next(i)]], points[tri[prev(i)]], p) < 0.0) {
+					nt = nbr;
+					break;
+				}
+			}
+			if (nt < 0)
+				break;
+			from = t;
+			t = nt;
+		}
+		return t;
+	}
+	void DelaunayBuilder::insert(int v) {
+		int t = locate(v);
+		if (!isGhost(t)) {
+			const int3& tri = triangles[t];
+			for (int i = 0; i < 3; i++) {
+				if (points[tri[i]] == points[v]) {
+					vertexMap[v] = tri[i];
+					return;
+				}
+			}
+		}
+		stamp++;
+		cavity.clear();
+		boundary.clear();
+		stack.clear();
+		marks[t] = stamp;
+		stack.push_back(t);
+		while (!stack.empty()) {
+			int c = stack.back();
+			stack.pop_back();
+			cavity.push_back(c);
+			for (int i = 0; i < 3; i++) {
+				int nbr = neighbors[c][i];
+				if (marks[nbr] == stamp)
+					continue;
+				if (inCavity(nbr, v)) {
+					marks[nbr] = stamp;
+					stack.push_back(nbr);
+				} else {
+					boundary.push_back(int3(triangles[c][next(i)], triangles[c][prev(i)], nbr));
+				}
+			}
+		}
+		//A cavity of k triangles has k+2 boundary edges, so two new triangles are added.
+		int last = (int) triangles.size();
+		triangles.resize(last + 2);
+		neighbors.resize(last + 2);
+		marks.resize(last + 2, 0);
+		cavity.push_back(last);
+		cavity.push_back(last + 1);
+		for (size_t n = 0; n < boundary.size(); n++) {
+			int a = boundary[n].x;
+			int b = boundary[n].y;
+			int nt = cavity[n];
+			triangles[nt] = (a == ghost) ? int3(b, v, a) : int3(v, a, b);
+			startAt[a] = nt;
+			endAt[b] = nt;
+		}
+		for (size_t n = 0; n < boundary.size(); n++) {
+			int a = boundary[n].x;
+			int b = boundary[n].y;
+			int outside = boundary[n].z;
+			int nt = cavity[n];
+			if (a == ghost) {
+				neighbors[nt] = int3(endAt[a], outside, startAt[b]);
+			} else {
+				neighbors[nt] = int3(outside, startAt[b], endAt[a]);
+				lastTriangle = (b == ghost) ? lastTriangle : nt;
+			}
+			setNeighbor(outside, b, a, nt);
+			if (a != ghost)
+				vertexTriangle[a] = nt;
+		}
+		vertexTriangle[v] = lastTriangle;
+	}
+	bool DelaunayBuilder::triangulate() {
+		int N = (int) points.size();
+		vertexMap.resize(N);
+		for (int i = 0; i < N; i++) {
+			vertexMap[i] = i;
+		}
+		vertexTriangle.assign(N + 1, -1);
+		startAt.assign(N + 1, -1);
+		endAt.assign(N + 1, -1);
+		if (N < 3)
+			return false;
+		std::vector<int> order;
+		sortPoints(order);
+		//Seed with the first three points in insertion order that are not collinear.
+		int i0 = order[0], i1 = -1, i2 = -1;
+		int n = 1;
+		for (; n < N; n++) {
+			if (points[order[n]] != points[i0]) {
+				i1 = order[n];
+				break;
+			}
+		}
+		for (n++; n < N && i1 >= 0; n++) {
+			if (orient(i0, i1, order[n]) != 0.0) {
+				i2 = order[n];
+				break;
+			}
+		}
+		if (i2 < 0)
+			return false;
+		if (orient(i0, i1, i2) < 0.0) {
+			std::swap(i1, i2);
+		}
+		triangles.reserve(2 * N + 4);
+		neighbors.reserve(2 * N + 4);
+		triangles.push_back(int3(i0, i1, i2));
+		triangles.push_back(int3(i2, i1, ghost));
+		triangles.push_back(int3(i0, i2, ghost));
+		triangles.push_back(int3(i1, i0, ghost));
+		neighbors.push_back(int3(1, 2, 3));
+		neighbors.push_back(int3(3, 2, 0));
+		neighbors.push_back(int3(1, 3, 0));
+		neighbors.push_back(int3(2, 1, 0));
+		marks.assign(4, 0);
+		vertexTriangle[i0] = vertexTriangle[i1] = vertexTriangle[i2] = 0;
+		lastTriangle = 0;
+		for (int v : order) {
+			if (v != i0 && v != i1 && v != i2) {
+				insert(v);
+			}
+		}
+		return true;
+	}
+	//Finds the triangle t containing directed edge u->w, with i the index of the opposite vertex.
+	bool DelaunayBuilder::findEdge(int u, int w, int& t, int& i) const {
+		int start = vertexTriangle[u];
+		t = start;
+		do {
+			const int3& tri = triangles[t];
+			int iu = find(tri, u);
+			if (tri[next(iu)] == w) {
+				i = prev(iu);
+				return true;
+			}
+			t = neighbors[t][next(iu)];
+		} while (t != start);
+		return false;
+	}
+	//Replaces the edge opposite vertex i1 of t1 with the other diagonal of the quadrilateral.
+	void DelaunayBuilder::flip(int t1, int i1) {
+		int3 tri1 = triangles[t1];
+		int x = tri1[i1], u = tri1[next(i1)], w = tri1[prev(i1)];
+		int t2 = neighbors[t1][i1];
+		int3 tri2 = triangles[t2];
+		int i2 = find(tri2, w);
+		i2 = prev(i2);
+		int y = tri2[i2];
+		int nwx = neighbors[t1][next(i1)], nxu = neighbors[t1][prev(i1)];
+		int nuy = neighbors[t2][next(i2)], nyw = neighbors[t2][prev(i2)];
+		bool cwx = (constrained[t1] >> next(i1)) & 1, cxu = (constrained[t1] >> prev(i1)) & 1;
+		bool cuy = (constrained[t2] >> next(i2)) & 1, cyw = (constrained[t2] >> prev(i2)) & 1;
+		triangles[t1] = int3(x, u, y);
+		neighbors[t1] = int3(nuy, t2, nxu);
+		constrained[t1] = (uint8_t) (cuy | (cxu << 2));
+		triangles[t2] = int3(y, w, x);
+		neighbors[t2] = int3(nwx, t1, nyw);
+		constrained[t2] = (uint8_t) (cwx | (cyw << 2));
+		setNeighbor(nuy, y, u, t1);
+		setNeighbor(nwx, x, w, t2);
+		vertexTriangle[u] = t1;
+		vertexTriangle[w] = t2;
+		vertexTriangle[x] = t1;
+		vertexTriangle[y] = t2;
+	}
+	//Lawson flips on the given edges and the edges around every flip until all unconstrained edges are Delaunay.
+	void DelaunayBuilder::legalize(std::vector<int2>& edges) {
+		while (!edges.empty()) {
+			int2 e = edges.back();
+			edges.pop_back();
+			int t1, i1;
+			if (!findEdge(e.x, e.y, t1, i1))
+				continue;
+			int t2 = neighbors[t1][i1];
+			if (isGhost(t1) || isGhost(t2) || ((constrained[t1] >> i1) & 1))
+				continue;
+			const int3& tri1 = triangles[t1];
+			int x = tri1[i1], u = tri1[next(i1)], w = tri1[prev(i1)];
+			int y = triangles[t2][prev(find(triangles[t2], w))];
+			if (InCircle(points[x], points[u], points[w], points[y]) > 0.0) {
+				flip(t1, i1);
+				edges.push_back(int2(x, u));
+				edges.push_back(int2(u, y));
+				edges.push_back(int2(y, w));
+				edges.push_back(int2(w, x));
+			}
+		}
+	}
+	/*
+	 * Inserts segment a-b by flipping away every edge that crosses it (Sloan 1993)
+	 * and then restoring the Delaunay property around the new edges. The segment
+	 * is split at vertices lying on it.
+	 */
+	void DelaunayBuilder::insertSegment(int a, int b) {
+		while (a != b) {
+			const float2& pa = points[a];
+			const float2& pb = points[b];
+			auto forward = [&](int u) {
+				return (pa.x != pb.x) ? ((points[u].x > pa.x) == (pb.x > pa.x)) : ((points[u].y > pa.y) == (pb.y > pa.y));
+			};
+			//Find the edge a->c of the segment or the first edge it crosses.
+			int start = vertexTriangle[a];
+			int t = start;
+			int c = -1;
+			int2 crossing(-1, -1);
+			do {
+				const int3& tri = triangles[t];
+				int ia = find(tri, a);
+				int u = tri[next(ia)], w = tri[prev(ia)];
+				if (!isGhost(t)) {
+					if (u == b || w == b) {
+						c = b;
+						break;
+					}
+					double ou = orient(a, b, u), ow = orient(a, b, w);
+					if (ou == 0.0 && forward(u)) {
+						c = u;
+						break;
+					}
+					if (ow == 0.0 && forward(w)) {
+						c = w;
+						break;
+					}
+					if (ou < 0.0 && ow > 0.0) {
+						crossing = int2(u, w);
+						break;
+					}
+				}
+				t = neighbors[t][next(ia)];
+			} while (t != start);
+			if (c < 0 && crossing.x < 0) {
+				throw std::runtime_error(MakeString() << "Could not insert constrained edge (" << a << "," << b << ").");
+			}
+			std::deque<int2> queue;
+			if (c < 0) {
+				//Walk along the segment collecting crossed edges until reaching b or a vertex on the segment.
+				int2 e = crossing;
+				while (true) {
+					int t1, i1;
+					findEdge(e.x, e.y, t1, i1);
+					if ((constrained[t1] >> i1) & 1) {
+						throw std::runtime_error(MakeString() << "Constrained edge (" << a << "," << b << ") crosses another constrained edge.");
+					}
+					queue.push_back(e);
+					int t2 = neighbors[t1][i1];
+					int x = triangles[t2][prev(find(triangles[t2], e.y))];
+					if (x == b) {
+						c = b;
+						break;
+					}
+					double ox = orient(a, b, x);
+					if (ox == 0.0) {
+						c = x;
+						break;
+					}
+					e = (ox < 0.0) ? int2(x, e.y) : int2(e.x, x);
+				}
+			}
+			std::vector<int2> created;
+			while (!queue.empty()) {
+				int2 e = queue.front();
+				queue.pop_front();
+				int t1, i1;
+				findEdge(e.x, e.y, t1, i1);
+				int t2 = neighbors[t1][i1];
+				int x = triangles[t1][i1];
+				int y = triangles[t2][prev(find(triangles[t2], e.y))];
+				//Only flip if the quadrilateral x,u,y,w is strictly convex.
+				if (orient(x, y, e.x) < 0.0 && orient(x, y, e.y) > 0.0) {
+					flip(t1, i1);
+					bool crosses = false;
+					if (x != a && x != c && y != a && y != c) {
+						double ox = orient(a, c, x), oy = orient(a, c, y);
+						crosses = (ox < 0.0 && oy > 0.0) || (ox > 0.0 && oy < 0.0);
+					}
+					if (crosses) {
+						queue.push_back(int2(x, y));
+					} else {
+						created.push_back(int2(x, y));
+					}
+				} else {
+					queue.push_back(e);
+				}
+			}
+			int t1, i1;
+			if (findEdge(a, c, t1, i1)) {
+				constrained[t1] |= (uint8_t) (1 << i1);
+			}
+			if (findEdge(c, a, t1, i1)) {
+				constrained[t1] |= (uint8_t) (1 << i1);
+			}
+			legalize(created);
+			a = c;
+		}
+	}
+	void DelaunayBuilder::constrain(const std::vector<uint2>& constraints) {
+		constrained.assign(triangles.size(), 0);
+		int N = (int) points.size();
+		for (const uint2& edge : constraints) {
+			if ((int) edge.x >= N || (int) edge.y >= N) {
+				throw std::runtime_error(MakeString() << "Constrained edge (" << edge.x << "," << edge.y << ") is out of range.");
+			}
+			insertSegment(vertexMap[edge.x], vertexMap[edge.y]);
+		}
+	}
+	void DelaunayBuilder::getTriangles(std::vector<uint3>& output) const {
+		output.clear();
+		output.reserve(triangles.size() / 2);
+		for (size_t t = 0; t < triangles.size(); t++) {
+			if (!isGhost((int) t)) {
+				const int3& tri = triangles[t];
+				output.push_back(uint3((uint32_t) tri.x, (uint32_t) tri.y, (uint32_t) tri.z));
+			}
+		}
+	}
+	void MakeDelaunay(const std::vector<float2>& vertexes, std::vector<uint3>& output) {
+		MakeDelaunay(vertexes, std::vector<uint2>(), output);
+	}
+	void MakeDelaunay(const std::vector<float2>& vertexes, const std::vector<uint2>& constraints, std::vector<uint3>& output) {
 		output.clear();
-		if (vertexes.size() < 3) {
+		DelaunayBuilder builder(vertexes);
+		if (!builder.triangulate()) {
 			return;
 		}
-		int N = (int)vertexes.size();
-		std::vector<std::pair<float2, int>> vertPairs(N);
-		int index = 0;
-		for (const float2& vert : vertexes) {
-			vertPairs[index] = std::pair<float2, int>(vert, index);
-			index++;
-		}
-		std::sort(vertPairs.begin(), vertPairs.end());
-		std::vector<float2> tmp;
-		tmp.reserve(vertPairs.size());
-		for (std::pair<float2, int>& pr : vertPairs) {
-			tmp.push_back(pr.first);
-		}
-		std::vector<int3>	cTriangles;
-		Triangulate(tmp, cTriangles);
-		for (int3& triangle : cTriangles) {
-			if (triangle.x < N &&
-				triangle.y < N &&
-				triangle.z < N) {
-				output.push_back(uint3((uint32_t)vertPairs[triangle.x].second, (uint32_t)vertPairs[triangle.y].second, vertPairs[triangle.z].second));
+		if (constraints.size() > 0) {
+			builder.constrain(constraints);
+		}
+		builder.getTriangles(output);
+	}
+	//Vertices of the face opposite vertex i, ordered so that vertex i lies on its positive side.
+	static const int TET_FACES[4][3] = { { 1, 3, 2 }, { 0, 2, 3 }, { 0, 3, 1 }, { 0, 1, 2 } };
+	/*
+	 * Incremental Delaunay tetrahedralization with ghost tetrahedra, the 3D
+	 * counterpart of DelaunayBuilder. Hull faces have a ghost tetrahedron
+	 * (a,b,c,GHOST) on their outside, tetrahedra satisfy Orient3D(v0,v1,v2,v3) > 0
+	 * and neighbor i is the tetrahedron across the face opposite vertex i.
+	 * Tetrahedra removed by a cavity that shrank are kept on a free list.
+	 */
+	class DelaunayBuilder3D {
+	protected:
+		const std::vector<float3>& points;
+		int ghost;
+		std::vector<int4> tets;
+		std::vector<int4> neighbors;
+		std::vector<int> freeTets;
+		std::vector<int> marks;
+		int stamp;
+		int lastTet;
+		uint32_t seed;
+		std::vector<int> cavity;
+		std::vector<int> stack;
+		std::vector<int4> boundary;
+		std::vector<int> created;
+		//Directed edges of the new faces around the inserted point, chained per start vertex.
+		std::vector<int> edgeHead;
+		std::vector<int4> edges;
+		inline uint32_t random() {
+			seed = seed * 1664525u + 1013904223u;
+			return seed >> 16;
+		}
+		inline bool isGhost(int t) const {
+			return tets[t].w == ghost;
+		}
+		inline double orient(int t, int i, const float3& p) const {
+			const int4& tet = tets[t];
+			return Orient3D(points[tet[TET_FACES[i][0]]], points[tet[TET_FACES[i][1]]], points[tet[TET_FACES[i][2]]], p);
+		}
+		bool inCavity(int t, int v) const {
+			const int4& tet = tets[t];
+			const float3& p = points[v];
+			if (tet.w == ghost) {
+				//Open half space beyond the hull face plus the open circumdisk of the face. Any sphere
+				//through the face meets its plane in that circle, so the real neighbor's sphere decides.
+				double o = orient(t, 3, p);
+				if (o != 0.0)
+					return (o > 0.0);
+				const int4& nbr = tets[neighbors[t].w];
+				return InSphere(points[nbr.x], points[nbr.y], points[nbr.z], points[nbr.w], p) > 0.0;
+			}
+			return InSphere(points[tet.x], points[tet.y], points[tet.z], points[tet.w], p) > 0.0;
+		}
+		//Sets the neighbor of t across the face with vertices a, b, c.
+		void setNeighbor(int t, int a, int b, int c, int nbr) {
+			const int4& tet = tets[t];
+			for (int i = 0; i < 4; i++) {
+				if (tet[i] != a && tet[i] != b && tet[i] != c) {
+					neighbors[t][i] = nbr;
+					return;
+				}
+			}
+		}
+		int allocate() {
+			if (freeTets.size() > 0) {
+				int t = freeTets.back();
+				freeTets.pop_back();
+				return t;
+			}
+			tets.push_back(int4(-1));
+			neighbors.push_back(int4(-1));
+			marks.push_back(0);
+			return (int) tets.size() - 1;
+		}
+		void link(int t, int i, int v);
+		void sortPoints(std::vector<int>& order) const;
+		int locate(int v);
+		void insert(int v);
+	public:
+		DelaunayBuilder3D(const std::vector<float3>& points) :
+				points(points), ghost((int) points.size()), stamp(0), lastTet(-1), seed(12345) {
+		}
+		bool tetrahedralize();
+		void getTetrahedra(std::vector<uint4>& output, std::vector<int4>* outputNeighbors) const;
+	};
+	void DelaunayBuilder3D::sortPoints(std::vector<int>& order) const {
+		int N = (int) points.size();
+		float3 minPt = points[0], maxPt = points[0];
+		for (int i = 1; i < N; i++) {
+			minPt = aly::min(minPt, points[i]);
+			maxPt = aly::max(maxPt, points[i]);
+		}
+		float3 scale = 1023.0f / aly::max(maxPt - minPt, float3(1E-30f));
+		int rounds = BrioRounds(N);
+		std::vector<std::pair<uint64_t, int>> keys(N);
+#pragma omp parallel for
+		for (int i = 0; i < N; i++) {
+			float3 q = (points[i] - minPt) * scale;
+			uint32_t x = (uint32_t) aly::clamp(q.x, 0.0f, 1023.0f);
+			uint32_t y = (uint32_t) aly::clamp(q.y, 0.0f, 1023.0f);
+			uint32_t z = (uint32_t) aly::clamp(q.z, 0.0f, 1023.0f);
+			keys[i] = std::pair<uint64_t, int>(BrioRound(i, rounds) | HilbertIndex(x, y, z), i);
+		}
+		SortInsertionOrder(keys, order);
+	}
+	int DelaunayBuilder3D::locate(int v) {
+		const float3& p = points[v];
+		int t = lastTet;
+		int from = -1;
+		while (!isGhost(t)) {
+			int r = (int) (random() & 3);
+			int nt = -1;
+			for (int e = 0; e < 4; e++) {
+				int i = (r + e) & 3;
+				int nbr = neighbors[t][i];
+				if (nbr != from && orient(t, i, p) < 0.0) {
+					nt = nbr;
+					break;
+				}
+			}
+			if (nt < 0)
+				break;
+			from = t;
+			t = nt;
+		}
+		return t;
+	}
+	//Registers the face opposite vertex i of new tetrahedron t, which contains v, and links it to its twin if present.
+	void DelaunayBuilder3D::link(int t, int i, int v) {
+		const int4& tet = tets[t];
+		int f[3] = { tet[TET_FACES[i][0]], tet[TET_FACES[i][1]], tet[TET_FACES[i][2]] };
+		int k = (f[0] == v) ? 0 : ((f[1] == v) ? 1 : 2);
+		int u = f[(k + 1) % 3], w = f[(k + 2) % 3];
+		//The twin face traverses the edge as w->u.
+		for (int e = edgeHead[w]; e >= 0; e = edges[e].w) {
+			if (edges[e].x == u) {
+				neighbors[t][i] = edges[e].y;
+				neighbors[edges[e].y][edges[e].z] = t;
+				return;
+			}
+		}
+		edges.push_back(int4(w, t, i, edgeHead[u]));
+		edgeHead[u] = (int) edges.size() - 1;
+	}
+	void DelaunayBuilder3D::insert(int v) {
+		int t = locate(v);
+		if (!isGhost(t)) {
+			const int4& tet = tets[t];
+			for (int i = 0; i < 4; i++) {
+				if (points[tet[i]] == points[v]) {
+					return;
+				}
+			}
+		}
+		stamp++;
+		cavity.clear();
+		boundary.clear();
+		stack.clear();
+		marks[t] = stamp;
+		stack.push_back(t);
+		while (!stack.empty()) {
+			int c = stack.back();
+			stack.pop_back();
+			cavity.push_back(c);
+			for (int i = 0; i < 4; i++) {
+				int nbr = neighbors[c][i];
+				if (marks[nbr] == stamp)
+					continue;
+				if (inCavity(nbr, v)) {
+					marks[nbr] = stamp;
+					stack.push_back(nbr);
+				} else {
+					const int4& tet = tets[c];
+					boundary.push_back(int4(tet[TET_FACES[i][0]], tet[TET_FACES[i][1]], tet[TET_FACES[i][2]], nbr));
+				}
+			}
+		}
+		for (size_t n = boundary.size(); n < cavity.size(); n++) {
+			tets[cavity[n]] = int4(-1);
+			freeTets.push_back(cavity[n]);
+		}
+		created.clear();
+		for (size_t n = 0; n < boundary.size(); n++) {
+			int nt = (n < cavity.size()) ? cavity[n] : allocate();
+			int4 b = boundary[n];
+			int x[4] = { b.x, b.y, b.z, v };
+			int k = (b.x == ghost) ? 0 : ((b.y == ghost) ? 1 : ((b.z == ghost) ? 2 : 3));
+			//Even permutation that moves the ghost vertex last.
+			int4 tet = (k == 3) ? int4(x[0], x[1], x[2], x[3]) : int4(x[TET_FACES[k][0]], x[TET_FACES[k][1]], x[TET_FACES[k][2]], x[k]);
+			tets[nt] = tet;
+			for (int i = 0; i < 4; i++) {
+				if (tet[i] == v) {
+					neighbors[nt][i] = b.w;
+				}
+			}
+			setNeighbor(b.w, b.x, b.y, b.z, nt);
+			created.push_back(nt);
+			if (k == 3)
+				lastTet = nt;
+		}
+		for (int nt : created) {
+			for (int i = 0; i < 4; i++) {
+				if (tets[nt][i] != v)
+					link(nt, i, v);
+			}
+		}
+		for (const int4& b : boundary) {
+			edgeHead[b.x] = edgeHead[b.y] = edgeHead[b.z] = -1;
+		}
+		edges.clear();
+	}
+	bool DelaunayBuilder3D::tetrahedralize() {
+		int N = (int) points.size();
+		if (N < 4)
+			return false;
+		edgeHead.assign(N + 1, -1);
+		std::vector<int> order;
+		sortPoints(order);
+		//Seed with the first four points in insertion order that span a tetrahedron.
+		int seedPoints[4] = { order[0], -1, -1, -1 };
+		int n = 1;
+		for (; n < N && seedPoints[1] < 0; n++) {
+			if (points[order[n]] != points[seedPoints[0]])
+				seedPoints[1] = order[n];
+		}
+		for (; n < N && seedPoints[2] < 0; n++) {
+			const float3& a = points[seedPoints[0]];
+			const float3& b = points[seedPoints[1]];
+			const float3& c = points[order[n]];
+			if (Orient2D(a.x, a.y, b.x, b.y, c.x, c.y) != 0.0 || Orient2D(a.y, a.z, b.y, b.z, c.y, c.z) != 0.0
+					|| Orient2D(a.x, a.z, b.x, b.z, c.x, c.z) != 0.0)
+				seedPoints[2] = order[n];
+		}
+		for (; n < N && seedPoints[3] < 0; n++) {
+			if (Orient3D(points[seedPoints[0]], points[seedPoints[1]], points[seedPoints[2]], points[order[n]]) != 0.0)
+				seedPoints[3] = order[n];
+		}
+		if (seedPoints[3] < 0)
+			return false;
+		if (Orient3D(points[seedPoints[0]], points[seedPoints[1]], points[seedPoints[2]], points[seedPoints[3]]) < 0.0) {
+			std::swap(seedPoints[2], seedPoints[3]);
+		}
+		int4 first(seedPoints[0], seedPoints[1], seedPoints[2], seedPoints[3]);
+		tets.reserve(7 * N);
+		neighbors.reserve(7 * N);
+		marks.reserve(7 * N);
+		tets.push_back(first);
+		neighbors.push_back(int4(1, 2, 3, 4));
+		marks.push_back(0);
+		for (int i = 0; i < 4; i++) {
+			//Reversed face so that the outside is on the positive side.
+			tets.push_back(int4(first[TET_FACES[i][0]], first[TET_FACES[i][2]], first[TET_FACES[i][1]], ghost));
+			neighbors.push_back(int4(-1, -1, -1, 0));
+			marks.push_back(0);
+		}
+		//Ghosts share a face with each other for every edge of the first tetrahedron.
+		for (int t = 1; t <= 4; t++) {
+			for (int s = t + 1; s <= 4; s++) {
+				for (int i = 0; i < 3; i++) {
+					int missing = -1;
+					for (int j = 0; j < 3; j++) {
+						int v = tets[s][j];
+						if (v != tets[t].x && v != tets[t].y && v != tets[t].z)
+							missing = j;
+					}
+					if (tets[t][i] != tets[s].x && tets[t][i] != tets[s].y && tets[t][i] != tets[s].z && missing >= 0) {
+						neighbors[t][i] = s;
+						neighbors[s][missing] = t;
+					}
+				}
+			}
+		}
+		lastTet = 0;
+		for (int i = 0; i < N; i++) {
+			int v = order[i];
+			if (v != first.x && v != first.y && v != first.z && v != first.w) {
+				insert(v);
+			}
+		}
+		return true;
+	}
+	void DelaunayBuilder3D::getTetrahedra(std::vector<uint4>& output, std::vector<int4>* outputNeighbors) const {
+		std::vector<int> index(tets.size(), -1);
+		int count = 0;
+		for (size_t t = 0; t < tets.size(); t++) {
+			if (tets[t].x >= 0 && !isGhost((int) t)) {
+				index[t] = count++;
+			}
+		}
+		output.resize(count);
+		if (outputNeighbors)
+			outputNeighbors->resize(count);
+#pragma omp parallel for
+		for (int t = 0; t < (int) tets.size(); t++) {
+			int idx = index[t];
+			if (idx < 0)
+				continue;
+			const int4& tet = tets[t];
+			output[idx] = uint4((uint32_t) tet.x, (uint32_t) tet.y, (uint32_t) tet.z, (uint32_t) tet.w);
+			if (outputNeighbors) {
+				const int4& nbr = neighbors[t];
+				(*outputNeighbors)[idx] = int4(index[nbr.x], index[nbr.y], index[nbr.z], index[nbr.w]);
+			}
+		}
+	}
+	void MakeDelaunay(const std::vector<float3>& vertexes, std::vector<uint4>& tetrahedra) {
+		tetrahedra.clear();
+		DelaunayBuilder3D builder(vertexes);
+		if (builder.tetrahedralize()) {
+			builder.getTetrahedra(tetrahedra, nullptr);
+		}
+	}
+	void MakeDelaunay(const std::vector<float3>& vertexes, std::vector<uint4>& tetrahedra, std::vector<int4>& neighbors) {
+		tetrahedra.clear();
+		neighbors.clear();
+		DelaunayBuilder3D builder(vertexes);
+		if (builder.tetrahedralize()) {
+			builder.getTetrahedra(tetrahedra, &neighbors);
+		}
+	}
+	void GetBoundaryFaces(const std::vector<uint4>& tetrahedra, const std::vector<int4>& neighbors, std::vector<uint3>& faces) {
+		faces.clear();
+		for (size_t t = 0; t < tetrahedra.size(); t++) {
+			const uint4& tet = tetrahedra[t];
+			for (int i = 0; i < 4; i++) {
+				if (neighbors[t][i] < 0) {
+					faces.push_back(uint3(tet[TET_FACES[i][0]], tet[TET_FACES[i][1]], tet[TET_FACES[i][2]]));
+				}
 			}
 		}
 	}
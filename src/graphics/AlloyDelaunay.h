@@ -25,14 +25,53 @@
 #include "math/AlloyVector.h"
 #include <iostream>
 namespace aly {
-	void Triangulate(std::vector<float2>& pxyz, std::vector<uint3>& v);
+	bool SANITY_CHECK_DELAUNAY();
+	//Bourke's quadratic incremental algorithm, kept for reference. Use MakeDelaunay() instead.
+	void Triangulate(std::vector<float2>& pxyz, std::vector<int3>& v);
 	bool CircumCircle(float, float, float, float, float, float, float, float, float&, float&, float&);
+	/*
+	 * Delaunay triangulation of a point set. Points are inserted in a biased
+	 * randomized Hilbert curve order with Bowyer-Watson cavity retriangulation
+	 * and exact predicates, so it runs in expected O(n log n) time and handles
+	 * duplicate, collinear and cocircular points. Triangles are counterclockwise
+	 * in a y-up frame and duplicate points are referenced through their first
+	 * occurrence. Nothing is output if all points are collinear.
+	 */
 	void MakeDelaunay(const std::vector<float2>& vertexes, std::vector<uint3>& output);
+	/*
+	 * Constrained Delaunay triangulation. Every edge in constraints is present in
+	 * the output, split at any vertex lying on it, and the remaining edges are as
+	 * Delaunay as the constraints allow. Throws if two constraints cross.
+	 */
+	void MakeDelaunay(const std::vector<float2>& vertexes, const std::vector<uint2>& constraints, std::vector<uint3>& output);
+	/*
+	 * Delaunay tetrahedralization of a point set, built the same way as the 2D
+	 * triangulation. Tetrahedra (a,b,c,d) are positively oriented, that is
+	 * Orient3D(a,b,c,d) > 0 with d below the counterclockwise face (a,b,c).
+	 * Nothing is output if all points are coplanar.
+	 */
+	void MakeDelaunay(const std::vector<float3>& vertexes, std::vector<uint4>& tetrahedra);
+	//Also returns the tetrahedron across the face opposite each vertex, or -1 on the hull.
+	void MakeDelaunay(const std::vector<float3>& vertexes, std::vector<uint4>& tetrahedra, std::vector<int4>& neighbors);
+	//Hull faces of a tetrahedral mesh with outward counterclockwise winding, suitable for Mesh::triIndexes.
+	void GetBoundaryFaces(const std::vector<uint4>& tetrahedra, const std::vector<int4>& neighbors, std::vector<uint3>& faces);
 	inline void MakeDelaunay(const Vector2f& vertexes, std::vector<uint3>& output) {
 		MakeDelaunay(vertexes.data, output);
 	}
 	inline void MakeDelaunay(const Vector2f& vertexes, Vector3ui& output) {
 		MakeDelaunay(vertexes.data, output.data);
 	}
+	inline void MakeDelaunay(const Vector2f& vertexes, const Vector2ui& constraints, Vector3ui& output) {
+		MakeDelaunay(vertexes.data, constraints.data, output.data);
+	}
+	inline void MakeDelaunay(const Vector3f& vertexes, Vector4ui& tetrahedra) {
+		MakeDelaunay(vertexes.data, tetrahedra.data);
+	}
+	inline void MakeDelaunay(const Vector3f& vertexes, Vector4ui& tetrahedra, Vector4i& neighbors) {
+		MakeDelaunay(vertexes.data, tetrahedra.data, neighbors.data);
+	}
+	inline void GetBoundaryFaces(const Vector4ui& tetrahedra, const Vector4i& neighbors, Vector3ui& faces) {
+		GetBoundaryFaces(tetrahedra.data, neighbors.data, faces.data);
+	}
 }
 #endif
@@ -35,10 +35,6 @@ template<class T, int C> struct xvec: public vec<T, C> {
 	xvec() :
 			vec<T, C>(), index(-1) {
 	}
-	xvec(const xvec<T, C>& pt) :
-			vec<T, C>(pt), index(pt.index) {
-
-	}
 	xvec(const vec<T, C>& pos, int index) :
 			vec<T, C>(pos), index(index) {
 	}
@@ -65,20 +61,36 @@ typedef xvec<double, 2> double2i;
 typedef xvec<double, 3> double3i;
 typedef xvec<double, 4> double4i;
 
-template<class T, int C> class Locator {
+enum class LocatorBackend {
+	KdTree, HashGrid
+};
+//Common radius query interface so simulations can swap the spatial index they build every time step.
+template<class T, int C> class PointLocator {
+public:
+	static const xvec<T, C> NO_POINT_FOUND;
+	virtual size_t size() const = 0;
+	virtual xvec<T, C> closest(vec<T, C> pt, T maxDistance) const = 0;
+	//Points within maxDistance of pt sorted by distance.
+	virtual void closest(vec<T, C> pt, T maxDistance, std::vector<xvec<T, C>>& pts) const = 0;
+	virtual ~PointLocator() {
+	}
+};
+template<class T, int C> const xvec<T, C> PointLocator<T, C>::NO_POINT_FOUND = xvec<T, C>(vec<T, C>(std::numeric_limits<T>::max()), -1);
+
+template<class T, int C> class Locator: public PointLocator<T, C> {
 protected:
 	typedef libkdtree::KDTree<C, xvec<T, C> > LocatorType;
 	LocatorType locator;
 	int indexCount = 0;
 public:
-	static const xvec<T, C> NO_POINT_FOUND;
+	using PointLocator<T, C>::NO_POINT_FOUND;
 	Locator() {
 	}
 	void clear() {
 		indexCount = 0;
 		locator.clear();
 	}
-	size_t size() const {
+	virtual size_t size() const override {
 		return locator.size();
 	}
 	void insert(const xvec<T, C>& pt) {
@@ -130,7 +142,7 @@ public:
 		}
 		locator.insert(ptsi.begin(), ptsi.end());
 	}
-	xvec<T, C> closest(vec<T, C> pt, T maxDistance) const {
+	virtual xvec<T, C> closest(vec<T, C> pt, T maxDistance) const override {
 		xvec<T, C> query(pt, -1);
 		auto result = locator.find_nearest(query, maxDistance);
 		if (result.first != locator.end()) {
@@ -157,8 +169,8 @@ public:
 		}
 	}
 
-	void closest(vec<T, C> pt, T maxDistance,
-			std::vector<xvec<T, C>>& pts) const {
+	virtual void closest(vec<T, C> pt, T maxDistance,
+			std::vector<xvec<T, C>>& pts) const override {
 		xvec<T, C> query(pt, -1);
 		pts.clear();
 		std::vector<xvec<T, C>> tmp;
@@ -202,8 +214,259 @@ public:
 
 	}
 };
-template<class T, int C> const xvec<T, C> Locator<T, C>::NO_POINT_FOUND = xvec<
-		T, C>(vec<T, C>(std::numeric_limits<T>::max()), -1);
+/*
+ * Uniform spatial hash over a static point set. Points are counting-sorted by hashed cell so each cell
+ * is a contiguous run, which makes building O(N) and radius queries touch only the 3^C cells around
+ * the query when the cell size matches the search radius. Unlike Locator, points cannot be inserted
+ * or erased after build().
+ */
+template<class T, int C> class HashGrid: public PointLocator<T, C> {
+protected:
+	std::vector<xvec<T, C>> points;
+	std::vector<uint32_t> bucketStarts;
+	uint64_t mask;
+	T cellSize;
+	vec<int, C> minCell;
+	vec<int, C> maxCell;
+	vec<int, C> cellOf(const vec<T, C>& pt) const {
+		vec<int, C> cell;
+		for (int c = 0; c < C; c++) {
+			cell[c] = (int) std::floor(pt[c] / cellSize);
+		}
+		return cell;
+	}
+	uint64_t bucketOf(const vec<int, C>& cell) const {
+		static const uint64_t PRIMES[4] = { 73856093ULL, 19349663ULL, 83492791ULL, 2654435761ULL };
+		uint64_t h = 0;
+		for (int c = 0; c < C; c++) {
+			h ^= ((uint64_t) (int64_t) cell[c]) * PRIMES[c % 4];
+		}
+		return h & mask;
+	}
+	template<class F> void visitCell(const vec<int, C>& cell, const F& func) const {
+		uint64_t b = bucketOf(cell);
+		for (uint32_t i = bucketStarts[b]; i < bucketStarts[b + 1]; i++) {
+			const xvec<T, C>& pt = points[i];
+			//Different cells can hash to the same bucket.
+			vec<int, C> pcell = cellOf(pt);
+			bool same = true;
+			for (int c = 0; c < C; c++) {
+				if (pcell[c] != cell[c]) {
+					same = false;
+					break;
+				}
+			}
+			if (same) {
+				func(pt);
+			}
+		}
+	}
+	template<class F> void visitCells(vec<int, C> lo, vec<int, C> hi, const F& func) const {
+		for (int c = 0; c < C; c++) {
+			lo[c] = std::max(lo[c], minCell[c]);
+			hi[c] = std::min(hi[c], maxCell[c]);
+			if (lo[c] > hi[c]) {
+				return;
+			}
+		}
+		vec<int, C> cell = lo;
+		while (true) {
+			func(cell);
+			int c = 0;
+			for (; c < C; c++) {
+				if (++cell[c] <= hi[c]) {
+					break;
+				}
+				cell[c] = lo[c];
+			}
+			if (c == C) {
+				break;
+			}
+		}
+	}
+public:
+	using PointLocator<T, C>::NO_POINT_FOUND;
+	HashGrid() :
+			mask(0), cellSize(1), minCell(0), maxCell(-1) {
+	}
+	HashGrid(const Vector<T, C>& data, T cellSize) :
+			HashGrid() {
+		build(data, cellSize);
+	}
+	HashGrid(const std::vector<vec<T, C>>& data, T cellSize) :
+			HashGrid() {
+		build(data, cellSize);
+	}
+	void build(const Vector<T, C>& data, T cellSize) {
+		build(data.data, cellSize);
+	}
+	//cellSize should be close to the radius used for queries.
+	void build(const std::vector<vec<T, C>>& data, T cellSize) {
+		this->cellSize = cellSize;
+		size_t N = data.size();
+		size_t tableSize = 1;
+		while (tableSize < 2 * N) {
+			tableSize <<= 1;
+		}
+		mask = tableSize - 1;
+		std::vector<uint32_t> buckets(N);
+#pragma omp parallel for
+		for (int64_t i = 0; i < (int64_t) N; i++) {
+			buckets[i] = (uint32_t) bucketOf(cellOf(data[i]));
+		}
+		//Serial scatter keeps points in input order within a bucket, so results do not depend on thread count.
+		bucketStarts.assign(tableSize + 1, 0);
+		vec<T, C> minPt(std::numeric_limits<T>::max());
+		vec<T, C> maxPt(std::numeric_limits<T>::lowest());
+		for (size_t i = 0; i < N; i++) {
+			bucketStarts[buckets[i] + 1]++;
+			minPt = aly::min(minPt, data[i]);
+			maxPt = aly::max(maxPt, data[i]);
+		}
+		for (size_t b = 0; b < tableSize; b++) {
+			bucketStarts[b + 1] += bucketStarts[b];
+		}
+		std::vector<uint32_t> offsets(bucketStarts.begin(), bucketStarts.end() - 1);
+		points.resize(N);
+		for (size_t i = 0; i < N; i++) {
+			points[offsets[buckets[i]]++] = xvec<T, C>(data[i], (int) i);
+		}
+		if (N > 0) {
+			minCell = cellOf(minPt);
+			maxCell = cellOf(maxPt);
+		} else {
+			minCell = vec<int, C>(0);
+			maxCell = vec<int, C>(-1);
+		}
+	}
+	void clear() {
+		points.clear();
+		bucketStarts.clear();
+		mask = 0;
+		minCell = vec<int, C>(0);
+		maxCell = vec<int, C>(-1);
+	}
+	T getCellSize() const {
+		return cellSize;
+	}
+	virtual size_t size() const override {
+		return points.size();
+	}
+	virtual xvec<T, C> closest(vec<T, C> pt, T maxDistance) const override {
+		xvec<T, C> best = NO_POINT_FOUND;
+		T bestDist = maxDistance * maxDistance;
+		visitCells(cellOf(pt - vec<T, C>(maxDistance)), cellOf(pt + vec<T, C>(maxDistance)), [&](const vec<int, C>& cell) {
+			visitCell(cell, [&](const xvec<T, C>& val) {
+				T d = distanceSqr(pt, val);
+				if (d < bestDist || (d == bestDist && (best.index < 0 || val.index < best.index))) {
+					best = val;
+					bestDist = d;
+				}
+			});
+		});
+		return best;
+	}
+	virtual void closest(vec<T, C> pt, T maxDistance, std::vector<xvec<T, C>>& pts) const override {
+		pts.clear();
+		T distSqr = maxDistance * maxDistance;
+		visitCells(cellOf(pt - vec<T, C>(maxDistance)), cellOf(pt + vec<T, C>(maxDistance)), [&](const vec<int, C>& cell) {
+			visitCell(cell, [&](const xvec<T, C>& val) {
+				if (distanceSqr(pt, val) <= distSqr) {
+					pts.push_back(val);
+				}
+			});
+		});
+		std::sort(pts.begin(), pts.end(), [=](const xvec<T, C>& a, const xvec<T, C>& b) {
+			T da = distanceSqr(pt, a);
+			T db = distanceSqr(pt, b);
+			return (da < db || (da == db && a.index < b.index));
+		});
+	}
+	void closest(vec<T, C> pt, T maxDistance, std::vector<std::pair<xvec<T, C>, T>>& pts) const {
+		std::vector<xvec<T, C>> tmp;
+		closest(pt, maxDistance, tmp);
+		pts.clear();
+		pts.reserve(tmp.size());
+		for (const xvec<T, C>& val : tmp) {
+			pts.push_back(std::pair<xvec<T, C>, T>(val, distance(pt, val)));
+		}
+	}
+	//kNN search expanding one ring of cells at a time until no unvisited cell can hold a closer point.
+	void closest(vec<T, C> pt, int kNN, std::vector<xvec<T, C>>& pts) const {
+		pts.clear();
+		if (points.size() == 0 || kNN <= 0) {
+			return;
+		}
+		auto compare = [=](const xvec<T, C>& a, const xvec<T, C>& b) {
+			T da = distanceSqr(pt, a);
+			T db = distanceSqr(pt, b);
+			return (da < db || (da == db && a.index < b.index));
+		};
+		vec<int, C> center = cellOf(pt);
+		for (int ring = 0;; ring++) {
+			vec<int, C> lo = center - vec<int, C>(ring);
+			vec<int, C> hi = center + vec<int, C>(ring);
+			visitCells(lo, hi, [&](const vec<int, C>& cell) {
+				int d = 0;
+				for (int c = 0; c < C; c++) {
+					d = std::max(d, std::abs(cell[c] - center[c]));
+				}
+				if (d == ring) {
+					visitCell(cell, [&](const xvec<T, C>& val) {
+						pts.push_back(val);
+					});
+				}
+			});
+			if ((int) pts.size() >= kNN) {
+				std::nth_element(pts.begin(), pts.begin() + (kNN - 1), pts.end(), compare);
+				if (distance(pt, pts[kNN - 1]) <= ring * cellSize) {
+					break;
+				}
+			}
+			bool covered = true;
+			for (int c = 0; c < C; c++) {
+				if (lo[c] > minCell[c] || hi[c] < maxCell[c]) {
+					covered = false;
+					break;
+				}
+			}
+			if (covered) {
+				break;
+			}
+		}
+		std::sort(pts.begin(), pts.end(), compare);
+		if ((int) pts.size() > kNN) {
+			pts.erase(pts.begin() + kNN, pts.end());
+		}
+	}
+	xvec<T, C> closest(vec<T, C> pt) const {
+		std::vector<xvec<T, C>> pts;
+		closest(pt, 1, pts);
+		return (pts.size() > 0) ? pts[0] : NO_POINT_FOUND;
+	}
+	//Batched queries, evaluated in parallel.
+	void closest(const Vector<T, C>& queries, T maxDistance, std::vector<std::vector<xvec<T, C>>>& results) const {
+		results.resize(queries.size());
+#pragma omp parallel for
+		for (int64_t n = 0; n < (int64_t) queries.size(); n++) {
+			closest(queries[n], maxDistance, results[n]);
+		}
+	}
+	void closest(const Vector<T, C>& queries, int kNN, std::vector<std::vector<xvec<T, C>>>& results) const {
+		results.resize(queries.size());
+#pragma omp parallel for
+		for (int64_t n = 0; n < (int64_t) queries.size(); n++) {
+			closest(queries[n], kNN, results[n]);
+		}
+	}
+};
+template<class T, int C> std::shared_ptr<PointLocator<T, C>> MakePointLocator(const Vector<T, C>& data, T searchRadius, const LocatorBackend& backend = LocatorBackend::HashGrid) {
+	if (backend == LocatorBackend::HashGrid) {
+		return std::shared_ptr<PointLocator<T, C>>(new HashGrid<T, C>(data, searchRadius));
+	} else {
+		return std::shared_ptr<PointLocator<T, C>>(new Locator<T, C>(data));
+	}
+}
 
 namespace detail {
 template<typename T = double, int C = -1, class Distance = nanoflann::metric_L2,
@@ -522,6 +785,13 @@ public:
 template<class T, int C> const size_t MatcherVec<T, C>::NO_POINT_FOUND =
 		std::numeric_limits<size_t>::max();
 
+typedef PointLocator<float, 2> PointLocator2f;
+typedef PointLocator<float, 3> PointLocator3f;
+typedef HashGrid<float, 2> HashGrid2f;
+typedef HashGrid<float, 3> HashGrid3f;
+typedef HashGrid<double, 2> HashGrid2d;
+typedef HashGrid<double, 3> HashGrid3d;
+
 typedef Locator<float, 2> Locator2f;
 typedef Locator<float, 3> Locator3f;
 typedef Locator<float, 4> Locator4f;
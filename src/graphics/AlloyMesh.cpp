@@ -23,6 +23,7 @@
 #include "graphics/AlloyPLY.h"
 #include "graphics/tiny_obj_loader.h"
 #include "system/AlloyFileUtil.h"
+#include "system/AlloyMemMappedFile.h"
 #include <vector>
 #include <list>
 #include <stdlib.h>
@@ -31,6 +32,9 @@
 #include <string.h>
 #include <stddef.h>
 #include <set>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
 #ifndef ALY_WINDOWS
 #pragma GCC diagnostic ignored "-Wwrite-strings"
 #endif
@@ -1398,123 +1402,473 @@ void ReadObjMeshFromFile(const std::string& file, std::vector<Mesh>& meshList) {
 	}
 
 }
-void ReadObjMeshFromFile(const std::string& file, Mesh& mesh) {
-	using namespace tinyobj;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string err = tinyobj::LoadObj(shapes, materials, file.c_str(),
-			GetParentDirectory(file).c_str());
-	if (err.size() > 0)
-		throw std::runtime_error(err);
-
-	uint32_t positionCount = 0;
-	uint32_t colorCount = 0;
-	uint32_t normalCount = 0;
-	uint32_t texCount = 0;
-	uint32_t lineIndexCount = 0;
-	uint32_t triIndexCount = 0;
-	uint32_t quadIndexCount = 0;
-	for (int n = 0; n < (int) shapes.size(); n++) {
-		shape_t& shape = shapes[n];
-		positionCount += (uint32_t) shape.mesh.positions.size();
-		colorCount += (uint32_t) shape.mesh.colors.size();
-		normalCount += (uint32_t) shape.mesh.normals.size();
-		texCount += (uint32_t) shape.mesh.texcoords.size();
-		lineIndexCount += (uint32_t) shape.mesh.lineIndices.size();
-		triIndexCount += (uint32_t) shape.mesh.triIndices.size();
-		quadIndexCount += (uint32_t) shape.mesh.quadIndices.size();
+//Lines of an OBJ file parsed independently of the other chunks.
+struct ObjChunk {
+	std::vector<float3> positions;
+	std::vector<float3> colors;
+	std::vector<float3> normals;
+	std::vector<float2> texcoords;
+	//(v, vt, vn) per face corner, -1 if absent.
+	std::vector<int3> corners;
+	std::vector<int> faceSizes;
+	//3 * corner + component of negative indexes, stored relative to the start of this chunk.
+	std::vector<size_t> relativeIndexes;
+	std::vector<std::string> materialLibraries;
+	std::vector<std::string> materialNames;
+	size_t triCount = 0;
+	size_t quadCount = 0;
+	size_t lineCount = 0;
+	bool hasColors = false;
+	bool hasTexcoords = false;
+	bool hasNormals = false;
+	std::string error;
+};
+static inline const char* ObjSkipSpace(const char* ptr, const char* end) {
+	while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+		ptr++;
+	return ptr;
+}
+static inline bool ObjParseInt(const char*& ptr, const char* end, int& val) {
+	const char* start = ptr;
+	bool negative = false;
+	if (ptr < end && (*ptr == '-' || *ptr == '+'))
+		negative = (*ptr++ == '-');
+	int64_t result = 0;
+	const char* digits = ptr;
+	while (ptr < end && *ptr >= '0' && *ptr <= '9' && result < 0x7FFFFFFF)
+		result = 10 * result + (*ptr++ - '0');
+	if (ptr == digits) {
+		ptr = start;
+		return false;
 	}
-	mesh.vertexColors.clear();
-	mesh.vertexColors.resize(colorCount / 3);
-	mesh.vertexLocations.resize(positionCount / 3);
-	mesh.vertexNormals.resize(normalCount / 3);
-	mesh.lineIndexes.resize(lineIndexCount / 2);
-	mesh.triIndexes.resize(triIndexCount / 3);
-	mesh.quadIndexes.resize(quadIndexCount / 4);
-	positionCount = 0;
-	colorCount = 0;
-	normalCount = 0;
-	texCount = 0;
-	lineIndexCount = 0;
-	triIndexCount = 0;
-	quadIndexCount = 0;
-	mesh.textureMap.clear();
-	for (int n = 0; n < (int) shapes.size(); n++) {
-		shape_t& shape = shapes[n];
-		for (size_t i = 0; i < shape.mesh.lineIndices.size(); i += 2) {
-			mesh.lineIndexes[lineIndexCount++] = uint2(
-					positionCount + shape.mesh.lineIndices[i],
-					positionCount + shape.mesh.lineIndices[i + 1]);
+	val = (int) (negative ? -result : result);
+	return true;
+}
+//Parses [sign] digits [. digits] [e [sign] digits] without locale lookups. Up to 19
+//significant digits are kept, which is more than a float can hold.
+static inline bool ObjParseFloat(const char*& ptr, const char* end, float& val) {
+	static const double POW10[] = { 1E0, 1E1, 1E2, 1E3, 1E4, 1E5, 1E6, 1E7, 1E8, 1E9, 1E10, 1E11, 1E12, 1E13, 1E14, 1E15, 1E16, 1E17, 1E18,
+			1E19, 1E20, 1E21, 1E22 };
+	const char* start = ptr;
+	bool negative = false;
+	if (ptr < end && (*ptr == '-' || *ptr == '+'))
+		negative = (*ptr++ == '-');
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	bool any = false;
+	for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++, any = true) {
+		if (digits < 19) {
+			mantissa = 10 * mantissa + (*ptr - '0');
+			if (mantissa > 0)
+				digits++;
+		} else {
+			exponent++;
 		}
-		for (size_t i = 0; i < shape.mesh.triIndices.size(); i += 3) {
-			mesh.triIndexes[triIndexCount++] = uint3(
-					positionCount + shape.mesh.triIndices[i],
-					positionCount + shape.mesh.triIndices[i + 1],
-					positionCount + shape.mesh.triIndices[i + 2]);
+	}
+	if (ptr < end && *ptr == '.') {
+		for (ptr++; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++, any = true) {
+			if (digits < 19) {
+				mantissa = 10 * mantissa + (*ptr - '0');
+				exponent--;
+				if (mantissa > 0)
+					digits++;
+			}
 		}
-		for (size_t i = 0; i < shape.mesh.quadIndices.size(); i += 4) {
-			mesh.quadIndexes[quadIndexCount++] = uint4(
-					positionCount + shape.mesh.quadIndices[i],
-					positionCount + shape.mesh.quadIndices[i + 1],
-					positionCount + shape.mesh.quadIndices[i + 2],
-					positionCount + shape.mesh.quadIndices[i + 3]);
+	}
+	if (!any) {
+		ptr = start;
+		return false;
+	}
+	if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+		const char* mark = ptr++;
+		int power = 0;
+		if (ObjParseInt(ptr, end, power)) {
+			exponent += std::max(std::min(power, 1000), -1000);
+		} else {
+			ptr = mark;
 		}
-		for (size_t i = 0; i < shape.mesh.positions.size(); i += 3) {
-			mesh.vertexLocations[positionCount++] = float3(
-					shape.mesh.positions[i], shape.mesh.positions[i + 1],
-					shape.mesh.positions[i + 2]);
+	}
+	double result = (double) mantissa;
+	if (mantissa != 0) {
+		while (exponent > 22) {
+			result *= 1E22;
+			exponent -= 22;
 		}
-		for (size_t i = 0; i < shape.mesh.colors.size(); i += 3) {
-			mesh.vertexColors[colorCount++] = float4(shape.mesh.colors[i],
-					shape.mesh.colors[i + 1], shape.mesh.colors[i + 2], 1.0f);
+		while (exponent < -22) {
+			result /= 1E22;
+			exponent += 22;
+		}
+		result = (exponent >= 0) ? result * POW10[exponent] : result / POW10[-exponent];
+	}
+	val = (float) (negative ? -result : result);
+	return true;
+}
+static inline std::string ObjParseName(const char* ptr, const char* end) {
+	ptr = ObjSkipSpace(ptr, end);
+	const char* last = end;
+	while (last > ptr && (last[-1] == ' ' || last[-1] == '\t'))
+		last--;
+	return std::string(ptr, last);
+}
+static inline bool ObjIsCommand(const char* ptr, const char* end, const char* cmd, size_t len) {
+	return ((size_t) (end - ptr) > len && strncmp(ptr, cmd, len) == 0 && (ptr[len] == ' ' || ptr[len] == '\t'));
+}
+//Converts a one based or negative OBJ index. Negative indexes are counted back from
+//the elements seen so far in this chunk and flagged in mask, they are fixed up once chunk offsets are known.
+static inline int ObjCornerIndex(int idx, size_t count, uint8_t& mask, int component) {
+	if (idx < 0) {
+		mask |= (uint8_t) (1 << component);
+		return (int) count + idx;
+	}
+	return std::max(idx - 1, 0);
+}
+//Records the negative indexes of a corner at its final position in the chunk.
+static inline void ObjAddRelative(ObjChunk& chunk, size_t corner, uint8_t mask) {
+	for (int component = 0; component < 3; component++) {
+		if (mask & (1 << component))
+			chunk.relativeIndexes.push_back(3 * corner + component);
+	}
+}
+static void ParseObjChunk(const char* begin, const char* end, ObjChunk& chunk) {
+	const char* ptr = begin;
+	//Negative index flags of the current face's corners.
+	std::vector<uint8_t> relative;
+	while (ptr < end) {
+		const char* lineEnd = (const char*) memchr(ptr, '\n', end - ptr);
+		if (lineEnd == nullptr)
+			lineEnd = end;
+		const char* next = lineEnd + ((lineEnd < end) ? 1 : 0);
+		if (lineEnd > ptr && lineEnd[-1] == '\r')
+			lineEnd--;
+		ptr = ObjSkipSpace(ptr, lineEnd);
+		if (ptr >= lineEnd || *ptr == '#') {
+			ptr = next;
+			continue;
+		}
+		if (ObjIsCommand(ptr, lineEnd, "v", 1)) {
+			float3 pt(0.0f), color(0.0f);
+			ptr += 2;
+			for (int c = 0; c < 3; c++) {
+				ptr = ObjSkipSpace(ptr, lineEnd);
+				ObjParseFloat(ptr, lineEnd, pt[c]);
+			}
+			ptr = ObjSkipSpace(ptr, lineEnd);
+			if (ptr < lineEnd && ObjParseFloat(ptr, lineEnd, color.x)) {
+				for (int c = 1; c < 3; c++) {
+					ptr = ObjSkipSpace(ptr, lineEnd);
+					ObjParseFloat(ptr, lineEnd, color[c]);
+				}
+				if (!chunk.hasColors) {
+					chunk.colors.resize(chunk.positions.size(), float3(0.0f));
+					chunk.hasColors = true;
+				}
+			}
+			chunk.positions.push_back(pt);
+			if (chunk.hasColors)
+				chunk.colors.push_back(color);
+		} else if (ObjIsCommand(ptr, lineEnd, "vn", 2)) {
+			float3 norm(0.0f);
+			ptr += 3;
+			for (int c = 0; c < 3; c++) {
+				ptr = ObjSkipSpace(ptr, lineEnd);
+				ObjParseFloat(ptr, lineEnd, norm[c]);
+			}
+			chunk.normals.push_back(norm);
+		} else if (ObjIsCommand(ptr, lineEnd, "vt", 2)) {
+			float2 uv(0.0f);
+			ptr += 3;
+			for (int c = 0; c < 2; c++) {
+				ptr = ObjSkipSpace(ptr, lineEnd);
+				ObjParseFloat(ptr, lineEnd, uv[c]);
+			}
+			chunk.texcoords.push_back(uv);
+		} else if (ObjIsCommand(ptr, lineEnd, "f", 1) || ObjIsCommand(ptr, lineEnd, "l", 1)) {
+			bool polyline = (*ptr == 'l');
+			int count = 0;
+			ptr += 2;
+			relative.clear();
+			while ((ptr = ObjSkipSpace(ptr, lineEnd)) < lineEnd) {
+				int3 corner(-1);
+				uint8_t mask = 0;
+				int idx = 0;
+				if (!ObjParseInt(ptr, lineEnd, idx)) {
+					chunk.error = MakeString() << "Could not parse face \"" << std::string(ptr, lineEnd) << "\"";
+					return;
+				}
+				corner.x = ObjCornerIndex(idx, chunk.positions.size(), mask, 0);
+				if (ptr < lineEnd && *ptr == '/') {
+					ptr++;
+					if (ObjParseInt(ptr, lineEnd, idx)) {
+						corner.y = ObjCornerIndex(idx, chunk.texcoords.size(), mask, 1);
+						chunk.hasTexcoords = true;
+					}
+					if (ptr < lineEnd && *ptr == '/') {
+						ptr++;
+						if (ObjParseInt(ptr, lineEnd, idx)) {
+							corner.z = ObjCornerIndex(idx, chunk.normals.size(), mask, 2);
+							chunk.hasNormals = true;
+						}
+					}
+				}
+				while (ptr < lineEnd && *ptr != ' ' && *ptr != '\t')
+					ptr++;
+				chunk.corners.push_back(corner);
+				relative.push_back(mask);
+				count++;
+			}
+			if (polyline && count > 2) {
+				//Polylines are split into segments so every face size is a primitive.
+				std::vector<int3> points(chunk.corners.end() - count, chunk.corners.end());
+				chunk.corners.resize(chunk.corners.size() - count);
+				for (int i = 0; i + 1 < count; i++) {
+					ObjAddRelative(chunk, chunk.corners.size(), relative[i]);
+					chunk.corners.push_back(points[i]);
+					ObjAddRelative(chunk, chunk.corners.size(), relative[i + 1]);
+					chunk.corners.push_back(points[i + 1]);
+					chunk.faceSizes.push_back(2);
+					chunk.lineCount++;
+				}
+			} else if (count < 2) {
+				chunk.corners.resize(chunk.corners.size() - count);
+			} else {
+				for (int i = 0; i < count; i++) {
+					ObjAddRelative(chunk, chunk.corners.size() - count + i, relative[i]);
+				}
+				if (count == 2) {
+					chunk.faceSizes.push_back(2);
+					chunk.lineCount++;
+				} else if (count == 3) {
+					chunk.faceSizes.push_back(3);
+					chunk.triCount++;
+				} else if (count == 4) {
+					chunk.faceSizes.push_back(4);
+					chunk.quadCount++;
+				} else {
+					chunk.faceSizes.push_back(count);
+					chunk.triCount += count - 2;
+				}
+			}
+		} else if (ObjIsCommand(ptr, lineEnd, "usemtl", 6)) {
+			chunk.materialNames.push_back(ObjParseName(ptr + 7, lineEnd));
+		} else if (ObjIsCommand(ptr, lineEnd, "mtllib", 6)) {
+			chunk.materialLibraries.push_back(ObjParseName(ptr + 7, lineEnd));
 		}
-		for (size_t i = 0; i < shape.mesh.normals.size(); i += 3) {
-			mesh.vertexNormals[normalCount++] = float3(shape.mesh.normals[i],
-					shape.mesh.normals[i + 1], shape.mesh.normals[i + 2]);
+		ptr = next;
+	}
+}
+/*
+ * Reads the whole file into one mesh. The file is memory mapped and split into
+ * blocks of lines that are parsed in parallel. A second parallel pass offsets each
+ * block's indexes and writes them straight into the mesh. Vertices keep their file
+ * order, and a vertex is duplicated only when its corners reference different normals.
+ */
+void ReadObjMeshFromFile(const std::string& file, Mesh& mesh) {
+	const size_t CHUNK_SIZE = 1 << 22;
+	ReadableMemMapFile mapped(file);
+	if (!mapped.isOpen() || mapped.getMappedSize() != mapped.getFileSize()) {
+		throw std::runtime_error(MakeString() << "Could not open " << file);
+	}
+	const char* data = mapped.data();
+	const char* dataEnd = data + mapped.getMappedSize();
+	//Chunk boundaries fall after a newline so that no line is split.
+	std::vector<const char*> bounds(1, data);
+	while (bounds.back() < dataEnd) {
+		const char* next = bounds.back() + std::min(CHUNK_SIZE, (size_t) (dataEnd - bounds.back()));
+		if (next < dataEnd) {
+			const char* newline = (const char*) memchr(next, '\n', dataEnd - next);
+			next = (newline != nullptr) ? newline + 1 : dataEnd;
+		}
+		bounds.push_back(next);
+	}
+	int chunkCount = (int) bounds.size() - 1;
+	std::vector<ObjChunk> chunks(chunkCount);
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < chunkCount; c++) {
+		ParseObjChunk(bounds[c], bounds[c + 1], chunks[c]);
+	}
+	struct ObjOffsets {
+		size_t position, normal, texcoord, tri, quad, line;
+	};
+	std::vector<ObjOffsets> offsets(chunkCount + 1);
+	offsets[0] = ObjOffsets { 0, 0, 0, 0, 0, 0 };
+	bool hasColors = false, hasTexcoords = false, hasNormals = false;
+	for (int c = 0; c < chunkCount; c++) {
+		const ObjChunk& chunk = chunks[c];
+		if (chunk.error.size() > 0) {
+			throw std::runtime_error(MakeString() << "Could not read " << file << ". " << chunk.error);
+		}
+		offsets[c + 1].position = offsets[c].position + chunk.positions.size();
+		offsets[c + 1].normal = offsets[c].normal + chunk.normals.size();
+		offsets[c + 1].texcoord = offsets[c].texcoord + chunk.texcoords.size();
+		offsets[c + 1].tri = offsets[c].tri + chunk.triCount;
+		offsets[c + 1].quad = offsets[c].quad + chunk.quadCount;
+		offsets[c + 1].line = offsets[c].line + chunk.lineCount;
+		hasColors |= chunk.hasColors;
+		hasTexcoords |= chunk.hasTexcoords;
+		hasNormals |= chunk.hasNormals;
+	}
+	const ObjOffsets& total = offsets[chunkCount];
+	std::vector<std::string> libraries, names;
+	for (const ObjChunk& chunk : chunks) {
+		libraries.insert(libraries.end(), chunk.materialLibraries.begin(), chunk.materialLibraries.end());
+		names.insert(names.end(), chunk.materialNames.begin(), chunk.materialNames.end());
+	}
+	if (total.position > 0xFFFFFFFFULL) {
+		throw std::runtime_error(MakeString() << "Could not read " << file << ", too many vertexes.");
+	}
+	mesh.clear();
+	mesh.vertexLocations.resize(total.position);
+	mesh.vertexColors.resize(hasColors ? total.position : 0);
+	mesh.triIndexes.resize(total.tri);
+	mesh.quadIndexes.resize(total.quad);
+	mesh.lineIndexes.resize(total.line);
+	mesh.textureMap.resize(hasTexcoords ? 3 * total.tri + 4 * total.quad : 0);
+	std::vector<float3> normals(total.normal);
+	//Normal index of every tri, quad and line corner, in that order.
+	std::vector<int> cornerNormals(hasNormals ? 3 * total.tri + 4 * total.quad + 2 * total.line : 0, -1);
+	std::vector<float2> texcoords(total.texcoord);
+	std::vector<char> valid(chunkCount, 1);
+#pragma omp parallel for schedule(dynamic)
+	for (int c = 0; c < chunkCount; c++) {
+		ObjChunk& chunk = chunks[c];
+		const ObjOffsets& offset = offsets[c];
+		std::copy(chunk.positions.begin(), chunk.positions.end(), mesh.vertexLocations.begin() + offset.position);
+		if (hasColors) {
+			for (size_t i = 0; i < chunk.positions.size(); i++) {
+				mesh.vertexColors[offset.position + i] = chunk.hasColors ? float4(chunk.colors[i], 1.0f) : float4(0.0f, 0.0f, 0.0f, 1.0f);
+			}
 		}
-		for (size_t i = 0; i < shape.mesh.triIndices.size(); i += 3) {
-			uint32_t vid1 = shape.mesh.triIndices[i];
-			uint32_t vid2 = shape.mesh.triIndices[i + 1];
-			uint32_t vid3 = shape.mesh.triIndices[i + 2];
-			if (shape.mesh.texcoords.size() > 0) {
-				mesh.textureMap.push_back(
-						float2(shape.mesh.texcoords[2 * vid1],
-								shape.mesh.texcoords[2 * vid1 + 1]));
-				mesh.textureMap.push_back(
-						float2(shape.mesh.texcoords[2 * vid2],
-								shape.mesh.texcoords[2 * vid2 + 1]));
-				mesh.textureMap.push_back(
-						float2(shape.mesh.texcoords[2 * vid3],
-								shape.mesh.texcoords[2 * vid3 + 1]));
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + offset.normal);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + offset.texcoord);
+		for (size_t r : chunk.relativeIndexes) {
+			int3& corner = chunk.corners[r / 3];
+			int component = (int) (r % 3);
+			corner[component] += (int) ((component == 0) ? offset.position : (component == 1) ? offset.texcoord : offset.normal);
+		}
+		for (const int3& corner : chunk.corners) {
+			if (corner.x < 0 || corner.x >= (int) total.position || corner.y < -1 || corner.y >= (int) total.texcoord || corner.z < -1
+					|| corner.z >= (int) total.normal) {
+				valid[c] = 0;
 			}
 		}
-		for (size_t i = 0; i < shape.mesh.quadIndices.size(); i += 4) {
-			uint32_t vid1 = shape.mesh.quadIndices[i];
-			uint32_t vid2 = shape.mesh.quadIndices[i + 1];
-			uint32_t vid3 = shape.mesh.quadIndices[i + 2];
-			uint32_t vid4 = shape.mesh.quadIndices[i + 3];
-			if (shape.mesh.texcoords.size() > 0) {
-				mesh.textureMap.push_back(
-						float2(shape.mesh.texcoords[2 * vid1],
-								shape.mesh.texcoords[2 * vid1 + 1]));
-				mesh.textureMap.push_back(
-						float2(shape.mesh.texcoords[2 * vid2],
-								shape.mesh.texcoords[2 * vid2 + 1]));
-				mesh.textureMap.push_back(
-						float2(shape.mesh.texcoords[2 * vid3],
-								shape.mesh.texcoords[2 * vid3 + 1]));
-				mesh.textureMap.push_back(
-						float2(shape.mesh.texcoords[2 * vid4],
-								shape.mesh.texcoords[2 * vid4 + 1]));
+		if (!valid[c])
+			continue;
+		size_t tri = offset.tri, quad = offset.quad, line = offset.line;
+		size_t quadCorner = 3 * total.tri, lineCorner = 3 * total.tri + 4 * total.quad;
+		const int3* corners = chunk.corners.data();
+		for (int sz : chunk.faceSizes) {
+			if (sz == 2) {
+				mesh.lineIndexes[line] = uint2(corners[0].x, corners[1].x);
+				if (hasNormals) {
+					cornerNormals[lineCorner + 2 * line] = corners[0].z;
+					cornerNormals[lineCorner + 2 * line + 1] = corners[1].z;
+				}
+				line++;
+			} else if (sz == 4) {
+				mesh.quadIndexes[quad] = uint4(corners[0].x, corners[1].x, corners[2].x, corners[3].x);
+				for (int k = 0; k < 4; k++) {
+					if (hasTexcoords)
+						mesh.textureMap[quadCorner + 4 * quad + k] = (corners[k].y >= 0) ? texcoords[corners[k].y] : float2(0.0f);
+					if (hasNormals)
+						cornerNormals[quadCorner + 4 * quad + k] = corners[k].z;
+				}
+				quad++;
+			} else {
+				//Triangles, and polygons as a triangle fan.
+				for (int f = 2; f < sz; f++) {
+					int3 fan[3] = { corners[0], corners[f - 1], corners[f] };
+					mesh.triIndexes[tri] = uint3(fan[0].x, fan[1].x, fan[2].x);
+					for (int k = 0; k < 3; k++) {
+						if (hasTexcoords)
+							mesh.textureMap[3 * tri + k] = (fan[k].y >= 0) ? texcoords[fan[k].y] : float2(0.0f);
+						if (hasNormals)
+							cornerNormals[3 * tri + k] = fan[k].z;
+					}
+					tri++;
+				}
+			}
+			corners += sz;
+		}
+		chunk = ObjChunk();
+	}
+	for (int c = 0; c < chunkCount; c++) {
+		if (!valid[c]) {
+			throw std::runtime_error(MakeString() << "Could not read " << file << ", face index out of range.");
+		}
+	}
+	if (hasNormals) {
+		//Assign each vertex the normal of its corners, splitting vertexes whose corners disagree.
+		std::vector<int> vertexNormal(total.position, -1);
+		std::unordered_map<uint64_t, uint32_t> splits;
+		auto resolve = [&](uint32_t& v, int n) {
+			if (n < 0)
+				return;
+			if (vertexNormal[v] < 0) {
+				vertexNormal[v] = n;
+			} else if (vertexNormal[v] != n) {
+				uint64_t key = ((uint64_t) v << 32) | (uint32_t) n;
+				auto pos = splits.find(key);
+				if (pos == splits.end()) {
+					uint32_t split = (uint32_t) mesh.vertexLocations.size();
+					mesh.vertexLocations.push_back(float3(mesh.vertexLocations[v]));
+					if (hasColors)
+						mesh.vertexColors.push_back(float4(mesh.vertexColors[v]));
+					vertexNormal.push_back(n);
+					pos = splits.insert(std::make_pair(key, split)).first;
+				}
+				v = pos->second;
 			}
+		};
+		size_t k = 0;
+		for (uint3& tri : mesh.triIndexes.data) {
+			for (int i = 0; i < 3; i++)
+				resolve(tri[i], cornerNormals[k++]);
+		}
+		for (uint4& quad : mesh.quadIndexes.data) {
+			for (int i = 0; i < 4; i++)
+				resolve(quad[i], cornerNormals[k++]);
+		}
+		for (uint2& line : mesh.lineIndexes.data) {
+			for (int i = 0; i < 2; i++)
+				resolve(line[i], cornerNormals[k++]);
+		}
+		if (std::find(vertexNormal.begin(), vertexNormal.end(), -1) != vertexNormal.end()) {
+			//Only vertexes without a normal in the file, such as unreferenced ones, keep the computed normal.
+			mesh.updateVertexNormals();
+		} else {
+			mesh.vertexNormals.resize(vertexNormal.size());
 		}
-		if (n < (int) materials.size()) {
-			std::string texName = materials[n].diffuse_texname;
-			if (texName.size() > 0) {
-				aly::ReadImageFromFile(
-						GetParentDirectory(file) + ALY_PATH_SEPARATOR+ texName, mesh.textureImage);
+#pragma omp parallel for
+		for (int i = 0; i < (int) vertexNormal.size(); i++) {
+			if (vertexNormal[i] >= 0)
+				mesh.vertexNormals[i] = normals[vertexNormal[i]];
+		}
+	}
+	if (libraries.size() > 0) {
+		std::vector<tinyobj::material_t> materials;
+		std::map<std::string, int> materialMap;
+		tinyobj::MaterialFileReader reader(GetParentDirectory(file));
+		for (const std::string& lib : libraries) {
+			std::string err = reader(lib, materials, materialMap);
+			if (err.size() > 0)
+				throw std::runtime_error(err);
+		}
+		//Uses the first material applied to faces that has a diffuse texture.
+		std::string texName;
+		for (const std::string& name : names) {
+			auto pos = materialMap.find(name);
+			if (pos != materialMap.end() && materials[pos->second].diffuse_texname.size() > 0) {
+				texName = materials[pos->second].diffuse_texname;
+				break;
 			}
 		}
+		for (size_t i = 0; i < materials.size() && texName.size() == 0; i++) {
+			texName = materials[i].diffuse_texname;
+		}
+		if (texName.size() > 0) {
+			aly::ReadImageFromFile(GetParentDirectory(file) + texName, mesh.textureImage);
+		}
 	}
 	if (mesh.vertexNormals.size() == 0) {
 		mesh.updateVertexNormals();
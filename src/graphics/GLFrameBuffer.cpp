@@ -96,7 +96,7 @@ void GLFrameBuffer::update() {
 	glBindFramebuffer(GL_FRAMEBUFFER, mFrameBufferId);
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH32F_STENCIL8,texture.getWidth(), texture.getHeight());
 	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,mDepthBufferId);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER,mDepthBufferId);
 	//glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mFrameBufferId);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,texture.getTextureId(), 0);
 	glBindTexture(GL_TEXTURE_2D, 0);
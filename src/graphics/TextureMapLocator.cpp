@@ -20,64 +20,219 @@
 */
 #include "graphics/TextureMapLocator.h"
 namespace aly {
-
-TextureMapLocator::TextureMapLocator(int dim):dim(dim) {
+//A triangle in texel units with its texel bounds clipped to a tile.
+struct TexelTriangle {
+	float2 p[3];
+	double dx[3], dy[3], origin[3], edgeScale[3];
+	int i0, i1, j0, j1;
+	int index;
+	bool degenerate;
+};
+TextureMapLocator::TextureMapLocator(int dim, float dilation) :
+		dim(dim), dilation(dilation) {
 }
-double3 TextureMapLocator::ToBaryNoNormalize(float2 f, float2 p1, float2 p2, float2 p3) {
-	float2 f1 = p1 - f;
-	float2 f2 = p2 - f;
-	float2 f3 = p3 - f;
-	double va =  crossMag(p1 - p2,p1 - p3); // main triangle cross product
-	double va1 = crossMag(f2, f3); // p1's triangle cross product
-	double va2 =  crossMag(f3, f1); // p2's triangle cross product
-	double va3 =  crossMag(f1, f2); // p3's triangle cross product
-	float a1 = va1 / va * aly::sign(va*va1);
-	float a2 = va2 / va * aly::sign(va*va2);
-	float a3 = va3 / va * aly::sign(va*va3);
-	return double3(a1,a2,a3);
+void TextureMapLocator::rasterize(const Mesh& mesh) {
+	rasterize(mesh.textureMap);
 }
-void TextureMapLocator::build(const Mesh& mesh,Image4f& positionMap,Image3f& normalMap){
-	const Vector2f& uvs=mesh.textureMap;
-	const Vector3f& verts=mesh.vertexLocations;
-	const Vector3f& norms=mesh.vertexNormals;
-	const Vector3ui& tris=mesh.triIndexes;
-	float2 maxUv =uvs.max();
-	size_t N=uvs.size();
-	const float delta=1.0f/(dim);
-	positionMap.resize(dim,dim);
-	positionMap.set(float4(0,0,0,-1.0f));
-	normalMap.resize(dim,dim);
-	normalMap.set(float3(0,0,0));
-	for(size_t n=0;n<N;n+=3){
-		float2 uv1=uvs[n];
-		float2 uv2=uvs[n+1];
-		float2 uv3=uvs[n+2];
-
-		uint3 tri=tris[n/3];
-		float3 vr1=verts[tri.x];
-		float3 vr2=verts[tri.y];
-		float3 vr3=verts[tri.z];
-		float3 nr1=norms[tri.x];
-		float3 nr2=norms[tri.y];
-		float3 nr3=norms[tri.z];
-		int2 minPix=aly::max(int2(0),int2(aly::min(aly::min(uv1,uv2),uv3)*(float)dim)-1);
-		int2 maxPix=aly::min(int2(dim-1),int2(aly::max(aly::max(uv1,uv2),uv3)*(float)dim)+1);
-		int2 boxSize=maxPix-minPix;
-		float2 closestPoint;
-		for(int j=0;j<boxSize.y;j++){
-			for(int i=0;i<boxSize.x;i++){
-				float dist=DistanceToTriangleSqr(float2((i+minPix.x)*delta,(j+minPix.y)*delta),uv1,uv2,uv3,&closestPoint);
-				float4& dmap=positionMap(i+minPix.x,dim-1-(j+minPix.y));
-				if(dist<dmap.w||dmap.w==-1){
-					double3 b=ToBaryNoNormalize(closestPoint,uv1,uv2,uv3);
-					float3 pt=FromBary(b,vr1,vr2,vr3);
-					float3 norm=normalize(FromBary(b,nr1,nr2,nr3));
-					dmap=float4(pt,dist);
-					normalMap(i+minPix.x,dim-1-(j+minPix.y))=norm;
+void TextureMapLocator::rasterize(const Vector2f& uvs) {
+	const int BIN_CHUNKS = 16;
+	int triCount = (int) (uvs.size() / 3);
+	int tiles = (dim + TILE_SIZE - 1) / TILE_SIZE;
+	float radius = std::max(dilation, 0.0f);
+	triangleMap.resize(dim, dim);
+	baryMap.resize(dim, dim);
+	//Tile range covered by each triangle's dilated bounding box in texel units.
+	std::vector<int4> tileRanges(triCount);
+#pragma omp parallel for
+	for (int t = 0; t < triCount; t++) {
+		float2 a = uvs[3 * t] * (float) dim, b = uvs[3 * t + 1] * (float) dim, c = uvs[3 * t + 2] * (float) dim;
+		float2 minPt = aly::min(aly::min(a, b), c) - radius;
+		float2 maxPt = aly::max(aly::max(a, b), c) + radius;
+		if (maxPt.x < 0.0f || maxPt.y < 0.0f || minPt.x > dim - 1 || minPt.y > dim - 1) {
+			tileRanges[t] = int4(0, 0, -1, -1);
+		} else {
+			tileRanges[t] = int4(aly::clamp((int) std::ceil(minPt.x), 0, dim - 1) / TILE_SIZE,
+					aly::clamp((int) std::ceil(minPt.y), 0, dim - 1) / TILE_SIZE, aly::clamp((int) std::floor(maxPt.x), 0, dim - 1) / TILE_SIZE,
+					aly::clamp((int) std::floor(maxPt.y), 0, dim - 1) / TILE_SIZE);
+		}
+	}
+	//Counting sort of triangles into tile bins. Chunks are counted in parallel and
+	//filled in chunk order, so each bin lists its triangles in increasing order.
+	std::vector<int> chunkCounts(BIN_CHUNKS * tiles * tiles, 0);
+#pragma omp parallel for
+	for (int c = 0; c < BIN_CHUNKS; c++) {
+		int* counts = &chunkCounts[c * tiles * tiles];
+		int end = (int) (((int64_t) triCount * (c + 1)) / BIN_CHUNKS);
+		for (int t = (int) (((int64_t) triCount * c) / BIN_CHUNKS); t < end; t++) {
+			const int4& r = tileRanges[t];
+			for (int ty = r.y; ty <= r.w; ty++) {
+				for (int tx = r.x; tx <= r.z; tx++) {
+					counts[tx + ty * tiles]++;
 				}
 			}
 		}
 	}
+	std::vector<size_t> binOffsets(tiles * tiles + 1, 0);
+	for (int b = 0; b < tiles * tiles; b++) {
+		size_t total = binOffsets[b];
+		for (int c = 0; c < BIN_CHUNKS; c++) {
+			int count = chunkCounts[c * tiles * tiles + b];
+			chunkCounts[c * tiles * tiles + b] = (int) (total - binOffsets[b]);
+			total += count;
+		}
+		binOffsets[b + 1] = total;
+	}
+	std::vector<int> bins(binOffsets.back());
+#pragma omp parallel for
+	for (int c = 0; c < BIN_CHUNKS; c++) {
+		int* offsets = &chunkCounts[c * tiles * tiles];
+		int end = (int) (((int64_t) triCount * (c + 1)) / BIN_CHUNKS);
+		for (int t = (int) (((int64_t) triCount * c) / BIN_CHUNKS); t < end; t++) {
+			const int4& r = tileRanges[t];
+			for (int ty = r.y; ty <= r.w; ty++) {
+				for (int tx = r.x; tx <= r.z; tx++) {
+					int b = tx + ty * tiles;
+					bins[binOffsets[b] + (offsets[b]++)] = t;
+				}
+			}
+		}
+	}
+	const float uvScale = 1.0f / ((float) dim * (float) dim);
+	const float radiusSqr = radius * radius;
+#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < tiles * tiles; b++) {
+		int tileX = (b % tiles) * TILE_SIZE, tileY = (b / tiles) * TILE_SIZE;
+		int tileW = std::min(TILE_SIZE, dim - tileX), tileH = std::min(TILE_SIZE, dim - tileY);
+		std::vector<float> bestDist(TILE_SIZE * TILE_SIZE, radiusSqr);
+		std::vector<int> bestTri(TILE_SIZE * TILE_SIZE, -1);
+		std::vector<float3> bestBary(TILE_SIZE * TILE_SIZE);
+		//Edge function setup for the triangles in this tile, shared by both passes.
+		std::vector<TexelTriangle> setups;
+		setups.reserve(binOffsets[b + 1] - binOffsets[b]);
+		for (size_t k = binOffsets[b]; k < binOffsets[b + 1]; k++) {
+			int t = bins[k];
+			TexelTriangle tri;
+			tri.index = t;
+			for (int v = 0; v < 3; v++) {
+				tri.p[v] = uvs[3 * t + v] * (float) dim;
+			}
+			float2 minPt = aly::min(aly::min(tri.p[0], tri.p[1]), tri.p[2]) - radius;
+			float2 maxPt = aly::max(aly::max(tri.p[0], tri.p[1]), tri.p[2]) + radius;
+			tri.i0 = std::max(tileX, (int) std::ceil(minPt.x));
+			tri.i1 = std::min(tileX + tileW - 1, (int) std::floor(maxPt.x));
+			tri.j0 = std::max(tileY, (int) std::ceil(minPt.y));
+			tri.j1 = std::min(tileY + tileH - 1, (int) std::floor(maxPt.y));
+			double area = ((double) tri.p[1].x - tri.p[0].x) * ((double) tri.p[2].y - tri.p[0].y)
+					- ((double) tri.p[1].y - tri.p[0].y) * ((double) tri.p[2].x - tri.p[0].x);
+			tri.degenerate = (std::abs(area) < 1E-12);
+			for (int e = 0; e < 3; e++) {
+				const float2& u = tri.p[(e + 1) % 3];
+				const float2& w = tri.p[(e + 2) % 3];
+				if (tri.degenerate) {
+					tri.dx[e] = tri.dy[e] = tri.origin[e] = tri.edgeScale[e] = 0.0;
+				} else {
+					//Differences in double, float round off is scaled by the texel coordinate.
+					tri.dx[e] = ((double) u.y - w.y) / area;
+					tri.dy[e] = ((double) w.x - u.x) / area;
+					tri.origin[e] = ((double) u.x * w.y - (double) w.x * u.y) / area;
+					//Converts a negative barycentric coordinate to the distance outside the edge.
+					tri.edgeScale[e] = -std::abs(area) / std::max((double) distance(u, w), 1E-30);
+				}
+			}
+			setups.push_back(tri);
+		}
+		//The first pass fills texels inside triangles with their lowest index triangle.
+		for (const TexelTriangle& tri : setups) {
+			if (tri.degenerate)
+				continue;
+			for (int j = tri.j0; j <= tri.j1; j++) {
+				double b0 = tri.origin[0] + tri.dx[0] * tri.i0 + tri.dy[0] * j;
+				double b1 = tri.origin[1] + tri.dx[1] * tri.i0 + tri.dy[1] * j;
+				double b2 = tri.origin[2] + tri.dx[2] * tri.i0 + tri.dy[2] * j;
+				int n = (tri.i0 - tileX) + (j - tileY) * TILE_SIZE;
+				for (int i = tri.i0; i <= tri.i1; i++, n++, b0 += tri.dx[0], b1 += tri.dx[1], b2 += tri.dx[2]) {
+					if (b0 >= 0.0 && b1 >= 0.0 && b2 >= 0.0 && bestTri[n] < 0) {
+						bestDist[n] = 0.0f;
+						bestTri[n] = tri.index;
+						bestBary[n] = float3((float) b0, (float) b1, (float) b2);
+					}
+				}
+			}
+		}
+		//The second pass finds the closest triangle for texels left in the dilation band.
+		for (size_t k = 0; k < setups.size() && radius > 0.0f; k++) {
+			const TexelTriangle& tri = setups[k];
+			for (int j = tri.j0; j <= tri.j1; j++) {
+				double b0 = tri.origin[0] + tri.dx[0] * tri.i0 + tri.dy[0] * j;
+				double b1 = tri.origin[1] + tri.dx[1] * tri.i0 + tri.dy[1] * j;
+				double b2 = tri.origin[2] + tri.dx[2] * tri.i0 + tri.dy[2] * j;
+				int n = (tri.i0 - tileX) + (j - tileY) * TILE_SIZE;
+				for (int i = tri.i0; i <= tri.i1; i++, n++, b0 += tri.dx[0], b1 += tri.dx[1], b2 += tri.dx[2]) {
+					if (bestTri[n] >= 0 && bestDist[n] == 0.0f)
+						continue;
+					if (!tri.degenerate
+							&& std::max(std::max(b0 * tri.edgeScale[0], b1 * tri.edgeScale[1]), b2 * tri.edgeScale[2]) > radius)
+						continue;
+					float2 q((float) i, (float) j);
+					float minDist = bestDist[n];
+					float3 minBary;
+					bool found = false;
+					for (int e = 0; e < 3; e++) {
+						const float2& u = tri.p[e];
+						float2 d = tri.p[(e + 1) % 3] - u;
+						float len = lengthSqr(d);
+						float s = (len > 0.0f) ? aly::clamp(dot(q - u, d) / len, 0.0f, 1.0f) : 0.0f;
+						float dist = lengthSqr(u + s * d - q);
+						if (dist < minDist || (dist == minDist && bestTri[n] < 0)) {
+							minDist = dist;
+							minBary = float3(0.0f);
+							minBary[e] = 1.0f - s;
+							minBary[(e + 1) % 3] = s;
+							found = true;
+						}
+					}
+					if (found) {
+						bestDist[n] = minDist;
+						bestTri[n] = tri.index;
+						bestBary[n] = minBary;
+					}
+				}
+			}
+		}
+		for (int j = 0; j < tileH; j++) {
+			for (int i = 0; i < tileW; i++) {
+				int n = i + j * TILE_SIZE;
+				int x = tileX + i, y = dim - 1 - (tileY + j);
+				triangleMap(x, y).x = bestTri[n];
+				baryMap(x, y) = (bestTri[n] >= 0) ? float4(bestBary[n], bestDist[n] * uvScale) : float4(0.0f, 0.0f, 0.0f, -1.0f);
+			}
+		}
+	}
+}
+void TextureMapLocator::bakePositions(const Mesh& mesh, Image4f& positionMap) const {
+	Image3f positions;
+	bake(mesh.triIndexes, mesh.vertexLocations, positions);
+	positionMap.resize(dim, dim);
+#pragma omp parallel for
+	for (int n = 0; n < (int) positionMap.size(); n++) {
+		positionMap.data[n] = float4(positions.data[n], baryMap.data[n].w);
+	}
+}
+void TextureMapLocator::bakeNormals(const Mesh& mesh, Image3f& normalMap) const {
+	bake(mesh.triIndexes, mesh.vertexNormals, normalMap);
+#pragma omp parallel for
+	for (int n = 0; n < (int) normalMap.size(); n++) {
+		if (triangleMap.data[n].x >= 0)
+			normalMap.data[n] = normalize(normalMap.data[n]);
+	}
+}
+void TextureMapLocator::bakeColors(const Mesh& mesh, Image4f& colorMap) const {
+	bake(mesh.triIndexes, mesh.vertexColors, colorMap);
+}
+void TextureMapLocator::build(const Mesh& mesh, Image4f& positionMap, Image3f& normalMap) {
+	rasterize(mesh);
+	bakePositions(mesh, positionMap);
+	bakeNormals(mesh, normalMap);
 }
 
 } /* namespace intel */
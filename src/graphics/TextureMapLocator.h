@@ -24,14 +24,66 @@
 
 #include "graphics/AlloyMesh.h"
 namespace aly {
+/*
+ * Rasterizes a mesh's uv triangles into a dim x dim texture and bakes vertex
+ * attributes into it. Every texel within the dilation radius of a triangle
+ * stores the closest triangle and the barycentric coordinates of the closest
+ * point on it. Texels inside a triangle have distance zero, and a dilation of
+ * at least 0.71 texels gives conservative coverage. Texel (i,j) samples uv
+ * (i/dim, j/dim) and is stored in row dim-1-j. Triangles are binned into
+ * tiles that are rasterized in parallel, and ties go to the lower triangle
+ * index so the result does not depend on the thread count.
+ */
 class TextureMapLocator {
 protected:
-	double3 ToBaryNoNormalize(float2 f, float2 p1, float2 p2, float2 p3);
+	static const int TILE_SIZE = 64;
 	int dim;
+	float dilation;
+	//Closest triangle for each texel, or -1 if none is within the dilation radius.
+	Image1i triangleMap;
+	//Barycentric coordinates of the closest point and its squared distance in uv units, which is -1 for empty texels.
+	Image4f baryMap;
 public:
-	TextureMapLocator(int dim);
-	void build(const Mesh& mesh,Image4f& positionMap,Image3f& normalMap);
-	virtual ~TextureMapLocator(){}
+	TextureMapLocator(int dim, float dilation = 1.0f);
+	//Uses the per corner uv coordinates in mesh.textureMap, three per triangle in triIndexes.
+	void rasterize(const Mesh& mesh);
+	void rasterize(const Vector2f& uvs);
+	const Image1i& getTriangleMap() const {
+		return triangleMap;
+	}
+	const Image4f& getBarycentricMap() const {
+		return baryMap;
+	}
+	//Interpolates a per vertex attribute at every covered texel of the last rasterization. Empty texels are set to background.
+	template<class T, int C, ImageType I> void bake(const Vector3ui& triIndexes, const Vector<T, C>& attributes, Image<T, C, I>& out,
+			const vec<T, C>& background = vec<T, C>(T(0))) const {
+		if (attributes.size() == 0) {
+			throw std::runtime_error("Cannot bake an empty attribute array.");
+		}
+		out.resize(dim, dim);
+#pragma omp parallel for
+		for (int j = 0; j < dim; j++) {
+			for (int i = 0; i < dim; i++) {
+				int t = triangleMap(i, j).x;
+				if (t < 0) {
+					out(i, j) = background;
+					continue;
+				}
+				const uint3& tri = triIndexes[t];
+				const float4& b = baryMap(i, j);
+				out(i, j) = vec<T, C>(
+						b.x * vec<float, C>(attributes[tri.x]) + b.y * vec<float, C>(attributes[tri.y]) + b.z * vec<float, C>(attributes[tri.z]));
+			}
+		}
+	}
+	//Rasterizes and bakes positions, with the squared uv distance to the mesh in w (-1 if empty), and unit normals.
+	void build(const Mesh& mesh, Image4f& positionMap, Image3f& normalMap);
+	//Bakes positions with the squared uv distance in w from the last rasterization.
+	void bakePositions(const Mesh& mesh, Image4f& positionMap) const;
+	void bakeNormals(const Mesh& mesh, Image3f& normalMap) const;
+	void bakeColors(const Mesh& mesh, Image4f& colorMap) const;
+	virtual ~TextureMapLocator() {
+	}
 };
 
 } /* namespace intel */
@@ -23,6 +23,31 @@
 #include "math/AlloySparseMatrix.h"
 #include "math/AlloySparseSolve.h"
 namespace aly {
+template<int C> vec<float, C> Diffusivity(const vec<float, C>& mag,
+		const AnisotropicKernel& kernel, float K) {
+	const float ZERO_TOLERANCE = 1E-6f;
+	vec<float, C> score(0.0f);
+	if (kernel == AnisotropicKernel::Gaussian) {
+		for (int n = 0; n < C; n++) {
+			score[n] = (float) std::exp(-std::max(mag[n], 0.0f) / (K * K));
+		}
+	} else if (kernel == AnisotropicKernel::PeronaMalik) {
+		for (int n = 0; n < C; n++) {
+			score[n] = (float) 1.0f
+					/ std::max(ZERO_TOLERANCE, 1 + mag[n] / (K * K));
+		}
+	} else if (kernel == AnisotropicKernel::Weickert) {	//Used in KAZE filters
+		for (int n = 0; n < C; n++) {
+			double det = std::pow(std::sqrt(mag[n]) / K, 8.0);
+			if (det <= ZERO_TOLERANCE) {
+				score[n] = 1.0f;
+			} else {
+				score[n] = 1.0f - (float) std::exp(-3.315 / det);
+			}
+		}
+	}
+	return score;
+}
 template<int C> void AnisotropicDiffusionT(
 		const Image<float, C, ImageType::FLOAT>& imageIn,
 		Image<float, C, ImageType::FLOAT>& out, int iterations,
@@ -47,7 +72,6 @@ template<int C> void AnisotropicDiffusionT(
 	aly::Image<float, C, ImageType::FLOAT> imageC(imageIn.width,
 			imageIn.height);
 	out = imageIn;
-	const float ZERO_TOLERANCE = 1E-6f;
 	int R = (int) (imageIn.width * imageIn.height);
 	aly::SparseMatrix<float,C> A(R, R);
 	Vector<float,C> b;
@@ -70,32 +94,7 @@ template<int C> void AnisotropicDiffusionT(
 				imageGx(i, j) = gX;
 				imageGy(i, j) = gY;
 				imageL(i, j) = L;
-				vec<float, C> score(0.0f);
-				if (kernel == AnisotropicKernel::Gaussian) {
-					vec<float, C> mag = gX * gX + gY * gY;
-					for (int n = 0; n < C; n++) {
-						score[n] = (float) std::exp(
-								-std::max(mag[n], 0.0f) / (K * K));
-					}
-				} else if (kernel == AnisotropicKernel::PeronaMalik) {
-					vec<float, C> mag = gX * gX + gY * gY;
-					for (int n = 0; n < C; n++) {
-						score[n] = (float) 1.0f
-								/ std::max(ZERO_TOLERANCE,
-										1 + mag[n] / (K * K));
-					}
-				} else if (kernel == AnisotropicKernel::Weickert) {	//Used in KAZE filters
-					vec<float, C> mag = gX * gX + gY * gY;
-					for (int n = 0; n < C; n++) {
-						double det = std::pow(std::sqrt(mag[n]) / K, 8.0);
-						if (det <= ZERO_TOLERANCE) {
-							score[n] = 1.0f;
-						} else {
-							score[n] = 1.0f - (float)std::exp(-3.315 / det);
-						}
-					}
-				}
-				imageC(i, j) = score;
+				imageC(i, j) = Diffusivity(gX * gX + gY * gY, kernel, K);
 			}
 		}
 		for (int j = 0; j < imageIn.height ; j++) {
@@ -142,6 +141,223 @@ template<int C> void AnisotropicDiffusionT(
 	}
 }
 
+//Solves (I - s*A_l) x = u along one line with Neumann boundaries (Thomas algorithm) and accumulates w*x into out.
+template<int C> void SolveDiffusionLine(const vec<float, C>* u,
+		const vec<float, C>* g, vec<float, C>* out, size_t stride, int n,
+		float s, float w, std::vector<vec<float, C>>& cp,
+		std::vector<vec<float, C>>& dp) {
+	if (n == 1) {
+		out[0] += w * u[0];
+		return;
+	}
+	cp.resize(n);
+	dp.resize(n);
+	vec<float, C> wl(0.0f);
+	for (int i = 0; i < n; i++) {
+		vec<float, C> wr =
+				(i < n - 1) ?
+						0.5f * (g[i * stride] + g[(i + 1) * stride]) :
+						vec<float, C>(0.0f);
+		vec<float, C> lower = -s * wl;
+		vec<float, C> upper = -s * wr;
+		vec<float, C> diag = 1.0f + s * (wl + wr);
+		if (i == 0) {
+			cp[i] = upper / diag;
+			dp[i] = u[0] / diag;
+		} else {
+			vec<float, C> denom = diag - lower * cp[i - 1];
+			cp[i] = upper / denom;
+			dp[i] = (u[i * stride] - lower * dp[i - 1]) / denom;
+		}
+		wl = wr;
+	}
+	for (int i = n - 2; i >= 0; i--) {
+		dp[i] -= cp[i] * dp[i + 1];
+	}
+	for (int i = 0; i < n; i++) {
+		out[i * stride] += w * dp[i];
+	}
+}
+template<int C> float UpdateDiffusion(std::vector<vec<float, C>>& data,
+		const std::vector<vec<float, C>>& next) {
+	double change = 0.0;
+	size_t N = data.size();
+#pragma omp parallel for reduction(+:change)
+	for (int64_t n = 0; n < (int64_t) N; n++) {
+		vec<float, C> delta = aly::abs(next[n] - data[n]);
+		for (int c = 0; c < C; c++) {
+			change += delta[c];
+		}
+		data[n] = next[n];
+	}
+	return (float) (change / std::max((size_t) 1, N * C));
+}
+template<int C> int AnisotropicDiffusionAOS(
+		const Image<float, C, ImageType::FLOAT>& imageIn,
+		Image<float, C, ImageType::FLOAT>& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	const int M = 3;
+	const int N = 3;
+	const float sigma = 1.2f;
+	float kernelGX[M][N];
+	float kernelGY[M][N];
+	GaussianKernelDerivative(kernelGX, kernelGY, sigma, sigma);
+	const int width = imageIn.width;
+	const int height = imageIn.height;
+	//Two operators split additively, each gets twice the time step and half the weight.
+	const float s = 2.0f * dt;
+	const float w = 0.5f;
+	Image<float, C, ImageType::FLOAT> imageC(width, height);
+	Image<float, C, ImageType::FLOAT> next(width, height);
+	out = imageIn;
+	int iter = 0;
+	while (iter < iterations) {
+#pragma omp parallel for
+		for (int j = 0; j < height; j++) {
+			for (int i = 0; i < width; i++) {
+				vec<float, C> gX(0.0f);
+				vec<float, C> gY(0.0f);
+				for (int ii = 0; ii < M; ii++) {
+					for (int jj = 0; jj < N; jj++) {
+						vec<float, C> val = out(i + ii - M / 2, j + jj - N / 2);
+						gX += kernelGX[ii][jj] * val;
+						gY += kernelGY[ii][jj] * val;
+					}
+				}
+				imageC(i, j) = Diffusivity(gX * gX + gY * gY, kernel, K);
+			}
+		}
+		next.setZero();
+#pragma omp parallel
+		{
+			std::vector<vec<float, C>> cp, dp;
+#pragma omp for
+			for (int j = 0; j < height; j++) {
+				size_t offset = j * (size_t) width;
+				SolveDiffusionLine(&out.data[offset], &imageC.data[offset],
+						&next.data[offset], 1, width, s, w, cp, dp);
+			}
+#pragma omp for
+			for (int i = 0; i < width; i++) {
+				SolveDiffusionLine(&out.data[i], &imageC.data[i], &next.data[i],
+						width, height, s, w, cp, dp);
+			}
+		}
+		iter++;
+		if (UpdateDiffusion(out.data, next.data) < tolerance) {
+			break;
+		}
+	}
+	if (C > 1) {
+		for (vec<float, C>& val : out.data) {
+			val = clamp(val, vec<float, C>(0.0f), vec<float, C>(1.0f));
+		}
+	}
+	return iter;
+}
+template<int C> int AnisotropicDiffusionAOS(
+		const Volume<float, C, ImageType::FLOAT>& volIn,
+		Volume<float, C, ImageType::FLOAT>& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	const int M = 3;
+	const float sigma = 1.2f;
+	float kernelGX[M][M][M];
+	float kernelGY[M][M][M];
+	float kernelGZ[M][M][M];
+	float sum = 0.0f;
+	for (int ii = 0; ii < M; ii++) {
+		for (int jj = 0; jj < M; jj++) {
+			for (int kk = 0; kk < M; kk++) {
+				float x = (ii - M / 2) / sigma;
+				float y = (jj - M / 2) / sigma;
+				float z = (kk - M / 2) / sigma;
+				float g = std::exp(-0.5f * (x * x + y * y + z * z));
+				sum += g;
+				kernelGX[ii][jj][kk] = g * x / sigma;
+				kernelGY[ii][jj][kk] = g * y / sigma;
+				kernelGZ[ii][jj][kk] = g * z / sigma;
+			}
+		}
+	}
+	for (int ii = 0; ii < M; ii++) {
+		for (int jj = 0; jj < M; jj++) {
+			for (int kk = 0; kk < M; kk++) {
+				kernelGX[ii][jj][kk] /= sum;
+				kernelGY[ii][jj][kk] /= sum;
+				kernelGZ[ii][jj][kk] /= sum;
+			}
+		}
+	}
+	const int rows = volIn.rows;
+	const int cols = volIn.cols;
+	const int slices = volIn.slices;
+	const size_t area = rows * (size_t) cols;
+	//Three operators split additively, each gets three times the time step and a third of the weight.
+	const float s = 3.0f * dt;
+	const float w = 1.0f / 3.0f;
+	Volume<float, C, ImageType::FLOAT> volC(rows, cols, slices);
+	Volume<float, C, ImageType::FLOAT> next(rows, cols, slices);
+	out = volIn;
+	int iter = 0;
+	while (iter < iterations) {
+#pragma omp parallel for
+		for (int k = 0; k < slices; k++) {
+			for (int j = 0; j < cols; j++) {
+				for (int i = 0; i < rows; i++) {
+					vec<float, C> gX(0.0f);
+					vec<float, C> gY(0.0f);
+					vec<float, C> gZ(0.0f);
+					for (int ii = 0; ii < M; ii++) {
+						for (int jj = 0; jj < M; jj++) {
+							for (int kk = 0; kk < M; kk++) {
+								vec<float, C> val = out(i + ii - M / 2,
+										j + jj - M / 2, k + kk - M / 2);
+								gX += kernelGX[ii][jj][kk] * val;
+								gY += kernelGY[ii][jj][kk] * val;
+								gZ += kernelGZ[ii][jj][kk] * val;
+							}
+						}
+					}
+					volC(i, j, k) = Diffusivity(gX * gX + gY * gY + gZ * gZ,
+							kernel, K);
+				}
+			}
+		}
+		next.setZero();
+#pragma omp parallel
+		{
+			std::vector<vec<float, C>> cp, dp;
+#pragma omp for
+			for (int n = 0; n < cols * slices; n++) {
+				size_t offset = n * (size_t) rows;
+				SolveDiffusionLine(&out.data[offset], &volC.data[offset],
+						&next.data[offset], 1, rows, s, w, cp, dp);
+			}
+#pragma omp for
+			for (int n = 0; n < rows * slices; n++) {
+				size_t offset = (n % rows) + (n / rows) * area;
+				SolveDiffusionLine(&out.data[offset], &volC.data[offset],
+						&next.data[offset], rows, cols, s, w, cp, dp);
+			}
+#pragma omp for
+			for (int n = 0; n < rows * cols; n++) {
+				SolveDiffusionLine(&out.data[n], &volC.data[n], &next.data[n],
+						area, slices, s, w, cp, dp);
+			}
+		}
+		iter++;
+		if (UpdateDiffusion(out.data, next.data) < tolerance) {
+			break;
+		}
+	}
+	if (C > 1) {
+		for (vec<float, C>& val : out.data) {
+			val = clamp(val, vec<float, C>(0.0f), vec<float, C>(1.0f));
+		}
+	}
+	return iter;
+}
+
 void AnisotropicDiffusion(const Image1f& imageIn, Image1f& out, int iterations,
 	const AnisotropicKernel& kernel, float K, float dt) {
 AnisotropicDiffusionT(imageIn, out, iterations, kernel, K, dt);
@@ -166,5 +382,71 @@ void AnisotropicDiffusion(const Image4f& imageIn, Image4f& out, int iterations,
 AnisotropicDiffusionT(imageIn, out, iterations, kernel, K, dt);
 }
 
+int AnisotropicDiffusionAOS(const Image1us& imageIn, Image1us& out,
+		int iterations, const AnisotropicKernel& kernel, float K, float dt,
+		float tolerance) {
+	Image1f tmpIn, tmpOut;
+	ConvertImage(imageIn, tmpIn);
+	int iter = AnisotropicDiffusionAOS(tmpIn, tmpOut, iterations, kernel, K, dt,
+			tolerance);
+	ConvertImage(tmpOut, out);
+	return iter;
+}
+int AnisotropicDiffusionAOS(const Image1f& imageIn, Image1f& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	return AnisotropicDiffusionAOS<1>(imageIn, out, iterations, kernel, K, dt,
+			tolerance);
+}
+int AnisotropicDiffusionAOS(const Image2f& imageIn, Image2f& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	return AnisotropicDiffusionAOS<2>(imageIn, out, iterations, kernel, K, dt,
+			tolerance);
+}
+int AnisotropicDiffusionAOS(const Image3f& imageIn, Image3f& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	return AnisotropicDiffusionAOS<3>(imageIn, out, iterations, kernel, K, dt,
+			tolerance);
+}
+int AnisotropicDiffusionAOS(const Image4f& imageIn, Image4f& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	return AnisotropicDiffusionAOS<4>(imageIn, out, iterations, kernel, K, dt,
+			tolerance);
+}
+int AnisotropicDiffusionAOS(const Volume1us& volIn, Volume1us& out,
+		int iterations, const AnisotropicKernel& kernel, float K, float dt,
+		float tolerance) {
+	Volume1f tmpIn(volIn.rows, volIn.cols, volIn.slices, volIn.position()), tmpOut;
+	for (size_t n = 0; n < volIn.size(); n++) {
+		tmpIn[n].x = volIn[n].x;
+	}
+	int iter = AnisotropicDiffusionAOS(tmpIn, tmpOut, iterations, kernel, K, dt,
+			tolerance);
+	out.resize(tmpOut.rows, tmpOut.cols, tmpOut.slices);
+	out.setPosition(tmpOut.position());
+	for (size_t n = 0; n < tmpOut.size(); n++) {
+		out[n].x = clamp((int) tmpOut[n].x, 0, 65535);
+	}
+	return iter;
+}
+int AnisotropicDiffusionAOS(const Volume1f& volIn, Volume1f& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	return AnisotropicDiffusionAOS<1>(volIn, out, iterations, kernel, K, dt,
+			tolerance);
+}
+int AnisotropicDiffusionAOS(const Volume2f& volIn, Volume2f& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	return AnisotropicDiffusionAOS<2>(volIn, out, iterations, kernel, K, dt,
+			tolerance);
+}
+int AnisotropicDiffusionAOS(const Volume3f& volIn, Volume3f& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	return AnisotropicDiffusionAOS<3>(volIn, out, iterations, kernel, K, dt,
+			tolerance);
+}
+int AnisotropicDiffusionAOS(const Volume4f& volIn, Volume4f& out, int iterations,
+		const AnisotropicKernel& kernel, float K, float dt, float tolerance) {
+	return AnisotropicDiffusionAOS<4>(volIn, out, iterations, kernel, K, dt,
+			tolerance);
+}
 }
 
@@ -22,6 +22,7 @@
 #ifndef INCLUDE_CORE_ALLOYANISOTROPICFILTER_H_
 #define INCLUDE_CORE_ALLOYANISOTROPICFILTER_H_
 #include "image/AlloyImageProcessing.h"
+#include "image/AlloyVolume.h"
 namespace aly{
 	enum class AnisotropicKernel {
 		Gaussian,
@@ -34,6 +35,20 @@ namespace aly{
 	void AnisotropicDiffusion(const Image3f& imageIn,Image3f& out,int iterations=4,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=1.0f);
 	void AnisotropicDiffusion(const Image4f& imageIn,Image4f& out,int iterations=4,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=1.0f);
 
+	//Semi-implicit additive operator splitting (AOS) scheme of Weickert et al. Each step solves tridiagonal systems along rows, columns (and slices), so it remains stable for large time steps.
+	//Stops early once the mean absolute update per step drops below tolerance. Returns the number of steps taken.
+	int AnisotropicDiffusionAOS(const Image1us& imageIn,Image1us& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+	int AnisotropicDiffusionAOS(const Image1f& imageIn,Image1f& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+	int AnisotropicDiffusionAOS(const Image2f& imageIn,Image2f& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+	int AnisotropicDiffusionAOS(const Image3f& imageIn,Image3f& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+	int AnisotropicDiffusionAOS(const Image4f& imageIn,Image4f& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+
+	int AnisotropicDiffusionAOS(const Volume1us& volIn,Volume1us& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+	int AnisotropicDiffusionAOS(const Volume1f& volIn,Volume1f& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+	int AnisotropicDiffusionAOS(const Volume2f& volIn,Volume2f& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+	int AnisotropicDiffusionAOS(const Volume3f& volIn,Volume3f& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+	int AnisotropicDiffusionAOS(const Volume4f& volIn,Volume4f& out,int iterations=10,const AnisotropicKernel& kernel=AnisotropicKernel::Gaussian,float K=0.02f,float dt=5.0f,float tolerance=1E-4f);
+
 }
 
 
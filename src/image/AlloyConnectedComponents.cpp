@@ -0,0 +1,276 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "image/AlloyConnectedComponents.h"
+#include <stdexcept>
+namespace aly {
+//Number of slabs labeled independently before they are stitched together.
+static const int MAX_COMPONENT_SLABS = 32;
+struct ComponentAccumulator {
+	int label;
+	int size;
+	int3 minPoint;
+	int3 maxPoint;
+	double3 sum;
+	ComponentAccumulator(int label = -1) :
+			label(label), size(0), minPoint(std::numeric_limits<int>::max()), maxPoint(std::numeric_limits<int>::min()), sum(0.0) {
+	}
+	void add(const int3& pos) {
+		size++;
+		minPoint = aly::min(minPoint, pos);
+		maxPoint = aly::max(maxPoint, pos);
+		sum += double3(pos);
+	}
+	void add(const ComponentAccumulator& other) {
+		size += other.size;
+		minPoint = aly::min(minPoint, other.minPoint);
+		maxPoint = aly::max(maxPoint, other.maxPoint);
+		sum += other.sum;
+	}
+};
+//Path halving, so every find also shortens the path for the next one.
+static inline int FindComponentRoot(int* parent, int i) {
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+//Read only version for the parallel flatten.
+static inline int FindComponentRoot(const int* parent, int i) {
+	while (parent[i] != i) {
+		i = parent[i];
+	}
+	return i;
+}
+//The smaller index always becomes the root, so roots are the first pixel of their component in raster order.
+static inline void UnionComponents(int* parent, int a, int b) {
+	a = FindComponentRoot(parent, a);
+	b = FindComponentRoot(parent, b);
+	if (a < b) {
+		parent[b] = a;
+	} else if (b < a) {
+		parent[a] = b;
+	}
+}
+static int LabelComponents(const int* labels, int* out, const int3& dims, bool volume, int connectivity, bool ignoreNegative,
+		std::vector<ComponentAccumulator>& comps) {
+	int maxNonZero;
+	if (!volume) {
+		if (connectivity == 4) {
+			maxNonZero = 1;
+		} else if (connectivity == 8) {
+			maxNonZero = 2;
+		} else {
+			throw std::runtime_error(MakeString() << "Connected components connectivity must be 4 or 8 in 2D, not " << connectivity);
+		}
+	} else {
+		if (connectivity == 6) {
+			maxNonZero = 1;
+		} else if (connectivity == 18) {
+			maxNonZero = 2;
+		} else if (connectivity == 26) {
+			maxNonZero = 3;
+		} else {
+			throw std::runtime_error(MakeString() << "Connected components connectivity must be 6, 18 or 26 in 3D, not " << connectivity);
+		}
+	}
+	comps.clear();
+	int N = dims.x * dims.y * dims.z;
+	if (N == 0)
+		return 0;
+	//Slabs are cut along the slowest axis.
+	int axis = (volume) ? 2 : 1;
+	int layers = dims[axis];
+	int layerSize = N / layers;
+	//Neighbors that come earlier in raster order, with their index offsets.
+	std::vector<int3> offsets;
+	std::vector<int> deltas;
+	for (int dz = -1; dz <= 1; dz++) {
+		for (int dy = -1; dy <= 1; dy++) {
+			for (int dx = -1; dx <= 1; dx++) {
+				int nonZero = std::abs(dx) + std::abs(dy) + std::abs(dz);
+				if ((!volume && dz != 0) || nonZero == 0 || nonZero > maxNonZero)
+					continue;
+				if (dz < 0 || (dz == 0 && dy < 0) || (dz == 0 && dy == 0 && dx < 0)) {
+					offsets.push_back(int3(dx, dy, dz));
+					deltas.push_back(dx + (dy + dz * dims.y) * dims.x);
+				}
+			}
+		}
+	}
+	int slabs = std::min(layers, MAX_COMPONENT_SLABS);
+	std::vector<int> slabStart(slabs + 1);
+	for (int s = 0; s <= slabs; s++) {
+		slabStart[s] = (int) (((int64_t) layers * s) / slabs);
+	}
+	std::vector<int> parent(N);
+	std::vector<std::vector<int>> localRoots(slabs);
+	std::vector<std::vector<ComponentAccumulator>> localComps(slabs);
+	int* P = parent.data();
+	//Label each slab on its own, then accumulate statistics for the provisional components while the slab is in cache.
+#pragma omp parallel for
+	for (int s = 0; s < slabs; s++) {
+		int start = slabStart[s];
+		int3 low(0, (volume) ? 0 : start, (volume) ? start : 0);
+		int3 high(dims.x, (volume) ? dims.y : slabStart[s + 1], (volume) ? slabStart[s + 1] : 1);
+		int O = (int) offsets.size();
+		int idx = start * layerSize;
+		for (int k = low.z; k < high.z; k++) {
+			for (int j = low.y; j < high.y; j++) {
+				for (int i = 0; i < dims.x; i++, idx++) {
+					int l = labels[idx];
+					if (ignoreNegative && l < 0) {
+						P[idx] = -1;
+						continue;
+					}
+					P[idx] = idx;
+					for (int n = 0; n < O; n++) {
+						const int3& off = offsets[n];
+						int ni = i + off.x;
+						int nj = j + off.y;
+						if (ni < 0 || ni >= dims.x || nj < low.y || nj >= dims.y || k + off.z < low.z)
+							continue;
+						int nidx = idx + deltas[n];
+						if (labels[nidx] == l) {
+							UnionComponents(P, idx, nidx);
+						}
+					}
+				}
+			}
+		}
+		std::vector<int>& roots = localRoots[s];
+		std::vector<ComponentAccumulator>& accum = localComps[s];
+		idx = start * layerSize;
+		for (int k = low.z; k < high.z; k++) {
+			for (int j = low.y; j < high.y; j++) {
+				for (int i = 0; i < dims.x; i++, idx++) {
+					if (P[idx] < 0)
+						continue;
+					int r = FindComponentRoot(P, idx);
+					if (r == idx) {
+						out[idx] = (int) roots.size();
+						roots.push_back(idx);
+						accum.push_back(ComponentAccumulator(labels[idx]));
+					}
+					accum[out[r]].add(int3(i, j, k));
+				}
+			}
+		}
+	}
+	//Stitch each slab to the last layer of the one before it.
+	for (int s = 1; s < slabs; s++) {
+		int start = slabStart[s];
+		for (int idx = start * layerSize; idx < (start + 1) * layerSize; idx++) {
+			if (P[idx] < 0)
+				continue;
+			int l = labels[idx];
+			int3 pos(idx % dims.x, (idx / dims.x) % dims.y, idx / (dims.x * dims.y));
+			for (const int3& off : offsets) {
+				int3 nbr = pos + off;
+				if (nbr[axis] != start - 1 || nbr.x < 0 || nbr.y < 0 || nbr.x >= dims.x || nbr.y >= dims.y)
+					continue;
+				int nidx = nbr.x + (nbr.y + nbr.z * dims.y) * dims.x;
+				if (labels[nidx] == l) {
+					UnionComponents(P, idx, nidx);
+				}
+			}
+		}
+	}
+	//Number the global roots in raster order.
+	std::vector<int> slabOffsets(slabs + 1, 0);
+#pragma omp parallel for
+	for (int s = 0; s < slabs; s++) {
+		int count = 0;
+		for (int r : localRoots[s]) {
+			if (P[r] == r)
+				count++;
+		}
+		slabOffsets[s + 1] = count;
+	}
+	for (int s = 0; s < slabs; s++) {
+		slabOffsets[s + 1] += slabOffsets[s];
+	}
+#pragma omp parallel for
+	for (int s = 0; s < slabs; s++) {
+		int id = slabOffsets[s];
+		for (int r : localRoots[s]) {
+			if (P[r] == r)
+				out[r] = id++;
+		}
+	}
+	const int* cP = P;
+#pragma omp parallel for
+	for (int s = 0; s < slabs; s++) {
+		for (int idx = slabStart[s] * layerSize; idx < slabStart[s + 1] * layerSize; idx++) {
+			int p = cP[idx];
+			if (p < 0) {
+				out[idx] = -1;
+			} else if (p != idx) {
+				out[idx] = out[FindComponentRoot(cP, idx)];
+			}
+		}
+	}
+	int count = slabOffsets[slabs];
+	comps.resize(count);
+	for (int s = 0; s < slabs; s++) {
+		for (size_t k = 0; k < localRoots[s].size(); k++) {
+			ComponentAccumulator& comp = comps[out[localRoots[s][k]]];
+			comp.label = localComps[s][k].label;
+			comp.add(localComps[s][k]);
+		}
+	}
+	return count;
+}
+int ConnectedComponents(const Image1i& labels, Image1i& components, std::vector<ConnectedComponent2D>& stats, int connectivity,
+		bool ignoreNegative) {
+	std::vector<ComponentAccumulator> comps;
+	components.resize(labels.width, labels.height);
+	int count = LabelComponents(labels.ptr(), components.ptr(), int3(labels.width, labels.height, 1), false, connectivity, ignoreNegative, comps);
+	stats.resize(count);
+	for (int n = 0; n < count; n++) {
+		const ComponentAccumulator& comp = comps[n];
+		ConnectedComponent2D& stat = stats[n];
+		stat.label = comp.label;
+		stat.size = comp.size;
+		stat.minPoint = comp.minPoint.xy();
+		stat.maxPoint = comp.maxPoint.xy();
+		stat.centroid = float2((float) (comp.sum.x / comp.size), (float) (comp.sum.y / comp.size));
+	}
+	return count;
+}
+int ConnectedComponents(const Volume1i& labels, Volume1i& components, std::vector<ConnectedComponent3D>& stats, int connectivity,
+		bool ignoreNegative) {
+	std::vector<ComponentAccumulator> comps;
+	components.resize(labels.rows, labels.cols, labels.slices);
+	int count = LabelComponents(labels.ptr(), components.ptr(), labels.dimensions(), true, connectivity, ignoreNegative, comps);
+	stats.resize(count);
+	for (int n = 0; n < count; n++) {
+		const ComponentAccumulator& comp = comps[n];
+		ConnectedComponent3D& stat = stats[n];
+		stat.label = comp.label;
+		stat.size = comp.size;
+		stat.minPoint = comp.minPoint;
+		stat.maxPoint = comp.maxPoint;
+		stat.centroid = float3(comp.sum / (double) comp.size);
+	}
+	return count;
+}
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef INCLUDE_ALLOYCONNECTEDCOMPONENTS_H_
+#define INCLUDE_ALLOYCONNECTEDCOMPONENTS_H_
+#include "image/AlloyImage.h"
+#include "image/AlloyVolume.h"
+#include <vector>
+namespace aly {
+bool SANITY_CHECK_CONNECTED_COMPONENTS();
+struct ConnectedComponent2D {
+	int label;//Input label shared by every pixel in the component
+	int size;
+	int2 minPoint;
+	int2 maxPoint;
+	float2 centroid;
+	ConnectedComponent2D() :
+			label(-1), size(0), minPoint(0), maxPoint(0), centroid(0.0f) {
+	}
+};
+struct ConnectedComponent3D {
+	int label;
+	int size;
+	int3 minPoint;
+	int3 maxPoint;
+	float3 centroid;
+	ConnectedComponent3D() :
+			label(-1), size(0), minPoint(0), maxPoint(0), centroid(0.0f) {
+	}
+};
+/*
+ * Labels regions of equal value with a block-parallel union-find. The image is
+ * split into slabs that are labeled independently, then the slabs are stitched
+ * together and flattened in parallel. Components are numbered from 0 in raster
+ * order of their first pixel, and their size, bounding box and centroid are
+ * gathered while the slabs are labeled. If ignoreNegative is set, negative labels
+ * are background and come out as -1. Connectivity is 4 or 8 in 2D and 6, 18 or 26
+ * in 3D. Returns the number of components.
+ */
+int ConnectedComponents(const Image1i& labels, Image1i& components, std::vector<ConnectedComponent2D>& stats, int connectivity = 4,
+		bool ignoreNegative = false);
+int ConnectedComponents(const Volume1i& labels, Volume1i& components, std::vector<ConnectedComponent3D>& stats, int connectivity = 6,
+		bool ignoreNegative = false);
+}
+#endif
@@ -0,0 +1,307 @@
+/*
+ * Copyright(C) 2015, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef INCLUDE_CORE_ALLOYPYRAMID_H_
+#define INCLUDE_CORE_ALLOYPYRAMID_H_
+#include "image/AlloyImage.h"
+#include <mutex>
+#include <memory>
+#include <list>
+#include <cstring>
+namespace aly {
+//Gaussian3x3 and Gaussian5x5 reproduce DownSample3x3 and DownSample5x5 respectively.
+enum class PyramidFilter {
+	Gaussian3x3, Gaussian5x5
+};
+template<class T, int C, ImageType I> class Pyramid {
+public:
+	typedef Image<float, C, ImageType::FLOAT> LaplacianImage;
+protected:
+	//Levels are built on demand and never reallocated afterwards, so references to them stay valid for the pyramid's lifetime.
+	std::vector<Image<T, C, I>> gaussian;
+	std::vector<LaplacianImage> laplacian;
+	std::vector<int2> dims;
+	std::vector<bool> laplacianValid;
+	int gaussianValid;
+	PyramidFilter filter;
+	mutable std::mutex lock;
+	static int MaxLevels(int2 d, int levels) {
+		int l = 1;
+		while (l < levels && d.x >= 2 && d.y >= 2) {
+			d = d / 2;
+			l++;
+		}
+		return l;
+	}
+	void getKernel(const float*& kernel, int& size, int& shift) const {
+		static const float Kernel3x3[3] = { 0.25f, 0.5f, 0.25f };
+		static const float Kernel5x5[5] = { 0.0625f, 0.25f, 0.375f, 0.25f,
+				0.0625f };
+		if (filter == PyramidFilter::Gaussian3x3) {
+			kernel = Kernel3x3;
+			size = 3;
+			shift = -2;
+		} else {
+			kernel = Kernel5x5;
+			size = 5;
+			shift = -2;
+		}
+	}
+	//Separable down sample. Clamped look-ups are only used for the few samples whose support leaves the image.
+	template<class R> void downSample(const vec<R, C>* in, int2 inDims,
+			vec<T, C>* out, int2 outDims) const {
+		const float* kernel;
+		int K, shift;
+		getKernel(kernel, K, shift);
+		std::vector<vec<float, C>> rows(outDims.x * (size_t) inDims.y);
+		int iStart = std::min(outDims.x, std::max(0, (1 - shift) / 2));
+		int iEnd = std::max(iStart,
+				std::min(outDims.x, (inDims.x - K - shift) / 2 + 1));
+#pragma omp parallel for
+		for (int j = 0; j < inDims.y; j++) {
+			const vec<R, C>* row = &in[j * (size_t) inDims.x];
+			vec<float, C>* dst = &rows[j * (size_t) outDims.x];
+			for (int i = 0; i < outDims.x; i++) {
+				vec<float, C> vsum(0.0f);
+				int x = 2 * i + shift;
+				if (i >= iStart && i < iEnd) {
+					for (int k = 0; k < K; k++) {
+						vsum += kernel[k] * vec<float, C>(row[x + k]);
+					}
+				} else {
+					for (int k = 0; k < K; k++) {
+						vsum += kernel[k]
+								* vec<float, C>(
+										row[clamp(x + k, 0, inDims.x - 1)]);
+					}
+				}
+				dst[i] = vsum;
+			}
+		}
+#pragma omp parallel for
+		for (int j = 0; j < outDims.y; j++) {
+			vec<T, C>* dst = &out[j * (size_t) outDims.x];
+			int y = 2 * j + shift;
+			const vec<float, C>* src[5];
+			for (int k = 0; k < K; k++) {
+				src[k] = &rows[clamp(y + k, 0, inDims.y - 1)
+						* (size_t) outDims.x];
+			}
+			for (int i = 0; i < outDims.x; i++) {
+				vec<float, C> vsum(0.0f);
+				for (int k = 0; k < K; k++) {
+					vsum += kernel[k] * src[k][i];
+				}
+				dst[i] = vec<T, C>(vsum);
+			}
+		}
+	}
+	//Separable equivalent of UpSample() that writes directly into a buffer of the finer level's dimensions.
+	template<class R> static void upSample(const vec<R, C>* in, int2 inDims,
+			vec<float, C>* out, int2 outDims) {
+		static const float Kernel[5] = { 0.125f, 0.5f, 0.75f, 0.5f, 0.125f };
+		std::vector<vec<float, C>> rows(outDims.x * (size_t) inDims.y);
+#pragma omp parallel for
+		for (int j = 0; j < inDims.y; j++) {
+			const vec<R, C>* row = &in[j * (size_t) inDims.x];
+			vec<float, C>* dst = &rows[j * (size_t) outDims.x];
+			for (int i = 0; i < outDims.x; i++) {
+				vec<float, C> vsum(0.0f);
+				for (int k = (i % 2 == 0) ? 0 : 1; k < 5; k += 2) {
+					vsum += Kernel[k]
+							* vec<float, C>(
+									row[clamp((i + k - 2) / 2, 0,
+											inDims.x - 1)]);
+				}
+				dst[i] = vsum;
+			}
+		}
+#pragma omp parallel for
+		for (int j = 0; j < outDims.y; j++) {
+			vec<float, C>* dst = &out[j * (size_t) outDims.x];
+			for (int i = 0; i < outDims.x; i++) {
+				dst[i] = vec<float, C>(0.0f);
+			}
+			for (int k = (j % 2 == 0) ? 0 : 1; k < 5; k += 2) {
+				const vec<float, C>* src = &rows[clamp((j + k - 2) / 2, 0,
+						inDims.y - 1) * (size_t) outDims.x];
+				for (int i = 0; i < outDims.x; i++) {
+					dst[i] += Kernel[k] * src[i];
+				}
+			}
+		}
+	}
+	void buildGaussian(int l) {
+		while (gaussianValid <= l) {
+			int n = gaussianValid;
+			gaussian[n].resize(dims[n]);
+			downSample(gaussian[n - 1].data.data(), dims[n - 1], gaussian[n].data.data(),
+					dims[n]);
+			gaussianValid++;
+		}
+	}
+	void buildLaplacian(int l) {
+		if (laplacianValid[l])
+			return;
+		buildGaussian(l);
+		const size_t N = dims[l].x * (size_t) dims[l].y;
+		laplacian[l].resize(dims[l]);
+		vec<float, C>* lap = laplacian[l].data.data();
+		const vec<T, C>* gauss = gaussian[l].data.data();
+		if (l == size() - 1) {
+			for (size_t n = 0; n < N; n++) {
+				lap[n] = vec<float, C>(gauss[n]);
+			}
+		} else {
+			buildGaussian(l + 1);
+			upSample(gaussian[l + 1].data.data(), dims[l + 1], lap, dims[l]);
+#pragma omp parallel for
+			for (int64_t n = 0; n < (int64_t) N; n++) {
+				lap[n] = vec<float, C>(gauss[n]) - lap[n];
+			}
+		}
+		laplacianValid[l] = true;
+	}
+	struct Cache {
+		std::mutex lock;
+		//Requested level count and pyramid, most recently used first.
+		std::list<std::pair<int, std::shared_ptr<Pyramid<T, C, I>>> > entries;
+		size_t capacity = 8;
+	};
+	static Cache& GetCache() {
+		static Cache cache;
+		return cache;
+	}
+public:
+	Pyramid(const Image<T, C, I>& image, int levels,
+			const PyramidFilter& filter = PyramidFilter::Gaussian5x5) :
+			gaussianValid(1), filter(filter) {
+		int L = MaxLevels(image.dimensions(), std::max(levels, 1));
+		int2 d = image.dimensions();
+		for (int l = 0; l < L; l++) {
+			dims.push_back(d);
+			d = d / 2;
+		}
+		laplacianValid.resize(L, false);
+		gaussian.resize(L);
+		laplacian.resize(L);
+		gaussian[0] = image;
+	}
+	//True if the pyramid was built from exactly these pixels. Level 0 is a copy of the source image.
+	bool matches(const Image<T, C, I>& image) const {
+		if (image.dimensions() != dims[0]) {
+			return false;
+		}
+		return (std::memcmp(image.ptr(), gaussian[0].ptr(),
+				image.size() * sizeof(vec<T, C>)) == 0);
+	}
+	//Returns a pyramid shared by every caller that requests the same image, level count and filter.
+	//Entries are matched on dimensions first and then on the pixels themselves, so a hit is never another image's pyramid.
+	//Callers that build a pyramid for a one-off computation should own it instead, entries stay alive until evicted.
+	static std::shared_ptr<Pyramid<T, C, I>> Get(const Image<T, C, I>& image,
+			int levels, const PyramidFilter& filter =
+					PyramidFilter::Gaussian5x5) {
+		Cache& cache = GetCache();
+		std::lock_guard<std::mutex> lockMe(cache.lock);
+		for (auto iter = cache.entries.begin(); iter != cache.entries.end();
+				iter++) {
+			if (iter->first == levels && iter->second->filter == filter
+					&& iter->second->matches(image)) {
+				cache.entries.splice(cache.entries.begin(), cache.entries, iter);
+				return cache.entries.front().second;
+			}
+		}
+		std::shared_ptr<Pyramid<T, C, I>> pyramid = std::shared_ptr<
+				Pyramid<T, C, I>>(new Pyramid<T, C, I>(image, levels, filter));
+		cache.entries.push_front(std::make_pair(levels, pyramid));
+		while (cache.entries.size() > cache.capacity) {
+			cache.entries.pop_back();
+		}
+		return pyramid;
+	}
+	static void SetCacheCapacity(size_t capacity) {
+		Cache& cache = GetCache();
+		std::lock_guard<std::mutex> lockMe(cache.lock);
+		cache.capacity = capacity;
+		while (cache.entries.size() > cache.capacity) {
+			cache.entries.pop_back();
+		}
+	}
+	static void ClearCache() {
+		Cache& cache = GetCache();
+		std::lock_guard<std::mutex> lockMe(cache.lock);
+		cache.entries.clear();
+	}
+	int size() const {
+		return (int) dims.size();
+	}
+	int2 dimensions(int l) const {
+		return dims[l];
+	}
+	PyramidFilter getFilter() const {
+		return filter;
+	}
+	//Level l of the Gaussian pyramid, building coarser levels on demand. Use the reference directly instead of copying the level.
+	const Image<T, C, I>& getGaussian(int l) {
+		std::lock_guard<std::mutex> lockMe(lock);
+		buildGaussian(l);
+		return gaussian[l];
+	}
+	void getGaussian(int l, Image<T, C, I>& out) {
+		out = getGaussian(l);
+	}
+	const LaplacianImage& getLaplacian(int l) {
+		std::lock_guard<std::mutex> lockMe(lock);
+		buildLaplacian(l);
+		return laplacian[l];
+	}
+	void getLaplacian(int l, LaplacianImage& out) {
+		out = getLaplacian(l);
+	}
+	//Collapses the Laplacian pyramid back into an image at the resolution of level l.
+	void reconstruct(Image<T, C, I>& out, int l = 0) {
+		int L = size();
+		const LaplacianImage& top = getLaplacian(L - 1);
+		std::vector<vec<float, C>> current(top.data.begin(), top.data.end());
+		std::vector<vec<float, C>> next;
+		for (int n = L - 2; n >= l; n--) {
+			const LaplacianImage& lap = getLaplacian(n);
+			next.resize(dims[n].x * (size_t) dims[n].y);
+			upSample(current.data(), dims[n + 1], next.data(), dims[n]);
+			for (size_t k = 0; k < next.size(); k++) {
+				next[k] += lap[k];
+			}
+			current.swap(next);
+		}
+		out.resize(dims[l]);
+		for (size_t k = 0; k < current.size(); k++) {
+			out[k] = vec<T, C>(current[k]);
+		}
+	}
+};
+typedef Pyramid<float, 1, ImageType::FLOAT> Pyramid1f;
+typedef Pyramid<float, 2, ImageType::FLOAT> Pyramid2f;
+typedef Pyramid<float, 3, ImageType::FLOAT> Pyramid3f;
+typedef Pyramid<float, 4, ImageType::FLOAT> Pyramid4f;
+typedef Pyramid<uint8_t, 1, ImageType::UBYTE> Pyramid1ub;
+typedef Pyramid<uint8_t, 3, ImageType::UBYTE> Pyramid3ub;
+typedef Pyramid<uint8_t, 4, ImageType::UBYTE> Pyramid4ub;
+}
+#endif /* INCLUDE_CORE_ALLOYPYRAMID_H_ */
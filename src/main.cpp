@@ -138,6 +138,11 @@ typedef std::unique_ptr<Example> ExamplePtr;
 bool SANITY_CHECK() {
 	bool ret = true;
 	//ret &= SANITY_CHECK_LOCATOR();
+	//ret &= SANITY_CHECK_DESCRIPTOR_MATCHER();
+	//ret &= SANITY_CHECK_MATRIX_BATCH();
+	//ret &= SANITY_CHECK_CONNECTED_COMPONENTS();
+	//ret &= SANITY_CHECK_DELAUNAY();
+	//ret &= SANITY_CHECK_VECTOR_SERIALIZATION();
 	//SANITY_CHECK_ANY();
 	//SANITY_CHECK_SVD();
 	//SANITY_CHECK_ALGO();
@@ -159,6 +164,8 @@ bool SANITY_CHECK() {
 	//SANITY_CHECK_SVD();
 	//SANITY_CHECK_VIDEOENCODER();
 	//SANITY_CHECK_STRINGS();
+	//SANITY_CHECK_DIRECTORY_INDEX();
+	//SANITY_CHECK_FLUID3D();
 	return ret;
 }
 int main(int argc, char *argv[]) {
@@ -21,6 +21,7 @@
 #include "math/AlloyDenseSolve.h"
 #include "system/AlloyFileUtil.h"
 #include "image/AlloyDistanceField.h"
+#include "image/AlloyPyramid.h"
 #include <queue>
 namespace aly {
 void LaplaceFill(const Image4f& sourceImg, Image4f& targetImg, int iterations,
@@ -41,20 +42,16 @@ void LaplaceFill(const Image4f& sourceImg, Image4f& targetImg, int iterations,
 			}
 		});
 	} else {
-		std::vector<Image4f> srcPyramid(levels);
-		std::vector<Image4f> tarPyramid(levels);
-		srcPyramid[0] = sourceImg;
-		tarPyramid[0] = targetImg;
-		for (int l = 1; l < levels; l++) {
-			srcPyramid[l - 1].downSample(srcPyramid[l]);
-			tarPyramid[l - 1].downSample(tarPyramid[l]);
-		}
+		//Read-only inputs share their pyramids with other solves of the same image. Only the coarsest level of the solution is needed.
+		std::shared_ptr<Pyramid4f> srcLevels = Pyramid4f::Get(sourceImg, levels);
+		levels = srcLevels->size();
+		Image4f current = Pyramid4f(targetImg, levels).getGaussian(levels - 1);
 		for (int l = levels - 1; l >= 1; l--) {
 			if (iterationMonitor) {
 				if (!iterationMonitor(l, 0))
 					return;
 			}
-			LaplaceFill(srcPyramid[l], tarPyramid[l], iterations, lambda,
+			LaplaceFill(srcLevels->getGaussian(l), current, iterations, lambda,
 					[=](int iter) {
 						if (iterationMonitor) {
 							return iterationMonitor(l, iter);
@@ -63,9 +60,14 @@ void LaplaceFill(const Image4f& sourceImg, Image4f& targetImg, int iterations,
 							return true;
 						}
 					});
-			tarPyramid[l].upSample(tarPyramid[l - 1]);
+			if (l > 1) {
+				Image4f next(srcLevels->dimensions(l - 1));
+				current.upSample(next);
+				current = next;
+			} else {
+				current.upSample(targetImg);
+			}
 		}
-		targetImg = tarPyramid[0];
 		LaplaceFill(sourceImg, targetImg, iterations, lambda, [=](int iter) {
 			if (iterationMonitor) {
 				return iterationMonitor(0, iter);
@@ -200,20 +202,16 @@ void LaplaceFill(const Image2f& sourceImg, Image2f& targetImg, int iterations,
 			return iterationMonitor(0, iter);
 		});
 	} else {
-		std::vector<Image2f> srcPyramid(levels);
-		std::vector<Image2f> tarPyramid(levels);
-		srcPyramid[0] = sourceImg;
-		tarPyramid[0] = targetImg;
-		for (int l = 1; l < levels; l++) {
-			srcPyramid[l - 1].downSample(srcPyramid[l]);
-			tarPyramid[l - 1].downSample(tarPyramid[l]);
-		}
+		//Read-only inputs share their pyramids with other solves of the same image. Only the coarsest level of the solution is needed.
+		std::shared_ptr<Pyramid2f> srcLevels = Pyramid2f::Get(sourceImg, levels);
+		levels = srcLevels->size();
+		Image2f current = Pyramid2f(targetImg, levels).getGaussian(levels - 1);
 		for (int l = levels - 1; l >= 1; l--) {
 			if (iterationMonitor) {
 				if (!iterationMonitor(l, 0))
 					return;
 			}
-			LaplaceFill(srcPyramid[l], tarPyramid[l], iterations, lambda,
+			LaplaceFill(srcLevels->getGaussian(l), current, iterations, lambda,
 					[=](int iter) {
 						if (iterationMonitor) {
 							return iterationMonitor(l, iter);
@@ -222,9 +220,14 @@ void LaplaceFill(const Image2f& sourceImg, Image2f& targetImg, int iterations,
 							return true;
 						}
 					});
-			tarPyramid[l].upSample(tarPyramid[l - 1]);
+			if (l > 1) {
+				Image2f next(srcLevels->dimensions(l - 1));
+				current.upSample(next);
+				current = next;
+			} else {
+				current.upSample(targetImg);
+			}
 		}
-		targetImg = tarPyramid[0];
 		LaplaceFill(sourceImg, targetImg, iterations, lambda, [=](int iter) {
 			if (iterationMonitor) {
 				return iterationMonitor(0, iter);
@@ -366,23 +369,17 @@ void PoissonInpaint(const Image4f& sourceImg, const Image4f& targetImg,
 					}
 				});
 	} else {
-		std::vector<Image4f> srcPyramid(levels);
-		std::vector<Image4f> tarPyramid(levels);
-		std::vector<Image4f> outPyramid(levels);
-		srcPyramid[0] = sourceImg;
-		tarPyramid[0] = targetImg;
-		outPyramid[0] = outImg;
-		for (int l = 1; l < levels; l++) {
-			srcPyramid[l - 1].downSample(srcPyramid[l]);
-			tarPyramid[l - 1].downSample(tarPyramid[l]);
-			outPyramid[l - 1].downSample(outPyramid[l]);
-		}
+		//Read-only inputs share their pyramids with other solves of the same image. Only the coarsest level of the solution is needed.
+		std::shared_ptr<Pyramid4f> srcLevels = Pyramid4f::Get(sourceImg, levels);
+		std::shared_ptr<Pyramid4f> tarLevels = Pyramid4f::Get(targetImg, levels);
+		levels = srcLevels->size();
+		Image4f current = Pyramid4f(outImg, levels).getGaussian(levels - 1);
 		for (int l = levels - 1; l >= 1; l--) {
 			if (iterationMonitor) {
 				if (!iterationMonitor(l, 0))
 					return;
 			}
-			PoissonInpaint(srcPyramid[l], tarPyramid[l], outPyramid[l],
+			PoissonInpaint(srcLevels->getGaussian(l), tarLevels->getGaussian(l), current,
 					iterations, lambda, [=](int iter) {
 						if (iterationMonitor) {
 							return iterationMonitor(l, iter);
@@ -391,9 +388,14 @@ void PoissonInpaint(const Image4f& sourceImg, const Image4f& targetImg,
 							return true;
 						}
 					});
-			outPyramid[l].upSample(outPyramid[l - 1]);
+			if (l > 1) {
+				Image4f next(srcLevels->dimensions(l - 1));
+				current.upSample(next);
+				current = next;
+			} else {
+				current.upSample(outImg);
+			}
 		}
-		outImg = outPyramid[0];
 		PoissonInpaint(sourceImg, targetImg, outImg, iterations, lambda,
 				[=](int iter) {
 					if (iterationMonitor) {
@@ -494,23 +496,17 @@ void PoissonInpaint(const Image2f& sourceImg, const Image2f& targetImg,
 					}
 				});
 	} else {
-		std::vector<Image2f> srcPyramid(levels);
-		std::vector<Image2f> tarPyramid(levels);
-		std::vector<Image2f> outPyramid(levels);
-		srcPyramid[0] = sourceImg;
-		tarPyramid[0] = targetImg;
-		outPyramid[0] = outImg;
-		for (int l = 1; l < levels; l++) {
-			srcPyramid[l - 1].downSample(srcPyramid[l]);
-			tarPyramid[l - 1].downSample(tarPyramid[l]);
-			outPyramid[l - 1].downSample(outPyramid[l]);
-		}
+		//Read-only inputs share their pyramids with other solves of the same image. Only the coarsest level of the solution is needed.
+		std::shared_ptr<Pyramid2f> srcLevels = Pyramid2f::Get(sourceImg, levels);
+		std::shared_ptr<Pyramid2f> tarLevels = Pyramid2f::Get(targetImg, levels);
+		levels = srcLevels->size();
+		Image2f current = Pyramid2f(outImg, levels).getGaussian(levels - 1);
 		for (int l = levels - 1; l >= 1; l--) {
 			if (iterationMonitor) {
 				if (!iterationMonitor(l, 0))
 					return;
 			}
-			PoissonInpaint(srcPyramid[l], tarPyramid[l], outPyramid[l],
+			PoissonInpaint(srcLevels->getGaussian(l), tarLevels->getGaussian(l), current,
 					iterations, lambda, [=](int iter) {
 						if (iterationMonitor) {
 							return iterationMonitor(l, iter);
@@ -519,9 +515,14 @@ void PoissonInpaint(const Image2f& sourceImg, const Image2f& targetImg,
 							return true;
 						}
 					});
-			outPyramid[l].upSample(outPyramid[l - 1]);
+			if (l > 1) {
+				Image2f next(srcLevels->dimensions(l - 1));
+				current.upSample(next);
+				current = next;
+			} else {
+				current.upSample(outImg);
+			}
 		}
-		outImg = outPyramid[0];
 		PoissonInpaint(sourceImg, targetImg, outImg, iterations, lambda,
 				[=](int iter) {
 					if (iterationMonitor) {
@@ -619,20 +620,16 @@ void PoissonBlend(const Image4f& sourceImg, Image4f& targetImg, int iterations,
 			}
 		});
 	} else {
-		std::vector<Image4f> srcPyramid(levels);
-		std::vector<Image4f> tarPyramid(levels);
-		srcPyramid[0] = sourceImg;
-		tarPyramid[0] = targetImg;
-		for (int l = 1; l < levels; l++) {
-			srcPyramid[l - 1].downSample(srcPyramid[l]);
-			tarPyramid[l - 1].downSample(tarPyramid[l]);
-		}
+		//Read-only inputs share their pyramids with other solves of the same image. Only the coarsest level of the solution is needed.
+		std::shared_ptr<Pyramid4f> srcLevels = Pyramid4f::Get(sourceImg, levels);
+		levels = srcLevels->size();
+		Image4f current = Pyramid4f(targetImg, levels).getGaussian(levels - 1);
 		for (int l = levels - 1; l >= 1; l--) {
 			if (iterationMonitor) {
 				if (!iterationMonitor(l, 0))
 					return;
 			}
-			PoissonBlend(srcPyramid[l], tarPyramid[l], iterations, lambda,
+			PoissonBlend(srcLevels->getGaussian(l), current, iterations, lambda,
 					[=](int iter) {
 						if (iterationMonitor) {
 							return iterationMonitor(l, iter);
@@ -641,9 +638,14 @@ void PoissonBlend(const Image4f& sourceImg, Image4f& targetImg, int iterations,
 							return true;
 						}
 					});
-			tarPyramid[l].upSample(tarPyramid[l - 1]);
+			if (l > 1) {
+				Image4f next(srcLevels->dimensions(l - 1));
+				current.upSample(next);
+				current = next;
+			} else {
+				current.upSample(targetImg);
+			}
 		}
-		targetImg = tarPyramid[0];
 		PoissonBlend(sourceImg, targetImg, iterations, lambda, [=](int iter) {
 			if (iterationMonitor) {
 				return iterationMonitor(0, iter);
@@ -672,20 +674,16 @@ void PoissonBlend(const Image2f& sourceImg, Image2f& targetImg, int iterations,
 			}
 		});
 	} else {
-		std::vector<Image2f> srcPyramid(levels);
-		std::vector<Image2f> tarPyramid(levels);
-		srcPyramid[0] = sourceImg;
-		tarPyramid[0] = targetImg;
-		for (int l = 1; l < levels; l++) {
-			srcPyramid[l - 1].downSample(srcPyramid[l]);
-			tarPyramid[l - 1].downSample(tarPyramid[l]);
-		}
+		//Read-only inputs share their pyramids with other solves of the same image. Only the coarsest level of the solution is needed.
+		std::shared_ptr<Pyramid2f> srcLevels = Pyramid2f::Get(sourceImg, levels);
+		levels = srcLevels->size();
+		Image2f current = Pyramid2f(targetImg, levels).getGaussian(levels - 1);
 		for (int l = levels - 1; l >= 1; l--) {
 			if (iterationMonitor) {
 				if (!iterationMonitor(l, 0))
 					return;
 			}
-			PoissonBlend(srcPyramid[l], tarPyramid[l], iterations, lambda,
+			PoissonBlend(srcLevels->getGaussian(l), current, iterations, lambda,
 					[=](int iter) {
 						if (iterationMonitor) {
 							return iterationMonitor(l, iter);
@@ -694,9 +692,14 @@ void PoissonBlend(const Image2f& sourceImg, Image2f& targetImg, int iterations,
 							return true;
 						}
 					});
-			tarPyramid[l].upSample(tarPyramid[l - 1]);
+			if (l > 1) {
+				Image2f next(srcLevels->dimensions(l - 1));
+				current.upSample(next);
+				current = next;
+			} else {
+				current.upSample(targetImg);
+			}
 		}
-		targetImg = tarPyramid[0];
 		PoissonBlend(sourceImg, targetImg, iterations, lambda, [=](int iter) {
 			if (iterationMonitor) {
 				return iterationMonitor(0, iter);
@@ -824,4 +827,441 @@ void PoissonBlend(const Image2f& sourceImg, Image2f& targetImg, int iterations,
 		}
 	}
 }
+namespace detail {
+//Geometric multigrid for x_p - 0.25*(sum of 4 neighbors) = b_p on the pixels flagged in mask. Every other pixel holds a fixed (Dirichlet) value.
+template<int C> class PoissonMultigrid {
+protected:
+	typedef Image<float, C, ImageType::FLOAT> ImageT;
+	struct Level {
+		ImageT x, b, r;
+		Image1ub mask;
+		//Unknowns near fixed pixels, split by red-black color. The coarse grid cannot correct them well, so they get extra smoothing.
+		std::vector<size_t> band[2];
+	};
+	std::vector<Level> levels;
+	static const int PRE_SMOOTH = 2;
+	static const int POST_SMOOTH = 2;
+	static const int COARSE_SMOOTH = 64;
+	static const int BAND_SMOOTH = 4;
+	static const int BAND_WIDTH = 2;
+	//Float residuals plateau at roundoff. Cycles stop once STALL_CYCLES in a row fail to reduce the best residual by STALL_RATIO.
+	static constexpr double STALL_RATIO = 0.9;
+	static const int STALL_CYCLES = 2;
+	void smoothBand(Level& level, int iterations) {
+		const int w = level.x.width;
+		vec<float, C>* x = &level.x.data[0];
+		const vec<float, C>* b = &level.b.data[0];
+		for (int iter = 0; iter < iterations; iter++) {
+			for (int color = 0; color < 2; color++) {
+				const std::vector<size_t>& band = level.band[color];
+#pragma omp parallel for
+				for (int64_t n = 0; n < (int64_t) band.size(); n++) {
+					size_t k = band[n];
+					x[k] = b[k] + 0.25f * (x[k - 1] + x[k + 1] + x[k - w] + x[k + w]);
+				}
+			}
+		}
+	}
+	void buildBand(Level& level) {
+		const int w = level.x.width;
+		const int h = level.x.height;
+		for (int j = 1; j < h - 1; j++) {
+			for (int i = 1; i < w - 1; i++) {
+				if (!level.mask(i, j).x)
+					continue;
+				bool nearFixed = false;
+				for (int dj = -BAND_WIDTH; dj <= BAND_WIDTH && !nearFixed; dj++) {
+					for (int di = -BAND_WIDTH; di <= BAND_WIDTH && !nearFixed;
+							di++) {
+						if (!level.mask(i + di, j + dj).x) {
+							nearFixed = true;
+						}
+					}
+				}
+				if (nearFixed) {
+					level.band[(i + j) % 2].push_back(i + j * (size_t) w);
+				}
+			}
+		}
+	}
+	void smooth(Level& level, int iterations) {
+		const int w = level.x.width;
+		const int h = level.x.height;
+		for (int iter = 0; iter < iterations; iter++) {
+			for (int color = 0; color < 2; color++) {
+#pragma omp parallel for
+				for (int j = 1; j < h - 1; j++) {
+					vec<float, C>* x = &level.x.data[j * (size_t) w];
+					const vec<float, C>* b = &level.b.data[j * (size_t) w];
+					const ubyte1* mask = &level.mask.data[j * (size_t) w];
+					for (int i = 1 + (j + 1 + color) % 2; i < w - 1; i += 2) {
+						if (mask[i].x) {
+							x[i] = b[i]
+									+ 0.25f
+											* (x[i - 1] + x[i + 1] + x[i - w]
+													+ x[i + w]);
+						}
+					}
+				}
+			}
+		}
+	}
+	double residual(Level& level) {
+		const int w = level.x.width;
+		const int h = level.x.height;
+		double sum = 0.0;
+		level.r.set(vec<float, C>(0.0f));
+#pragma omp parallel for reduction(+:sum)
+		for (int j = 1; j < h - 1; j++) {
+			const vec<float, C>* x = &level.x.data[j * (size_t) w];
+			const vec<float, C>* b = &level.b.data[j * (size_t) w];
+			vec<float, C>* r = &level.r.data[j * (size_t) w];
+			const ubyte1* mask = &level.mask.data[j * (size_t) w];
+			for (int i = 1; i < w - 1; i++) {
+				if (mask[i].x) {
+					r[i] = b[i] - x[i]
+							+ 0.25f * (x[i - 1] + x[i + 1] + x[i - w] + x[i + w]);
+					sum += lengthSqr(r[i]);
+				}
+			}
+		}
+		return sum;
+	}
+	//Full weighting restriction. The factor of 4 accounts for the doubled grid spacing.
+	void restrict(const Level& fine, Level& coarse) {
+		const int w = fine.x.width;
+		const int h = fine.x.height;
+		const float weights[3] = { 0.25f, 0.5f, 0.25f };
+#pragma omp parallel for
+		for (int J = 0; J < coarse.x.height; J++) {
+			for (int I = 0; I < coarse.x.width; I++) {
+				vec<float, C> sum(0.0f);
+				if (coarse.mask(I, J).x) {
+					for (int dj = -1; dj <= 1; dj++) {
+						for (int di = -1; di <= 1; di++) {
+							int i = 2 * I + di;
+							int j = 2 * J + dj;
+							if (i >= 0 && j >= 0 && i < w && j < h) {
+								sum += weights[di + 1] * weights[dj + 1]
+										* fine.r(i, j);
+							}
+						}
+					}
+				}
+				coarse.b(I, J) = 4.0f * sum;
+			}
+		}
+		coarse.x.set(vec<float, C>(0.0f));
+	}
+	//Bilinear prolongation of the coarse correction onto unknown fine pixels.
+	void prolong(const Level& coarse, Level& fine) {
+		const int w = fine.x.width;
+		const int h = fine.x.height;
+		const int cw = coarse.x.width;
+#pragma omp parallel for
+		for (int j = 1; j < h - 1; j++) {
+			const int J = j / 2;
+			for (int i = 1; i < w - 1; i++) {
+				if (!fine.mask(i, j).x)
+					continue;
+				const int I = i / 2;
+				const vec<float, C>* e = &coarse.x.data[I + J * (size_t) cw];
+				vec<float, C> corr;
+				if (i % 2 == 0 && j % 2 == 0) {
+					corr = e[0];
+				} else if (j % 2 == 0) {
+					corr = 0.5f * (e[0] + e[1]);
+				} else if (i % 2 == 0) {
+					corr = 0.5f * (e[0] + e[cw]);
+				} else {
+					corr = 0.25f * (e[0] + e[1] + e[cw] + e[cw + 1]);
+				}
+				fine.x(i, j) += corr;
+			}
+		}
+	}
+	void cycle(int l, const MultigridCycle& type) {
+		Level& level = levels[l];
+		if (l == (int) levels.size() - 1) {
+			smooth(level, COARSE_SMOOTH);
+			return;
+		}
+		smooth(level, PRE_SMOOTH);
+		smoothBand(level, BAND_SMOOTH);
+		residual(level);
+		restrict(level, levels[l + 1]);
+		if (type == MultigridCycle::V) {
+			cycle(l + 1, MultigridCycle::V);
+		} else if (type == MultigridCycle::W) {
+			cycle(l + 1, MultigridCycle::W);
+			cycle(l + 1, MultigridCycle::W);
+		} else {
+			cycle(l + 1, MultigridCycle::F);
+			cycle(l + 1, MultigridCycle::V);
+		}
+		prolong(levels[l + 1], level);
+		smoothBand(level, BAND_SMOOTH);
+		smooth(level, POST_SMOOTH);
+	}
+	void buildLevels() {
+		while (true) {
+			const Level& fine = levels.back();
+			const int w = fine.x.width;
+			const int h = fine.x.height;
+			if (w < 5 || h < 5)
+				break;
+			Level coarse;
+			const int cw = w / 2 + 1;
+			const int ch = h / 2 + 1;
+			coarse.x.resize(cw, ch);
+			coarse.b.resize(cw, ch);
+			coarse.r.resize(cw, ch);
+			coarse.mask.resize(cw, ch);
+			coarse.mask.set(ubyte1((uint8_t) 0));
+			size_t count = 0;
+#pragma omp parallel for reduction(+:count)
+			for (int J = 1; J < ch - 1; J++) {
+				for (int I = 1; I < cw - 1; I++) {
+					bool active = true;
+					for (int dj = -1; dj <= 1 && active; dj++) {
+						for (int di = -1; di <= 1 && active; di++) {
+							int i = 2 * I + di;
+							int j = 2 * J + dj;
+							if (i >= w || j >= h || !fine.mask(i, j).x) {
+								active = false;
+							}
+						}
+					}
+					if (active) {
+						coarse.mask(I, J).x = 1;
+						count++;
+					}
+				}
+			}
+			if (count == 0)
+				break;
+			levels.push_back(coarse);
+		}
+	}
+public:
+	PoissonMultigrid(ImageT& x, const ImageT& b, const Image1ub& mask) {
+		levels.resize(1);
+		levels[0].x = x;
+		levels[0].b = b;
+		levels[0].r.resize(x.width, x.height);
+		levels[0].mask = mask;
+		buildLevels();
+		for (Level& level : levels) {
+			buildBand(level);
+		}
+	}
+	int solve(ImageT& out, const MultigridCycle& type, float tolerance,
+			int maxCycles,
+			const std::function<bool(int, float)>& iterationMonitor) {
+		double initial = std::sqrt(residual(levels[0]));
+		//The first cycles can raise the residual of the initial guess, so stalls are measured from the first cycle on.
+		double best = std::numeric_limits<double>::max();
+		int stalled = 0;
+		int c = 0;
+		if (initial > 0.0) {
+			while (c < maxCycles) {
+				cycle(0, type);
+				c++;
+				double current = std::sqrt(residual(levels[0]));
+				float relative = (float) (current / initial);
+				if (iterationMonitor && !iterationMonitor(c, relative))
+					break;
+				if (relative < tolerance)
+					break;
+				if (current < STALL_RATIO * best) {
+					stalled = 0;
+				} else if (++stalled >= STALL_CYCLES) {
+					break;
+				}
+				best = std::min(best, current);
+			}
+		}
+		out = levels[0].x;
+		return c;
+	}
+};
+//Right hand side and initial guess for LaplaceFill. Alpha is stored in the last channel.
+template<int C> void LaplaceFillSystem(
+		const Image<float, C, ImageType::FLOAT>& sourceImg,
+		Image<float, C, ImageType::FLOAT>& targetImg,
+		Image<float, C, ImageType::FLOAT>& divergence) {
+	divergence.resize(sourceImg.width, sourceImg.height);
+	divergence.set(vec<float, C>(0.0f));
+#pragma omp parallel for
+	for (int j = 1; j < sourceImg.height - 1; j++) {
+		for (int i = 1; i < sourceImg.width - 1; i++) {
+			vec<float, C> src = sourceImg(i, j);
+			vec<float, C> tar = targetImg(i, j);
+			float alpha = src[C - 1];
+			src[C - 1] = 1.0f;
+			vec<float, C> div(0.0f);
+			if (sourceImg(i, j)[C - 1] > 0 && sourceImg(i, j + 1)[C - 1] > 0
+					&& sourceImg(i, j - 1)[C - 1] > 0
+					&& sourceImg(i + 1, j)[C - 1] > 0
+					&& sourceImg(i - 1, j)[C - 1] > 0) {
+				div = sourceImg(i, j)
+						- 0.25f
+								* (sourceImg(i, j + 1) + sourceImg(i, j - 1)
+										+ sourceImg(i + 1, j)
+										+ sourceImg(i - 1, j));
+				div[C - 1] = 0.0f;
+			}
+			divergence(i, j) = alpha * div;
+			targetImg(i, j) = mix(tar, src, alpha);
+		}
+	}
+}
+template<int C> vec<float, C> MaskedDivergence(
+		const Image<float, C, ImageType::FLOAT>& img, int i, int j) {
+	vec<float, C> div(0.0f);
+	if (img(i, j)[C - 1] > 0 && img(i, j + 1)[C - 1] > 0
+			&& img(i, j - 1)[C - 1] > 0 && img(i + 1, j)[C - 1] > 0
+			&& img(i - 1, j)[C - 1] > 0) {
+		div = img(i, j)
+				- 0.25f
+						* (img(i, j + 1) + img(i, j - 1) + img(i + 1, j)
+								+ img(i - 1, j));
+		div[C - 1] = 0.0f;
+	}
+	return div;
+}
+inline Image1ub InteriorMask(int width, int height) {
+	Image1ub mask(width, height);
+	mask.set(ubyte1((uint8_t) 0));
+#pragma omp parallel for
+	for (int j = 1; j < height - 1; j++) {
+		for (int i = 1; i < width - 1; i++) {
+			mask(i, j).x = 1;
+		}
+	}
+	return mask;
+}
+template<int C> int LaplaceFillMultigrid(
+		const Image<float, C, ImageType::FLOAT>& sourceImg,
+		Image<float, C, ImageType::FLOAT>& targetImg,
+		const MultigridCycle& cycle, float tolerance, int maxCycles,
+		const std::function<bool(int, float)>& iterationMonitor) {
+	if (sourceImg.dimensions() != targetImg.dimensions())
+		throw std::runtime_error(
+				MakeString() << "Cannot solve. Image dimensions do not match "
+						<< sourceImg.dimensions() << " "
+						<< targetImg.dimensions());
+	Image<float, C, ImageType::FLOAT> divergence;
+	LaplaceFillSystem(sourceImg, targetImg, divergence);
+	PoissonMultigrid<C> solver(targetImg, divergence,
+			InteriorMask(sourceImg.width, sourceImg.height));
+	return solver.solve(targetImg, cycle, tolerance, maxCycles,
+			iterationMonitor);
+}
+template<int C> int PoissonInpaintMultigrid(
+		const Image<float, C, ImageType::FLOAT>& sourceImg,
+		const Image<float, C, ImageType::FLOAT>& targetImg,
+		Image<float, C, ImageType::FLOAT>& outImg, const MultigridCycle& cycle,
+		float tolerance, int maxCycles,
+		const std::function<bool(int, float)>& iterationMonitor) {
+	//Assumes mask is encoded in the last channel of the source image.
+	if (sourceImg.dimensions() != targetImg.dimensions()
+			|| sourceImg.dimensions() != outImg.dimensions())
+		throw std::runtime_error(
+				MakeString() << "Cannot solve. Image dimensions do not match "
+						<< sourceImg.dimensions() << " "
+						<< targetImg.dimensions());
+	Image<float, C, ImageType::FLOAT> divergence(sourceImg.width,
+			sourceImg.height);
+	divergence.set(vec<float, C>(0.0f));
+#pragma omp parallel for
+	for (int j = 1; j < sourceImg.height - 1; j++) {
+		for (int i = 1; i < sourceImg.width - 1; i++) {
+			float alpha = sourceImg(i, j)[C - 1];
+			divergence(i, j) = mix(MaskedDivergence(targetImg, i, j),
+					MaskedDivergence(sourceImg, i, j), alpha);
+		}
+	}
+	PoissonMultigrid<C> solver(outImg, divergence,
+			InteriorMask(sourceImg.width, sourceImg.height));
+	return solver.solve(outImg, cycle, tolerance, maxCycles, iterationMonitor);
+}
+template<int C> int PoissonBlendMultigrid(
+		const Image<float, C, ImageType::FLOAT>& sourceImg,
+		Image<float, C, ImageType::FLOAT>& targetImg,
+		const MultigridCycle& cycle, float tolerance, int maxCycles,
+		const std::function<bool(int, float)>& iterationMonitor) {
+	if (sourceImg.dimensions() != targetImg.dimensions())
+		throw std::runtime_error(
+				MakeString() << "Cannot solve. Image dimensions do not match "
+						<< sourceImg.dimensions() << " "
+						<< targetImg.dimensions());
+	const float THRESHOLD = 0.5f;
+	Image<float, C, ImageType::FLOAT> divergence(sourceImg.width,
+			sourceImg.height);
+	Image1ub mask(sourceImg.width, sourceImg.height);
+	divergence.set(vec<float, C>(0.0f));
+	mask.set(ubyte1((uint8_t) 0));
+#pragma omp parallel for
+	for (int j = 1; j < sourceImg.height - 1; j++) {
+		for (int i = 1; i < sourceImg.width - 1; i++) {
+			divergence(i, j) = MaskedDivergence(sourceImg, i, j);
+			if (targetImg(i, j)[C - 1] >= THRESHOLD
+					&& targetImg(i, j + 1)[C - 1] >= THRESHOLD
+					&& targetImg(i, j - 1)[C - 1] >= THRESHOLD
+					&& targetImg(i + 1, j)[C - 1] >= THRESHOLD
+					&& targetImg(i - 1, j)[C - 1] >= THRESHOLD) {
+				mask(i, j).x = 1;
+			}
+		}
+	}
+	Image<float, C, ImageType::FLOAT> result;
+	PoissonMultigrid<C> solver(targetImg, divergence, mask);
+	int cycles = solver.solve(result, cycle, tolerance, maxCycles,
+			iterationMonitor);
+	//Alpha is not blended, only the color channels.
+#pragma omp parallel for
+	for (int64_t n = 0; n < (int64_t) result.size(); n++) {
+		result[n][C - 1] = targetImg[n][C - 1];
+	}
+	targetImg = result;
+	return cycles;
+}
+}
+int LaplaceFill(const Image4f& sourceImg, Image4f& targetImg,
+		const MultigridCycle& cycle, float tolerance, int maxCycles,
+		const std::function<bool(int, float)>& iterationMonitor) {
+	return detail::LaplaceFillMultigrid(sourceImg, targetImg, cycle, tolerance,
+			maxCycles, iterationMonitor);
+}
+int LaplaceFill(const Image2f& sourceImg, Image2f& targetImg,
+		const MultigridCycle& cycle, float tolerance, int maxCycles,
+		const std::function<bool(int, float)>& iterationMonitor) {
+	return detail::LaplaceFillMultigrid(sourceImg, targetImg, cycle, tolerance,
+			maxCycles, iterationMonitor);
+}
+int PoissonInpaint(const Image4f& sourceImg, const Image4f& targetImg,
+		Image4f& outImg, const MultigridCycle& cycle, float tolerance,
+		int maxCycles, const std::function<bool(int, float)>& iterationMonitor) {
+	return detail::PoissonInpaintMultigrid(sourceImg, targetImg, outImg, cycle,
+			tolerance, maxCycles, iterationMonitor);
+}
+int PoissonInpaint(const Image2f& sourceImg, const Image2f& targetImg,
+		Image2f& outImg, const MultigridCycle& cycle, float tolerance,
+		int maxCycles, const std::function<bool(int, float)>& iterationMonitor) {
+	return detail::PoissonInpaintMultigrid(sourceImg, targetImg, outImg, cycle,
+			tolerance, maxCycles, iterationMonitor);
+}
+int PoissonBlend(const Image4f& sourceImg, Image4f& targetImg,
+		const MultigridCycle& cycle, float tolerance, int maxCycles,
+		const std::function<bool(int, float)>& iterationMonitor) {
+	return detail::PoissonBlendMultigrid(sourceImg, targetImg, cycle, tolerance,
+			maxCycles, iterationMonitor);
+}
+int PoissonBlend(const Image2f& sourceImg, Image2f& targetImg,
+		const MultigridCycle& cycle, float tolerance, int maxCycles,
+		const std::function<bool(int, float)>& iterationMonitor) {
+	return detail::PoissonBlendMultigrid(sourceImg, targetImg, cycle, tolerance,
+			maxCycles, iterationMonitor);
+}
 }
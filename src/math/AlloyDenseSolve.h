@@ -39,6 +39,14 @@ namespace aly {
 	void LaplaceFill(const Image4f& sourceImg, Image4f& targetImg, int iterations,float lambda = 0.99f , const std::function<bool(int)>& iterationMonitor=nullptr);
 	void LaplaceFill(const Image2f& sourceImg, Image2f& targetImg, int iterations,float lambda = 0.99f, const std::function<bool(int)>& iterationMonitor = nullptr);
 	void LaplaceFill(const Image2f& sourceImg, Image2f& targetImg, int iterations,int levels, float lambda = 0.99f, const std::function<bool(int, int)>& iterationMonitor = nullptr);
+	enum class MultigridCycle {V, W, F};
+	//Multigrid solvers with red-black Gauss-Seidel smoothing. Cycles repeat until the residual falls below tolerance relative to the initial residual, stops decreasing because it has reached float roundoff, or maxCycles is reached. The monitor receives the cycle count and relative residual, and can return false to stop. Returns the number of cycles.
+	int PoissonBlend(const Image4f& in, Image4f& out, const MultigridCycle& cycle, float tolerance = 1E-4f, int maxCycles = 32, const std::function<bool(int, float)>& iterationMonitor = nullptr);
+	int PoissonBlend(const Image2f& in, Image2f& out, const MultigridCycle& cycle, float tolerance = 1E-4f, int maxCycles = 32, const std::function<bool(int, float)>& iterationMonitor = nullptr);
+	int PoissonInpaint(const Image4f& source, const Image4f& target, Image4f& out, const MultigridCycle& cycle, float tolerance = 1E-4f, int maxCycles = 32, const std::function<bool(int, float)>& iterationMonitor = nullptr);
+	int PoissonInpaint(const Image2f& source, const Image2f& target, Image2f& out, const MultigridCycle& cycle, float tolerance = 1E-4f, int maxCycles = 32, const std::function<bool(int, float)>& iterationMonitor = nullptr);
+	int LaplaceFill(const Image4f& sourceImg, Image4f& targetImg, const MultigridCycle& cycle, float tolerance = 1E-4f, int maxCycles = 32, const std::function<bool(int, float)>& iterationMonitor = nullptr);
+	int LaplaceFill(const Image2f& sourceImg, Image2f& targetImg, const MultigridCycle& cycle, float tolerance = 1E-4f, int maxCycles = 32, const std::function<bool(int, float)>& iterationMonitor = nullptr);
 	void ColorPropagation(Image4f& image,int maxDistance,float threshold=0.5f);
 	void ColorPropagation(Image1f& image,int maxDistance,float threshold=0.0f);
 	/******************************************************************************
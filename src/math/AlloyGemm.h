@@ -0,0 +1,259 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef INCLUDE_ALLOYGEMM_H_
+#define INCLUDE_ALLOYGEMM_H_
+#include <stdexcept>
+#include "system/AlignedAllocator.h"
+#include <vector>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ALY_GEMM_SSE
+#endif
+namespace aly {
+namespace detail {
+/*
+ * Packed, register blocked matrix multiply in the style of GotoBLAS / BLIS.
+ * A KC deep slab of op(B) is packed into NR wide column slivers and the
+ * matching slab of op(A) into MR tall row slivers, so the micro-kernel streams
+ * both operands from contiguous memory while an MR x NR tile of C stays in
+ * registers. MC x KC blocks of A are sized for L2, KC x NR slivers of B for L1.
+ */
+template<class T> struct GemmBlocking {
+	static const int MR = 4;
+	static const int NR = 4;
+	static const int MC = 64;
+	static const int KC = 256;
+	static const int NC = 2048;
+};
+template<> struct GemmBlocking<float> {
+	static const int MR = 4;
+	static const int NR = 8;
+	static const int MC = 128;
+	static const int KC = 256;
+	static const int NC = 4096;
+};
+template<> struct GemmBlocking<double> {
+	static const int MR = 4;
+	static const int NR = 4;
+	static const int MC = 64;
+	static const int KC = 256;
+	static const int NC = 2048;
+};
+//Products with fewer multiply-adds than this skip packing and threading.
+static const double GEMM_SMALL_WORK = 48.0 * 48.0 * 48.0;
+//Number of output columns handled by one parallel task.
+static const int GEMM_TASK_COLUMNS = 256;
+
+template<class T, int MR, int NR> inline void GemmMicroKernel(int kc, const T* a, const T* b, T* acc) {
+	T c[MR * NR];
+	std::fill(c, c + MR * NR, T(0));
+	for (int p = 0; p < kc; p++, a += MR, b += NR) {
+		for (int r = 0; r < MR; r++) {
+			const T ar = a[r];
+			for (int n = 0; n < NR; n++) {
+				c[r * NR + n] += ar * b[n];
+			}
+		}
+	}
+	std::copy(c, c + MR * NR, acc);
+}
+#ifdef ALY_GEMM_SSE
+template<> inline void GemmMicroKernel<float, 4, 8>(int kc, const float* a, const float* b, float* acc) {
+	__m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+	__m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+	__m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+	__m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+	for (int p = 0; p < kc; p++, a += 4, b += 8) {
+		__m128 b0 = _mm_load_ps(b);
+		__m128 b1 = _mm_load_ps(b + 4);
+		__m128 a0 = _mm_set1_ps(a[0]);
+		c00 = _mm_add_ps(c00, _mm_mul_ps(a0, b0));
+		c01 = _mm_add_ps(c01, _mm_mul_ps(a0, b1));
+		__m128 a1 = _mm_set1_ps(a[1]);
+		c10 = _mm_add_ps(c10, _mm_mul_ps(a1, b0));
+		c11 = _mm_add_ps(c11, _mm_mul_ps(a1, b1));
+		__m128 a2 = _mm_set1_ps(a[2]);
+		c20 = _mm_add_ps(c20, _mm_mul_ps(a2, b0));
+		c21 = _mm_add_ps(c21, _mm_mul_ps(a2, b1));
+		__m128 a3 = _mm_set1_ps(a[3]);
+		c30 = _mm_add_ps(c30, _mm_mul_ps(a3, b0));
+		c31 = _mm_add_ps(c31, _mm_mul_ps(a3, b1));
+	}
+	_mm_storeu_ps(acc, c00);
+	_mm_storeu_ps(acc + 4, c01);
+	_mm_storeu_ps(acc + 8, c10);
+	_mm_storeu_ps(acc + 12, c11);
+	_mm_storeu_ps(acc + 16, c20);
+	_mm_storeu_ps(acc + 20, c21);
+	_mm_storeu_ps(acc + 24, c30);
+	_mm_storeu_ps(acc + 28, c31);
+}
+template<> inline void GemmMicroKernel<double, 4, 4>(int kc, const double* a, const double* b, double* acc) {
+	__m128d c00 = _mm_setzero_pd(), c01 = _mm_setzero_pd();
+	__m128d c10 = _mm_setzero_pd(), c11 = _mm_setzero_pd();
+	__m128d c20 = _mm_setzero_pd(), c21 = _mm_setzero_pd();
+	__m128d c30 = _mm_setzero_pd(), c31 = _mm_setzero_pd();
+	for (int p = 0; p < kc; p++, a += 4, b += 4) {
+		__m128d b0 = _mm_load_pd(b);
+		__m128d b1 = _mm_load_pd(b + 2);
+		__m128d a0 = _mm_set1_pd(a[0]);
+		c00 = _mm_add_pd(c00, _mm_mul_pd(a0, b0));
+		c01 = _mm_add_pd(c01, _mm_mul_pd(a0, b1));
+		__m128d a1 = _mm_set1_pd(a[1]);
+		c10 = _mm_add_pd(c10, _mm_mul_pd(a1, b0));
+		c11 = _mm_add_pd(c11, _mm_mul_pd(a1, b1));
+		__m128d a2 = _mm_set1_pd(a[2]);
+		c20 = _mm_add_pd(c20, _mm_mul_pd(a2, b0));
+		c21 = _mm_add_pd(c21, _mm_mul_pd(a2, b1));
+		__m128d a3 = _mm_set1_pd(a[3]);
+		c30 = _mm_add_pd(c30, _mm_mul_pd(a3, b0));
+		c31 = _mm_add_pd(c31, _mm_mul_pd(a3, b1));
+	}
+	_mm_storeu_pd(acc, c00);
+	_mm_storeu_pd(acc + 2, c01);
+	_mm_storeu_pd(acc + 4, c10);
+	_mm_storeu_pd(acc + 6, c11);
+	_mm_storeu_pd(acc + 8, c20);
+	_mm_storeu_pd(acc + 10, c21);
+	_mm_storeu_pd(acc + 12, c30);
+	_mm_storeu_pd(acc + 14, c31);
+}
+#endif
+//Packs rows [i0,i0+mc) and depth [p0,p0+kc) of op(A) into MR tall slivers, zero padding the last one.
+template<class T> void GemmPackA(bool transA, const T* A, int lda, int i0, int mc, int p0, int kc, T* out) {
+	const int MR = GemmBlocking<T>::MR;
+	for (int ir = 0; ir < mc; ir += MR) {
+		int mr = std::min(MR, mc - ir);
+		for (int p = 0; p < kc; p++) {
+			for (int r = 0; r < MR; r++) {
+				int i = i0 + ir + r;
+				*out++ = (r < mr) ? (transA ? A[(size_t) (p0 + p) * lda + i] : A[(size_t) i * lda + p0 + p]) : T(0);
+			}
+		}
+	}
+}
+//Packs depth [p0,p0+kc) and columns [j0,j0+nc) of op(B) into NR wide slivers, zero padding the last one.
+template<class T> void GemmPackB(bool transB, const T* B, int ldb, int p0, int kc, int j0, int nc, T* out) {
+	const int NR = GemmBlocking<T>::NR;
+	int slivers = (nc + NR - 1) / NR;
+#pragma omp parallel for
+	for (int s = 0; s < slivers; s++) {
+		int jr = s * NR;
+		int nr = std::min(NR, nc - jr);
+		T* dst = out + (size_t) s * NR * kc;
+		for (int p = 0; p < kc; p++) {
+			for (int n = 0; n < NR; n++) {
+				int j = j0 + jr + n;
+				*dst++ = (n < nr) ? (transB ? B[(size_t) j * ldb + p0 + p] : B[(size_t) (p0 + p) * ldb + j]) : T(0);
+			}
+		}
+	}
+}
+/*
+ * Row major C = alpha * op(A) * op(B) + beta * C, where op(A) is M x K and
+ * op(B) is K x N. lda, ldb and ldc are row strides, so sub-blocks of a
+ * larger matrix can be passed directly.
+ */
+template<class T> void Gemm(bool transA, bool transB, int M, int N, int K, T alpha, const T* A, int lda, const T* B, int ldb,
+		T beta, T* C, int ldc) {
+	if (M <= 0 || N <= 0)
+		return;
+	if (beta != T(1)) {
+#pragma omp parallel for if((double)M*N>65536.0)
+		for (int i = 0; i < M; i++) {
+			T* row = C + (size_t) i * ldc;
+			for (int j = 0; j < N; j++) {
+				row[j] = (beta == T(0)) ? T(0) : beta * row[j];
+			}
+		}
+	}
+	if (K <= 0 || alpha == T(0))
+		return;
+	if ((double) M * (double) N * (double) K <= GEMM_SMALL_WORK) {
+		for (int i = 0; i < M; i++) {
+			T* row = C + (size_t) i * ldc;
+			for (int p = 0; p < K; p++) {
+				T a = alpha * (transA ? A[(size_t) p * lda + i] : A[(size_t) i * lda + p]);
+				if (transB) {
+					for (int j = 0; j < N; j++) {
+						row[j] += a * B[(size_t) j * ldb + p];
+					}
+				} else {
+					const T* brow = B + (size_t) p * ldb;
+					for (int j = 0; j < N; j++) {
+						row[j] += a * brow[j];
+					}
+				}
+			}
+		}
+		return;
+	}
+	const int MR = GemmBlocking<T>::MR;
+	const int NR = GemmBlocking<T>::NR;
+	const int MC = GemmBlocking<T>::MC;
+	const int KC = GemmBlocking<T>::KC;
+	const int NC = GemmBlocking<T>::NC;
+	const int Mpad = ((M + MR - 1) / MR) * MR;
+	std::vector<T, aligned_allocator<T, 64>> packedA((size_t) Mpad * std::min(K, KC));
+	std::vector<T, aligned_allocator<T, 64>> packedB((size_t) (std::min(N, NC) + NR) * std::min(K, KC));
+	for (int jc = 0; jc < N; jc += NC) {
+		int nc = std::min(NC, N - jc);
+		for (int pc = 0; pc < K; pc += KC) {
+			int kc = std::min(KC, K - pc);
+			GemmPackB(transB, B, ldb, pc, kc, jc, nc, packedB.data());
+			int blocksA = (M + MC - 1) / MC;
+#pragma omp parallel for
+			for (int ib = 0; ib < blocksA; ib++) {
+				int ic = ib * MC;
+				GemmPackA(transA, A, lda, ic, std::min(MC, M - ic), pc, kc, packedA.data() + (size_t) ic * kc);
+			}
+			int tasksN = (nc + GEMM_TASK_COLUMNS - 1) / GEMM_TASK_COLUMNS;
+			int tasks = blocksA * tasksN;
+#pragma omp parallel for schedule(dynamic)
+			for (int t = 0; t < tasks; t++) {
+				int ic = (t / tasksN) * MC;
+				int mc = std::min(MC, M - ic);
+				int j0 = (t % tasksN) * GEMM_TASK_COLUMNS;
+				int j1 = std::min(j0 + GEMM_TASK_COLUMNS, nc);
+				T acc[GemmBlocking<T>::MR * GemmBlocking<T>::NR];
+				for (int jr = j0; jr < j1; jr += NR) {
+					int nr = std::min(NR, nc - jr);
+					const T* b = packedB.data() + (size_t) (jr / NR) * NR * kc;
+					for (int ir = 0; ir < mc; ir += MR) {
+						int mr = std::min(MR, mc - ir);
+						const T* a = packedA.data() + (size_t) (ic + ir) * kc;
+						GemmMicroKernel<T, GemmBlocking<T>::MR, GemmBlocking<T>::NR>(kc, a, b, acc);
+						for (int r = 0; r < mr; r++) {
+							T* row = C + (size_t) (ic + ir + r) * ldc + jc + jr;
+							for (int n = 0; n < nr; n++) {
+								row[n] += alpha * acc[r * NR + n];
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+}
+}
+#endif
@@ -0,0 +1,533 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "math/AlloyMatrixBatch.h"
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ALY_BATCH_SSE
+#endif
+namespace aly {
+/*
+ * Lane types. The kernels below are written once against these overloads and
+ * run either on one matrix (float) or on four matrices at a time (Float4).
+ */
+inline float BatchSqrt(float a) {
+	return std::sqrt(a);
+}
+inline float BatchAbs(float a) {
+	return std::abs(a);
+}
+inline float BatchMax(float a, float b) {
+	return std::max(a, b);
+}
+inline bool BatchLess(float a, float b) {
+	return a < b;
+}
+inline float BatchSelect(bool c, float a, float b) {
+	return c ? a : b;
+}
+#ifdef ALY_BATCH_SSE
+struct BatchFloat4 {
+	__m128 v;
+	BatchFloat4() {
+	}
+	BatchFloat4(__m128 v) :
+			v(v) {
+	}
+	BatchFloat4(float f) :
+			v(_mm_set1_ps(f)) {
+	}
+};
+struct BatchMask4 {
+	__m128 m;
+	BatchMask4(__m128 m) :
+			m(m) {
+	}
+};
+inline BatchFloat4 operator+(const BatchFloat4& a, const BatchFloat4& b) {
+	return _mm_add_ps(a.v, b.v);
+}
+inline BatchFloat4 operator-(const BatchFloat4& a, const BatchFloat4& b) {
+	return _mm_sub_ps(a.v, b.v);
+}
+inline BatchFloat4 operator*(const BatchFloat4& a, const BatchFloat4& b) {
+	return _mm_mul_ps(a.v, b.v);
+}
+inline BatchFloat4 operator/(const BatchFloat4& a, const BatchFloat4& b) {
+	return _mm_div_ps(a.v, b.v);
+}
+inline BatchFloat4 operator-(const BatchFloat4& a) {
+	return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f));
+}
+inline BatchFloat4 BatchSqrt(const BatchFloat4& a) {
+	return _mm_sqrt_ps(a.v);
+}
+inline BatchFloat4 BatchAbs(const BatchFloat4& a) {
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v);
+}
+inline BatchFloat4 BatchMax(const BatchFloat4& a, const BatchFloat4& b) {
+	return _mm_max_ps(a.v, b.v);
+}
+inline BatchMask4 BatchLess(const BatchFloat4& a, const BatchFloat4& b) {
+	return BatchMask4(_mm_cmplt_ps(a.v, b.v));
+}
+inline BatchFloat4 BatchSelect(const BatchMask4& c, const BatchFloat4& a, const BatchFloat4& b) {
+	return _mm_or_ps(_mm_and_ps(c.m, a.v), _mm_andnot_ps(c.m, b.v));
+}
+#endif
+/*
+ * Port of svd3 (McAdams et al. 2011) to the lane types. The sequence of
+ * operations matches svd3.cpp so the scalar and SIMD paths give the same
+ * results as SVD(float3x3).
+ */
+template<class V> struct BatchMat3 {
+	V m[3][3];
+};
+template<class V> void BatchCondSwap(const decltype(BatchLess(V(0.0f), V(0.0f)))& c, V& x, V& y) {
+	V z = x;
+	x = BatchSelect(c, y, x);
+	y = BatchSelect(c, z, y);
+}
+template<class V> void BatchCondNegSwap(const decltype(BatchLess(V(0.0f), V(0.0f)))& c, V& x, V& y) {
+	V z = -x;
+	x = BatchSelect(c, y, x);
+	y = BatchSelect(c, z, y);
+}
+template<class V> void BatchApproximateGivensQuaternion(const V& a11, const V& a12, const V& a22, V& ch, V& sh) {
+	const float gamma = 5.828427124f;
+	const float cstar = 0.923879532f;
+	const float sstar = 0.3826834323f;
+	ch = V(2.0f) * (a11 - a22);
+	sh = a12;
+	auto b = BatchLess(V(gamma) * sh * sh, ch * ch);
+	V w = V(1.0f) / BatchSqrt(ch * ch + sh * sh);
+	ch = BatchSelect(b, w * ch, V(cstar));
+	sh = BatchSelect(b, w * sh, V(sstar));
+}
+template<class V> void BatchJacobiConjugation(const int x, const int y, const int z, V& s11, V& s21, V& s22, V& s31,
+		V& s32, V& s33, V* qV) {
+	V ch, sh;
+	BatchApproximateGivensQuaternion(s11, s21, s22, ch, sh);
+	V scale = ch * ch + sh * sh;
+	V a = (ch * ch - sh * sh) / scale;
+	V b = (V(2.0f) * sh * ch) / scale;
+	V _s11 = s11;
+	V _s21 = s21;
+	V _s22 = s22;
+	V _s31 = s31;
+	V _s32 = s32;
+	V _s33 = s33;
+	s11 = a * (a * _s11 + b * _s21) + b * (a * _s21 + b * _s22);
+	s21 = a * (-b * _s11 + a * _s21) + b * (-b * _s21 + a * _s22);
+	s22 = -b * (-b * _s11 + a * _s21) + a * (-b * _s21 + a * _s22);
+	s31 = a * _s31 + b * _s32;
+	s32 = -b * _s31 + a * _s32;
+	s33 = _s33;
+	V tmp[3];
+	tmp[0] = qV[0] * sh;
+	tmp[1] = qV[1] * sh;
+	tmp[2] = qV[2] * sh;
+	sh = sh * qV[3];
+	qV[0] = qV[0] * ch;
+	qV[1] = qV[1] * ch;
+	qV[2] = qV[2] * ch;
+	qV[3] = qV[3] * ch;
+	qV[z] = qV[z] + sh;
+	qV[3] = qV[3] - tmp[z];
+	qV[x] = qV[x] + tmp[y];
+	qV[y] = qV[y] - tmp[x];
+	_s11 = s22;
+	_s21 = s32;
+	_s22 = s33;
+	_s31 = s21;
+	_s32 = s31;
+	_s33 = s11;
+	s11 = _s11;
+	s21 = _s21;
+	s22 = _s22;
+	s31 = _s31;
+	s32 = _s32;
+	s33 = _s33;
+}
+template<class V> void BatchQRGivensQuaternion(const V& a1, const V& a2, V& ch, V& sh) {
+	const float epsilon = 1e-6f;
+	V rho = BatchSqrt(a1 * a1 + a2 * a2);
+	sh = BatchSelect(BatchLess(V(epsilon), rho), a2, V(0.0f));
+	ch = BatchAbs(a1) + BatchMax(rho, V(epsilon));
+	BatchCondSwap<V>(BatchLess(a1, V(0.0f)), sh, ch);
+	V w = V(1.0f) / BatchSqrt(ch * ch + sh * sh);
+	ch = ch * w;
+	sh = sh * w;
+}
+template<class V> void BatchSVD3(const BatchMat3<V>& A, BatchMat3<V>& U, V* S, BatchMat3<V>& Vm) {
+	const V (&a)[3][3] = A.m;
+	//Normal equations matrix, only the lower triangle is needed.
+	V s11 = a[0][0] * a[0][0] + a[1][0] * a[1][0] + a[2][0] * a[2][0];
+	V s21 = a[0][1] * a[0][0] + a[1][1] * a[1][0] + a[2][1] * a[2][0];
+	V s22 = a[0][1] * a[0][1] + a[1][1] * a[1][1] + a[2][1] * a[2][1];
+	V s31 = a[0][2] * a[0][0] + a[1][2] * a[1][0] + a[2][2] * a[2][0];
+	V s32 = a[0][2] * a[0][1] + a[1][2] * a[1][1] + a[2][2] * a[2][1];
+	V s33 = a[0][2] * a[0][2] + a[1][2] * a[1][2] + a[2][2] * a[2][2];
+	V qV[4] = { V(0.0f), V(0.0f), V(0.0f), V(1.0f) };
+	for (int i = 0; i < 4; i++) {
+		BatchJacobiConjugation(0, 1, 2, s11, s21, s22, s31, s32, s33, qV);
+		BatchJacobiConjugation(1, 2, 0, s11, s21, s22, s31, s32, s33, qV);
+		BatchJacobiConjugation(2, 0, 1, s11, s21, s22, s31, s32, s33, qV);
+	}
+	{
+		V w = qV[3], x = qV[0], y = qV[1], z = qV[2];
+		V qxx = x * x, qyy = y * y, qzz = z * z;
+		V qxz = x * z, qxy = x * y, qyz = y * z;
+		V qwx = w * x, qwy = w * y, qwz = w * z;
+		Vm.m[0][0] = V(1.0f) - V(2.0f) * (qyy + qzz);
+		Vm.m[0][1] = V(2.0f) * (qxy - qwz);
+		Vm.m[0][2] = V(2.0f) * (qxz + qwy);
+		Vm.m[1][0] = V(2.0f) * (qxy + qwz);
+		Vm.m[1][1] = V(1.0f) - V(2.0f) * (qxx + qzz);
+		Vm.m[1][2] = V(2.0f) * (qyz - qwx);
+		Vm.m[2][0] = V(2.0f) * (qxz - qwy);
+		Vm.m[2][1] = V(2.0f) * (qyz + qwx);
+		Vm.m[2][2] = V(1.0f) - V(2.0f) * (qxx + qyy);
+	}
+	V b[3][3];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			b[i][j] = a[i][0] * Vm.m[0][j] + a[i][1] * Vm.m[1][j] + a[i][2] * Vm.m[2][j];
+		}
+	}
+	//Sort singular values by column length.
+	V rho1 = b[0][0] * b[0][0] + b[1][0] * b[1][0] + b[2][0] * b[2][0];
+	V rho2 = b[0][1] * b[0][1] + b[1][1] * b[1][1] + b[2][1] * b[2][1];
+	V rho3 = b[0][2] * b[0][2] + b[1][2] * b[1][2] + b[2][2] * b[2][2];
+	{
+		auto c = BatchLess(rho1, rho2);
+		for (int i = 0; i < 3; i++) {
+			BatchCondNegSwap<V>(c, b[i][0], b[i][1]);
+			BatchCondNegSwap<V>(c, Vm.m[i][0], Vm.m[i][1]);
+		}
+		BatchCondSwap<V>(c, rho1, rho2);
+	}
+	{
+		auto c = BatchLess(rho1, rho3);
+		for (int i = 0; i < 3; i++) {
+			BatchCondNegSwap<V>(c, b[i][0], b[i][2]);
+			BatchCondNegSwap<V>(c, Vm.m[i][0], Vm.m[i][2]);
+		}
+		BatchCondSwap<V>(c, rho1, rho3);
+	}
+	{
+		auto c = BatchLess(rho2, rho3);
+		for (int i = 0; i < 3; i++) {
+			BatchCondNegSwap<V>(c, b[i][1], b[i][2]);
+			BatchCondNegSwap<V>(c, Vm.m[i][1], Vm.m[i][2]);
+		}
+	}
+	//QR decomposition of b with three Givens rotations.
+	V ch1, sh1, ch2, sh2, ch3, sh3;
+	V r[3][3];
+	BatchQRGivensQuaternion(b[0][0], b[1][0], ch1, sh1);
+	V ga = V(1.0f) - V(2.0f) * sh1 * sh1;
+	V gb = V(2.0f) * ch1 * sh1;
+	for (int j = 0; j < 3; j++) {
+		r[0][j] = ga * b[0][j] + gb * b[1][j];
+		r[1][j] = -gb * b[0][j] + ga * b[1][j];
+		r[2][j] = b[2][j];
+	}
+	BatchQRGivensQuaternion(r[0][0], r[2][0], ch2, sh2);
+	ga = V(1.0f) - V(2.0f) * sh2 * sh2;
+	gb = V(2.0f) * ch2 * sh2;
+	for (int j = 0; j < 3; j++) {
+		b[0][j] = ga * r[0][j] + gb * r[2][j];
+		b[1][j] = r[1][j];
+		b[2][j] = -gb * r[0][j] + ga * r[2][j];
+	}
+	BatchQRGivensQuaternion(b[1][1], b[2][1], ch3, sh3);
+	ga = V(1.0f) - V(2.0f) * sh3 * sh3;
+	gb = V(2.0f) * ch3 * sh3;
+	S[0] = b[0][0];
+	S[1] = ga * b[1][1] + gb * b[2][1];
+	S[2] = -gb * b[1][2] + ga * b[2][2];
+	V sh12 = sh1 * sh1;
+	V sh22 = sh2 * sh2;
+	V sh32 = sh3 * sh3;
+	V one(1.0f), two(2.0f), four(4.0f), eight(8.0f);
+	U.m[0][0] = (-one + two * sh12) * (-one + two * sh22);
+	U.m[0][1] = four * ch2 * ch3 * (-one + two * sh12) * sh2 * sh3 + two * ch1 * sh1 * (-one + two * sh32);
+	U.m[0][2] = four * ch1 * ch3 * sh1 * sh3 - two * ch2 * (-one + two * sh12) * sh2 * (-one + two * sh32);
+	U.m[1][0] = two * ch1 * sh1 * (one - two * sh22);
+	U.m[1][1] = -eight * ch1 * ch2 * ch3 * sh1 * sh2 * sh3 + (-one + two * sh12) * (-one + two * sh32);
+	U.m[1][2] = -two * ch3 * sh3 + four * sh1 * (ch3 * sh1 * sh3 + ch1 * ch2 * sh2 * (-one + two * sh32));
+	U.m[2][0] = two * ch2 * sh2;
+	U.m[2][1] = two * ch3 * (one - two * sh22) * sh3;
+	U.m[2][2] = (-one + two * sh22) * (-one + two * sh32);
+}
+//R = U * Vt, flipping the last singular direction if R is a reflection, as FactorRotation() does.
+template<class V> void BatchRotation(const BatchMat3<V>& U, const BatchMat3<V>& Vm, BatchMat3<V>& R) {
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			R.m[i][j] = U.m[i][0] * Vm.m[j][0] + U.m[i][1] * Vm.m[j][1] + U.m[i][2] * Vm.m[j][2];
+		}
+	}
+	V det = R.m[0][0] * (R.m[1][1] * R.m[2][2] - R.m[1][2] * R.m[2][1])
+			- R.m[0][1] * (R.m[1][0] * R.m[2][2] - R.m[1][2] * R.m[2][0])
+			+ R.m[0][2] * (R.m[1][0] * R.m[2][1] - R.m[1][1] * R.m[2][0]);
+	auto flip = BatchLess(det, V(0.0f));
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			R.m[i][j] = BatchSelect(flip, R.m[i][j] - V(2.0f) * U.m[i][2] * Vm.m[j][2], R.m[i][j]);
+		}
+	}
+}
+template<class V> void BatchInverse3(const BatchMat3<V>& M, BatchMat3<V>& R, V& det) {
+	const V (&m)[3][3] = M.m;
+	V c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+	V c10 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+	V c20 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+	det = m[0][0] * c00 + m[0][1] * c10 + m[0][2] * c20;
+	auto singular = BatchLess(BatchAbs(det), V(std::numeric_limits<float>::min()));
+	V invDet = V(1.0f) / BatchSelect(singular, V(1.0f), det);
+	V zero(0.0f);
+	R.m[0][0] = BatchSelect(singular, zero, c00 * invDet);
+	R.m[0][1] = BatchSelect(singular, zero, (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet);
+	R.m[0][2] = BatchSelect(singular, zero, (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet);
+	R.m[1][0] = BatchSelect(singular, zero, c10 * invDet);
+	R.m[1][1] = BatchSelect(singular, zero, (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet);
+	R.m[1][2] = BatchSelect(singular, zero, (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet);
+	R.m[2][0] = BatchSelect(singular, zero, c20 * invDet);
+	R.m[2][1] = BatchSelect(singular, zero, (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet);
+	R.m[2][2] = BatchSelect(singular, zero, (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet);
+}
+/*
+ * Matrices per parallel task. Tasks write disjoint ranges of the output so
+ * results do not depend on the number of threads.
+ */
+static const int MATRIX_BATCH_BLOCK = 256;
+/*
+ * Runs op over [0, count) in lane groups. op(i, n) processes matrices
+ * i...i+n-1 with n equal to 4 on the SIMD path and 1 for the tail.
+ */
+template<class ScalarOp, class VectorOp> void BatchRun(size_t count, const ScalarOp& scalarOp, const VectorOp& vectorOp) {
+	const int blocks = (int) ((count + MATRIX_BATCH_BLOCK - 1) / MATRIX_BATCH_BLOCK);
+#pragma omp parallel for if(blocks>1)
+	for (int b = 0; b < blocks; b++) {
+		size_t begin = (size_t) b * MATRIX_BATCH_BLOCK;
+		size_t end = std::min(count, begin + MATRIX_BATCH_BLOCK);
+		size_t i = begin;
+#ifdef ALY_BATCH_SSE
+		for (; i + 4 <= end; i += 4) {
+			vectorOp(i);
+		}
+#endif
+		for (; i < end; i++) {
+			scalarOp(i);
+		}
+	}
+}
+inline void BatchLoad(const float3x3& A, BatchMat3<float>& M) {
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			M.m[i][j] = A(i, j);
+		}
+	}
+}
+inline void BatchStore(const BatchMat3<float>& M, float3x3& A) {
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			A(i, j) = M.m[i][j];
+		}
+	}
+}
+#ifdef ALY_BATCH_SSE
+inline void BatchLoad(const float3x3* A, BatchMat3<BatchFloat4>& M) {
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			M.m[i][j] = _mm_setr_ps(A[0](i, j), A[1](i, j), A[2](i, j), A[3](i, j));
+		}
+	}
+}
+inline void BatchStore(const BatchFloat4& v, float* out) {
+	_mm_storeu_ps(out, v.v);
+}
+inline void BatchStore(const BatchMat3<BatchFloat4>& M, float3x3* A) {
+	float tmp[4];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			_mm_storeu_ps(tmp, M.m[i][j].v);
+			for (int l = 0; l < 4; l++) {
+				A[l](i, j) = tmp[l];
+			}
+		}
+	}
+}
+inline void BatchStoreTranspose(const BatchMat3<BatchFloat4>& M, float3x3* A) {
+	float tmp[4];
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			_mm_storeu_ps(tmp, M.m[i][j].v);
+			for (int l = 0; l < 4; l++) {
+				A[l](j, i) = tmp[l];
+			}
+		}
+	}
+}
+#endif
+inline void BatchStoreTranspose(const BatchMat3<float>& M, float3x3& A) {
+	for (int i = 0; i < 3; i++) {
+		for (int j = 0; j < 3; j++) {
+			A(j, i) = M.m[i][j];
+		}
+	}
+}
+void BatchSVD(const float3x3* A, float3x3* U, float3* D, float3x3* Vt, size_t count) {
+	BatchRun(count, [=](size_t i) {
+		BatchMat3<float> a,u,v;
+		float s[3];
+		BatchLoad(A[i],a);
+		BatchSVD3(a,u,s,v);
+		BatchStore(u,U[i]);
+		BatchStoreTranspose(v,Vt[i]);
+		D[i]=float3(s[0],s[1],s[2]);
+	}, [=](size_t i) {
+#ifdef ALY_BATCH_SSE
+		BatchMat3<BatchFloat4> a,u,v;
+		BatchFloat4 s[3];
+		BatchLoad(A+i,a);
+		BatchSVD3(a,u,s,v);
+		BatchStore(u,U+i);
+		BatchStoreTranspose(v,Vt+i);
+		float tmp[3][4];
+		for(int k=0;k<3;k++) {
+			BatchStore(s[k],tmp[k]);
+		}
+		for(int l=0;l<4;l++) {
+			D[i+l]=float3(tmp[0][l],tmp[1][l],tmp[2][l]);
+		}
+#endif
+	});
+}
+void BatchSVD(const std::vector<float3x3>& A, std::vector<float3x3>& U, std::vector<float3>& D, std::vector<float3x3>& Vt) {
+	U.resize(A.size());
+	D.resize(A.size());
+	Vt.resize(A.size());
+	BatchSVD(A.data(), U.data(), D.data(), Vt.data(), A.size());
+}
+void BatchFactorRotation(const float3x3* A, float3x3* R, size_t count) {
+	BatchRun(count, [=](size_t i) {
+		BatchMat3<float> a,u,v,r;
+		float s[3];
+		BatchLoad(A[i],a);
+		BatchSVD3(a,u,s,v);
+		BatchRotation(u,v,r);
+		BatchStore(r,R[i]);
+	}, [=](size_t i) {
+#ifdef ALY_BATCH_SSE
+		BatchMat3<BatchFloat4> a,u,v,r;
+		BatchFloat4 s[3];
+		BatchLoad(A+i,a);
+		BatchSVD3(a,u,s,v);
+		BatchRotation(u,v,r);
+		BatchStore(r,R+i);
+#endif
+	});
+}
+void BatchFactorRotation(const std::vector<float3x3>& A, std::vector<float3x3>& R) {
+	R.resize(A.size());
+	BatchFactorRotation(A.data(), R.data(), A.size());
+}
+template<class V> void BatchPolar(const BatchMat3<V>& a, BatchMat3<V>& r, BatchMat3<V>& s) {
+	BatchMat3<V> u, v;
+	V d[3];
+	BatchSVD3(a, u, d, v);
+	BatchRotation(u, v, r);
+	for (int i = 0; i < 3; i++) {
+		for (int j = i; j < 3; j++) {
+			V sum = r.m[0][i] * a.m[0][j] + r.m[1][i] * a.m[1][j] + r.m[2][i] * a.m[2][j];
+			if (i != j) {
+				//Average with the mirrored entry so S is exactly symmetric.
+				sum = V(0.5f)
+						* (sum + r.m[0][j] * a.m[0][i] + r.m[1][j] * a.m[1][i] + r.m[2][j] * a.m[2][i]);
+			}
+			s.m[i][j] = sum;
+			s.m[j][i] = sum;
+		}
+	}
+}
+void BatchPolarDecomposition(const float3x3* A, float3x3* R, float3x3* S, size_t count) {
+	BatchRun(count, [=](size_t i) {
+		BatchMat3<float> a,r,s;
+		BatchLoad(A[i],a);
+		BatchPolar(a,r,s);
+		BatchStore(r,R[i]);
+		BatchStore(s,S[i]);
+	}, [=](size_t i) {
+#ifdef ALY_BATCH_SSE
+		BatchMat3<BatchFloat4> a,r,s;
+		BatchLoad(A+i,a);
+		BatchPolar(a,r,s);
+		BatchStore(r,R+i);
+		BatchStore(s,S+i);
+#endif
+	});
+}
+void BatchPolarDecomposition(const std::vector<float3x3>& A, std::vector<float3x3>& R, std::vector<float3x3>& S) {
+	R.resize(A.size());
+	S.resize(A.size());
+	BatchPolarDecomposition(A.data(), R.data(), S.data(), A.size());
+}
+bool BatchInverse(const float3x3* A, float3x3* Ainv, size_t count) {
+	//Each lane group writes its own flag so no synchronization is needed.
+	std::vector<char> singular((count + 3) / 4, 0);
+	char* flags = singular.data();
+	BatchRun(count, [=](size_t i) {
+		BatchMat3<float> a,r;
+		float det;
+		BatchLoad(A[i],a);
+		BatchInverse3(a,r,det);
+		BatchStore(r,Ainv[i]);
+		if(std::abs(det)<std::numeric_limits<float>::min()) {
+			flags[i/4]=1;
+		}
+	}, [=](size_t i) {
+#ifdef ALY_BATCH_SSE
+		BatchMat3<BatchFloat4> a,r;
+		BatchFloat4 det;
+		BatchLoad(A+i,a);
+		BatchInverse3(a,r,det);
+		BatchStore(r,Ainv+i);
+		if(_mm_movemask_ps(_mm_cmplt_ps(BatchAbs(det).v,_mm_set1_ps(std::numeric_limits<float>::min())))!=0) {
+			flags[i/4]=1;
+		}
+#endif
+	});
+	for (char c : singular) {
+		if (c) {
+			return false;
+		}
+	}
+	return true;
+}
+bool BatchInverse(const std::vector<float3x3>& A, std::vector<float3x3>& Ainv) {
+	Ainv.resize(A.size());
+	return BatchInverse(A.data(), Ainv.data(), A.size());
+}
+}
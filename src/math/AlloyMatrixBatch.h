@@ -0,0 +1,48 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef INCLUDE_ALLOYMATRIXBATCH_H_
+#define INCLUDE_ALLOYMATRIXBATCH_H_
+#include "math/AlloyVecMath.h"
+#include <vector>
+namespace aly {
+bool SANITY_CHECK_MATRIX_BATCH();
+/*
+ * Batched versions of the per-element 3x3 decompositions. Matrices are
+ * transposed into structure-of-arrays form four at a time so the branch free
+ * svd3 algorithm runs on every SIMD lane at once, and large arrays are split
+ * into blocks processed in parallel. Results agree with the single matrix
+ * versions up to rounding. They are not guaranteed to be bit-identical, since
+ * the compiler may contract the scalar versions into fused multiply-adds.
+ */
+//Same factorization as SVD(float3x3), with the singular values returned as a vector.
+void BatchSVD(const float3x3* A, float3x3* U, float3* D, float3x3* Vt, size_t count);
+void BatchSVD(const std::vector<float3x3>& A, std::vector<float3x3>& U, std::vector<float3>& D, std::vector<float3x3>& Vt);
+//Same as FactorRotation() for every matrix.
+void BatchFactorRotation(const float3x3* A, float3x3* R, size_t count);
+void BatchFactorRotation(const std::vector<float3x3>& A, std::vector<float3x3>& R);
+//Polar decomposition A = R * S with R the closest rotation to A and S symmetric.
+void BatchPolarDecomposition(const float3x3* A, float3x3* R, float3x3* S, size_t count);
+void BatchPolarDecomposition(const std::vector<float3x3>& A, std::vector<float3x3>& R, std::vector<float3x3>& S);
+//Inverts every matrix. Singular matrices are set to zero and the method returns false.
+bool BatchInverse(const float3x3* A, float3x3* Ainv, size_t count);
+bool BatchInverse(const std::vector<float3x3>& A, std::vector<float3x3>& Ainv);
+}
+#endif
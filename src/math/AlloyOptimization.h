@@ -68,308 +68,272 @@ template<class T> struct SparseProblem {
 	}
 };
 
-/******************************************************************************
- * XLISP-STAT 2.1 Copyright (c) 1990, by Luke Tierney
- * XLISP version 2.1, Copyright (c) 1989, by David Betz.
- *
- * Permission to use, copy, modify, distribute, and sell this software and its
- * documentation for any purpose is hereby granted without fee, provided that
- * the above copyright notice appear in all copies and that both that
- * copyright notice and this permission notice appear in supporting
- * documentation, and that the name of Luke Tierney and David Betz not be
- * used in advertising or publicity pertaining to distribution of the software
- * without specific, written prior permission.  Luke Tierney and David Betz
- * make no representations about the suitability of this software for any
- * purpose. It is provided "as is" without express or implied warranty.
- *
- * LUKE TIERNEY AND DAVID BETZ DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
- * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS,
- * IN NO EVENT SHALL LUKE TIERNEY NOR DAVID BETZ BE LIABLE FOR ANY SPECIAL,
- * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
- * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
- * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
- * PERFORMANCE OF THIS SOFTWARE.
- *
- * XLISP-STAT AUTHOR:
- *               Luke Tierney
- *               School of Statistics
- *               University of Minnesota
- *               Minneapolis, MN 55455
- *               (612) 625-7843
- *
- *       Email Address:
- *               internet: luke@umnstat.stat.umn.edu
- *
- * XLISP AUTHOR:
- *              David Betz
- *              P.O. Box 144
- *              Peterborough, NH 03458
- *              (603) 924-4145
- ******************************************************************************
- * XLISP-STAT 2.1 was ported to the Amiga by
- *              J.K. Lindsey
- *              Faculty of Economic, Business and Social Sciences,
- *              University of Liege,
- *              Sart Tilman B31,
- *              4000 Liege,
- *              Belgium
- *              32-41-56.29.64
- *
- * The above permission and disclaimer also applies to all of the specifically
- * Amiga portions of this software, with the restriction that the Amiga
- * version not be used for any military-related applications.
- ******************************************************************************
-
+namespace detail {
+//Number of columns factored per panel by the blocked LU, QR and Cholesky factorizations.
+static const int FACTOR_BLOCK = 64;
+/*
+ * Block of Householder reflectors in compact WY form H_1...H_b = I - V T V^T,
+ * where V holds the unit lower trapezoidal reflector vectors for rows
+ * [offset, m) and T is upper triangular.
  */
-
-template<class T> void SVD(const DenseMat<T>& M, DenseMat<T>& U, DenseMat<T>& D,
-		DenseMat<T>& Vt, double zeroTolerance = 0) {
-	const int m = M.rows;
-	const int n = M.cols;
-	DenseMat<double> u(m, m);
-	DenseMat<double> v(n, n);
-	std::vector<double> w(n);
-	std::vector<double> rv1(n);
-	int flag, i, its, j, jj, k, l, nm = 0;
-	double c, f, h, s, x, y, z;
-	double anorm, g, scale;
-	U.resize(m, m);
-	Vt.resize(n, n);
-	D.resize(m, n);
-	anorm = 0.0, g = 0.0, scale = 0.0;
-	if (m < n) {
-		throw std::runtime_error(
-				"SVD error, rows must be greater than or equal to cols.");
-	}
-	for (int i = 0; i < m; i++) {
-		for (int j = 0; j < n; j++) {
-			u[i][j] = (double) M[i][j];
-		}
-	}
-	for (i = 0; i < n; i++) {
-		l = i + 1;
-		rv1[i] = scale * g;
-		g = s = scale = 0.0;
-		if (i < m) {
-			for (k = i; k < m; k++)
-				scale += std::abs((double) u[k][i]);
-			if (scale > zeroTolerance) {
-				for (k = i; k < m; k++) {
-					u[k][i] = ((double) u[k][i] / scale);
-					s += ((double) u[k][i] * (double) u[k][i]);
-				}
-				f = (double) u[i][i];
-				g = -sign(std::sqrt(s), f);
-				h = f * g - s;
-				u[i][i] = (f - g);
-				if (i != n - 1) {
-					for (j = l; j < n; j++) {
-						for (s = 0.0, k = i; k < m; k++)
-							s += ((double) u[k][i] * (double) u[k][j]);
-						f = s / h;
-						for (k = i; k < m; k++)
-							u[k][j] += (f * (double) u[k][i]);
-					}
-				}
-				for (k = i; k < m; k++)
-					u[k][i] = ((double) u[k][i] * scale);
+struct HouseholderBlock {
+	int offset;
+	DenseMat<double> V;
+	DenseMat<double> T;
+};
+/*
+ * In place Householder QR of a row major matrix. Each panel of FACTOR_BLOCK
+ * columns is reduced column by column, then applied to the trailing matrix
+ * with three GEMMs. Reflectors use the JAMA convention, so the upper part of
+ * "a" and "rdiag" hold the same R as the unblocked factorization.
+ */
+inline void HouseholderQR(DenseMat<double>& a, std::vector<double>& rdiag, std::vector<HouseholderBlock>& blocks) {
+	const int m = a.rows;
+	const int n = a.cols;
+	const int kmax = std::min(m, n);
+	rdiag.assign(n, 0.0);
+	blocks.clear();
+	for (int k0 = 0; k0 < kmax; k0 += FACTOR_BLOCK) {
+		const int kb = std::min(FACTOR_BLOCK, kmax - k0);
+		const int k1 = k0 + kb;
+		const int mb = m - k0;
+		HouseholderBlock block;
+		block.offset = k0;
+		block.V.resize(mb, kb);
+		block.V.setZero();
+		block.T.resize(kb, kb);
+		block.T.setZero();
+		for (int c = 0; c < kb; c++) {
+			const int k = k0 + c;
+			double nrm = 0;
+			for (int i = k; i < m; i++) {
+				nrm = pythag(nrm, a[i][k]);
 			}
-		}
-		w[i] = (scale * g);
-		g = s = scale = 0.0;
-		if (i < m && i != n - 1) {
-			for (k = l; k < n; k++)
-				scale += std::abs((double) u[i][k]);
-			if (scale > zeroTolerance) {
-				for (k = l; k < n; k++) {
-					u[i][k] = ((double) u[i][k] / scale);
-					s += ((double) u[i][k] * (double) u[i][k]);
+			double tau = 0.0;
+			if (nrm != 0.0) {
+				if (a[k][k] < 0) {
+					nrm = -nrm;
 				}
-				f = (double) u[i][l];
-				g = -sign(std::sqrt(s), f);
-				h = f * g - s;
-				u[i][l] = (f - g);
-				for (k = l; k < n; k++)
-					rv1[k] = (double) u[i][k] / h;
-				if (i != m - 1) {
-					for (j = l; j < m; j++) {
-						for (s = 0.0, k = l; k < n; k++)
-							s += ((double) u[j][k] * (double) u[i][k]);
-						for (k = l; k < n; k++)
-							u[j][k] += (s * rv1[k]);
-					}
+				for (int i = k; i < m; i++) {
+					a[i][k] /= nrm;
 				}
-				for (k = l; k < n; k++)
-					u[i][k] = ((double) u[i][k] * scale);
-			}
-		}
-		anorm = aly::max(anorm, (std::abs((double) w[i]) + std::abs(rv1[i])));
-	}
-	for (i = n - 1; i >= 0; i--) {
-		if (i < n - 1) {
-			if (std::abs(g) > zeroTolerance) {
-				for (j = l; j < n; j++)
-					v[j][i] = (((double) u[i][j] / (double) u[i][l]) / g);
-				for (j = l; j < n; j++) {
-					for (s = 0.0, k = l; k < n; k++)
-						s += ((double) u[i][k] * (double) v[k][j]);
-					for (k = l; k < n; k++)
-						v[k][j] += (s * (double) v[k][i]);
+				a[k][k] += 1.0;
+				tau = a[k][k];
+#pragma omp parallel for if((double)(m-k)*(k1-k)>65536.0)
+				for (int j = k + 1; j < k1; j++) {
+					double s = 0.0;
+					for (int i = k; i < m; i++) {
+						s += a[i][k] * a[i][j];
+					}
+					s = -s / a[k][k];
+					for (int i = k; i < m; i++) {
+						a[i][j] += s * a[i][k];
+					}
 				}
-			}
-			for (j = l; j < n; j++)
-				v[i][j] = v[j][i] = 0.0;
-		}
-		v[i][i] = 1.0;
-		g = rv1[i];
-		l = i;
-	}
-	for (i = n - 1; i >= 0; i--) {
-		l = i + 1;
-		g = (double) w[i];
-		if (i < n - 1)
-			for (j = l; j < n; j++)
-				u[i][j] = 0.0;
-		if (std::abs(g) > zeroTolerance) {
-			g = 1.0 / g;
-			if (i != n - 1) {
-				for (j = l; j < n; j++) {
-					for (s = 0.0, k = l; k < m; k++)
-						s += ((double) u[k][i] * (double) u[k][j]);
-					f = (s / (double) u[i][i]) * g;
-					for (k = i; k < m; k++)
-						u[k][j] += (f * (double) u[k][i]);
+				for (int i = k; i < m; i++) {
+					block.V[i - k0][c] = a[i][k] / tau;
 				}
+			} else {
+				block.V[c][c] = 1.0;
 			}
-			for (j = i; j < m; j++)
-				u[j][i] = ((double) u[j][i] * g);
-		} else {
-			for (j = i; j < m; j++)
-				u[j][i] = 0.0;
-		}
-		++u[i][i];
-	}
-	for (k = n - 1; k >= 0; k--) {
-		for (its = 0; its < 30; its++) {
-			flag = 1;
-			for (l = k; l >= 0; l--) {
-				nm = l - 1;
-				if (std::abs(rv1[l]) + anorm == anorm) {
-					flag = 0;
-					break;
-				}
-				if (nm >= 0 && std::abs((double) w[nm]) + anorm == anorm) {
-					break;
+			rdiag[k] = -nrm;
+			block.T[c][c] = tau;
+		}
+		std::vector<double> w(kb);
+		for (int c = 1; c < kb; c++) {
+			std::fill(w.begin(), w.begin() + c, 0.0);
+			for (int i = c; i < mb; i++) {
+				const double vi = block.V[i][c];
+				const double* row = block.V[i];
+				for (int p = 0; p < c; p++) {
+					w[p] += row[p] * vi;
 				}
 			}
-			if (flag) {
-				c = 0.0;
-				s = 1.0;
-				for (i = l; i <= k; i++) {
-					f = s * rv1[i];
-					if (std::abs(f) + anorm != anorm) {
-						g = (double) w[i];
-						h = pythag(f, g);
-						w[i] = h;
-						h = 1.0 / h;
-						c = g * h;
-						s = (-f * h);
-						for (j = 0; j < m; j++) {
-							y = (double) u[j][nm];
-							z = (double) u[j][i];
-							u[j][nm] = (y * c + z * s);
-							u[j][i] = (z * c - y * s);
-						}
-					}
+			for (int p = 0; p < c; p++) {
+				double s = 0.0;
+				for (int q = p; q < c; q++) {
+					s += block.T[p][q] * w[q];
 				}
+				block.T[p][c] = -block.T[c][c] * s;
 			}
-			z = (double) w[k];
-			if (l == k) {
-				if (z < 0.0) {
-					w[k] = (-z);
-					for (j = 0; j < n; j++)
-						v[j][k] = (-v[j][k]);
-				}
-				int iii, jjj;
-				for (iii = k; (iii < n - 1) && (w[iii] < w[iii + 1]); iii++) {
-					std::swap(w[iii], w[iii + 1]);
-					for (jjj = 0; jjj < m; jjj++)
-						std::swap(u[jjj][iii], u[jjj][iii + 1]);
-					for (jjj = 0; jjj < n; jjj++)
-						std::swap(v[jjj][iii], v[jjj][iii + 1]);
+		}
+		const int nc = n - k1;
+		if (nc > 0) {
+			//Trailing matrix C = (I - V T^T V^T) C
+			DenseMat<double> W(kb, nc), TW(kb, nc);
+			double* C = &a[k0][k1];
+			Gemm(true, false, kb, nc, mb, 1.0, block.V.data.data(), kb, C, n, 0.0, W.data.data(), nc);
+			Gemm(true, false, kb, nc, kb, 1.0, block.T.data.data(), kb, W.data.data(), nc, 0.0, TW.data.data(), nc);
+			Gemm(false, false, mb, nc, kb, -1.0, block.V.data.data(), kb, TW.data.data(), nc, 1.0, C, n);
+		}
+		blocks.push_back(std::move(block));
+	}
+}
+//Forms the first n columns of Q from the reflectors, applying blocks in reverse order.
+inline void HouseholderQ(const std::vector<HouseholderBlock>& blocks, int m, int n, DenseMat<double>& Q) {
+	Q.resize(m, n);
+	Q.setZero();
+	for (int i = 0; i < std::min(m, n); i++) {
+		Q[i][i] = 1.0;
+	}
+	for (int b = (int) blocks.size() - 1; b >= 0; b--) {
+		const HouseholderBlock& block = blocks[b];
+		const int k0 = block.offset;
+		const int kb = block.T.rows;
+		const int mb = m - k0;
+		const int nc = n - k0;
+		DenseMat<double> W(kb, nc), TW(kb, nc);
+		double* C = &Q[k0][k0];
+		Gemm(true, false, kb, nc, mb, 1.0, block.V.data.data(), kb, C, n, 0.0, W.data.data(), nc);
+		Gemm(false, false, kb, nc, kb, 1.0, block.T.data.data(), kb, W.data.data(), nc, 0.0, TW.data.data(), nc);
+		Gemm(false, false, mb, nc, kb, -1.0, block.V.data.data(), kb, TW.data.data(), nc, 1.0, C, n);
+	}
+}
+/*
+ * Rotates rows xi and xj so they become orthogonal, applying the same
+ * rotation to rows vi and vj. Returns false if they already are.
+ */
+inline bool JacobiRotate(double* xi, double* xj, double* vi, double* vj, int n, double tolerance) {
+	double alpha = 0.0, beta = 0.0, gamma = 0.0;
+	for (int k = 0; k < n; k++) {
+		alpha += xi[k] * xi[k];
+		beta += xj[k] * xj[k];
+		gamma += xi[k] * xj[k];
+	}
+	if (gamma == 0.0 || std::abs(gamma) <= tolerance * std::sqrt(alpha * beta)) {
+		return false;
+	}
+	double zeta = (beta - alpha) / (2.0 * gamma);
+	double t = ((zeta >= 0.0) ? 1.0 : -1.0) / (std::abs(zeta) + std::hypot(1.0, zeta));
+	double c = 1.0 / std::sqrt(1.0 + t * t);
+	double s = c * t;
+	for (int k = 0; k < n; k++) {
+		double a = xi[k];
+		double b = xj[k];
+		xi[k] = c * a - s * b;
+		xj[k] = s * a + c * b;
+	}
+	for (int k = 0; k < n; k++) {
+		double a = vi[k];
+		double b = vj[k];
+		vi[k] = c * a - s * b;
+		vj[k] = s * a + c * b;
+	}
+	return true;
+}
+/*
+ * One-sided Jacobi (Hestenes) on the rows of x, accumulating rotations in vt.
+ * Pairs are visited in round-robin tournament order so each round rotates
+ * n/2 disjoint pairs in parallel. Returns false if it did not converge.
+ */
+inline bool OneSidedJacobi(DenseMat<double>& x, DenseMat<double>& vt, int maxSweeps = 60) {
+	const int n = x.rows;
+	const int players = n + (n & 1);
+	const double tolerance = std::sqrt((double) x.cols) * std::numeric_limits<double>::epsilon();
+	std::vector<int> order(players);
+	for (int i = 0; i < players; i++) {
+		order[i] = i;
+	}
+	for (int sweep = 0; sweep < maxSweeps; sweep++) {
+		int rotations = 0;
+		for (int round = 0; round < players - 1; round++) {
+#pragma omp parallel for reduction(+:rotations) if(n>=64)
+			for (int p = 0; p < players / 2; p++) {
+				int i = order[p];
+				int j = order[players - 1 - p];
+				if (i < n && j < n && JacobiRotate(x[i], x[j], vt[i], vt[j], x.cols, tolerance)) {
+					rotations++;
 				}
-				break;
-			}
-			if (its >= 30) {
-				throw std::runtime_error("SVD did not converge.");
 			}
-			x = (double) w[l];
-			nm = k - 1;
-			y = (double) w[nm];
-			g = rv1[nm];
-			h = rv1[k];
-			f = ((y - z) * (y + z) + (g - h) * (g + h)) / (2.0 * h * y);
-			g = pythag(f, 1.0);
-			f = ((x - z) * (x + z) + h * ((y / (f + sign(g, f))) - h)) / x;
-			c = s = 1.0;
-			for (j = l; j <= nm; j++) {
-				i = j + 1;
-				g = rv1[i];
-				y = (double) w[i];
-				h = s * g;
-				g = c * g;
-				z = pythag(f, h);
-				rv1[j] = z;
-				c = f / z;
-				s = h / z;
-				f = x * c + g * s;
-				g = g * c - x * s;
-				h = y * s;
-				y = y * c;
-				for (jj = 0; jj < n; jj++) {
-					x = (double) v[jj][j];
-					z = (double) v[jj][i];
-					v[jj][j] = (x * c + z * s);
-					v[jj][i] = (z * c - x * s);
-				}
-				z = pythag(f, h);
-				w[j] = z;
-				if (z) {
-					z = 1.0 / z;
-					c = f * z;
-					s = h * z;
-				}
-				f = (c * g) + (s * y);
-				x = (c * y) - (s * g);
-				for (jj = 0; jj < m; jj++) {
-					y = (double) u[jj][j];
-					z = (double) u[jj][i];
-					u[jj][j] = (y * c + z * s);
-					u[jj][i] = (z * c - y * s);
-				}
+			int last = order[players - 1];
+			for (int k = players - 1; k > 1; k--) {
+				order[k] = order[k - 1];
 			}
-			rv1[l] = 0.0;
-			rv1[k] = f;
-			w[k] = x;
+			if (players > 1)
+				order[1] = last;
+		}
+		if (rotations == 0) {
+			return true;
 		}
 	}
-	for (int i = 0; i < m; i++) {
-		for (int j = 0; j < n; j++) {
-			if (i == j) {
-				D[i][j] = (T) w[j];
-			} else {
-				D[i][j] = T(0);
-			}
+	return false;
+}
+}
+/*
+ * Singular value decomposition M = U * D * Vt for rows >= cols. M is first
+ * reduced to R with the blocked QR, then R is diagonalized by one-sided
+ * Jacobi rotations, which are accurate to working precision even for small
+ * singular values. Singular values are sorted in decreasing order. As before,
+ * only the first cols columns of U are set, the rest are zero.
+ */
+template<class T> void SVD(const DenseMat<T>& M, DenseMat<T>& U, DenseMat<T>& D,
+		DenseMat<T>& Vt, double zeroTolerance = 0) {
+	const int m = M.rows;
+	const int n = M.cols;
+	if (m < n) {
+		throw std::runtime_error(
+				"SVD error, rows must be greater than or equal to cols.");
+	}
+	U.resize(m, m);
+	Vt.resize(n, n);
+	D.resize(m, n);
+	DenseMat<double> a(m, n);
+	for (size_t i = 0; i < a.data.size(); i++) {
+		a.data[i] = (double) M.data[i];
+	}
+	std::vector<double> rdiag;
+	std::vector<detail::HouseholderBlock> blocks;
+	detail::HouseholderQR(a, rdiag, blocks);
+	DenseMat<double> q;
+	detail::HouseholderQ(blocks, m, n, q);
+	//Rows of x are the columns of R.
+	DenseMat<double> x(n, n), vt(n, n);
+	x.setZero();
+	vt.setZero();
+	for (int i = 0; i < n; i++) {
+		x[i][i] = rdiag[i];
+		vt[i][i] = 1.0;
+		for (int j = i + 1; j < n; j++) {
+			x[j][i] = a[i][j];
+		}
+	}
+	if (!detail::OneSidedJacobi(x, vt)) {
+		throw std::runtime_error("SVD did not converge.");
+	}
+	std::vector<double> w(n);
+	std::vector<int> order(n);
+	for (int i = 0; i < n; i++) {
+		double s = 0.0;
+		for (int k = 0; k < n; k++) {
+			s += x[i][k] * x[i][k];
 		}
+		w[i] = std::sqrt(s);
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&w](int a, int b) {
+		return w[a] > w[b];
+	});
+	DenseMat<double> ur(n, n), u(m, n);
+	for (int j = 0; j < n; j++) {
+		const int i = order[j];
+		const double scale = (w[i] > zeroTolerance && w[i] > 0.0) ? 1.0 / w[i] : 0.0;
+		for (int k = 0; k < n; k++) {
+			ur[k][j] = x[i][k] * scale;
+		}
+	}
+	detail::Gemm(false, false, m, n, n, 1.0, q.data.data(), n, ur.data.data(), n, 0.0, u.data.data(), n);
+	D.setZero();
+	for (int j = 0; j < n; j++) {
+		D[j][j] = (T) w[order[j]];
 	}
 	for (int i = 0; i < m; i++) {
 		for (int j = 0; j < m; j++) {
-			U[i][j] = (T) u[i][j];
+			U[i][j] = (j < n) ? (T) u[i][j] : T(0);
 		}
 	}
 	for (int i = 0; i < n; i++) {
 		for (int j = 0; j < n; j++) {
-			Vt[i][j] = (T) v[j][i];
+			Vt[i][j] = (T) vt[order[i]][j];
 		}
 	}
 }
@@ -427,57 +391,77 @@ template<class T> bool LU(const DenseMat<T>& A, DenseMat<T>& L, DenseMat<T>& U,
 		std::vector<int>& piv, const double zeroTolerance = 0.0) {
 	const int m = A.rows;
 	const int n = A.cols;
-	std::vector<std::vector<double>> LU(m, std::vector<double>(n, 0.0));
-	piv.resize(m);
-	std::vector<double> LUcolj(m, 0.0);
-	int pivsign;
-	double* LUrowi;
-	L.resize(m, n);
-	U.resize(n, n);
-	bool nonSingular = true;
-	for (int i = 0; i < m; i++) {
-		for (int j = 0; j < n; j++) {
-			LU[i][j] = (double) A[i][j];
-		}
+	const int kmax = std::min(m, n);
+	DenseMat<double> lu(m, n);
+	for (size_t i = 0; i < lu.data.size(); i++) {
+		lu.data[i] = (double) A.data[i];
 	}
+	piv.resize(m);
 	for (int i = 0; i < m; i++) {
 		piv[i] = i;
 	}
-	pivsign = 1;
-	for (int j = 0; j < n; j++) {
-		for (int i = 0; i < m; i++) {
-			LUcolj[i] = LU[i][j];
-		}
-		for (int i = 0; i < m; i++) {
-			LUrowi = &LU[i][0];
-			int kmax = aly::min(i, j);
-			double s = 0.0;
-			for (int k = 0; k < kmax; k++) {
-				s += LUrowi[k] * LUcolj[k];
+	L.resize(m, n);
+	U.resize(n, n);
+	bool nonSingular = true;
+	/*
+	 * Right looking blocked elimination with partial pivoting. Each panel of
+	 * FACTOR_BLOCK columns is factored in place, then the block row of U is
+	 * solved and the trailing matrix is updated with one GEMM.
+	 */
+	for (int j0 = 0; j0 < kmax; j0 += detail::FACTOR_BLOCK) {
+		const int j1 = std::min(j0 + detail::FACTOR_BLOCK, kmax);
+		for (int j = j0; j < j1; j++) {
+			int p = j;
+			for (int i = j + 1; i < m; i++) {
+				if (std::abs(lu[i][j]) > std::abs(lu[p][j])) {
+					p = i;
+				}
 			}
-			LUrowi[j] = LUcolj[i] -= s;
-		}
-		int p = j;
-		for (int i = j + 1; i < m; i++) {
-			if (std::abs(LUcolj[i]) > std::abs(LUcolj[p])) {
-				p = i;
+			if (p != j) {
+				std::swap_ranges(lu[p], lu[p] + n, lu[j]);
+				std::swap(piv[p], piv[j]);
 			}
-		}
-		if (p != j) {
-			for (int k = 0; k < n; k++) {
-				std::swap(LU[p][k], LU[j][k]);
+			const double pivot = lu[j][j];
+			const bool divide = (std::abs(pivot) > zeroTolerance);
+			const double* prow = lu[j];
+#pragma omp parallel for if((double)(m-j)*(j1-j)>65536.0)
+			for (int i = j + 1; i < m; i++) {
+				double* row = lu[i];
+				if (divide) {
+					row[j] /= pivot;
+				}
+				const double l = row[j];
+				for (int k = j + 1; k < j1; k++) {
+					row[k] -= l * prow[k];
+				}
 			}
-			std::swap(piv[p], piv[j]);
-			pivsign = -pivsign;
 		}
-		if (j < m && std::abs(LU[j][j]) > zeroTolerance) {
-			for (int i = j + 1; i < m; i++) {
-				LU[i][j] /= LU[j][j];
+		const int nc = n - j1;
+		if (nc > 0) {
+			//Solve L11 * U12 = A12, where L11 is unit lower triangular.
+			const int TILE = 256;
+#pragma omp parallel for if((double)nc*(j1-j0)>65536.0)
+			for (int c0 = 0; c0 < nc; c0 += TILE) {
+				const int c1 = std::min(c0 + TILE, nc);
+				for (int r = j0 + 1; r < j1; r++) {
+					double* row = lu[r] + j1;
+					for (int q = j0; q < r; q++) {
+						const double l = lu[r][q];
+						const double* qrow = lu[q] + j1;
+						for (int c = c0; c < c1; c++) {
+							row[c] -= l * qrow[c];
+						}
+					}
+				}
+			}
+			if (j1 < m) {
+				//A22 = A22 - L21 * U12
+				detail::Gemm(false, false, m - j1, nc, j1 - j0, -1.0, lu[j1] + j0, n, lu[j0] + j1, n, 1.0, lu[j1] + j1, n);
 			}
 		}
 	}
-	for (int j = 0; j < n; j++) {
-		if (std::abs(LU[j][j]) <= zeroTolerance) {
+	for (int j = 0; j < kmax; j++) {
+		if (std::abs(lu[j][j]) <= zeroTolerance) {
 			nonSingular = false;
 			break;
 		}
@@ -485,7 +469,7 @@ template<class T> bool LU(const DenseMat<T>& A, DenseMat<T>& L, DenseMat<T>& U,
 	for (int i = 0; i < m; i++) {
 		for (int j = 0; j < n; j++) {
 			if (i > j) {
-				L[i][j] = (T) LU[i][j];
+				L[i][j] = (T) lu[i][j];
 			} else if (i == j) {
 				L[i][j] = T(1.0);
 			} else {
@@ -495,8 +479,8 @@ template<class T> bool LU(const DenseMat<T>& A, DenseMat<T>& L, DenseMat<T>& U,
 	}
 	for (int i = 0; i < n; i++) {
 		for (int j = 0; j < n; j++) {
-			if (i <= j) {
-				U[i][j] = T(LU[i][j]);
+			if (i <= j && i < m) {
+				U[i][j] = T(lu[i][j]);
 			} else {
 				U[i][j] = T(0.0);
 			}
@@ -504,7 +488,6 @@ template<class T> bool LU(const DenseMat<T>& A, DenseMat<T>& L, DenseMat<T>& U,
 	}
 	return nonSingular;
 }
-
 template<class T> Vec<T> SolveLU(const DenseMat<T>& A, const Vec<T>& b) {
 
 	if (A.rows != (int) b.size()) {
@@ -592,42 +575,15 @@ template<class T> bool QR(const DenseMat<T>& A, DenseMat<T>& Q,
 	const int m = A.rows;
 	const int n = A.cols;
 	DenseMat<double> qr(m, n);
-	std::vector<double> Rdiag(m);
 	R.resize(n, n);
 	Q.resize(m, n);
 	bool nonSingular = true;
-	for (int i = 0; i < m; i++) {
-		for (int j = 0; j < n; j++) {
-			qr[i][j] = (double) A[i][j];
-		}
-	}
-	for (int k = 0; k < n; k++) {
-		double nrm = 0;
-		for (int i = k; i < m; i++) {
-			nrm = pythag(nrm, qr[i][k]);
-		}
-		if (nrm != 0.0) {
-			if (qr[k][k] < 0) {
-				nrm = -nrm;
-			}
-			for (int i = k; i < m; i++) {
-				qr[i][k] /= nrm;
-			}
-			qr[k][k] += 1.0;
-			for (int j = k + 1; j < n; j++) {
-				double s = 0.0;
-				for (int i = k; i < m; i++) {
-					s += qr[i][k] * qr[i][j];
-				}
-				s = -s / qr[k][k];
-				for (int i = k; i < m; i++) {
-					qr[i][j] += s * qr[i][k];
-				}
-			}
-		}
-		Rdiag[k] = -nrm;
+	for (size_t i = 0; i < qr.data.size(); i++) {
+		qr.data[i] = (double) A.data[i];
 	}
-
+	std::vector<double> Rdiag;
+	std::vector<detail::HouseholderBlock> blocks;
+	detail::HouseholderQR(qr, Rdiag, blocks);
 	for (int i = 0; i < n; i++) {
 		for (int j = 0; j < n; j++) {
 			if (i < j) {
@@ -647,27 +603,13 @@ template<class T> bool QR(const DenseMat<T>& A, DenseMat<T>& Q,
 			}
 		}
 	}
-	for (int k = n - 1; k >= 0; k--) {
-		for (int i = 0; i < m; i++) {
-			Q[i][k] = T(0.0);
-		}
-		Q[k][k] = T(1.0);
-		for (int j = k; j < n; j++) {
-			if (qr[k][k] != 0) {
-				double s = 0.0;
-				for (int i = k; i < m; i++) {
-					s += qr[i][k] * Q[i][j];
-				}
-				s = -s / qr[k][k];
-				for (int i = k; i < m; i++) {
-					Q[i][j] += T(s * qr[i][k]);
-				}
-			}
-		}
+	DenseMat<double> q;
+	detail::HouseholderQ(blocks, m, n, q);
+	for (size_t i = 0; i < q.data.size(); i++) {
+		Q.data[i] = T(q.data[i]);
 	}
 	return nonSingular;
 }
-
 template<class T> Vec<T> SolveQR(const DenseMat<T>& A, const Vec<T>& b) {
 
 	if (A.rows != (int) b.size()) {
@@ -718,6 +660,106 @@ template<class T> Vec<T> SolveQR(const DenseMat<T>& A, const Vec<T>& b) {
 		return x;
 	}
 }
+/*
+ * Cholesky decomposition A = L * L^T of a symmetric positive definite matrix,
+ * where L is lower triangular. Only the lower triangle of A is read. Returns
+ * false if A is not positive definite.
+ */
+template<class T> bool Cholesky(const DenseMat<T>& A, DenseMat<T>& L) {
+	if (A.rows != A.cols) {
+		throw std::runtime_error(
+				MakeString() << "Cholesky decomposition requires a square matrix: ["
+						<< A.rows << ", " << A.cols << "]");
+	}
+	const int n = A.rows;
+	DenseMat<double> a(n, n);
+	for (size_t i = 0; i < a.data.size(); i++) {
+		a.data[i] = (double) A.data[i];
+	}
+	L.resize(n, n);
+	L.setZero();
+	for (int k0 = 0; k0 < n; k0 += detail::FACTOR_BLOCK) {
+		const int k1 = std::min(k0 + detail::FACTOR_BLOCK, n);
+		for (int j = k0; j < k1; j++) {
+			double d = a[j][j];
+			if (!(d > 0.0)) {
+				return false;
+			}
+			d = std::sqrt(d);
+			a[j][j] = d;
+			for (int i = j + 1; i < k1; i++) {
+				a[i][j] /= d;
+			}
+			for (int i = j + 1; i < k1; i++) {
+				for (int c = j + 1; c <= i; c++) {
+					a[i][c] -= a[i][j] * a[c][j];
+				}
+			}
+		}
+		if (k1 < n) {
+			//L21 = A21 * L11^-T
+#pragma omp parallel for if((double)(n-k1)*(k1-k0)>16384.0)
+			for (int i = k1; i < n; i++) {
+				double* row = a[i];
+				for (int c = k0; c < k1; c++) {
+					double s = row[c];
+					const double* lrow = a[c];
+					for (int p = k0; p < c; p++) {
+						s -= row[p] * lrow[p];
+					}
+					row[c] = s / lrow[c];
+				}
+			}
+			//A22 = A22 - L21 * L21^T
+			detail::Gemm(false, true, n - k1, n - k1, k1 - k0, -1.0, a[k1] + k0, n, a[k1] + k0, n, 1.0, a[k1] + k1, n);
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j <= i; j++) {
+			L[i][j] = T(a[i][j]);
+		}
+	}
+	return true;
+}
+template<class T> Vec<T> SolveCholesky(const DenseMat<T>& A, const Vec<T>& b) {
+	if (A.rows != (int) b.size()) {
+		throw std::runtime_error(
+				MakeString()
+						<< "Matrix row dimensions and vector length must agree. A=["
+						<< A.rows << "," << A.cols << "] b=[" << b.size()
+						<< "]");
+	}
+	DenseMat<T> L;
+	Vec<T> x;
+	if (A.rows != A.cols) {
+		DenseMat<T> At = A.transpose();
+		if (!Cholesky(At * A, L)) {
+			throw std::runtime_error("Matrix is not positive definite.");
+		}
+		x = At * b;
+	} else {
+		if (!Cholesky(A, L)) {
+			throw std::runtime_error("Matrix is not positive definite.");
+		}
+		x = b;
+	}
+	int n = L.rows;
+	// Forward solve Ly = b
+	for (int i = 0; i < n; i++) {
+		for (int j = 0; j < i; j++) {
+			x[i] -= L[i][j] * x[j];
+		}
+		x[i] /= L[i][i];
+	}
+	// Backward solve L^T x = y
+	for (int i = n - 1; i >= 0; i--) {
+		for (int j = i + 1; j < n; j++) {
+			x[i] -= L[j][i] * x[j];
+		}
+		x[i] /= L[i][i];
+	}
+	return x;
+}
 template<class C, class R> std::basic_ostream<C, R> & operator <<(
 		std::basic_ostream<C, R> & ss, const MatrixFactorization& type) {
 	switch (type) {
@@ -23,6 +23,7 @@
 #define INCLUDE_CORE_ALLOYOPTIMIZATIONMATH_H_
 #include "math/AlloyVector.h"
 #include "system/AlignedAllocator.h"
+#include "math/AlloyGemm.h"
 #include "common/cereal/types/list.hpp"
 #include "common/cereal/types/vector.hpp"
 #include "common/cereal/types/tuple.hpp"
@@ -599,6 +600,8 @@ public:
 	DenseMat(int rows, int cols): rows(rows), cols(cols) {
 		data.resize(rows * (size_t) cols);
 	}
+	DenseMat(const DenseMat<T>& mat) = default;
+	DenseMat(DenseMat<T>&& mat) = default;
 	void resize(int rows, int cols) {
 		if (this->rows != rows || this->cols != cols) {
 			data.resize(rows * (size_t) cols);
@@ -662,9 +665,16 @@ public:
 	}
 	inline DenseMat<T> transpose() const {
 		DenseMat<T> M(cols, rows);
-		for (int i = 0; i < rows; i++) {
-			for (int j = 0; j < cols; j++) {
-				M(j, i) = operator()(i, j);
+		//Transpose in tiles so reads and writes both stay in cache.
+		const int TILE = 32;
+#pragma omp parallel for if((double)rows*cols>65536.0)
+		for (int i0 = 0; i0 < rows; i0 += TILE) {
+			for (int j0 = 0; j0 < cols; j0 += TILE) {
+				for (int i = i0; i < std::min(i0 + TILE, rows); i++) {
+					for (int j = j0; j < std::min(j0 + TILE, cols); j++) {
+						M(j, i) = operator()(i, j);
+					}
+				}
 			}
 		}
 		return M;
@@ -720,6 +730,7 @@ template<class A, class B, class T> std::basic_ostream<A, B> & operator <<(
 
 template<class T> Vec<T> operator*(const DenseMat<T>& A, const VecType<T>& v) {
 	Vec<T> out(A.rows);
+#pragma omp parallel for if((double)A.rows*A.cols>65536.0)
 	for (int i = 0; i < A.rows; i++) {
 		T sum(0.0);
 		for (int j = 0; j < A.cols; j++) {
@@ -738,15 +749,7 @@ template<class T> DenseMat<T> operator*(const DenseMat<T>& A,
 						<< "[" << A.rows << "," << A.cols << "] * [" << B.rows
 						<< "," << B.cols << "]");
 	DenseMat<T> out(A.rows, B.cols);
-	for (int i = 0; i < out.rows; i++) {
-		for (int j = 0; j < out.cols; j++) {
-			T sum(0.0);
-			for (int k = 0; k < A.cols; k++) {
-				sum += A(i, k) * B(k, j);
-			}
-			out(i, j) = sum;
-		}
-	}
+	detail::Gemm(false, false, A.rows, B.cols, A.cols, T(1), A.data.data(), A.cols, B.data.data(), B.cols, T(0), out.data.data(), out.cols);
 	return out;
 }
 //Slight abuse of mathematics here. Vectors are always interpreted as column vectors as a convention,
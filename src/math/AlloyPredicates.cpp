@@ -0,0 +1,250 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+//Error bounds and expansion arithmetic follow Shewchuk, J. R. (1997). Adaptive precision
+//floating-point arithmetic and fast robust geometric predicates. Discrete & Computational Geometry, 18(3), 305-363.
+#include "math/AlloyPredicates.h"
+#include <vector>
+#include <cmath>
+namespace aly {
+typedef std::vector<double> Expansion;
+static const double PREDICATE_EPSILON = 1.1102230246251565e-16; //2^-53
+static const double ORIENT2D_BOUND = (3.0 + 16.0 * PREDICATE_EPSILON) * PREDICATE_EPSILON;
+static const double INCIRCLE_BOUND = (10.0 + 96.0 * PREDICATE_EPSILON) * PREDICATE_EPSILON;
+static const double ORIENT3D_BOUND = (7.0 + 56.0 * PREDICATE_EPSILON) * PREDICATE_EPSILON;
+static const double INSPHERE_BOUND = (16.0 + 224.0 * PREDICATE_EPSILON) * PREDICATE_EPSILON;
+static inline void TwoSum(double a, double b, double& x, double& y) {
+	x = a + b;
+	double bv = x - a;
+	double av = x - bv;
+	y = (a - av) + (b - bv);
+}
+static inline void TwoProduct(double a, double b, double& x, double& y) {
+	x = a * b;
+	y = std::fma(a, b, -x);
+}
+/*
+ * Expansions are sums of non-overlapping doubles stored in order of increasing
+ * magnitude with zeros removed, so the sign is the sign of the last entry.
+ */
+static Expansion Difference(double a, double b) {
+	double x, y;
+	TwoSum(a, -b, x, y);
+	Expansion h;
+	if (y != 0.0)
+		h.push_back(y);
+	if (x != 0.0)
+		h.push_back(x);
+	return h;
+}
+static void Grow(Expansion& e, double b) {
+	double q = b;
+	size_t n = 0;
+	for (size_t i = 0; i < e.size(); i++) {
+		double h;
+		TwoSum(q, e[i], q, h);
+		if (h != 0.0)
+			e[n++] = h;
+	}
+	e.resize(n);
+	if (q != 0.0)
+		e.push_back(q);
+}
+static Expansion Sum(const Expansion& e, const Expansion& f) {
+	Expansion h = e;
+	for (double b : f) {
+		Grow(h, b);
+	}
+	return h;
+}
+static Expansion Negate(const Expansion& e) {
+	Expansion h(e.size());
+	for (size_t i = 0; i < e.size(); i++) {
+		h[i] = -e[i];
+	}
+	return h;
+}
+static Expansion Scale(const Expansion& e, double b) {
+	Expansion h;
+	if (e.empty() || b == 0.0)
+		return h;
+	h.reserve(2 * e.size());
+	double q, t, s, p;
+	TwoProduct(e[0], b, q, s);
+	if (s != 0.0)
+		h.push_back(s);
+	for (size_t i = 1; i < e.size(); i++) {
+		TwoProduct(e[i], b, p, t);
+		TwoSum(q, t, q, s);
+		if (s != 0.0)
+			h.push_back(s);
+		TwoSum(p, q, q, s);
+		if (s != 0.0)
+			h.push_back(s);
+	}
+	if (q != 0.0)
+		h.push_back(q);
+	return h;
+}
+static Expansion Product(const Expansion& e, const Expansion& f) {
+	Expansion h;
+	for (double b : f) {
+		h = Sum(h, Scale(e, b));
+	}
+	return h;
+}
+static inline double Estimate(const Expansion& e) {
+	return (e.empty()) ? 0.0 : e.back();
+}
+static double Orient2DExact(double ax, double ay, double bx, double by, double cx, double cy) {
+	Expansion acx = Difference(ax, cx), acy = Difference(ay, cy);
+	Expansion bcx = Difference(bx, cx), bcy = Difference(by, cy);
+	return Estimate(Sum(Product(acx, bcy), Negate(Product(acy, bcx))));
+}
+double Orient2D(double ax, double ay, double bx, double by, double cx, double cy) {
+	double detleft = (ax - cx) * (by - cy);
+	double detright = (ay - cy) * (bx - cx);
+	double det = detleft - detright;
+	double errbound = ORIENT2D_BOUND * (std::abs(detleft) + std::abs(detright));
+	if (det > errbound || -det > errbound) {
+		return det;
+	}
+	return Orient2DExact(ax, ay, bx, by, cx, cy);
+}
+static double InCircleExact(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy) {
+	Expansion adx = Difference(ax, dx), ady = Difference(ay, dy);
+	Expansion bdx = Difference(bx, dx), bdy = Difference(by, dy);
+	Expansion cdx = Difference(cx, dx), cdy = Difference(cy, dy);
+	Expansion bc = Sum(Product(bdx, cdy), Negate(Product(bdy, cdx)));
+	Expansion ca = Sum(Product(cdx, ady), Negate(Product(cdy, adx)));
+	Expansion ab = Sum(Product(adx, bdy), Negate(Product(ady, bdx)));
+	Expansion alift = Sum(Product(adx, adx), Product(ady, ady));
+	Expansion blift = Sum(Product(bdx, bdx), Product(bdy, bdy));
+	Expansion clift = Sum(Product(cdx, cdx), Product(cdy, cdy));
+	return Estimate(Sum(Sum(Product(alift, bc), Product(blift, ca)), Product(clift, ab)));
+}
+double InCircle(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy) {
+	double adx = ax - dx, ady = ay - dy;
+	double bdx = bx - dx, bdy = by - dy;
+	double cdx = cx - dx, cdy = cy - dy;
+	double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+	double cdxady = cdx * ady, adxcdy = adx * cdy;
+	double adxbdy = adx * bdy, bdxady = bdx * ady;
+	double alift = adx * adx + ady * ady;
+	double blift = bdx * bdx + bdy * bdy;
+	double clift = cdx * cdx + cdy * cdy;
+	double det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) + clift * (adxbdy - bdxady);
+	double permanent = (std::abs(bdxcdy) + std::abs(cdxbdy)) * alift + (std::abs(cdxady) + std::abs(adxcdy)) * blift
+			+ (std::abs(adxbdy) + std::abs(bdxady)) * clift;
+	double errbound = INCIRCLE_BOUND * permanent;
+	if (det > errbound || -det > errbound) {
+		return det;
+	}
+	return InCircleExact(ax, ay, bx, by, cx, cy, dx, dy);
+}
+//Determinant of the 2x2 minor (a, b) as an expansion.
+static Expansion Minor(const Expansion& ax, const Expansion& ay, const Expansion& bx, const Expansion& by) {
+	return Sum(Product(ax, by), Negate(Product(bx, ay)));
+}
+static double Orient3DExact(double ax, double ay, double az, double bx, double by, double bz, double cx, double cy, double cz,
+		double dx, double dy, double dz) {
+	Expansion adx = Difference(ax, dx), ady = Difference(ay, dy), adz = Difference(az, dz);
+	Expansion bdx = Difference(bx, dx), bdy = Difference(by, dy), bdz = Difference(bz, dz);
+	Expansion cdx = Difference(cx, dx), cdy = Difference(cy, dy), cdz = Difference(cz, dz);
+	Expansion det = Product(adz, Minor(bdx, bdy, cdx, cdy));
+	det = Sum(det, Product(bdz, Minor(cdx, cdy, adx, ady)));
+	det = Sum(det, Product(cdz, Minor(adx, ady, bdx, bdy)));
+	return Estimate(det);
+}
+double Orient3D(double ax, double ay, double az, double bx, double by, double bz, double cx, double cy, double cz, double dx,
+		double dy, double dz) {
+	double adx = ax - dx, ady = ay - dy, adz = az - dz;
+	double bdx = bx - dx, bdy = by - dy, bdz = bz - dz;
+	double cdx = cx - dx, cdy = cy - dy, cdz = cz - dz;
+	double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+	double cdxady = cdx * ady, adxcdy = adx * cdy;
+	double adxbdy = adx * bdy, bdxady = bdx * ady;
+	double det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+	double permanent = (std::abs(bdxcdy) + std::abs(cdxbdy)) * std::abs(adz) + (std::abs(cdxady) + std::abs(adxcdy)) * std::abs(bdz)
+			+ (std::abs(adxbdy) + std::abs(bdxady)) * std::abs(cdz);
+	double errbound = ORIENT3D_BOUND * permanent;
+	if (det > errbound || -det > errbound) {
+		return det;
+	}
+	return Orient3DExact(ax, ay, az, bx, by, bz, cx, cy, cz, dx, dy, dz);
+}
+static double InSphereExact(double ax, double ay, double az, double bx, double by, double bz, double cx, double cy, double cz,
+		double dx, double dy, double dz, double ex, double ey, double ez) {
+	Expansion aex = Difference(ax, ex), aey = Difference(ay, ey), aez = Difference(az, ez);
+	Expansion bex = Difference(bx, ex), bey = Difference(by, ey), bez = Difference(bz, ez);
+	Expansion cex = Difference(cx, ex), cey = Difference(cy, ey), cez = Difference(cz, ez);
+	Expansion dex = Difference(dx, ex), dey = Difference(dy, ey), dez = Difference(dz, ez);
+	Expansion ab = Minor(aex, aey, bex, bey), bc = Minor(bex, bey, cex, cey);
+	Expansion cd = Minor(cex, cey, dex, dey), da = Minor(dex, dey, aex, aey);
+	Expansion ac = Minor(aex, aey, cex, cey), bd = Minor(bex, bey, dex, dey);
+	Expansion abc = Sum(Sum(Product(aez, bc), Negate(Product(bez, ac))), Product(cez, ab));
+	Expansion bcd = Sum(Sum(Product(bez, cd), Negate(Product(cez, bd))), Product(dez, bc));
+	Expansion cda = Sum(Sum(Product(cez, da), Product(dez, ac)), Product(aez, cd));
+	Expansion dab = Sum(Sum(Product(dez, ab), Product(aez, bd)), Product(bez, da));
+	Expansion alift = Sum(Sum(Product(aex, aex), Product(aey, aey)), Product(aez, aez));
+	Expansion blift = Sum(Sum(Product(bex, bex), Product(bey, bey)), Product(bez, bez));
+	Expansion clift = Sum(Sum(Product(cex, cex), Product(cey, cey)), Product(cez, cez));
+	Expansion dlift = Sum(Sum(Product(dex, dex), Product(dey, dey)), Product(dez, dez));
+	Expansion det = Sum(Product(dlift, abc), Negate(Product(clift, dab)));
+	det = Sum(det, Sum(Product(blift, cda), Negate(Product(alift, bcd))));
+	return Estimate(det);
+}
+double InSphere(double ax, double ay, double az, double bx, double by, double bz, double cx, double cy, double cz, double dx,
+		double dy, double dz, double ex, double ey, double ez) {
+	double aex = ax - ex, aey = ay - ey, aez = az - ez;
+	double bex = bx - ex, bey = by - ey, bez = bz - ez;
+	double cex = cx - ex, cey = cy - ey, cez = cz - ez;
+	double dex = dx - ex, dey = dy - ey, dez = dz - ez;
+	double aexbey = aex * bey, bexaey = bex * aey;
+	double bexcey = bex * cey, cexbey = cex * bey;
+	double cexdey = cex * dey, dexcey = dex * cey;
+	double dexaey = dex * aey, aexdey = aex * dey;
+	double aexcey = aex * cey, cexaey = cex * aey;
+	double bexdey = bex * dey, dexbey = dex * bey;
+	double ab = aexbey - bexaey, bc = bexcey - cexbey;
+	double cd = cexdey - dexcey, da = dexaey - aexdey;
+	double ac = aexcey - cexaey, bd = bexdey - dexbey;
+	double abc = aez * bc - bez * ac + cez * ab;
+	double bcd = bez * cd - cez * bd + dez * bc;
+	double cda = cez * da + dez * ac + aez * cd;
+	double dab = dez * ab + aez * bd + bez * da;
+	double alift = aex * aex + aey * aey + aez * aez;
+	double blift = bex * bex + bey * bey + bez * bez;
+	double clift = cex * cex + cey * cey + cez * cez;
+	double dlift = dex * dex + dey * dey + dez * dez;
+	double det = (dlift * abc - clift * dab) + (blift * cda - alift * bcd);
+	double aezplus = std::abs(aez), bezplus = std::abs(bez), cezplus = std::abs(cez), dezplus = std::abs(dez);
+	double abp = std::abs(aexbey) + std::abs(bexaey), bcp = std::abs(bexcey) + std::abs(cexbey);
+	double cdp = std::abs(cexdey) + std::abs(dexcey), dap = std::abs(dexaey) + std::abs(aexdey);
+	double acp = std::abs(aexcey) + std::abs(cexaey), bdp = std::abs(bexdey) + std::abs(dexbey);
+	double permanent = (cdp * bezplus + bdp * cezplus + bcp * dezplus) * alift + (dap * cezplus + acp * dezplus + cdp * aezplus) * blift
+			+ (abp * dezplus + bdp * aezplus + dap * bezplus) * clift + (bcp * aezplus + acp * bezplus + abp * cezplus) * dlift;
+	double errbound = INSPHERE_BOUND * permanent;
+	if (det > errbound || -det > errbound) {
+		return det;
+	}
+	return InSphereExact(ax, ay, az, bx, by, bz, cx, cy, cz, dx, dy, dz, ex, ey, ez);
+}
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef INCLUDE_ALLOYPREDICATES_H_
+#define INCLUDE_ALLOYPREDICATES_H_
+#include "math/AlloyVecMath.h"
+namespace aly {
+/*
+ * Geometric predicates that always return the correct sign. Each one is
+ * evaluated in double precision with a forward error bound and only falls back
+ * to exact expansion arithmetic when the result is too close to zero to trust,
+ * so the common case costs about the same as the naive formula.
+ */
+//Positive if a, b, c are in counterclockwise order, negative if clockwise, zero if collinear.
+double Orient2D(double ax, double ay, double bx, double by, double cx, double cy);
+//Positive if d lies inside the circle through counterclockwise a, b, c, negative if outside, zero if cocircular.
+double InCircle(double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy);
+//Positive if d lies below the plane through a, b, c, where below is the side from which a, b, c appear clockwise.
+double Orient3D(double ax, double ay, double az, double bx, double by, double bz, double cx, double cy, double cz, double dx,
+		double dy, double dz);
+//Positive if e lies inside the sphere through a, b, c, d, which must have Orient3D(a, b, c, d) > 0.
+double InSphere(double ax, double ay, double az, double bx, double by, double bz, double cx, double cy, double cz, double dx,
+		double dy, double dz, double ex, double ey, double ez);
+inline double Orient2D(const float2& a, const float2& b, const float2& c) {
+	return Orient2D(a.x, a.y, b.x, b.y, c.x, c.y);
+}
+inline double Orient2D(const double2& a, const double2& b, const double2& c) {
+	return Orient2D(a.x, a.y, b.x, b.y, c.x, c.y);
+}
+inline double InCircle(const float2& a, const float2& b, const float2& c, const float2& d) {
+	return InCircle(a.x, a.y, b.x, b.y, c.x, c.y, d.x, d.y);
+}
+inline double InCircle(const double2& a, const double2& b, const double2& c, const double2& d) {
+	return InCircle(a.x, a.y, b.x, b.y, c.x, c.y, d.x, d.y);
+}
+inline double Orient3D(const float3& a, const float3& b, const float3& c, const float3& d) {
+	return Orient3D(a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z, d.x, d.y, d.z);
+}
+inline double Orient3D(const double3& a, const double3& b, const double3& c, const double3& d) {
+	return Orient3D(a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z, d.x, d.y, d.z);
+}
+inline double InSphere(const float3& a, const float3& b, const float3& c, const float3& d, const float3& e) {
+	return InSphere(a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z, d.x, d.y, d.z, e.x, e.y, e.z);
+}
+inline double InSphere(const double3& a, const double3& b, const double3& c, const double3& d, const double3& e) {
+	return InSphere(a.x, a.y, a.z, b.x, b.y, b.z, c.x, c.y, c.z, d.x, d.y, d.z, e.x, e.y, e.z);
+}
+}
+#endif
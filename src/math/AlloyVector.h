@@ -35,6 +35,38 @@
 
 namespace aly {
 bool SANITY_CHECK_LINALG();
+bool SANITY_CHECK_VECTOR_SERIALIZATION();
+/*
+ * Binary archives write arrays of arithmetic vecs as one size tag and one raw
+ * block. Bytes match the element by element encoding, so old files still load,
+ * and PortableBinaryArchive swaps each scalar when endianness differs.
+ */
+template<class Archive, class T, int C> inline typename std::enable_if<
+		cereal::traits::is_output_serializable<cereal::BinaryData<T>, Archive>::value && std::is_arithmetic<T>::value>::type SaveVecData(
+		Archive& archive, const std::string&, const std::vector<vec<T, C>>& data) {
+	static_assert(sizeof(vec<T, C>) == C * sizeof(T), "vec must be tightly packed.");
+	archive(cereal::make_size_tag(static_cast<cereal::size_type>(data.size())));
+	archive(cereal::binary_data(reinterpret_cast<const T*>(data.data()), data.size() * sizeof(vec<T, C>)));
+}
+template<class Archive, class T, int C> inline typename std::enable_if<
+		!(cereal::traits::is_output_serializable<cereal::BinaryData<T>, Archive>::value && std::is_arithmetic<T>::value)>::type SaveVecData(
+		Archive& archive, const std::string& name, const std::vector<vec<T, C>>& data) {
+	archive(cereal::make_nvp(name, data));
+}
+template<class Archive, class T, int C> inline typename std::enable_if<
+		cereal::traits::is_input_serializable<cereal::BinaryData<T>, Archive>::value && std::is_arithmetic<T>::value>::type LoadVecData(
+		Archive& archive, const std::string&, std::vector<vec<T, C>>& data) {
+	static_assert(sizeof(vec<T, C>) == C * sizeof(T), "vec must be tightly packed.");
+	cereal::size_type sz = 0;
+	archive(cereal::make_size_tag(sz));
+	data.resize(static_cast<size_t>(sz));
+	archive(cereal::binary_data(reinterpret_cast<T*>(data.data()), data.size() * sizeof(vec<T, C>)));
+}
+template<class Archive, class T, int C> inline typename std::enable_if<
+		!(cereal::traits::is_input_serializable<cereal::BinaryData<T>, Archive>::value && std::is_arithmetic<T>::value)>::type LoadVecData(
+		Archive& archive, const std::string& name, std::vector<vec<T, C>>& data) {
+	archive(cereal::make_nvp(name, data));
+}
 
 template<class T, int C> struct Vector {
 public:
@@ -65,12 +97,12 @@ public:
 	}
 	template<class Archive>
 	inline void save(Archive & archive) const {
-		archive(cereal::make_nvp(MakeString() << "vector" << C, data));
+		SaveVecData(archive, MakeString() << "vector" << C, data);
 	}
 
 	template<class Archive>
 	inline void load(Archive & archive) {
-		archive(cereal::make_nvp(MakeString() << "vector" << C, data));
+		LoadVecData(archive, MakeString() << "vector" << C, data);
 	}
 
 	inline void set(const T& val) {
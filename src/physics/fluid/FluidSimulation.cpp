@@ -53,32 +53,29 @@ FluidSimulation::FluidSimulation(const int2& dims, float voxelSize,
 }
 void FluidSimulation::computeParticleDensity(float maxDensity) {
 	float scale = 1.0f / fluidVoxelSize;
+	const float kernelWidth = 4.0f * fluidParticleDiameter * fluidVoxelSize;
+	const std::vector<float2>& locations = particles.locations;
+	const std::vector<ObjectType>& types = particles.types;
+	const std::vector<float>& masses = particles.masses;
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		FluidParticlePtr& p = particles[n];
-		if (p->mObjectType == ObjectType::WALL) {
-			p->mDensity = 1.0;
+		if (types[n] == ObjectType::WALL) {
+			particles.densities[n] = 1.0;
 			continue;
 		}
-		float2& pt = p->mLocation;
-		int i = clamp((int) (scale * p->mLocation[0]), 0, gridSize.x - 1);
-		int j = clamp((int) (scale * p->mLocation[1]), 0, gridSize.y - 1);
-		//Search in small region
-		std::vector<FluidParticle*> neighbors =
-				particleLocator->getNeigboringCellParticles(i, j, 1, 1);
+		const float2 pt = locations[n];
+		int i = clamp((int) (scale * pt[0]), 0, gridSize.x - 1);
+		int j = clamp((int) (scale * pt[1]), 0, gridSize.y - 1);
 		float wsum = 0.0;
-		//Density a function of how close particles are to their neighbors.
-		for (FluidParticle* np : neighbors) {
-			if (np->mObjectType == ObjectType::WALL)
-				continue;
-			float d2 = distanceSquared(np->mLocation, pt);
-			float w = np->mMass
-					* smoothKernel(d2,
-							4.0f * fluidParticleDiameter * fluidVoxelSize);
-			wsum += w;
-		}
+		//Density a function of how close particles are to their neighbors. Search in small region.
+		particleLocator->forEachParticle(i - 1, j - 1, i + 1, j + 1, [&](int m) {
+			if (types[m] == ObjectType::WALL)
+				return;
+			float d2 = distanceSquared(locations[m], pt);
+			wsum += masses[m] * smoothKernel(d2, kernelWidth);
+		});
 		//Estimate density in region using current particle configuration.
-		p->mDensity = wsum / maxDensity;
+		particles.densities[n] = wsum / maxDensity;
 	}
 }
 void FluidSimulation::placeWalls() {
@@ -167,13 +164,13 @@ void FluidSimulation::addSimulationObject(SimulationObject* obj) {
 
 	}
 }
-void FluidSimulation::repositionParticles(std::vector<int>& indices) {
-	if (indices.empty())
+void FluidSimulation::repositionParticles(int count) {
+	if (count == 0)
 		return;
 	// First Search for Deep Water
 	std::vector<int2> waters;
-	while (waters.size() < indices.size()) {
-#pragma omp parallel
+	while ((int) waters.size() < count) {
+		size_t lastSize = waters.size();
 		for (int j = 0; j < labelImage.height; j++) {
 			for (int i = 0; i < labelImage.width; i++) {
 				if (i > 0
@@ -196,31 +193,40 @@ void FluidSimulation::repositionParticles(std::vector<int>& indices) {
 					continue;
 				int2 aPos(i, j);
 				waters.push_back(aPos);
-				if (waters.size() >= indices.size()) {
+				if ((int) waters.size() >= count) {
 					//Water is larger than particles! Set to max to break out of triple loop.
 					i = gridSize.x;
 					j = gridSize.y;
 				}
 			}
 		}
+		//No deep water at all.
+		if (waters.size() == lastSize)
+			break;
 	}
 	if (waters.empty())
 		return;
 // Shuffle
 	shuffleCoordinates(waters);
-	for (int n = 0; n < indices.size(); n++) {
-		FluidParticlePtr& p = particles[indices[n]];
-		p->mLocation[0] = fluidVoxelSize
-				* (waters[n][0] + 0.25 + 0.5 * (rand() % 101) / 100);
-		p->mLocation[1] = fluidVoxelSize
-				* (waters[n][1] + 0.25 + 0.5 * (rand() % 101) / 100);
+	int w = 0;
+	for (int n = 0; n < (int) particles.size(); n++) {
+		if (particles.removeIndicators[n]) {
+			const int2& water = waters[(w++) % waters.size()];
+			particles.locations[n][0] = fluidVoxelSize
+					* (water[0] + 0.25 + 0.5 * (rand() % 101) / 100);
+			particles.locations[n][1] = fluidVoxelSize
+					* (water[1] + 0.25 + 0.5 * (rand() % 101) / 100);
+		}
 	}
+	//Reorders particles, the remove indicators move with them.
 	particleLocator->update(particles);
-	for (int n = 0; n < indices.size(); n++) {
-		FluidParticlePtr &p = particles[indices[n]];
-		float2 u(0.0f);
-		resampleParticles(p->mLocation, u, fluidVoxelSize);
-		p->mVelocity = u;
+	for (int n = 0; n < (int) particles.size(); n++) {
+		if (particles.removeIndicators[n]) {
+			particles.removeIndicators[n] = false;
+			float2 u(0.0f);
+			resampleParticles(particles.locations[n], u, fluidVoxelSize);
+			particles.velocities[n] = u;
+		}
 	}
 }
 void FluidSimulation::addParticle(float2 pt, float2 center, ObjectType type) {
@@ -246,7 +252,6 @@ void FluidSimulation::addParticle(float2 pt, float2 center, ObjectType type) {
 		}
 	}
 	if (inside_obj) {
-		FluidParticle *p = new FluidParticle;
 		//float2 axis(((rand() % MAX_INT) / (MAX_INT - 1.0)) * 2.0f - 1.0f,((rand() % MAX_INT) / (MAX_INT - 1.0)) * 2.0f - 1.0f);
 		//axis=normalize(axis);
 		float ang = MAX_ANGLE * (rand() % MAX_INT) / (MAX_INT - 1.0);
@@ -255,17 +260,11 @@ void FluidSimulation::addParticle(float2 pt, float2 center, ObjectType type) {
 		R(1, 0) = std::sin(ang);
 		R(0, 1) = -std::sin(ang);
 		R(1, 1) = std::cos(ang);
+		float2 location = pt;
 		if (inside_obj->mType == ObjectType::FLUID) {
-			p->mLocation = center + R * (pt - center);
-		} else {
-			p->mLocation = pt;
+			location = center + R * (pt - center);
 		}
-		p->mVelocity = float2(0.0);
-		p->mNormal = float2(0.0);
-		p->mDensity = 10.0;
-		p->mObjectType = inside_obj->mType;
-		p->mMass = 1.0;
-		particles.push_back(FluidParticlePtr(p));
+		particles.add(location, float2(0.0f), inside_obj->mType, 1.0f, 10.0f);
 	}
 }
 bool FluidSimulation::init() {
@@ -279,18 +278,14 @@ bool FluidSimulation::init() {
 	float h = fluidParticleDiameter * fluidVoxelSize;
 	for (int j = 0; j < 10; j++) {
 		for (int i = 0; i < 10; i++) {
-			FluidParticle *p = new FluidParticle;
-			p->mLocation = float2((i + 0.5) * h, (j + 0.5) * h);
-			p->mObjectType = ObjectType::FLUID;
-			p->mMass = 1.0;
-			particles.push_back(std::unique_ptr<FluidParticle>(p));
+			particles.add(float2((i + 0.5) * h, (j + 0.5) * h), float2(0.0f), ObjectType::FLUID, 1.0f, 0.0f);
 		}
 	}
 	particleLocator->update(particles);
 	computeParticleDensity(1.0f);
 	maxDensity = 0.0;
-	for (FluidParticlePtr& p : particles) {
-		maxDensity = max(maxDensity, p->mDensity);
+	for (float density : particles.densities) {
+		maxDensity = max(maxDensity, density);
 	}
 	particles.clear();
 	float2 center;
@@ -327,22 +322,18 @@ bool FluidSimulation::init() {
 // Remove Particles That Stuck On Wal Cells
 	float scale = 1.0f / fluidVoxelSize;
 	int eraseCount=0;
-	for (std::vector<FluidParticlePtr>::iterator iter = particles.begin();
-			iter != particles.end();) {
-		FluidParticlePtr& p = *iter;
-		if (p->mObjectType == ObjectType::WALL) {
-			iter++;
+	for (int n = 0; n < (int) particles.size(); n++) {
+		if (particles.types[n] == ObjectType::WALL) {
 			continue;
 		}
-		int i = clamp((int) (scale * p->mLocation[0]), 0, gridSize.x - 1);
-		int j = clamp((int) (scale * p->mLocation[1]), 0, gridSize.y - 1);
+		int i = clamp((int) (scale * particles.locations[n][0]), 0, gridSize.x - 1);
+		int j = clamp((int) (scale * particles.locations[n][1]), 0, gridSize.y - 1);
 		if (labelImage(i, j).x == static_cast<char>(ObjectType::WALL)) {
-			iter = particles.erase(iter);
+			particles.removeIndicators[n] = true;
 			eraseCount++;
-		} else {
-			iter++;
 		}
 	}
+	particles.eraseMarked();
 	computeWallNormals();
 	updateParticleVolume();
 	computeParticleDensity(maxDensity);
@@ -367,19 +358,10 @@ void FluidSimulation::pourWater(int limit, float maxDensity) {
 		for (float z = w + w / 2.0; z < 1.0 - w / 2.0; z += w) {
 			if (hypot(x - mPourPosition[0], z - mPourPosition[1])
 					< mPourRadius) {
-				FluidParticle *p = new FluidParticle;
-				p->mLocation = float2(x,
-						1.0 - wallThickness
-								- 2.5 * fluidParticleDiameter
-										* fluidVoxelSize);
-				p->mVelocity = float2(0.0,
-						-0.5 * fluidVoxelSize * fluidParticleDiameter
-								/ simulationTimeStep);
-				p->mNormal = float2(0.0);
-				p->mObjectType = ObjectType::FLUID;
-				p->mDensity = maxDensity;
-				p->mMass = 1.0;
-				particles.push_back(FluidParticlePtr(p));
+				particles.add(
+						float2(x, 1.0 - wallThickness - 2.5 * fluidParticleDiameter * fluidVoxelSize),
+						float2(0.0, -0.5 * fluidVoxelSize * fluidParticleDiameter / simulationTimeStep),
+						ObjectType::FLUID, 1.0f, maxDensity);
 				cnt++;
 			}
 		}
@@ -388,12 +370,10 @@ void FluidSimulation::pourWater(int limit, float maxDensity) {
 void FluidSimulation::addExternalForce() {
 	float velocity = simulationTimeStep * GRAVITY;
 //Add gravity acceleration to all particles
-	int count = 0;
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		if (particles[n]->mObjectType == ObjectType::FLUID) {
-			particles[n]->mVelocity[1] += velocity;
-			count++;
+		if (particles.types[n] == ObjectType::FLUID) {
+			particles.velocities[n][1] += velocity;
 		}
 	}
 }
@@ -408,10 +388,9 @@ void FluidSimulation::advectParticles() {
 // Advect Particle Through Grid
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		FluidParticlePtr& p = particles[n];
-		if (p->mObjectType == ObjectType::FLUID) {
-			p->mLocation += ((float) simulationTimeStep)
-					* interpolate(contour.fluidParticles.velocityImage, p->mLocation);
+		if (particles.types[n] == ObjectType::FLUID) {
+			particles.locations[n] += ((float) simulationTimeStep)
+					* interpolate(contour.fluidParticles.velocityImage, particles.locations[n]);
 		}
 	}
 //Update localization
@@ -421,76 +400,71 @@ void FluidSimulation::advectParticles() {
 	float scale = 1.0f / fluidVoxelSize;
 	float mx = fluidVoxelSize * gridSize.x;
 	float my = fluidVoxelSize * gridSize.y;
+	const std::vector<ObjectType>& types = particles.types;
+	const std::vector<float2>& normals = particles.normals;
+	std::vector<float2>& locations = particles.locations;
 //Correct particle locations
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		FluidParticlePtr& p = particles[n];
-		if (p->mObjectType == ObjectType::FLUID) {
-			p->mLocation[0] = clamp(p->mLocation[0], r, mx - r);
-			p->mLocation[1] = clamp(p->mLocation[1], r, my - r);
-			int i = clamp((int) (p->mLocation[0] * scale), 0, gridSize.x - 1);
-			int j = clamp((int) (p->mLocation[1] * scale), 0, gridSize.y - 1);
-			std::vector<FluidParticle*> neighbors =
-					particleLocator->getNeigboringCellParticles(i, j, 1, 1);
-			for (int n = 0; n < neighbors.size(); n++) {
-				FluidParticle *np = neighbors[n];
-				if (np->mObjectType == ObjectType::WALL) {
-					float dist = distance(p->mLocation, np->mLocation);
+		if (types[n] == ObjectType::FLUID) {
+			float2& pt = locations[n];
+			float2& vel = particles.velocities[n];
+			pt[0] = clamp(pt[0], r, mx - r);
+			pt[1] = clamp(pt[1], r, my - r);
+			int i = clamp((int) (pt[0] * scale), 0, gridSize.x - 1);
+			int j = clamp((int) (pt[1] * scale), 0, gridSize.y - 1);
+			particleLocator->forEachParticle(i - 1, j - 1, i + 1, j + 1, [&](int m) {
+				if (types[m] == ObjectType::WALL) {
+					float dist = distance(pt, locations[m]);
 					if (dist < re) {
-						float2 normal = np->mNormal;
-						if (normal[0] == 0.0 && normal[1] == 0.0
-								&& normal[2] == 0.0 && dist) {
-							normal = (p->mLocation - np->mLocation) / dist;
+						float2 normal = normals[m];
+						if (normal[0] == 0.0 && normal[1] == 0.0 && dist) {
+							normal = (pt - locations[m]) / dist;
 						}
-						p->mLocation += (re - dist) * normal;
-						float dotprod = dot(p->mVelocity, normal);
-						p->mVelocity -= dotprod * normal;
+						pt += (re - dist) * normal;
+						float dotprod = dot(vel, normal);
+						vel -= dotprod * normal;
 					}
 				}
-			}
+			});
 		}
 	}
 
 // Remove Particles That Stuck On The Up-Down Wall Cells...
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		FluidParticlePtr& p = particles[n];
-		p->mRemoveIndicator = false;
+		particles.removeIndicators[n] = false;
 		// Focus on Only Fluid Particle
-		if (p->mObjectType == ObjectType::FLUID) {
-			int i = clamp((int) (p->mLocation[0] * scale), 0, gridSize.x - 1);
-			int j = clamp((int) (p->mLocation[1] * scale), 0, gridSize.y - 1);
+		if (types[n] == ObjectType::FLUID) {
+			const float2& pt = locations[n];
+			int i = clamp((int) (pt[0] * scale), 0, gridSize.x - 1);
+			int j = clamp((int) (pt[1] * scale), 0, gridSize.y - 1);
 			// If Stuck On Wall Cells Just Reposition
 			if (labelImage(i, j).x == static_cast<char>(ObjectType::WALL)) {
-				p->mRemoveIndicator = true;
+				particles.removeIndicators[n] = true;
 			}
-			i = clamp((int) (p->mLocation[0] * scale), 2, gridSize.x - 3);
-			j = clamp((int) (p->mLocation[1] * scale), 2, gridSize.y - 3);
-			if (p->mDensity < 0.04
+			i = clamp((int) (pt[0] * scale), 2, gridSize.x - 3);
+			j = clamp((int) (pt[1] * scale), 2, gridSize.y - 3);
+			if (particles.densities[n] < 0.04
 					&& (labelImage(i, max(0, j - 1)).x
 							== static_cast<char>(ObjectType::WALL)
 							|| labelImage(i, min(gridSize.y - 1, j + 1)).x
 									== static_cast<char>(ObjectType::WALL))) {
 				// Put Into Reposition List
-				p->mRemoveIndicator = true;
+				particles.removeIndicators[n] = true;
 			}
 		}
 
 	}
 // Reposition If Necessary
-	std::vector<int> reposition_indices;
-	size_t n = 0;
-	for (FluidParticlePtr& p : particles) {
-		if (p->mRemoveIndicator) {
-			p->mRemoveIndicator = false;
-			reposition_indices.push_back(n);
-		}
-		n++;
+	int count = 0;
+	for (char flag : particles.removeIndicators) {
+		if (flag)
+			count++;
 	}
-
 // Store Stuck Particle Number
-	stuckParticleCount = reposition_indices.size();
-	repositionParticles(reposition_indices);
+	stuckParticleCount = count;
+	repositionParticles(count);
 }
 void FluidSimulation::cleanup() {
 	if (cache.get() != nullptr)
@@ -712,11 +686,11 @@ void FluidSimulation::solvePicFlip() {
 	extrapolateVelocity();
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		FluidParticlePtr& p = particles[n];
-		float2 currentVelocity = interpolate(contour.fluidParticles.velocityImage, p->mLocation);
-		float2 velocity = p->mVelocity + currentVelocity
-				- interpolate(lastVelocityImage, p->mLocation);
-		p->mVelocity = (1.0f - picFlipBlendWeight) * currentVelocity
+		const float2& pt = particles.locations[n];
+		float2 currentVelocity = interpolate(contour.fluidParticles.velocityImage, pt);
+		float2 velocity = particles.velocities[n] + currentVelocity
+				- interpolate(lastVelocityImage, pt);
+		particles.velocities[n] = (1.0f - picFlipBlendWeight) * currentVelocity
 				+ picFlipBlendWeight * velocity;
 	}
 }
@@ -726,11 +700,10 @@ void FluidSimulation::updateParticleVolume() {
 	contour.fluidParticles.velocities.clear();
 	contour.fluidParticles.radius = 0.5f * fluidParticleDiameter;
 	for (int n = 0; n < (int) particles.size(); n++) {
-		FluidParticle* p = particles[n].get();
-		if (p->mObjectType == ObjectType::FLUID) {
-			float2 l = p->mLocation / voxelSize;
+		if (particles.types[n] == ObjectType::FLUID) {
+			float2 l = particles.locations[n] / voxelSize;
 			contour.fluidParticles.particles.push_back(l);
-			contour.fluidParticles.velocities.push_back(p->mVelocity);
+			contour.fluidParticles.velocities.push_back(particles.velocities[n]);
 		}
 	}
 	/*
@@ -815,33 +788,37 @@ void FluidSimulation::mapParticlesToGrid() {
 // Compute Mapping
 	int2 dims(contour.fluidParticles.velocityImage.width, contour.fluidParticles.velocityImage.height);
 	float scale = 1.0f / fluidVoxelSize;
+	const std::vector<float2>& locations = particles.locations;
+	const std::vector<float2>& velocities = particles.velocities;
+	const std::vector<ObjectType>& types = particles.types;
+	const std::vector<float>& masses = particles.masses;
+	/*
+	 * Each face gathers from the particles in nearby cells, so faces are
+	 * written by exactly one thread. Particles are sorted by cell, which keeps
+	 * every row of the stencil a contiguous range.
+	 */
 #pragma omp parallel for
 	for (int j = 0; j < contour.fluidParticles.velocityImage.height; j++) {
 		for (int i = 0; i < contour.fluidParticles.velocityImage.width; i++) {
-			// Variales for Particle Sorter
-			std::vector<FluidParticle*> neighbors;
 			// Map X Grids
 			if (j < dims[1]) {
 				float2 px(i, j + 0.5);
 				float sumw = 0.0;
 				float sumx = 0.0;
-				neighbors = particleLocator->getNeigboringWallParticles(i, j,
-						1, 2);
-				for (int n = 0; n < neighbors.size(); n++) {
-					FluidParticle *p = neighbors[n];
-					if (p->mObjectType == ObjectType::FLUID) {
-						float x = clamp(scale * p->mLocation[0], 0.0f,
+				particleLocator->forEachParticle(i - 1, j - 2, i, j + 1, [&](int n) {
+					if (types[n] == ObjectType::FLUID) {
+						float x = clamp(scale * locations[n][0], 0.0f,
 								(float) dims[0]);
-						float y = clamp(scale * p->mLocation[1], 0.0f,
+						float y = clamp(scale * locations[n][1], 0.0f,
 								(float) dims[1]);
 						float2 pos(x, y);
-						float w = p->mMass
+						float w = masses[n]
 								* sharpKernel(distanceSquared(pos, px),
 										RELAXATION_KERNEL_WIDTH);
-						sumx += w * p->mVelocity[0];
+						sumx += w * velocities[n][0];
 						sumw += w;
 					}
-				}
+				});
 				contour.fluidParticles.velocityImage(i, j, 0) = sumw ? sumx / sumw : 0.0;
 			}
 			// Map Y Grids
@@ -849,25 +826,20 @@ void FluidSimulation::mapParticlesToGrid() {
 				float2 py(i + 0.5, j);
 				float sumw = 0.0;
 				float sumy = 0.0;
-				neighbors = particleLocator->getNeigboringWallParticles(i, j,
-						2, 1);
-				for (int n = 0; n < neighbors.size(); n++) {
-					FluidParticle *p = neighbors[n];
-					if (p->mObjectType == ObjectType::FLUID) {
-						float x = clamp(scale * p->mLocation[0], 0.0f,
+				particleLocator->forEachParticle(i - 2, j - 1, i + 1, j, [&](int n) {
+					if (types[n] == ObjectType::FLUID) {
+						float x = clamp(scale * locations[n][0], 0.0f,
 								(float) dims[0]);
-						float y = clamp(scale * p->mLocation[1], 0.0f,
+						float y = clamp(scale * locations[n][1], 0.0f,
 								(float) dims[1]);
-						float z = clamp(scale * p->mLocation[2], 0.0f,
-								(float) dims[2]);
 						float2 pos(x, y);
-						float w = p->mMass
+						float w = masses[n]
 								* sharpKernel(distanceSquared(pos, py),
 										RELAXATION_KERNEL_WIDTH);
-						sumy += w * p->mVelocity[1];
+						sumy += w * velocities[n][1];
 						sumw += w;
 					}
-				}
+				});
 				contour.fluidParticles.velocityImage(i, j, 1) = sumw ? sumy / sumw : 0.0;
 			}
 		}
@@ -902,8 +874,6 @@ bool FluidSimulation::updateContour() {
 	return false;
 }
 void FluidSimulation::resampleParticles(float2& p, float2& u, float re) {
-// Variables for Neighboring Particles
-	std::vector<FluidParticle*> neighbors;
 	int2 cell_size = particleLocator->getGridSize();
 	float wsum = 0.0;
 	float2 save(u);
@@ -912,15 +882,14 @@ void FluidSimulation::resampleParticles(float2& p, float2& u, float re) {
 	int i = clamp((int) (p[0] * scale), 0, cell_size[0] - 1);
 	int j = clamp((int) (p[1] * scale), 0, cell_size[1] - 1);
 // Gather Neighboring Particles
-	neighbors = particleLocator->getNeigboringCellParticles(i, j, 1, 1);
-	for (FluidParticle *np : neighbors) {
-		if (np->mObjectType == ObjectType::FLUID) {
-			float dist2 = distanceSquared(p, np->mLocation);
-			float w = np->mMass * sharpKernel(dist2, re);
-			u += w * np->mVelocity;
+	particleLocator->forEachParticle(i - 1, j - 1, i + 1, j + 1, [&](int n) {
+		if (particles.types[n] == ObjectType::FLUID) {
+			float dist2 = distanceSquared(p, particles.locations[n]);
+			float w = particles.masses[n] * sharpKernel(dist2, re);
+			u += w * particles.velocities[n];
 			wsum += w;
 		}
-	}
+	});
 	if (wsum) {
 		u /= wsum;
 	} else {
@@ -928,98 +897,93 @@ void FluidSimulation::resampleParticles(float2& p, float2& u, float re) {
 	}
 }
 
-void FluidSimulation::correctParticles(std::vector<FluidParticlePtr>& particles,
+void FluidSimulation::correctParticles(FluidParticleArray& particles,
 		float dt, float re) {
 // Variables for Neighboring Particles
 	int2 cell_size = particleLocator->getGridSize();
 	particleLocator->update(particles);
 	float scale = 1.0f / particleLocator->getVoxelSize();
+	const std::vector<float2>& locations = particles.locations;
+	const std::vector<ObjectType>& types = particles.types;
+	particles.tmpLocations.resize(particles.size());
+	particles.tmpVelocities.resize(particles.size());
 // Compute Pseudo Moved Point
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		if (particles[n]->mObjectType == ObjectType::FLUID) {
-			FluidParticle *p = particles[n].get();
+		if (types[n] == ObjectType::FLUID) {
+			const float2 pt = locations[n];
 			float2 spring(0.0f);
-			int i = clamp((int) (p->mLocation[0] * scale), 0, cell_size[0] - 1);
-			int j = clamp((int) (p->mLocation[1] * scale), 0, cell_size[1] - 1);
-			std::vector<FluidParticle*> neighbors =
-					particleLocator->getNeigboringCellParticles(i, j, 1, 1);
-			for (int n = 0; n < neighbors.size(); n++) {
-				FluidParticle *np = neighbors[n];
-				if (p != np) {
-					float dist = distance(p->mLocation, np->mLocation);
-					float w = SPRING_STIFFNESS * np->mMass
+			int i = clamp((int) (pt[0] * scale), 0, cell_size[0] - 1);
+			int j = clamp((int) (pt[1] * scale), 0, cell_size[1] - 1);
+			particleLocator->forEachParticle(i - 1, j - 1, i + 1, j + 1, [&](int m) {
+				if (n != m) {
+					float dist = distance(pt, locations[m]);
+					float w = SPRING_STIFFNESS * particles.masses[m]
 							* smoothKernel(dist * dist, re);
 					if (dist > 0.1 * re) {
-						spring += w * (p->mLocation - np->mLocation) / dist
+						spring += w * (pt - locations[m]) / dist
 								* re;
 					} else {
-						if (np->mObjectType == ObjectType::FLUID) {
+						if (types[m] == ObjectType::FLUID) {
 							spring += 0.01f * re / dt * (rand() % 101) / 100.0f;
 						} else {
-							spring += 0.05f * re / dt * np->mNormal;
+							spring += 0.05f * re / dt * particles.normals[m];
 						}
 					}
 				}
-			}
-			p->mTmp[0] = p->mLocation + dt * spring;
+			});
+			particles.tmpLocations[n] = pt + dt * spring;
 		}
 	}
 // Resample New Velocity
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		if (particles[n]->mObjectType == ObjectType::FLUID) {
-			FluidParticle *p = particles[n].get();
-			p->mTmp[1] = p->mVelocity;
-			resampleParticles(p->mTmp[0], p->mTmp[1], re);
+		if (types[n] == ObjectType::FLUID) {
+			particles.tmpVelocities[n] = particles.velocities[n];
+			resampleParticles(particles.tmpLocations[n], particles.tmpVelocities[n], re);
 		}
 	}
 
 // Update
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		if (particles[n]->mObjectType == ObjectType::FLUID) {
-			FluidParticle *p = particles[n].get();
-			p->mLocation = p->mTmp[0];
-			p->mVelocity = p->mTmp[1];
+		if (types[n] == ObjectType::FLUID) {
+			particles.locations[n] = particles.tmpLocations[n];
+			particles.velocities[n] = particles.tmpVelocities[n];
 		}
 	}
 }
 void FluidSimulation::mapGridToParticles() {
 #pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		FluidParticlePtr& p = particles[n];
-		p->mVelocity = interpolate(contour.fluidParticles.velocityImage, p->mLocation);
+		particles.velocities[n] = interpolate(contour.fluidParticles.velocityImage, particles.locations[n]);
 	}
 }
-double FluidSimulation::implicit_func(std::vector<FluidParticle*>& neighbors,
-		float2& p, float radius, float voxelSize) {
-	double phi = 8.0f * radius;
+double FluidSimulation::implicit_func(float2& p, float radius) {
+	int2 cell_size = particleLocator->getGridSize();
 	float scale = 1.0f / particleLocator->getVoxelSize();
-	for (int m = 0; m < neighbors.size(); m++) {
-		FluidParticle &np = *neighbors[m];
-		double d = distance(np.mLocation, p) * scale;
-		if (np.mObjectType == ObjectType::WALL) {
+	int i = clamp((int) (p[0] * scale), 0, cell_size[0] - 1);
+	int j = clamp((int) (p[1] * scale), 0, cell_size[1] - 1);
+	double phi = 8.0f * radius;
+	bool nearWall = false;
+	particleLocator->forEachParticle(i - 2, j - 2, i + 2, j + 2, [&](int n) {
+		if (nearWall)
+			return;
+		double d = distance(particles.locations[n], p) * scale;
+		if (particles.types[n] == ObjectType::WALL) {
 			if (d < radius)
-				return 4.5 * radius;
-			continue;
+				nearWall = true;
+			return;
 		}
 		if (d < phi) {
 			phi = d;
 		}
-	}
-//std::cout<<"IMPLICIT "<<phi<<" "<<density<<" "<<voxelSize<<std::endl;
+	});
+	if (nearWall)
+		return 4.5 * radius;
 	return phi - radius;
 }
-double FluidSimulation::implicit_func(float2& p, float radius) {
-	int2 cell_size = particleLocator->getGridSize();
-	float scale = 1.0f / particleLocator->getVoxelSize();
-	std::vector<FluidParticle *> neighbors =
-			particleLocator->getNeigboringCellParticles(
-					clamp((int) (p[0] * scale), 0, cell_size[0] - 1),
-					clamp((int) (p[1] * scale), 0, cell_size[1] - 1), 2, 2);
-	return implicit_func(neighbors, p, radius, particleLocator->getVoxelSize());
-}
+
 void FluidSimulation::computeWallNormals() {
 // mParticleLocator Particles
 	particleLocator->update(particles);
@@ -1027,42 +991,40 @@ void FluidSimulation::computeWallNormals() {
 	float scale = 1.0f / fluidVoxelSize;
 	float mx = fluidVoxelSize * gridSize.x;
 	float my = fluidVoxelSize * gridSize.y;
+	const std::vector<float2>& locations = particles.locations;
 //#pragma omp parallel for
 	for (int n = 0; n < (int) particles.size(); n++) {
-		FluidParticlePtr& p = particles[n];
-		int i = clamp((int) (p->mLocation[0] * scale), 0, gridSize.x - 1);
-		int j = clamp((int) (p->mLocation[1] * scale), 0, gridSize.y - 1);
+		const float2& pt = locations[n];
+		float2& normal = particles.normals[n];
+		int i = clamp((int) (pt[0] * scale), 0, gridSize.x - 1);
+		int j = clamp((int) (pt[1] * scale), 0, gridSize.y - 1);
 		wallNormalImage(i, j) = float2(0.0f);
-		p->mNormal = float2(0.0);
-		if (p->mObjectType == ObjectType::WALL) {
-			if (p->mLocation[0] <= (mx + 0.1) * wallThickness) {
-				p->mNormal[0] = 1.0;
+		normal = float2(0.0);
+		if (particles.types[n] == ObjectType::WALL) {
+			if (pt[0] <= (mx + 0.1) * wallThickness) {
+				normal[0] = 1.0;
 			}
-			if (p->mLocation[0] >= mx - (mx - 0.1) * wallThickness) {
-				p->mNormal[0] = -1.0;
+			if (pt[0] >= mx - (mx - 0.1) * wallThickness) {
+				normal[0] = -1.0;
 			}
-			if (p->mLocation[1] <= (my + 0.1) * wallThickness) {
-				p->mNormal[1] = 1.0;
+			if (pt[1] <= (my + 0.1) * wallThickness) {
+				normal[1] = 1.0;
 			}
-			if (p->mLocation[1] >= my - (my - 0.1) * wallThickness) {
-				p->mNormal[1] = -1.0;
+			if (pt[1] >= my - (my - 0.1) * wallThickness) {
+				normal[1] = -1.0;
 			}
-			if (p->mNormal[0] == 0.0 && p->mNormal[1] == 0.0) {
-				std::vector<FluidParticle*> neighbors =
-						particleLocator->getNeigboringCellParticles(i, j, 3,
-								3);
-				for (int n = 0; n < (int) neighbors.size(); n++) {
-					FluidParticle *np = neighbors[n];
-					if (p.get() != np && np->mObjectType == ObjectType::WALL) {
-						float d = distance(p->mLocation, np->mLocation);
+			if (normal[0] == 0.0 && normal[1] == 0.0) {
+				particleLocator->forEachParticle(i - 3, j - 3, i + 3, j + 3, [&](int m) {
+					if (n != m && particles.types[m] == ObjectType::WALL) {
+						float d = distance(pt, locations[m]);
 						float w = 1.0 / d;
-						p->mNormal += w * (p->mLocation - np->mLocation) / d;
+						normal += w * (pt - locations[m]) / d;
 					}
-				}
+				});
 			}
 		}
-		p->mNormal = normalize(p->mNormal);
-		wallNormalImage(i, j) = p->mNormal;
+		normal = normalize(normal);
+		wallNormalImage(i, j) = normal;
 	}
 
 	particleLocator->update(particles);
@@ -72,7 +72,7 @@ protected:
 	std::vector<std::shared_ptr<SimulationObject>> fluidObjects;
 	std::vector<std::shared_ptr<SimulationObject>> wallObjects;
 	std::vector<std::shared_ptr<SimulationObject>> airObjects;
-	std::vector<FluidParticlePtr> particles;
+	FluidParticleArray particles;
 	void copyGridToBuffer();
 	void subtractGrid();
 	void placeObjects();
@@ -85,7 +85,7 @@ protected:
 	void addExternalForce();
 	void pourWater(int limit, float maxDensity);
 	void extrapolateVelocity();
-	void repositionParticles(std::vector<int>& indices);
+	void repositionParticles(int count);
 	void addParticle(float2 pt, float2 center, ObjectType type);
 	void project();
 	void createLevelSet();
@@ -100,12 +100,10 @@ protected:
 	void shuffleCoordinates(std::vector<int2> &waters);
 	float linear(Image1f& q, float x, float y, float z);
 	void resampleParticles(float2& p, float2& u, float re);
-	void correctParticles(std::vector<FluidParticlePtr>& particle, float dt,
+	void correctParticles(FluidParticleArray& particles, float dt,
 			float re);
 	bool updateContour();
-	double implicit_func(float2& p, float density);
-	double implicit_func(std::vector<FluidParticle*> &neighbors, float2& p,
-			float density, float voxelSize);
+	double implicit_func(float2& p, float radius);
 	void mapParticlesToGrid();
 	void mapGridToParticles();
 
@@ -0,0 +1,635 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  This implementation of a PIC/FLIP fluid simulator is derived from:
+ *
+ *  Ando, R., Thurey, N., & Tsuruno, R. (2012). Preserving fluid sheets with adaptively sampled anisotropic particles.
+ *  Visualization and Computer Graphics, IEEE Transactions on, 18(8), 1202-1214.
+ */
+#include "physics/fluid/FluidSimulation3D.h"
+#include "physics/fluid/LaplaceSolver.h"
+#include "graphics/EndlessGrid.h"
+namespace aly {
+const float FluidSimulation3D::GRAVITY = 9.8067f;
+const float RELAXATION_KERNEL_WIDTH = 1.4f;
+const float SPRING_STIFFNESS = 50.0f;
+//Layers of faces around the fluid that receive extrapolated velocities.
+const int EXTRAPOLATION_LAYERS = 3;
+static const int3 AXIS_OFFSETS[3] = { int3(1, 0, 0), int3(0, 1, 0), int3(0, 0, 1) };
+static inline float3 ToFloat(const int3& pos) {
+	return float3((float) pos.x, (float) pos.y, (float) pos.z);
+}
+//Deterministic replacement for rand() that is safe to call from parallel loops.
+static float3 JitterDirection(int n, int m) {
+	uint32_t h = ((uint32_t) n * 73856093u) ^ ((uint32_t) m * 19349663u);
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return float3((h & 0x3FF) / 511.5f - 1.0f, ((h >> 10) & 0x3FF) / 511.5f - 1.0f, ((h >> 20) & 0x3FF) / 511.5f - 1.0f);
+}
+template<class T> static void TransferField(const SparseBlockGrid3D& dest, const SparseBlockGrid3D& src,
+		std::vector<T>& field, const T& bg) {
+	std::vector<T> tmp;
+	if (field.size() != src.size()) {
+		field.assign(src.size(), bg);
+	}
+	dest.transfer(src, field, tmp, bg);
+	field.swap(tmp);
+}
+void FluidSimulation3D::setup(const aly::ParameterPanePtr& pane) {
+}
+FluidSimulation3D::FluidSimulation3D(const int3& dims, float voxelSize) :
+		Simulation("Fluid_Simulation_3D"), maxDensity(0.0f), picFlipBlendWeight(0.95f), fluidParticleDiameter(0.5f), maxLevelSet(
+				2.5f), fluidVoxelSize(voxelSize), wallThickness(voxelSize), gravity(0.0f, -GRAVITY, 0.0f), gridSize(dims), requestUpdateSurface(
+				false), grid(dims + 1) {
+	srand(52372143L);
+	simulationTimeStep = 0.5 * fluidVoxelSize;
+	domainSize = ToFloat(dims) * fluidVoxelSize;
+	simulationDuration = 4.0f;
+	domainBox.mType = ObjectType::WALL;
+	domainBox.mMin = float3(wallThickness);
+	domainBox.mMax = domainSize - float3(wallThickness);
+	int3 bdims = grid.getBlockDimensions();
+	blockMask.assign((size_t) bdims.x * bdims.y * bdims.z, 0);
+}
+void FluidSimulation3D::addSimulationObject(const SimulationObject3DPtr& obj) {
+	switch (obj->mType) {
+	case ObjectType::FLUID:
+		fluidObjects.push_back(obj);
+		break;
+	case ObjectType::WALL:
+		wallObjects.push_back(obj);
+		break;
+	default:
+		break;
+	}
+}
+void FluidSimulation3D::addFluid() {
+	//Dam break, a column of water in one corner above a shallow pool.
+	BoxObject3D* obj = new BoxObject3D;
+	obj->mType = ObjectType::FLUID;
+	obj->mMin = float3(wallThickness);
+	obj->mMax = float3(0.3f * domainSize.x, 0.6f * domainSize.y, 0.4f * domainSize.z);
+	addSimulationObject(SimulationObject3DPtr(obj));
+	obj = new BoxObject3D;
+	obj->mType = ObjectType::FLUID;
+	obj->mMin = float3(wallThickness);
+	obj->mMax = float3(domainSize.x - wallThickness, 0.1f * domainSize.y, domainSize.z - wallThickness);
+	addSimulationObject(SimulationObject3DPtr(obj));
+}
+float FluidSimulation3D::solidDistance(const float3& pt) const {
+	float d = -domainBox.signedDistance(pt);
+	for (const SimulationObject3DPtr& obj : wallObjects) {
+		d = std::min(d, obj->signedDistance(pt));
+	}
+	return d;
+}
+float3 FluidSimulation3D::solidNormal(const float3& pt) const {
+	float e = 0.5f * fluidVoxelSize;
+	float3 n(solidDistance(pt + float3(e, 0, 0)) - solidDistance(pt - float3(e, 0, 0)),
+			solidDistance(pt + float3(0, e, 0)) - solidDistance(pt - float3(0, e, 0)),
+			solidDistance(pt + float3(0, 0, e)) - solidDistance(pt - float3(0, 0, e)));
+	float len = length(n);
+	return (len > 0.0f) ? n / len : float3(0.0f);
+}
+bool FluidSimulation3D::isSolid(int i, int j, int k) const {
+	if (i < 0 || j < 0 || k < 0 || i >= gridSize.x || j >= gridSize.y || k >= gridSize.z)
+		return true;
+	int idx = grid.index(i, j, k);
+	return (idx >= 0 && labels[idx] == static_cast<char>(ObjectType::WALL));
+}
+void FluidSimulation3D::constrainParticle(float3& pt, float3& vel) const {
+	float re = 1.5f * fluidParticleDiameter * fluidVoxelSize;
+	float d = solidDistance(pt);
+	if (d < re) {
+		float3 normal = solidNormal(pt);
+		pt += (re - d) * normal;
+		float dotprod = dot(vel, normal);
+		if (dotprod < 0.0f)
+			vel -= dotprod * normal;
+	}
+	pt = clamp(pt, float3(wallThickness), domainSize - float3(wallThickness));
+}
+float3 FluidSimulation3D::interpolate(const std::vector<float>* field, const float3& pt) const {
+	float3 g = pt / fluidVoxelSize;
+	return float3(grid.interpolate(field[0], g.x, g.y - 0.5f, g.z - 0.5f, 0.0f),
+			grid.interpolate(field[1], g.x - 0.5f, g.y, g.z - 0.5f, 0.0f),
+			grid.interpolate(field[2], g.x - 0.5f, g.y - 0.5f, g.z, 0.0f));
+}
+void FluidSimulation3D::updateActiveBlocks() {
+	int3 bdims = grid.getBlockDimensions();
+	std::vector<char> mask(blockMask.size(), 0);
+	for (const float3& pt : particles.locations) {
+		int3 c = particleLocator->getCell(pt);
+		mask[(c.x >> SparseBlockGrid3D::BLOCK_SHIFT)
+				+ ((c.y >> SparseBlockGrid3D::BLOCK_SHIFT) + (c.z >> SparseBlockGrid3D::BLOCK_SHIFT) * bdims.y) * bdims.x] = 1;
+	}
+	//Dilate by one block so kernel stencils, the faces around the fluid and the air next to it stay active.
+	std::vector<char> dilated(mask.size(), 0);
+#pragma omp parallel for
+	for (int k = 0; k < bdims.z; k++) {
+		for (int j = 0; j < bdims.y; j++) {
+			for (int i = 0; i < bdims.x; i++) {
+				char active = 0;
+				for (int kk = std::max(k - 1, 0); kk <= std::min(k + 1, bdims.z - 1); kk++) {
+					for (int jj = std::max(j - 1, 0); jj <= std::min(j + 1, bdims.y - 1); jj++) {
+						for (int ii = std::max(i - 1, 0); ii <= std::min(i + 1, bdims.x - 1); ii++) {
+							active |= mask[ii + (jj + (size_t) kk * bdims.y) * bdims.x];
+						}
+					}
+				}
+				dilated[i + (j + (size_t) k * bdims.y) * bdims.x] = active;
+			}
+		}
+	}
+	if (dilated == blockMask && labels.size() == grid.size())
+		return;
+	blockMask.swap(dilated);
+	SparseBlockGrid3D old = grid;
+	grid.setActive(blockMask);
+	for (int c = 0; c < 3; c++) {
+		TransferField(grid, old, velocity[c], 0.0f);
+		TransferField(grid, old, lastVelocity[c], 0.0f);
+	}
+	TransferField(grid, old, labels, static_cast<char>(ObjectType::AIR));
+	TransferField(grid, old, laplacian, 1.0f);
+	TransferField(grid, old, divergence, 0.0f);
+	TransferField(grid, old, pressure, 0.0f);
+	TransferField(grid, old, levelSet, maxLevelSet);
+}
+void FluidSimulation3D::rebin() {
+	updateActiveBlocks();
+	particleLocator->update(particles);
+}
+bool FluidSimulation3D::init() {
+	simulationTime = 0;
+	simulationIteration = 0;
+	particles.clear();
+	grid.clear();
+	blockMask.assign(blockMask.size(), 0);
+	particleLocator.reset(new ParticleLocator3D(gridSize, fluidVoxelSize, grid));
+	if (fluidObjects.empty()) {
+		addFluid();
+	}
+// Generate pseudo particles to measure maximum particle density
+	float h = fluidParticleDiameter * fluidVoxelSize;
+	for (int k = 0; k < 10; k++) {
+		for (int j = 0; j < 10; j++) {
+			for (int i = 0; i < 10; i++) {
+				particles.add(float3((i + 0.5f) * h, (j + 0.5f) * h, (k + 0.5f) * h), float3(0.0f), 1.0f, 0.0f);
+			}
+		}
+	}
+	rebin();
+	computeParticleDensity(1.0f);
+	maxDensity = 0.0f;
+	for (float density : particles.densities) {
+		maxDensity = std::max(maxDensity, density);
+	}
+	particles.clear();
+// Place fluid particles, eight per cell with a small jitter
+	for (int k = 0; k < gridSize.z; k++) {
+		for (int j = 0; j < gridSize.y; j++) {
+			for (int i = 0; i < gridSize.x; i++) {
+				for (int kk = 0; kk < 2; kk++) {
+					for (int jj = 0; jj < 2; jj++) {
+						for (int ii = 0; ii < 2; ii++) {
+							float3 pt(h * (2 * i + ii + 0.5f), h * (2 * j + jj + 0.5f), h * (2 * k + kk + 0.5f));
+							pt += 0.25f * h
+									* float3((rand() % 101) / 100.0f - 0.5f, (rand() % 101) / 100.0f - 0.5f,
+											(rand() % 101) / 100.0f - 0.5f);
+							if (solidDistance(pt) < 0.5f * h)
+								continue;
+							for (SimulationObject3DPtr& obj : fluidObjects) {
+								if (obj->inside(pt)) {
+									particles.add(pt, float3(0.0f), 1.0f, maxDensity);
+									break;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	rebin();
+	computeParticleDensity(maxDensity);
+	solvePicFlip();
+	createLevelSet();
+	updateSurface();
+	return true;
+}
+void FluidSimulation3D::cleanup() {
+	particles.clear();
+	grid.clear();
+	blockMask.assign(blockMask.size(), 0);
+	for (int c = 0; c < 3; c++) {
+		velocity[c].clear();
+		lastVelocity[c].clear();
+	}
+	labels.clear();
+	laplacian.clear();
+	divergence.clear();
+	pressure.clear();
+	levelSet.clear();
+}
+bool FluidSimulation3D::stepInternal() {
+	rebin();
+	computeParticleDensity(maxDensity);
+	addExternalForce();
+	solvePicFlip();
+	advectParticles();
+	correctParticles(simulationTimeStep, fluidParticleDiameter * fluidVoxelSize);
+	createLevelSet();
+	simulationIteration++;
+	simulationTime = simulationIteration * simulationTimeStep;
+	return (simulationTime < simulationDuration);
+}
+float FluidSimulation3D::smoothKernel(float r2, float h) const {
+	return std::max(1.0f - r2 / (h * h), 0.0f);
+}
+float FluidSimulation3D::sharpKernel(float r2, float h) const {
+	return std::max(h * h / std::max(r2, 1.0e-5f) - 1.0f, 0.0f);
+}
+void FluidSimulation3D::computeParticleDensity(float maxDensity) {
+	const float kernelWidth = 4.0f * fluidParticleDiameter * fluidVoxelSize;
+	const float3* locations = particles.locations.data();
+	const float* masses = particles.masses.data();
+#pragma omp parallel for
+	for (int n = 0; n < (int) particles.size(); n++) {
+		const float3 pt = locations[n];
+		int3 c = particleLocator->getCell(pt);
+		float wsum = 0.0f;
+		particleLocator->forEachParticle(c.x - 1, c.y - 1, c.z - 1, c.x + 1, c.y + 1, c.z + 1, [&](int m) {
+			wsum += masses[m] * smoothKernel(lengthSqr(locations[m] - pt), kernelWidth);
+		});
+		particles.densities[n] = wsum / maxDensity;
+	}
+}
+void FluidSimulation3D::addExternalForce() {
+	float3 dv = (float) simulationTimeStep * gravity;
+#pragma omp parallel for
+	for (int n = 0; n < (int) particles.size(); n++) {
+		particles.velocities[n] += dv;
+	}
+}
+void FluidSimulation3D::mapParticlesToGrid() {
+	const float scale = 1.0f / fluidVoxelSize;
+	const float R2 = RELAXATION_KERNEL_WIDTH * RELAXATION_KERNEL_WIDTH;
+	const float3* locations = particles.locations.data();
+	const float3* velocities = particles.velocities.data();
+	const float* masses = particles.masses.data();
+	static const float3 faceOffsets[3] = { float3(0.0f, 0.5f, 0.5f), float3(0.5f, 0.0f, 0.5f), float3(0.5f, 0.5f, 0.0f) };
+	//Each voxel gathers its three faces from the particles in nearby cells, so writes never conflict.
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		float3 sumw(0.0f);
+		float3 sumv(0.0f);
+		if (pos.x <= gridSize.x && pos.y <= gridSize.y && pos.z <= gridSize.z) {
+			float3 corner = ToFloat(pos);
+			particleLocator->forEachParticle(pos.x - 2, pos.y - 2, pos.z - 2, pos.x + 1, pos.y + 1, pos.z + 1, [&](int n) {
+				float3 d = scale * locations[n] - corner;
+				for (int c = 0; c < 3; c++) {
+					float r2 = lengthSqr(d - faceOffsets[c]);
+					if (r2 < R2) {
+						float w = masses[n] * sharpKernel(r2, RELAXATION_KERNEL_WIDTH);
+						sumv[c] += w * velocities[n][c];
+						sumw[c] += w;
+					}
+				}
+			});
+		}
+		for (int c = 0; c < 3; c++) {
+			bool face = true;
+			for (int a = 0; a < 3; a++) {
+				if (pos[a] > gridSize[a] || (a != c && pos[a] == gridSize[a]))
+					face = false;
+			}
+			velocity[c][idx] = (face && sumw[c] > 0.0f) ? sumv[c] / sumw[c] : 0.0f;
+		}
+	});
+}
+void FluidSimulation3D::markCells() {
+	const float MAX_VOLUME = 1.0f / (fluidParticleDiameter * fluidParticleDiameter * fluidParticleDiameter);
+	const float alpha = 0.2f;
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		if (pos.x >= gridSize.x || pos.y >= gridSize.y || pos.z >= gridSize.z
+				|| solidDistance((ToFloat(pos) + float3(0.5f)) * fluidVoxelSize) < 0.0f) {
+			labels[idx] = static_cast<char>(ObjectType::WALL);
+			laplacian[idx] = 1.0f;
+			return;
+		}
+		float accm = 0.0f;
+		int end = particleLocator->getCellEnd(idx);
+		for (int n = particleLocator->getCellBegin(idx); n < end; n++) {
+			accm += particles.densities[n];
+		}
+		float value = alpha * MAX_VOLUME - accm;
+		laplacian[idx] = value;
+		labels[idx] = static_cast<char>((value < 0.0f) ? ObjectType::FLUID : ObjectType::AIR);
+	});
+}
+void FluidSimulation3D::enforceBoundaryCondition() {
+// Set velocity of faces between solid and non-solid cells to zero
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		bool solid = isSolid(pos.x, pos.y, pos.z);
+		for (int c = 0; c < 3; c++) {
+			int3 q = pos - AXIS_OFFSETS[c];
+			if (solid != isSolid(q.x, q.y, q.z))
+				velocity[c][idx] = 0.0f;
+		}
+	});
+}
+void FluidSimulation3D::project() {
+	const char FLUID = static_cast<char>(ObjectType::FLUID);
+	const char WALL = static_cast<char>(ObjectType::WALL);
+// Compute divergence
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		if (labels[idx] == FLUID) {
+			float div = 0.0f;
+			for (int c = 0; c < 3; c++) {
+				int3 q = pos + AXIS_OFFSETS[c];
+				div += grid.get(velocity[c], q.x, q.y, q.z, 0.0f) - velocity[c][idx];
+			}
+			divergence[idx] = -div / fluidVoxelSize;
+		} else {
+			divergence[idx] = 0.0f;
+		}
+	});
+	SolveLaplace3d(grid, labels, laplacian, pressure, divergence, fluidVoxelSize);
+// Subtract pressure gradient, using ghost pressures across the free surface
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		if (pos.x >= gridSize.x || pos.y >= gridSize.y || pos.z >= gridSize.z)
+			return;
+		char lb = labels[idx];
+		if (lb == WALL)
+			return;
+		for (int c = 0; c < 3; c++) {
+			int ia = grid.index(pos - AXIS_OFFSETS[c]);
+			if (ia < 0)
+				continue;
+			char la = labels[ia];
+			if (la == WALL || (la != FLUID && lb != FLUID))
+				continue;
+			float pa = pressure[ia];
+			float pb = pressure[idx];
+			if (la != FLUID) {
+				pa = pb * (1.0f - 1.0f / GhostFluidFraction(laplacian[idx], laplacian[ia]));
+			} else if (lb != FLUID) {
+				pb = pa * (1.0f - 1.0f / GhostFluidFraction(laplacian[ia], laplacian[idx]));
+			}
+			velocity[c][idx] -= (pb - pa) / fluidVoxelSize;
+		}
+	});
+}
+void FluidSimulation3D::extrapolateVelocity() {
+	const char FLUID = static_cast<char>(ObjectType::FLUID);
+	const size_t N = grid.size();
+// Mark faces next to fluid cells
+	std::vector<char> valid(3 * N, 0);
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		bool fluid = (labels[idx] == FLUID);
+		for (int c = 0; c < 3; c++) {
+			int ia = grid.index(pos - AXIS_OFFSETS[c]);
+			valid[3 * idx + c] = (fluid || (ia >= 0 && labels[ia] == FLUID));
+		}
+	});
+// Grow one layer at a time from double buffers so the result does not depend on traversal order
+	std::vector<char> nextValid;
+	std::vector<float> next[3];
+	for (int layer = 0; layer < EXTRAPOLATION_LAYERS; layer++) {
+		nextValid = valid;
+		for (int c = 0; c < 3; c++) {
+			next[c] = velocity[c];
+		}
+		grid.forEachVoxel([&](int idx, const int3& pos) {
+			for (int c = 0; c < 3; c++) {
+				if (valid[3 * idx + c])
+					continue;
+				float sum = 0.0f;
+				int wsum = 0;
+				for (int a = 0; a < 3; a++) {
+					for (int s = -1; s <= 1; s += 2) {
+						int iq = grid.index(pos + s * AXIS_OFFSETS[a]);
+						if (iq >= 0 && valid[3 * iq + c]) {
+							sum += velocity[c][iq];
+							wsum++;
+						}
+					}
+				}
+				if (wsum) {
+					next[c][idx] = sum / wsum;
+					nextValid[3 * idx + c] = 1;
+				}
+			}
+		});
+		valid.swap(nextValid);
+		for (int c = 0; c < 3; c++) {
+			velocity[c].swap(next[c]);
+		}
+	}
+}
+void FluidSimulation3D::solvePicFlip() {
+	mapParticlesToGrid();
+	markCells();
+	for (int c = 0; c < 3; c++) {
+		lastVelocity[c] = velocity[c];
+	}
+	enforceBoundaryCondition();
+	project();
+	extrapolateVelocity();
+	enforceBoundaryCondition();
+#pragma omp parallel for
+	for (int n = 0; n < (int) particles.size(); n++) {
+		const float3& pt = particles.locations[n];
+		float3 currentVelocity = interpolate(velocity, pt);
+		float3 flipVelocity = particles.velocities[n] + currentVelocity - interpolate(lastVelocity, pt);
+		particles.velocities[n] = (1.0f - picFlipBlendWeight) * currentVelocity + picFlipBlendWeight * flipVelocity;
+	}
+}
+void FluidSimulation3D::advectParticles() {
+	float dt = (float) simulationTimeStep;
+#pragma omp parallel for
+	for (int n = 0; n < (int) particles.size(); n++) {
+		float3& pt = particles.locations[n];
+		pt += dt * interpolate(velocity, pt);
+		constrainParticle(pt, particles.velocities[n]);
+	}
+	rebin();
+}
+void FluidSimulation3D::resampleParticle(const float3& p, float3& u, float re) const {
+	const float3* locations = particles.locations.data();
+	const float3* velocities = particles.velocities.data();
+	const float* masses = particles.masses.data();
+	const float re2 = re * re;
+	int3 c = particleLocator->getCell(p);
+	float wsum = 0.0f;
+	float3 sum(0.0f);
+	particleLocator->forEachParticle(c.x - 1, c.y - 1, c.z - 1, c.x + 1, c.y + 1, c.z + 1, [&](int n) {
+		float r2 = lengthSqr(p - locations[n]);
+		if (r2 < re2) {
+			float w = masses[n] * sharpKernel(r2, re);
+			sum += w * velocities[n];
+			wsum += w;
+		}
+	});
+	if (wsum > 0.0f) {
+		u = sum / wsum;
+	}
+}
+void FluidSimulation3D::correctParticles(float dt, float re) {
+	const float3* locations = particles.locations.data();
+	const float* masses = particles.masses.data();
+	const float re2 = re * re;
+	particles.tmpLocations.resize(particles.size());
+	particles.tmpVelocities.resize(particles.size());
+// Compute pseudo moved point
+#pragma omp parallel for
+	for (int n = 0; n < (int) particles.size(); n++) {
+		const float3 pt = locations[n];
+		float3 spring(0.0f);
+		int3 c = particleLocator->getCell(pt);
+		particleLocator->forEachParticle(c.x - 1, c.y - 1, c.z - 1, c.x + 1, c.y + 1, c.z + 1, [&](int m) {
+			float3 diff = pt - locations[m];
+			float dist2 = lengthSqr(diff);
+			//The spring kernel is zero outside re.
+			if (n == m || dist2 >= re2)
+				return;
+			float dist = std::sqrt(dist2);
+			float w = SPRING_STIFFNESS * masses[m] * smoothKernel(dist2, re);
+			if (dist > 0.1f * re) {
+				spring += w * diff / dist * re;
+			} else {
+				spring += 0.01f * re / dt * JitterDirection(n, m);
+			}
+		});
+		particles.tmpLocations[n] = pt + dt * spring;
+	}
+// Resample new velocity
+#pragma omp parallel for
+	for (int n = 0; n < (int) particles.size(); n++) {
+		particles.tmpVelocities[n] = particles.velocities[n];
+		resampleParticle(particles.tmpLocations[n], particles.tmpVelocities[n], re);
+		constrainParticle(particles.tmpLocations[n], particles.tmpVelocities[n]);
+	}
+	particles.locations.swap(particles.tmpLocations);
+	particles.velocities.swap(particles.tmpVelocities);
+}
+void FluidSimulation3D::createLevelSet() {
+	rebin();
+	const float scale = 1.0f / fluidVoxelSize;
+	const float radius = fluidParticleDiameter;
+	const float3* locations = particles.locations.data();
+// Distance to the nearest particle, sampled at cell corners
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		if (!grid.contains(pos.x, pos.y, pos.z)) {
+			levelSet[idx] = maxLevelSet;
+			return;
+		}
+		float3 p = ToFloat(pos);
+		float phi2 = 64.0f * radius * radius;
+		particleLocator->forEachParticle(pos.x - 2, pos.y - 2, pos.z - 2, pos.x + 1, pos.y + 1, pos.z + 1, [&](int n) {
+			phi2 = std::min(phi2, lengthSqr(scale * locations[n] - p));
+		});
+		levelSet[idx] = clamp(std::sqrt(phi2) - radius, -maxLevelSet, maxLevelSet);
+	});
+	requestUpdateSurface = true;
+}
+bool FluidSimulation3D::updateSurface() {
+	if (!requestUpdateSurface)
+		return false;
+	const int V = SparseBlockGrid3D::BLOCK_VOXELS;
+	EndlessGridFloat sparse( { 16, SparseBlockGrid3D::BLOCK_SIZE }, maxLevelSet);
+	for (int b = 0; b < (int) grid.getBlockCount(); b++) {
+		float minValue = maxLevelSet;
+		for (int n = b * V; n < (b + 1) * V; n++) {
+			minValue = std::min(minValue, levelSet[n]);
+		}
+		//Blocks without any value below the background contribute nothing to the surface.
+		if (minValue >= maxLevelSet)
+			continue;
+		for (int n = b * V; n < (b + 1) * V; n++) {
+			int3 pos = grid.position(n);
+			if (grid.contains(pos.x, pos.y, pos.z))
+				sparse.getLeafValue(pos.x, pos.y, pos.z) = levelSet[n];
+		}
+	}
+	Mesh mesh;
+	isoSurface.solve(sparse, mesh, MeshType::Triangle, false, 0.0f);
+	for (float3& pt : mesh.vertexLocations.data) {
+		pt *= fluidVoxelSize;
+	}
+	mesh.updateBoundingBox();
+	{
+		std::lock_guard<std::mutex> lockMe(surfaceLock);
+		mesh.clone(surface);
+		surface.setDirty(true);
+	}
+	requestUpdateSurface = false;
+	return true;
+}
+void FluidSimulation3D::getSignedLevelSet(Volume1f& out) const {
+	out.resize(gridSize.x + 1, gridSize.y + 1, gridSize.z + 1);
+	out.set(maxLevelSet);
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		if (grid.contains(pos.x, pos.y, pos.z))
+			out(pos.x, pos.y, pos.z).x = levelSet[idx];
+	});
+}
+void FluidSimulation3D::getPressure(Volume1f& out) const {
+	out.resize(gridSize.x, gridSize.y, gridSize.z);
+	out.set(0.0f);
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		if (pos.x < gridSize.x && pos.y < gridSize.y && pos.z < gridSize.z)
+			out(pos.x, pos.y, pos.z).x = pressure[idx];
+	});
+}
+void FluidSimulation3D::getVelocity(Volume3f& out) const {
+	out.resize(gridSize.x, gridSize.y, gridSize.z);
+	out.set(float3(0.0f));
+	grid.forEachVoxel([&](int idx, const int3& pos) {
+		if (pos.x < gridSize.x && pos.y < gridSize.y && pos.z < gridSize.z) {
+			float3 v;
+			for (int c = 0; c < 3; c++) {
+				int3 q = pos + AXIS_OFFSETS[c];
+				v[c] = 0.5f * (velocity[c][idx] + grid.get(velocity[c], q.x, q.y, q.z, 0.0f));
+			}
+			out(pos.x, pos.y, pos.z) = v;
+		}
+	});
+}
+float FluidSimulation3D::getMaxDivergence() const {
+	const char FLUID = static_cast<char>(ObjectType::FLUID);
+	float maxDiv = 0.0f;
+	for (size_t idx = 0; idx < labels.size(); idx++) {
+		if (labels[idx] != FLUID)
+			continue;
+		int3 pos = grid.position(idx);
+		float div = 0.0f;
+		for (int c = 0; c < 3; c++) {
+			int3 q = pos + AXIS_OFFSETS[c];
+			div += grid.get(velocity[c], q.x, q.y, q.z, 0.0f) - velocity[c][idx];
+		}
+		maxDiv = std::max(maxDiv, std::abs(div) / fluidVoxelSize);
+	}
+	return maxDiv;
+}
+FluidSimulation3D::~FluidSimulation3D() {
+}
+}
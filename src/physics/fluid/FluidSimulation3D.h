@@ -0,0 +1,143 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ *  This implementation of a PIC/FLIP fluid simulator is derived from:
+ *
+ *  Ando, R., Thurey, N., & Tsuruno, R. (2012). Preserving fluid sheets with adaptively sampled anisotropic particles.
+ *  Visualization and Computer Graphics, IEEE Transactions on, 18(8), 1202-1214.
+ */
+#ifndef INCLUDE_FLUID_FLUIDSIMULATION3D_H_
+#define INCLUDE_FLUID_FLUIDSIMULATION3D_H_
+#include "physics/fluid/SimulationObjects.h"
+#include "physics/fluid/SparseBlockGrid3D.h"
+#include "physics/fluid/ParticleLocator3D.h"
+#include "ui/AlloySimulation.h"
+#include "image/AlloyVolume.h"
+#include "graphics/AlloyMesh.h"
+#include "graphics/AlloyIsoSurface.h"
+#include <mutex>
+namespace aly {
+bool SANITY_CHECK_FLUID3D();
+/*
+ * 3D version of the PIC/FLIP solver in FluidSimulation. Grid quantities live
+ * on a sparse block grid whose active blocks are the ones near particles, so
+ * memory follows the fluid rather than the domain. Walls are given by signed
+ * distance (the domain boundary plus wall objects) instead of wall particles.
+ * Velocities are stored on a MAC grid: component c of voxel (i,j,k) is the
+ * face at the low side of cell (i,j,k) along axis c.
+ */
+class FluidSimulation3D: public Simulation {
+protected:
+	const static float GRAVITY;
+	float maxDensity;
+	float picFlipBlendWeight;
+	float fluidParticleDiameter;
+	float maxLevelSet;
+	float fluidVoxelSize;
+	float wallThickness;
+	float3 gravity;
+	int3 gridSize;
+	float3 domainSize;
+	bool requestUpdateSurface;
+	SparseBlockGrid3D grid;
+	std::vector<char> blockMask;
+	std::vector<float> velocity[3];
+	std::vector<float> lastVelocity[3];
+	std::vector<char> labels;
+	std::vector<float> laplacian;
+	std::vector<float> divergence;
+	std::vector<float> pressure;
+	std::vector<float> levelSet;
+	std::unique_ptr<ParticleLocator3D> particleLocator;
+	std::vector<SimulationObject3DPtr> fluidObjects;
+	std::vector<SimulationObject3DPtr> wallObjects;
+	//Interior of the domain, everything outside it is wall.
+	BoxObject3D domainBox;
+	FluidParticleArray3D particles;
+	IsoSurface isoSurface;
+	Mesh surface;
+	std::mutex surfaceLock;
+	void addFluid();
+	void updateActiveBlocks();
+	void rebin();
+	float solidDistance(const float3& pt) const;
+	float3 solidNormal(const float3& pt) const;
+	bool isSolid(int i, int j, int k) const;
+	void constrainParticle(float3& pt, float3& vel) const;
+	float3 interpolate(const std::vector<float>* field, const float3& pt) const;
+	void computeParticleDensity(float maxDensity);
+	void addExternalForce();
+	void mapParticlesToGrid();
+	void markCells();
+	void enforceBoundaryCondition();
+	void project();
+	void extrapolateVelocity();
+	void solvePicFlip();
+	void advectParticles();
+	void resampleParticle(const float3& p, float3& u, float re) const;
+	void correctParticles(float dt, float re);
+	void createLevelSet();
+	float smoothKernel(float r2, float h) const;
+	float sharpKernel(float r2, float h) const;
+	virtual bool stepInternal() override;
+public:
+	FluidSimulation3D(const int3& dims, float voxelSize);
+	//Objects added before init() define the initial fluid and the solid walls.
+	void addSimulationObject(const SimulationObject3DPtr& obj);
+	bool updateSurface();
+	//Fluid surface in world units, extracted from the active blocks of the level set.
+	Mesh* getSurface() {
+		return &surface;
+	}
+	std::mutex& getSurfaceLock() {
+		return surfaceLock;
+	}
+	inline float getFluidVoxelSize() const {
+		return fluidVoxelSize;
+	}
+	inline int3 dimensions() const {
+		return gridSize;
+	}
+	inline size_t getParticleCount() const {
+		return particles.size();
+	}
+	inline const std::vector<float3>& getParticleLocations() const {
+		return particles.locations;
+	}
+	inline size_t getActiveBlockCount() const {
+		return grid.getBlockCount();
+	}
+	void setGravity(const float3& g) {
+		gravity = g;
+	}
+	//Dense copies of the sparse fields over the whole domain, for inspection and export.
+	void getSignedLevelSet(Volume1f& out) const;
+	void getPressure(Volume1f& out) const;
+	//Velocity averaged to cell centers.
+	void getVelocity(Volume3f& out) const;
+	//Largest magnitude of the velocity divergence over fluid cells, in the units of the pressure solve's right hand side.
+	float getMaxDivergence() const;
+	virtual bool init() override;
+	virtual void cleanup() override;
+	virtual void setup(const aly::ParameterPanePtr& pane) override;
+	virtual ~FluidSimulation3D();
+};
+}
+#endif
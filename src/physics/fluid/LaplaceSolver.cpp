@@ -247,4 +247,214 @@ void SolveLaplace2d(const Image1ub& A, const Image1f& L, Image1f& x,const Image1
 	conjGrad(A, P, L, x, b, voxelSize);
 }
 
+static const int LAPLACE3D_MAX_ITERATIONS = 1000;
+static const double LAPLACE3D_TOLERANCE = 1E-5;
+static const double MIC_TAU = 0.97;
+static const double MIC_SIGMA = 0.25;
+/*
+ * Fluid voxels numbered in packed order, so rows of one block are contiguous
+ * and lexicographic within the block. Neighbors are -x,+x,-y,+y,-z,+z and -1
+ * when the neighbor is not fluid.
+ */
+struct LaplaceSystem3D {
+	std::vector<int> rows;
+	std::vector<int> blockStart;
+	std::vector<int> neighbors;
+	std::vector<float> diag;
+	std::vector<float> precon;
+};
+static void buildSystem(LaplaceSystem3D& sys, const SparseBlockGrid3D& grid, const std::vector<char>& A,
+		const std::vector<float>& L) {
+	static const int3 offsets[6] = { int3(-1, 0, 0), int3(1, 0, 0), int3(0, -1, 0), int3(0, 1, 0), int3(0, 0, -1), int3(
+			0, 0, 1) };
+	const int B = (int) grid.getBlockCount();
+	const int V = SparseBlockGrid3D::BLOCK_VOXELS;
+	const char FLUID = static_cast<char>(ObjectType::FLUID);
+	const char WALL = static_cast<char>(ObjectType::WALL);
+	sys.blockStart.assign(B + 1, 0);
+#pragma omp parallel for
+	for (int b = 0; b < B; b++) {
+		int count = 0;
+		for (int n = b * V; n < (b + 1) * V; n++) {
+			if (A[n] == FLUID)
+				count++;
+		}
+		sys.blockStart[b + 1] = count;
+	}
+	for (int b = 0; b < B; b++) {
+		sys.blockStart[b + 1] += sys.blockStart[b];
+	}
+	const int N = sys.blockStart[B];
+	std::vector<int> rowOf(A.size(), -1);
+	sys.rows.resize(N);
+#pragma omp parallel for
+	for (int b = 0; b < B; b++) {
+		int r = sys.blockStart[b];
+		for (int n = b * V; n < (b + 1) * V; n++) {
+			if (A[n] == FLUID) {
+				rowOf[n] = r;
+				sys.rows[r++] = n;
+			}
+		}
+	}
+	sys.neighbors.resize(6 * (size_t) N);
+	sys.diag.resize(N);
+#pragma omp parallel for
+	for (int r = 0; r < N; r++) {
+		int c = sys.rows[r];
+		int3 pos = grid.position(c);
+		float d = 0.0f;
+		for (int m = 0; m < 6; m++) {
+			int3 q = pos + offsets[m];
+			int nb = -1;
+			if (grid.contains(q.x, q.y, q.z)) {
+				int idx = grid.index(q);
+				if (idx < 0) {
+					d += 1.0f;
+				} else if (A[idx] == FLUID) {
+					nb = rowOf[idx];
+					d += 1.0f;
+				} else if (A[idx] != WALL) {
+					d += 1.0f / GhostFluidFraction(L[c], L[idx]);
+				}
+			}
+			sys.neighbors[6 * (size_t) r + m] = nb;
+		}
+		sys.diag[r] = d;
+	}
+}
+static void buildPreconditioner(LaplaceSystem3D& sys) {
+	const int B = (int) sys.blockStart.size() - 1;
+	sys.precon.resize(sys.rows.size());
+#pragma omp parallel for
+	for (int b = 0; b < B; b++) {
+		int start = sys.blockStart[b];
+		int end = sys.blockStart[b + 1];
+		for (int r = start; r < end; r++) {
+			const int* nb = &sys.neighbors[6 * (size_t) r];
+			double d = sys.diag[r];
+			double e = d;
+			for (int m = 0; m < 6; m += 2) {
+				int q = nb[m];
+				if (q < start)
+					continue;
+				double pq = sys.precon[q];
+				//Couplings of q to later rows in the block, other than r.
+				int others = 0;
+				for (int o = 1; o < 6; o += 2) {
+					int qq = sys.neighbors[6 * (size_t) q + o];
+					if (o != m + 1 && qq >= 0 && qq < end)
+						others++;
+				}
+				e -= pq * pq + MIC_TAU * others * pq * pq;
+			}
+			if (e < MIC_SIGMA * d)
+				e = d;
+			sys.precon[r] = (float) (1.0 / std::sqrt(e));
+		}
+	}
+}
+static void applyPreconditioner(const LaplaceSystem3D& sys, const std::vector<float>& r, std::vector<float>& q,
+		std::vector<float>& z) {
+	const int B = (int) sys.blockStart.size() - 1;
+#pragma omp parallel for
+	for (int b = 0; b < B; b++) {
+		int start = sys.blockStart[b];
+		int end = sys.blockStart[b + 1];
+		for (int n = start; n < end; n++) {
+			const int* nb = &sys.neighbors[6 * (size_t) n];
+			double t = r[n];
+			for (int m = 0; m < 6; m += 2) {
+				if (nb[m] >= start)
+					t += sys.precon[nb[m]] * q[nb[m]];
+			}
+			q[n] = (float) (t * sys.precon[n]);
+		}
+		for (int n = end - 1; n >= start; n--) {
+			const int* nb = &sys.neighbors[6 * (size_t) n];
+			double t = q[n];
+			for (int m = 1; m < 6; m += 2) {
+				if (nb[m] >= 0 && nb[m] < end)
+					t += sys.precon[n] * z[nb[m]];
+			}
+			z[n] = (float) (t * sys.precon[n]);
+		}
+	}
+}
+static void multiply(const LaplaceSystem3D& sys, const std::vector<float>& x, std::vector<float>& ans) {
+#pragma omp parallel for
+	for (int r = 0; r < (int) sys.rows.size(); r++) {
+		const int* nb = &sys.neighbors[6 * (size_t) r];
+		float sum = sys.diag[r] * x[r];
+		for (int m = 0; m < 6; m++) {
+			if (nb[m] >= 0)
+				sum -= x[nb[m]];
+		}
+		ans[r] = sum;
+	}
+}
+static double dotProduct(const std::vector<float>& x, const std::vector<float>& y) {
+	double ans = 0.0;
+#pragma omp parallel for reduction(+:ans)
+	for (int r = 0; r < (int) x.size(); r++) {
+		ans += (double) x[r] * y[r];
+	}
+	return ans;
+}
+void SolveLaplace3d(const SparseBlockGrid3D& grid, const std::vector<char>& A, const std::vector<float>& L,
+		std::vector<float>& x, const std::vector<float>& b, float voxelSize) {
+	LaplaceSystem3D sys;
+	buildSystem(sys, grid, A, L);
+	buildPreconditioner(sys);
+	const int N = (int) sys.rows.size();
+	const float h2 = voxelSize * voxelSize;
+	std::vector<float> p(N), r(N), z(N), s(N), q(N);
+	//Work in the unscaled system A p = h^2 b.
+#pragma omp parallel for
+	for (int n = 0; n < N; n++) {
+		p[n] = x[sys.rows[n]];
+	}
+	multiply(sys, p, z);
+#pragma omp parallel for
+	for (int n = 0; n < N; n++) {
+		r[n] = h2 * b[sys.rows[n]] - z[n];
+	}
+	double bnorm = 0.0;
+#pragma omp parallel for reduction(+:bnorm)
+	for (int n = 0; n < N; n++) {
+		bnorm += (double) b[sys.rows[n]] * b[sys.rows[n]];
+	}
+	double tol = LAPLACE3D_TOLERANCE * LAPLACE3D_TOLERANCE * h2 * h2 * bnorm;
+	double error2 = dotProduct(r, r);
+	if (N > 0 && error2 > tol) {
+		applyPreconditioner(sys, r, q, z);
+		s = z;
+		double a = dotProduct(z, r);
+		for (int k = 0; k < LAPLACE3D_MAX_ITERATIONS; k++) {
+			multiply(sys, s, z);
+			double alpha = a / dotProduct(z, s);
+#pragma omp parallel for
+			for (int n = 0; n < N; n++) {
+				p[n] += (float) (alpha * s[n]);
+				r[n] -= (float) (alpha * z[n]);
+			}
+			error2 = dotProduct(r, r);
+			if (error2 <= tol)
+				break;
+			applyPreconditioner(sys, r, q, z);
+			double a2 = dotProduct(z, r);
+			double beta = a2 / a;
+#pragma omp parallel for
+			for (int n = 0; n < N; n++) {
+				s[n] = z[n] + (float) (beta * s[n]);
+			}
+			a = a2;
+		}
+	}
+	x.assign(grid.size(), 0.0f);
+#pragma omp parallel for
+	for (int n = 0; n < N; n++) {
+		x[sys.rows[n]] = p[n];
+	}
+}
 }
@@ -25,6 +25,24 @@
  */
 #include "physics/fluid/SimulationObjects.h"
 #include "image/AlloyImage.h"
+#include "physics/fluid/SparseBlockGrid3D.h"
+#include <vector>
 namespace aly {
 void SolveLaplace2d(const Image1ub& A,const Image1f& L, Image1f& x,const Image1f& b,float voxelSize);
+/*
+ * Fraction of the way from a fluid voxel center to an air neighbor's center
+ * at which the level set crosses zero. Used for the ghost fluid boundary.
+ */
+inline float GhostFluidFraction(float fluidLevel, float airLevel) {
+	float theta = (fluidLevel < 0.0f && airLevel > 0.0f) ? fluidLevel / (fluidLevel - airLevel) : 1.0f;
+	return clamp(theta, 0.01f, 1.0f);
+}
+/*
+ * Pressure solve on the fluid voxels of a sparse block grid. A, L, x and b are
+ * stored in the grid's packed layout. Uses conjugate gradient with a modified
+ * incomplete Cholesky preconditioner factored independently in each block,
+ * so both the factorization and its application run in parallel.
+ */
+void SolveLaplace3d(const SparseBlockGrid3D& grid, const std::vector<char>& A, const std::vector<float>& L,
+		std::vector<float>& x, const std::vector<float>& b, float voxelSize);
 }
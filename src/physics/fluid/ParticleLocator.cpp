@@ -29,64 +29,56 @@
 using namespace std;
 namespace aly {
 ParticleLocator::ParticleLocator(int2 dims, float voxelSize) :
-		mVoxelSize(voxelSize), mGridSize(dims) {
-	cells.resize(dims.x * dims.y, FluidCell());
+		mVoxelSize(voxelSize), mGridSize(dims), particles(nullptr) {
+	cellStart.resize(dims.x * dims.y + 1, 0);
 }
 ParticleLocator::~ParticleLocator() {
 }
 
-void ParticleLocator::update(std::vector<FluidParticlePtr>& particles) {
-	// Clear All Cells
-#pragma omp parallel for
-	for (int n = 0; n < (int) cells.size(); n++) {
-		cells[n].clear();
-	}
+void ParticleLocator::update(FluidParticleArray& particles) {
+	this->particles = &particles;
+	const int N = (int) particles.size();
+	const int cellCount = mGridSize.x * mGridSize.y;
 	float scale = 1.0f / mVoxelSize;
-	// Store Into The Cells
-	for (FluidParticlePtr& p : particles) {
-		int i = clamp((int) (scale * p->mLocation[0]), 0, mGridSize[0] - 1);
-		int j = clamp((int) (scale * p->mLocation[1]), 0, mGridSize[1] - 1);
-		int k = clamp((int) (scale * p->mLocation[2]), 0, mGridSize[2] - 1);
-		getCell(i, j).push_back(p.get());
+	cellIndex.resize(N);
+#pragma omp parallel for if(N>16384)
+	for (int n = 0; n < N; n++) {
+		const float2& pt = particles.locations[n];
+		int i = clamp((int) (scale * pt[0]), 0, mGridSize[0] - 1);
+		int j = clamp((int) (scale * pt[1]), 0, mGridSize[1] - 1);
+		cellIndex[n] = i + j * mGridSize.x;
 	}
-}
-
-FluidCell ParticleLocator::getNeigboringWallParticles(int i, int j, int w,
-		int h) {
-	FluidCell res;
-	for (int si = max(i - w, 0); si <= min(i + w - 1, mGridSize[0] - 1); si++) {
-		for (int sj = max(j - h, 0); sj <= min(j + h - 1, mGridSize[1] - 1);
-				sj++) {
-			for (FluidParticle* p : getCell(si, sj)) {
-				res.push_back(p);
-			}
-		}
+	// Counting sort, stable so particles keep their relative order within a cell
+	cellStart.assign(cellCount + 1, 0);
+	for (int n = 0; n < N; n++) {
+		cellStart[cellIndex[n] + 1]++;
 	}
-	return res;
-}
-
-FluidCell ParticleLocator::getNeigboringCellParticles(int i, int j, int w,
-		int h) {
-	FluidCell res;
-	for (int si = max(i - w, 0); si <= min(i + w, mGridSize[0] - 1); si++) {
-		for (int sj = max(j - h, 0); sj <= min(j + h, mGridSize[1] - 1); sj++) {
-			for (FluidParticle* p : getCell(si, sj)) {
-				res.push_back(p);
-			}
-		}
+	for (int c = 0; c < cellCount; c++) {
+		cellStart[c + 1] += cellStart[c];
+	}
+	cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+	order.resize(N);
+	bool sorted = true;
+	for (int n = 0; n < N; n++) {
+		int dest = cellFill[cellIndex[n]]++;
+		order[dest] = n;
+		sorted &= (dest == n);
+	}
+	if (!sorted) {
+		particles.permute(order);
 	}
-	return res;
 }
 size_t ParticleLocator::getParticleCount(int i, int j) const {
-	return getCell(i, j).size();
+	return getCellEnd(i, j) - getCellBegin(i, j);
 }
 
 float ParticleLocator::getLevelSetValue(int i, int j, Image1f& halfwall,
 		float density) {
 	float accm = 0.0;
-	for (FluidParticle* p : getCell(i, j)) {
-		if (p->mObjectType == ObjectType::FLUID) {
-			accm += p->mDensity;
+	int end = getCellEnd(i, j);
+	for (int n = getCellBegin(i, j); n < end; n++) {
+		if (particles->types[n] == ObjectType::FLUID) {
+			accm += particles->densities[n];
 		} else {
 			return 1.0;
 		}
@@ -101,8 +93,9 @@ void ParticleLocator::markAsWater(Image1ub& A, Image1f& halfwall,
 	for (int j = 0; j < A.height; j++) {
 		for (int i = 0; i < A.width; i++) {
 			A(i, j).x = static_cast<char>(ObjectType::AIR);
-			for (FluidParticle* p : getCell(i, j)) {
-				if (p->mObjectType == ObjectType::WALL) {
+			int end = getCellEnd(i, j);
+			for (int n = getCellBegin(i, j); n < end; n++) {
+				if (particles->types[n] == ObjectType::WALL) {
 					A(i, j) = static_cast<char>(ObjectType::WALL);
 					break;
 				}
@@ -115,10 +108,8 @@ void ParticleLocator::markAsWater(Image1ub& A, Image1f& halfwall,
 	}
 }
 void ParticleLocator::deleteAllParticles() {
-#pragma omp parallel for
-	for (int n = 0; n < (int) cells.size(); n++) {
-		cells[n].clear();
-	}
+	cellStart.assign(cellStart.size(), 0);
+	particles = nullptr;
 }
 
 }
@@ -25,24 +25,32 @@
  */
 #include "image/AlloyImage.h"
 #include <vector>
+#include <algorithm>
 
 #include "physics/fluid/SimulationObjects.h"
 #ifndef _PARTICLE_LOCATOR_H
 #define _PARTICLE_LOCATOR_H
 namespace aly {
-typedef std::vector<FluidParticle*> FluidCell;
+/*
+ * Bins particles into grid cells with a counting sort and reorders the
+ * particle arrays to match, so each cell, and each run of cells in a row, is
+ * a contiguous index range.
+ */
 class ParticleLocator {
 protected:
 	int2 mGridSize;
 	float mVoxelSize;
-	std::vector<FluidCell> cells;
+	//Particles in cell c are [cellStart[c], cellStart[c+1]).
+	std::vector<int> cellStart;
+	std::vector<int> cellFill;
+	std::vector<int> cellIndex;
+	std::vector<int> order;
+	const FluidParticleArray* particles;
 public:
 	ParticleLocator(int2 dims, float voxelSize);
 	~ParticleLocator();
-
-	void update(std::vector<FluidParticlePtr>& particles);
-	FluidCell getNeigboringWallParticles(int i, int j,int w = 1, int h = 1);
-	FluidCell getNeigboringCellParticles(int i, int j,int w = 1, int h = 1);
+	//Sorts particles by cell. Indexes into the arrays change.
+	void update(FluidParticleArray& particles);
 	float getLevelSetValue(int i, int j, Image1f& halfwall,float density);
 	const int2& getGridSize() {
 		return mGridSize;
@@ -53,11 +61,27 @@ public:
 	size_t getParticleCount(int i, int j) const ;
 	void markAsWater(Image1ub& A, Image1f& halfwall,float density);
 	void deleteAllParticles();
-	inline FluidCell& getCell(int i,int j){
-		return cells[clamp(i,0,mGridSize.x-1)+clamp(j,0,mGridSize.y-1)*mGridSize.x];
+	inline int getCellBegin(int i, int j) const {
+		return cellStart[clamp(i, 0, mGridSize.x - 1) + clamp(j, 0, mGridSize.y - 1) * mGridSize.x];
+	}
+	inline int getCellEnd(int i, int j) const {
+		return cellStart[clamp(i, 0, mGridSize.x - 1) + clamp(j, 0, mGridSize.y - 1) * mGridSize.x + 1];
 	}
-	inline const FluidCell& getCell(int i,int j) const {
-		return cells[clamp(i,0,mGridSize.x-1)+clamp(j,0,mGridSize.y-1)*mGridSize.x];
+	//Calls f(n) for every particle in cells [i0,i1] x [j0,j1], clipped to the grid.
+	template<class F> void forEachParticle(int i0, int j0, int i1, int j1, const F& f) const {
+		i0 = std::max(i0, 0);
+		j0 = std::max(j0, 0);
+		i1 = std::min(i1, mGridSize.x - 1);
+		j1 = std::min(j1, mGridSize.y - 1);
+		if (i0 > i1) {
+			return;
+		}
+		for (int j = j0; j <= j1; j++) {
+			int end = cellStart[i1 + 1 + j * mGridSize.x];
+			for (int n = cellStart[i0 + j * mGridSize.x]; n < end; n++) {
+				f(n);
+			}
+		}
 	}
 };
 }
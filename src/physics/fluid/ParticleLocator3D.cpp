@@ -0,0 +1,67 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "physics/fluid/ParticleLocator3D.h"
+#include "common/AlloyCommon.h"
+namespace aly {
+ParticleLocator3D::ParticleLocator3D(const int3& dims, float voxelSize, const SparseBlockGrid3D& grid) :
+		mGridSize(dims), mVoxelSize(voxelSize), grid(&grid) {
+}
+void ParticleLocator3D::update(FluidParticleArray3D& particles) {
+	const int N = (int) particles.size();
+	const int cellCount = (int) grid->size();
+	cellIndex.resize(N);
+	int missingCount = 0;
+#pragma omp parallel for reduction(+:missingCount) if(N>16384)
+	for (int n = 0; n < N; n++) {
+		int idx = grid->index(getCell(particles.locations[n]));
+		if (idx < 0) {
+			missingCount++;
+		}
+		cellIndex[n] = idx;
+	}
+	if (missingCount > 0) {
+		int missing = 0;
+		while (cellIndex[missing] >= 0) {
+			missing++;
+		}
+		throw std::runtime_error(MakeString() << "Particle " << missing << " at " << particles.locations[missing] << " is outside the active blocks (" << missingCount << " particles in total).");
+	}
+	// Counting sort, stable so particles keep their relative order within a cell
+	cellStart.assign(cellCount + 1, 0);
+	for (int n = 0; n < N; n++) {
+		cellStart[cellIndex[n] + 1]++;
+	}
+	for (int c = 0; c < cellCount; c++) {
+		cellStart[c + 1] += cellStart[c];
+	}
+	cellFill.assign(cellStart.begin(), cellStart.end() - 1);
+	order.resize(N);
+	bool sorted = true;
+	for (int n = 0; n < N; n++) {
+		int dest = cellFill[cellIndex[n]]++;
+		order[dest] = n;
+		sorted &= (dest == n);
+	}
+	if (!sorted) {
+		particles.permute(order);
+	}
+}
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef INCLUDE_FLUID_PARTICLELOCATOR3D_H_
+#define INCLUDE_FLUID_PARTICLELOCATOR3D_H_
+#include "physics/fluid/SimulationObjects.h"
+#include "physics/fluid/SparseBlockGrid3D.h"
+#include <vector>
+namespace aly {
+/*
+ * Bins 3D particles by voxel with a counting sort over the packed storage of
+ * a sparse block grid, so memory follows the active blocks rather than the
+ * domain. Particles are reordered to match, so each voxel, and each run of
+ * voxels along x inside a block, is a contiguous index range.
+ */
+class ParticleLocator3D {
+protected:
+	int3 mGridSize;
+	float mVoxelSize;
+	const SparseBlockGrid3D* grid;
+	//Particles in packed voxel v are [cellStart[v], cellStart[v+1]).
+	std::vector<int> cellStart;
+	std::vector<int> cellFill;
+	std::vector<int> cellIndex;
+	std::vector<int> order;
+public:
+	ParticleLocator3D(const int3& dims, float voxelSize, const SparseBlockGrid3D& grid);
+	//Sorts particles by voxel. Every particle must lie in an active block.
+	void update(FluidParticleArray3D& particles);
+	inline const int3& getGridSize() const {
+		return mGridSize;
+	}
+	inline float getVoxelSize() const {
+		return mVoxelSize;
+	}
+	inline int3 getCell(const float3& pt) const {
+		float scale = 1.0f / mVoxelSize;
+		return int3(clamp((int) (scale * pt.x), 0, mGridSize.x - 1), clamp((int) (scale * pt.y), 0, mGridSize.y - 1),
+				clamp((int) (scale * pt.z), 0, mGridSize.z - 1));
+	}
+	inline size_t getParticleCount(int idx) const {
+		return (idx >= 0) ? cellStart[idx + 1] - cellStart[idx] : 0;
+	}
+	inline int getCellBegin(int idx) const {
+		return cellStart[idx];
+	}
+	inline int getCellEnd(int idx) const {
+		return cellStart[idx + 1];
+	}
+	//Calls f(n) for every particle in cells [i0,i1] x [j0,j1] x [k0,k1], clipped to the grid.
+	template<class F> void forEachParticle(int i0, int j0, int k0, int i1, int j1, int k1, const F& f) const {
+		i0 = std::max(i0, 0);
+		j0 = std::max(j0, 0);
+		k0 = std::max(k0, 0);
+		i1 = std::min(i1, mGridSize.x - 1);
+		j1 = std::min(j1, mGridSize.y - 1);
+		k1 = std::min(k1, mGridSize.z - 1);
+		for (int k = k0; k <= k1; k++) {
+			for (int j = j0; j <= j1; j++) {
+				int i = i0;
+				while (i <= i1) {
+					//Voxels along x are contiguous up to the end of the block.
+					int last = std::min(i1, i | SparseBlockGrid3D::BLOCK_MASK);
+					int idx = grid->index(i, j, k);
+					if (idx >= 0) {
+						int end = cellStart[idx + last - i + 1];
+						for (int n = cellStart[idx]; n < end; n++) {
+							f(n);
+						}
+					}
+					i = last + 1;
+				}
+			}
+		}
+	}
+};
+}
+#endif
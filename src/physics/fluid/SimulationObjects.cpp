@@ -110,5 +110,94 @@ bool SphereObject::insideShell(float2& pt) {
 		return false;
 	}
 }
+void FluidParticleArray::clear() {
+	locations.clear();
+	velocities.clear();
+	normals.clear();
+	types.clear();
+	masses.clear();
+	densities.clear();
+	removeIndicators.clear();
+	tmpLocations.clear();
+	tmpVelocities.clear();
+}
+void FluidParticleArray::add(const float2& location, const float2& velocity, ObjectType type, float mass,
+		float density) {
+	locations.push_back(location);
+	velocities.push_back(velocity);
+	normals.push_back(float2(0.0f));
+	types.push_back(type);
+	masses.push_back(mass);
+	densities.push_back(density);
+	removeIndicators.push_back(0);
+}
+template<class T> static void PermuteArray(std::vector<T>& data, const std::vector<int>& order) {
+	std::vector<T> tmp(order.size());
+#pragma omp parallel for if(order.size()>65536)
+	for (int n = 0; n < (int) order.size(); n++) {
+		tmp[n] = data[order[n]];
+	}
+	data.swap(tmp);
+}
+void FluidParticleArray::permute(const std::vector<int>& order) {
+	PermuteArray(locations, order);
+	PermuteArray(velocities, order);
+	PermuteArray(normals, order);
+	PermuteArray(types, order);
+	PermuteArray(masses, order);
+	PermuteArray(densities, order);
+	PermuteArray(removeIndicators, order);
+}
+void FluidParticleArray::eraseMarked() {
+	size_t count = 0;
+	for (size_t n = 0; n < locations.size(); n++) {
+		if (!removeIndicators[n]) {
+			locations[count] = locations[n];
+			velocities[count] = velocities[n];
+			normals[count] = normals[n];
+			types[count] = types[n];
+			masses[count] = masses[n];
+			densities[count] = densities[n];
+			removeIndicators[count] = 0;
+			count++;
+		}
+	}
+	locations.resize(count);
+	velocities.resize(count);
+	normals.resize(count);
+	types.resize(count);
+	masses.resize(count);
+	densities.resize(count);
+	removeIndicators.resize(count);
+}
+float SphereObject3D::signedDistance(const float3& pt) const {
+	return length(pt - mCenter) - mRadius;
+}
+float BoxObject3D::signedDistance(const float3& pt) const {
+	float3 d = max(mMin - pt, pt - mMax);
+	float outside = length(max(d, float3(0.0f)));
+	float inside = std::min(std::max(std::max(d.x, d.y), d.z), 0.0f);
+	return outside + inside;
+}
+void FluidParticleArray3D::clear() {
+	locations.clear();
+	velocities.clear();
+	masses.clear();
+	densities.clear();
+	tmpLocations.clear();
+	tmpVelocities.clear();
+}
+void FluidParticleArray3D::add(const float3& location, const float3& velocity, float mass, float density) {
+	locations.push_back(location);
+	velocities.push_back(velocity);
+	masses.push_back(mass);
+	densities.push_back(density);
+}
+void FluidParticleArray3D::permute(const std::vector<int>& order) {
+	PermuteArray(locations, order);
+	PermuteArray(velocities, order);
+	PermuteArray(masses, order);
+	PermuteArray(densities, order);
+}
 }
 
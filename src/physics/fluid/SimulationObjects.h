@@ -28,6 +28,7 @@
 #define INCLUDE_FLUID_SIMULATIONOBJECTS_H_
 #include "image/AlloyImage.h"
 #include "math/AlloyVecMath.h"
+#include <vector>
 namespace aly {
 enum class ObjectType {
 	AIR = 0, FLUID = 1, WALL = 2
@@ -101,18 +102,96 @@ public:
 	virtual bool inside(float2& pt);
 	virtual bool insideShell(float2& pt);
 };
-struct FluidParticle {
-	float2 mLocation;
-	float2 mVelocity;
-	float2 mNormal;
-	ObjectType mObjectType;
-	//char mVisible;
-	bool mRemoveIndicator;
-	float2 mTmp[2];
-	float mMass;
-	float mDensity;
+/*
+ * Fluid and wall particles stored as parallel arrays, one entry per particle.
+ * ParticleLocator::update() reorders them by grid cell, so indexes are only
+ * stable between updates.
+ */
+struct FluidParticleArray {
+	std::vector<float2> locations;
+	std::vector<float2> velocities;
+	std::vector<float2> normals;
+	std::vector<ObjectType> types;
+	std::vector<float> masses;
+	std::vector<float> densities;
+	std::vector<char> removeIndicators;
+	//Scratch space for correctParticles(), not preserved by permute().
+	std::vector<float2> tmpLocations;
+	std::vector<float2> tmpVelocities;
+	size_t size() const {
+		return locations.size();
+	}
+	bool empty() const {
+		return locations.empty();
+	}
+	void clear();
+	void add(const float2& location, const float2& velocity, ObjectType type, float mass, float density);
+	//Reorders particles so that entry n is the old entry order[n].
+	void permute(const std::vector<int>& order);
+	//Removes particles whose remove indicator is set.
+	void eraseMarked();
+};
+struct SimulationObject3D {
+public:
+	ObjectType mType;
+	ObjectShape mShape;
+	ObjectMaterial mMaterial;
+	bool mVisible;
+	//Negative inside the object.
+	virtual float signedDistance(const float3& pt) const {
+		return 0;
+	}
+	virtual bool inside(const float3& pt) const {
+		return signedDistance(pt) < 0.0f;
+	}
+	virtual ~SimulationObject3D() {
+	}
+	SimulationObject3D(ObjectShape shape) :
+			mType(ObjectType::AIR), mShape(shape), mMaterial(ObjectMaterial::SOLID), mVisible(true) {
+	}
+};
+struct SphereObject3D: public SimulationObject3D {
+public:
+	float mRadius;
+	float3 mCenter;
+	SphereObject3D() :
+			SimulationObject3D(ObjectShape::SPHERE), mRadius(0), mCenter() {
+	}
+	virtual float signedDistance(const float3& pt) const override;
+};
+struct BoxObject3D: public SimulationObject3D {
+public:
+	float3 mMin;
+	float3 mMax;
+	BoxObject3D() :
+			SimulationObject3D(ObjectShape::BOX), mMin(), mMax() {
+	}
+	virtual float signedDistance(const float3& pt) const override;
+};
+/*
+ * 3D fluid particles stored as parallel arrays. Walls are represented by
+ * their signed distance instead of wall particles, so every entry is fluid.
+ */
+struct FluidParticleArray3D {
+	std::vector<float3> locations;
+	std::vector<float3> velocities;
+	std::vector<float> masses;
+	std::vector<float> densities;
+	//Scratch space for correctParticles(), not preserved by permute().
+	std::vector<float3> tmpLocations;
+	std::vector<float3> tmpVelocities;
+	size_t size() const {
+		return locations.size();
+	}
+	bool empty() const {
+		return locations.empty();
+	}
+	void clear();
+	void add(const float3& location, const float3& velocity, float mass, float density);
+	//Reorders particles so that entry n is the old entry order[n].
+	void permute(const std::vector<int>& order);
 };
 typedef std::shared_ptr<SimulationObject> SimulationObjectPtr;
-typedef std::shared_ptr<FluidParticle> FluidParticlePtr;
+typedef std::shared_ptr<SimulationObject3D> SimulationObject3DPtr;
 }
 #endif /* INCLUDE_FLUID_SIMULATIONOBJECTS_H_ */
@@ -0,0 +1,50 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "physics/fluid/SparseBlockGrid3D.h"
+namespace aly {
+void SparseBlockGrid3D::resize(const int3& d) {
+	dims = d;
+	blockDims = (dims + BLOCK_MASK) / BLOCK_SIZE;
+	blockIndex.assign((size_t) blockDims.x * blockDims.y * blockDims.z, -1);
+	blocks.clear();
+}
+void SparseBlockGrid3D::setActive(const std::vector<char>& mask) {
+	blocks.clear();
+	int slot = 0;
+	for (int k = 0; k < blockDims.z; k++) {
+		for (int j = 0; j < blockDims.y; j++) {
+			for (int i = 0; i < blockDims.x; i++) {
+				size_t b = i + (j + (size_t) k * blockDims.y) * blockDims.x;
+				if (mask[b]) {
+					blockIndex[b] = slot++;
+					blocks.push_back(int3(i, j, k));
+				} else {
+					blockIndex[b] = -1;
+				}
+			}
+		}
+	}
+}
+void SparseBlockGrid3D::clear() {
+	blockIndex.assign(blockIndex.size(), -1);
+	blocks.clear();
+}
+}
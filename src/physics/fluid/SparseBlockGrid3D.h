@@ -0,0 +1,155 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef INCLUDE_FLUID_SPARSEBLOCKGRID3D_H_
+#define INCLUDE_FLUID_SPARSEBLOCKGRID3D_H_
+#include "math/AlloyVecMath.h"
+#include <vector>
+namespace aly {
+/*
+ * Index map for a bounded 3D grid that only stores voxels inside active
+ * 8x8x8 blocks. Fields are plain vectors of size() entries addressed through
+ * index(), so every field on the same map shares one layout and solvers can
+ * run over the packed storage directly. Memory is one int per block plus the
+ * active voxels.
+ */
+class SparseBlockGrid3D {
+public:
+	static const int BLOCK_SHIFT = 3;
+	static const int BLOCK_SIZE = 1 << BLOCK_SHIFT;
+	static const int BLOCK_MASK = BLOCK_SIZE - 1;
+	static const int BLOCK_VOXELS = BLOCK_SIZE * BLOCK_SIZE * BLOCK_SIZE;
+protected:
+	int3 dims;
+	int3 blockDims;
+	//Slot of each block in the packed storage, or -1 if inactive.
+	std::vector<int> blockIndex;
+	//Block coordinates of each slot, ordered by block index.
+	std::vector<int3> blocks;
+public:
+	SparseBlockGrid3D() :
+			dims(0), blockDims(0) {
+	}
+	SparseBlockGrid3D(const int3& dims) {
+		resize(dims);
+	}
+	void resize(const int3& dims);
+	//One flag per block, x fastest. Slots of blocks that stay active may change.
+	void setActive(const std::vector<char>& mask);
+	void clear();
+	inline int3 getDimensions() const {
+		return dims;
+	}
+	inline int3 getBlockDimensions() const {
+		return blockDims;
+	}
+	inline size_t getBlockCount() const {
+		return blocks.size();
+	}
+	//Number of stored voxels.
+	inline size_t size() const {
+		return blocks.size() * BLOCK_VOXELS;
+	}
+	inline bool contains(int i, int j, int k) const {
+		return (i >= 0 && j >= 0 && k >= 0 && i < dims.x && j < dims.y && k < dims.z);
+	}
+	inline int getBlockSlot(int bi, int bj, int bk) const {
+		return blockIndex[bi + (bj + bk * blockDims.y) * blockDims.x];
+	}
+	//Voxel origin of the block in a slot.
+	inline int3 getBlockOrigin(size_t slot) const {
+		return blocks[slot] * BLOCK_SIZE;
+	}
+	//Packed index of voxel (i,j,k), or -1 if it is outside the grid or not active.
+	inline int index(int i, int j, int k) const {
+		if (!contains(i, j, k))
+			return -1;
+		int slot = getBlockSlot(i >> BLOCK_SHIFT, j >> BLOCK_SHIFT, k >> BLOCK_SHIFT);
+		if (slot < 0)
+			return -1;
+		return slot * BLOCK_VOXELS + (i & BLOCK_MASK) + ((j & BLOCK_MASK) << BLOCK_SHIFT)
+				+ ((k & BLOCK_MASK) << (2 * BLOCK_SHIFT));
+	}
+	inline int index(const int3& pos) const {
+		return index(pos.x, pos.y, pos.z);
+	}
+	//Voxel position of a packed index.
+	inline int3 position(size_t idx) const {
+		int local = (int) (idx & (BLOCK_VOXELS - 1));
+		return getBlockOrigin(idx / BLOCK_VOXELS)
+				+ int3(local & BLOCK_MASK, (local >> BLOCK_SHIFT) & BLOCK_MASK, local >> (2 * BLOCK_SHIFT));
+	}
+	template<class T> inline T get(const std::vector<T>& field, int i, int j, int k, const T& bg) const {
+		int idx = index(i, j, k);
+		return (idx >= 0) ? field[idx] : bg;
+	}
+	//Trilinear interpolation at a continuous voxel position, inactive voxels read as bg.
+	template<class T> T interpolate(const std::vector<T>& field, float x, float y, float z, const T& bg) const {
+		int i = (int) std::floor(x);
+		int j = (int) std::floor(y);
+		int k = (int) std::floor(z);
+		float fx = x - i;
+		float fy = y - j;
+		float fz = z - k;
+		T c00 = (1.0f - fx) * get(field, i, j, k, bg) + fx * get(field, i + 1, j, k, bg);
+		T c10 = (1.0f - fx) * get(field, i, j + 1, k, bg) + fx * get(field, i + 1, j + 1, k, bg);
+		T c01 = (1.0f - fx) * get(field, i, j, k + 1, bg) + fx * get(field, i + 1, j, k + 1, bg);
+		T c11 = (1.0f - fx) * get(field, i, j + 1, k + 1, bg) + fx * get(field, i + 1, j + 1, k + 1, bg);
+		return (1.0f - fz) * ((1.0f - fy) * c00 + fy * c10) + fz * ((1.0f - fy) * c01 + fy * c11);
+	}
+	//Calls f(idx, pos) for every stored voxel, in parallel over blocks.
+	template<class F> void forEachVoxel(const F& f) const {
+#pragma omp parallel for
+		for (int b = 0; b < (int) blocks.size(); b++) {
+			int3 origin = getBlockOrigin(b);
+			int idx = b * BLOCK_VOXELS;
+			for (int k = 0; k < BLOCK_SIZE; k++) {
+				for (int j = 0; j < BLOCK_SIZE; j++) {
+					for (int i = 0; i < BLOCK_SIZE; i++) {
+						f(idx++, origin + int3(i, j, k));
+					}
+				}
+			}
+		}
+	}
+	//Copies values from a field stored on another map with the same dimensions.
+	template<class T> void transfer(const SparseBlockGrid3D& src, const std::vector<T>& in, std::vector<T>& out,
+			const T& bg) const {
+		out.resize(size());
+#pragma omp parallel for
+		for (int b = 0; b < (int) blocks.size(); b++) {
+			int3 bp = blocks[b];
+			int slot = src.getBlockSlot(bp.x, bp.y, bp.z);
+			T* dest = &out[(size_t) b * BLOCK_VOXELS];
+			if (slot >= 0) {
+				const T* source = &in[(size_t) slot * BLOCK_VOXELS];
+				for (int n = 0; n < BLOCK_VOXELS; n++) {
+					dest[n] = source[n];
+				}
+			} else {
+				for (int n = 0; n < BLOCK_VOXELS; n++) {
+					dest[n] = bg;
+				}
+			}
+		}
+	}
+};
+}
+#endif
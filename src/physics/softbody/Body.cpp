@@ -10,6 +10,7 @@
 #include <stdlib.h>
 
 #include "physics/softbody/Region.h"
+#include "math/AlloyMatrixBatch.h"
 #include "physics/softbody/stdafx.h"
 namespace aly {
 	namespace softbody {
@@ -22,6 +23,7 @@ namespace aly {
 			fractureRotationTolerance = 999.0f;
 			defaultParticleMass = 1.0f;
 			w = 1;
+			fracturing = false;
 			kRegionDamping = 0.5f;
 			invariantsDirty = true;
 		}
@@ -55,15 +57,17 @@ namespace aly {
 			// Initialize particle
 			ParticlePtr particle(new Particle());
 			l->particle = particle.get();
+			particle->lp = l.get();
+			particle->index = (int)particles.size();
 			particles.push_back(particle);
-			l->particle->lp = l.get();
-			float3 pos = spacing * float3((float)index.x, (float)index.y, (float)index.z);;
-			l->particle->x0 = pos;
-			l->particle->mass = defaultParticleMass;
-			l->particle->x = pos;
-			l->particle->v = float3(0.0f);
-			l->particle->f = float3(0.0f);
-			l->particle->R = float3x3::identity();
+			float3 pos = spacing * float3((float)index.x, (float)index.y, (float)index.z);
+			restPositions.push_back(pos);
+			masses.push_back(defaultParticleMass);
+			positions.push_back(pos);
+			velocities.push_back(float3(0.0f));
+			forces.push_back(float3(0.0f));
+			goals.push_back(pos);
+			rotations.push_back(float3x3::identity());
 		}
 
 		void Body::finalize()
@@ -78,13 +82,14 @@ namespace aly {
 			}
 			// Generate the regions
 			generateSMRegions();
+			existentRegionTable.clear();
 			// Set the parent regions
 			for (RegionPtr r : regions) {
 				for (Particle* p : r->particles) {
 					p->parentRegions.push_back(r->lp);
 				}
 			}
-
+			updateSummationLinks();
 			calculateInvariants();
 			initializeCells();		// Cells help with rendering
 			updateCellPositions();
@@ -134,32 +139,109 @@ namespace aly {
 		}
 		void Body::calculateInvariants()
 		{
-
-			// Calculate perRegionMass
-			for (ParticlePtr particle : particles) {
-				particle->perRegionMass = particle->mass / particle->parentRegions.size();
+			int N = (int)particles.size();
+			int R = (int)regions.size();
+			perRegionMasses.resize(N);
+			particleSums.resize(N);
+			// Calculate perRegionMass, and use fast summation to calculate region properties
+#pragma omp parallel for
+			for (int i = 0; i < N; i++) {
+				int count = parentRegionCounts[i];
+				perRegionMasses[i] = (count > 0) ? masses[i] / count : 0.0f;
+				SumData& sum = particleSums[i];
+				sum.M(0, 0) = perRegionMasses[i];
+				sum.v = perRegionMasses[i] * restPositions[i];
+			}
+			sumParticlesToRegions();
+			regionMasses.resize(R);
+			regionRestCenters.resize(R);
+#pragma omp parallel for
+			for (int r = 0; r < R; r++) {
+				regionMasses[r] = regionSums[r].M(0, 0);
+				regionRestCenters[r] = regionSums[r].v / regionMasses[r];
 			}
+		}
 
-			// Calculate region properties
-			// Use fast summation
-			for (ParticlePtr p : particles) {
-				p->sumData.M(0, 0) = p->perRegionMass;
-				p->sumData.v = p->perRegionMass * p->x0;
-				//std::cout << "Particle Invariant " << p->sumData.v << " " << p->sumData.M(0, 0)<<std::endl;
+		// Hash the neighborhood so duplicate regions are found without comparing against every region
+		bool Body::addExistentRegion(LatticeLocation* l)
+		{
+			size_t hash = l->neighborhood.size();
+			for (LatticeLocation* n : l->neighborhood) {
+				hash ^= std::hash<LatticeLocation*>()(n) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+			}
+			auto range = existentRegionTable.equal_range(hash);
+			for (auto iter = range.first; iter != range.second; iter++) {
+				LatticeLocation* check = iter->second;
+				if (check->neighborhood.size() == l->neighborhood.size() && equal(l->neighborhood.begin(), l->neighborhood.end(), check->neighborhood.begin())) {
+					return false;
+				}
 			}
-			sumParticlesToRegions();
-			for (RegionPtr r : regions) {
-				r->M = r->sumData.M(0, 0);
-				r->Ex0 = r->sumData.v;
-				r->c0 = r->Ex0 / r->M;
-				//std::cout << "Region " << r->Ex0<<" "<<r->c0 << " " <<r->M << std::endl;
+			existentRegionTable.insert(std::make_pair(hash, l));
+			latticeLocationsWithExistentRegions.push_back(l);
+			return true;
+		}
 
+		template<class T> void LinkChildren(const std::vector<std::shared_ptr<T>>& nodes, SummationLinks& links)
+		{
+			links.clear();
+			for (const std::shared_ptr<T>& node : nodes) {
+				for (Summation* child : node->children) {
+					links.indexes.push_back(child->index);
+				}
+				links.offsets.push_back((int)links.indexes.size());
+			}
+		}
+		template<class T> void LinkParents(const std::vector<std::shared_ptr<T>>& nodes, SummationLinks& links)
+		{
+			links.clear();
+			for (const std::shared_ptr<T>& node : nodes) {
+				for (Summation* parent : node->parents) {
+					links.indexes.push_back(parent->index);
+				}
+				links.offsets.push_back((int)links.indexes.size());
+			}
+		}
+		// Order summations by their first child so each gather reads memory close to the previous one
+		void SortByFirstChild(std::vector<SummationPtr>& nodes)
+		{
+			std::vector<std::pair<int, SummationPtr>> keyed(nodes.size());
+			for (size_t n = 0; n < nodes.size(); n++) {
+				int key = std::numeric_limits<int>::max();
+				for (Summation* child : nodes[n]->children) {
+					key = std::min(key, child->index);
+				}
+				keyed[n] = std::make_pair(key, nodes[n]);
+			}
+			std::stable_sort(keyed.begin(), keyed.end(), [](const std::pair<int, SummationPtr>& a, const std::pair<int, SummationPtr>& b) {
+				return a.first < b.first;
+			});
+			for (size_t n = 0; n < nodes.size(); n++) {
+				nodes[n] = keyed[n].second;
+				nodes[n]->index = (int)n;
+			}
+		}
+		void Body::updateSummationLinks()
+		{
+			SortByFirstChild(sums[0]);
+			SortByFirstChild(sums[1]);
+			for (int n = 0; n < (int)regions.size(); n++) {
+				regions[n]->index = n;
+			}
+			LinkChildren(sums[0], barChildren);
+			LinkChildren(sums[1], plateChildren);
+			LinkChildren(regions, regionChildren);
+			LinkParents(sums[1], plateParents);
+			LinkParents(sums[0], barParents);
+			LinkParents(particles, particleParents);
+			parentRegionCounts.resize(particles.size());
+			for (ParticlePtr particle : particles) {
+				parentRegionCounts[particle->index] = (int)particle->parentRegions.size();
 			}
 		}
 
 		LatticeLocation* Body::getLatticeLocation(int3 index)
 		{
-			std::map<int3, LatticeLocationPtr>::iterator found = lattice.find(index);
+			auto found = lattice.find(index);
 			if (found == lattice.end()) return nullptr;
 			else return found->second.get();
 		}
@@ -180,12 +262,14 @@ namespace aly {
 					// Only do it in this case so we don't check the same links twice (just to save time)
 					if (neighbor < lp) {
 						bool broke = false;
+						int i = particle->index;
+						int j = neighbor->particle->index;
 
 						// Check DISTANCE tolerance
 						if (fractureDistanceTolerance < 99) {
-							float normalDist = length(neighbor->particle->x0 - particle->x0);
-							float goalDist = length(neighbor->particle->g - particle->g);
-							float posDist = length(neighbor->particle->x - particle->x);
+							float normalDist = length(restPositions[j] - restPositions[i]);
+							float goalDist = length(goals[j] - goals[i]);
+							float posDist = length(positions[j] - positions[i]);
 							float actualDist = goalDist * fractureGoalWeight + (1.0f - fractureGoalWeight) * posDist;
 
 							if (fabs(normalDist - actualDist) > fractureDistanceTolerance * normalDist) {
@@ -196,7 +280,7 @@ namespace aly {
 						if (broke == false && fractureRotationTolerance < 99) {
 							// Check ROTATION tolerance
 
-							float3x3 rotationalDifference = particle->R - neighbor->particle->R;
+							float3x3 rotationalDifference = rotations[i] - rotations[j];
 
 							float sum = 0;
 							for (int i = 0; i < 3; i++) {
@@ -341,26 +425,10 @@ namespace aly {
 			}
 		}
 		template <class T> void Remove(std::vector<std::shared_ptr<T>>& vecin, const T* t) {
-			for (auto iter = vecin.begin(); iter != vecin.end(); iter++) {
-				std::shared_ptr<T> val = *iter;
-				if (val.get() == t) {
-					vecin.erase(iter);
-					if (vecin.size() > 0) {
-						iter--;
-					}
-				}
-			}
-		}
-		template <class T> void Remove(std::list<std::shared_ptr<T>>& vecin, const T* t) {
-			for (auto iter = vecin.begin(); iter != vecin.end(); iter++) {
-				std::shared_ptr<T> val = *iter;
-				if (val.get() == t) {
-					vecin.erase(iter);
-					if (vecin.size() > 0) {
-						iter--;
-					}
-				}
-			}
+			auto new_end = std::remove_if(vecin.begin(), vecin.end(), [t](const std::shared_ptr<T>& val) {
+				return val.get() == t;
+			});
+			vecin.erase(new_end, vecin.end());
 		}
 
 		void Remove(std::vector<Summation*> &vec, const Summation *t)
@@ -537,6 +605,7 @@ namespace aly {
 					//  (though we should update it if we want to re-BFS regions)
 				}
 			}
+			updateSummationLinks();
 		}
 		void Body::shapeMatch()
 		{
@@ -546,54 +615,74 @@ namespace aly {
 				calculateInvariants();
 				invariantsDirty = false;
 			}
-
+			int N = (int)particles.size();
+			int R = (int)regions.size();
 			// Set each particle's sumData in preparation for calculating F(mixi) and F(mixi0T)
-			for (ParticlePtr particle : particles)
+			particleSums.resize(N);
+#pragma omp parallel for
+			for (int i = 0; i < N; i++)
 			{
-				particle->sumData.v = particle->perRegionMass * particle->x;
-				particle->sumData.M = outerProd(particle->perRegionMass * particle->x, particle->x0);
+				float3 mx = perRegionMasses[i] * positions[i];
+				particleSums[i].v = mx;
+				particleSums[i].M = outerProd(mx, restPositions[i]);
 			}
 
 			// Calculate F(mixi) and F(mixi0T)
 			sumParticlesToRegions();
 
-			int count = 0;
 			// Shape match
-			for (RegionPtr r : regions)
+			regionMatrices.resize(R);
+			regionCenters.resize(R);
+			regionRotations.resize(R);
+#pragma omp parallel for
+			for (int r = 0; r < R; r++)
+			{
+				float3 Fmixi = regionSums[r].v;
+				float3x3 Fmixi0T = regionSums[r].M;
+				float M = regionMasses[r];
+				float3 c = (1.0f / M) * Fmixi;									// Eqn. 9
+				regionCenters[r] = c;
+				regionMatrices[r] = Fmixi0T - outerProd(M * c, regionRestCenters[r]);		// Enq. 11
+			}
+			// Polar decomposition of every region at once
+			BatchFactorRotation(regionMatrices, regionResults);
+#pragma omp parallel for
+			for (int r = 0; r < R; r++)
 			{
-				float3 Fmixi = r->sumData.v;
-				float3x3 Fmixi0T = r->sumData.M;
-				r->c = (1.0f / r->M) * Fmixi;						// Eqn. 9
-				r->A = Fmixi0T - outerProd(r->M * r->c, r->c0);		// Enq. 11
-				r->R = FactorRotation(r->A);
+				float3x3 Rr = regionResults[r];
 				// Test for inversion (flipping of the rest configuration)
 				// Disabled for fracturing objects as it can cause some screwups with degenerate (planar, linear) regions
-				if (determinant(r->R) < 0 && fracturing == false)
+				if (determinant(Rr) < 0 && fracturing == false)
 				{
-					r->R *= -1.0f;
+					Rr *= -1.0f;
 				}
-
-				// Set the translation part
-				r->t = r->c - r->R * r->c0;
-
-				// Set the region's SumData in preparation for calculating F(Tr)
-				r->sumData.M = r->R;
-				r->sumData.v = r->t;
+				regionRotations[r] = Rr;
+				// Set the region's SumData in preparation for calculating F(Tr), with the translation part
+				regionSums[r].M = Rr;
+				regionSums[r].v = regionCenters[r] - Rr * regionRestCenters[r];
 			}
 
 			// Calculate F(Tr)
 			sumRegionsToParticles();
 
 			// Calculate goal positions for the particles
-			for (ParticlePtr particle : particles)
+#pragma omp parallel for
+			for (int i = 0; i < N; i++)
 			{
-				float invNumParentRegions = 1.0f / particle->parentRegions.size();
+				int count = parentRegionCounts[i];
+				if (count == 0)
+				{
+					goals[i] = positions[i];
+					rotations[i] = float3x3::identity();
+					continue;
+				}
+				float invNumParentRegions = 1.0f / count;
 
 				// Eqn. 12, split into rotation and translation
-				particle->g = (invNumParentRegions * particle->sumData.M) * particle->x0 + invNumParentRegions * particle->sumData.v;
+				goals[i] = (invNumParentRegions * particleSums[i].M) * restPositions[i] + invNumParentRegions * particleSums[i].v;
 
 				// Store just the rotational part too; it's useful for rendering
-				particle->R = invNumParentRegions * particle->sumData.M;
+				rotations[i] = invNumParentRegions * particleSums[i].M;
 			}
 		}
 
@@ -617,36 +706,38 @@ namespace aly {
 		{
 			if (kRegionDamping == 0.0)
 				return;
-
+			int N = (int)particles.size();
+			int R = (int)regions.size();
 			// Set the data needed to calculate F(mivi), F(mix~ivi) and F(mix~ix~iT)
-			for (ParticlePtr particle : particles)
+#pragma omp parallel for
+			for (int i = 0; i < N; i++)
 			{
+				SumData& sum = particleSums[i];
+				float m = perRegionMasses[i];
+				float3 x = positions[i];
 				// This is for F(mivi)
-				particle->sumData.v = particle->perRegionMass * particle->v;
+				sum.v = m * velocities[i];
 
 				// This is for F(mix~ivi)
-				particle->sumData.M.x = cross(particle->x, particle->sumData.v);
+				sum.M.x = cross(x, sum.v);
 
 				// This is for F(mix~ix~iT)
 				// We take advantage of the fact that this is a symmetric matrix to squeeze the data in the standard SumData
-				float3 x = particle->x;
-				particle->sumData.M(2, 1) = particle->perRegionMass * (x.z * x.z + x.y * x.y);
-				particle->sumData.M(0, 1) = particle->perRegionMass * (-x.x*x.y);
-				particle->sumData.M(0, 2) = particle->perRegionMass * (-x.x*x.z);
-				particle->sumData.M(1, 1) = particle->perRegionMass * (x.z*x.z + x.x*x.x);
-				particle->sumData.M(1, 2) = particle->perRegionMass * (-x.z*x.y);
-				particle->sumData.M(2, 2) = particle->perRegionMass * (x.y*x.y + x.x*x.x);
+				sum.M(2, 1) = m * (x.z * x.z + x.y * x.y);
+				sum.M(0, 1) = m * (-x.x*x.y);
+				sum.M(0, 2) = m * (-x.x*x.z);
+				sum.M(1, 1) = m * (x.z*x.z + x.x*x.x);
+				sum.M(1, 2) = m * (-x.z*x.y);
+				sum.M(2, 2) = m * (x.y*x.y + x.x*x.x);
 			}
 
 			sumParticlesToRegions();
-			for (RegionPtr region : regions)
+			regionMatrices.resize(R);
+#pragma omp parallel for
+			for (int r = 0; r < R; r++)
 			{
-				float3 v = float3(0.0f);
-				float3 L = float3(0.0f);
-				float3x3 I;
-
 				// Rebuild the original symmetric matrix from the reduced data
-				const float3x3 &M = region->sumData.M;
+				const float3x3 &M = regionSums[r].M;
 				float3x3 FmixixiT;
 				FmixixiT(0, 0) = M(2, 1);
 				FmixixiT(0, 1) = M(0, 1);
@@ -657,104 +748,103 @@ namespace aly {
 				FmixixiT(2, 0) = M(0, 2);
 				FmixixiT(2, 1) = M(1, 2);
 				FmixixiT(2, 2) = M(2, 2);
-
+				regionMatrices[r] = FmixixiT - regionMasses[r] * MrMatrix(regionCenters[r]);
+			}
+			// Invert the inertia tensors of every region at once
+			if (!BatchInverse(regionMatrices, regionResults))
+			{
+				throw std::runtime_error("Could not invert matrix.");
+			}
+#pragma omp parallel for
+			for (int r = 0; r < R; r++)
+			{
+				SumData& sum = regionSums[r];
+				float3 c = regionCenters[r];
 				// Calculate v, L, I, w
-				v = (1.0f / region->M) * region->sumData.v;							// Eqn. 14
-				L = M.x - cross(region->c, region->sumData.v);
-				I = FmixixiT - region->M * MrMatrix(region->c);
-
-				float3 w = inverse(I) * L;
+				float3 v = (1.0f / regionMasses[r]) * sum.v;							// Eqn. 14
+				float3 L = sum.M.x - cross(c, sum.v);
+				float3 w = regionResults[r] * L;
 
 				// Set the data needed to apply this to the particles
-				region->sumData.v = v;
-				region->sumData.M.x = w;
-				region->sumData.M.y = cross(w, region->c);
+				sum.v = v;
+				sum.M.x = w;
+				sum.M.y = cross(w, c);
 			}
 
 			sumRegionsToParticles();
 
 			// Apply calculated damping
-			for (ParticlePtr particle : particles)
+#pragma omp parallel for
+			for (int i = 0; i < N; i++)
 			{
-				if (particle->parentRegions.size() > 0)
+				int count = parentRegionCounts[i];
+				if (count > 0)
 				{
-					float3 Fv = particle->sumData.v;
-					float3 Fw = particle->sumData.M.x;
-					float3 Fwc = particle->sumData.M.y;
-					float3 dv = (1.0f / particle->parentRegions.size()) * (Fv + cross(Fw, particle->x) - Fwc - (float)particle->parentRegions.size() * particle->v);
+					float3 Fv = particleSums[i].v;
+					float3 Fw = particleSums[i].M.x;
+					float3 Fwc = particleSums[i].M.y;
+					float3 dv = (1.0f / count) * (Fv + cross(Fw, positions[i]) - Fwc - (float)count * velocities[i]);
 					// Bleed off non-rigid motion
-					particle->v = particle->v + kRegionDamping * dv;
+					velocities[i] = velocities[i] + kRegionDamping * dv;
 				}
 			}
 		}
 
 		void Body::calculateParticleVelocities(float h)
 		{
-			for (ParticlePtr particle : particles)
+			int N = (int)particles.size();
+#pragma omp parallel for
+			for (int i = 0; i < N; i++)
 			{
-				if (particle->parentRegions.size() == 0)
+				if (parentRegionCounts[i] == 0)
 				{
 					// We are just a lone particle flying about - no regions, so no goal position - so only account for fExt
-					particle->v = particle->v + h * (particle->f / particle->mass);
+					velocities[i] = velocities[i] + h * (forces[i] / masses[i]);
 
 					// Set the goal in case we want to render particle goals
-					particle->g = particle->x;
+					goals[i] = positions[i];
 				}
 				else
 				{
 					// We have a goal position
-					particle->v = particle->v + alpha * (particle->g - particle->x) / h + h * (particle->f / particle->mass);	// Eqn. 1
+					velocities[i] = velocities[i] + alpha * (goals[i] - positions[i]) / h + h * (forces[i] / masses[i]);	// Eqn. 1
 				}
-				particle->f = float3(0.0f);			// Zero the force accumulator
+				forces[i] = float3(0.0f);			// Zero the force accumulator
 			}
 		}
 
 		void Body::applyParticleVelocities(float h)
 		{
-			for (ParticlePtr particle : particles)
+			int N = (int)particles.size();
+#pragma omp parallel for
+			for (int i = 0; i < N; i++)
 			{
-				particle->x = particle->x + h * particle->v;		// Eqn. 2
+				positions[i] = positions[i] + h * velocities[i];		// Eqn. 2
 			}
 		}
 
 		void Body::updateCellPositions()
 		{
-			for (CellPtr cell : cells)
+#pragma omp parallel for
+			for (int n = 0; n < (int)cells.size(); n++)
 			{
-				cell->updateVertexPositions();
+				cells[n]->updateVertexPositions();
 			}
 		}
 
+		// Each level is a gather over the flattened links, so every pass runs in parallel without write conflicts
 		void Body::sumParticlesToRegions()
 		{
-			for (SummationPtr bar : sums[0])
-			{
-				bar->SumFromChildren();
-			}
-			for (SummationPtr plate : sums[1])
-			{
-				plate->SumFromChildren();
-			}
-			for (RegionPtr region : regions)
-			{
-				region->SumFromChildren();
-			}
+			GatherSums(particleSums, barChildren, barSums);
+			GatherSums(barSums, plateChildren, plateSums);
+			GatherSums(plateSums, regionChildren, regionSums);
 		}
 
 		void Body::sumRegionsToParticles()
 		{
-			for (SummationPtr plate : sums[1])
-			{
-				plate->SumFromParents();
-			}
-			for (SummationPtr bar : sums[0])
-			{
-				bar->SumFromParents();
-			}
-			for (ParticlePtr particle : particles)
-			{
-				particle->SumFromParents();
-			}
+			GatherSums(regionSums, plateParents, plateSums);
+			GatherSums(plateSums, barParents, barSums);
+			GatherSums(barSums, particleParents, particleSums);
 		}
 	}
 }
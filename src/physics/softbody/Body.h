@@ -1,8 +1,7 @@
 #ifndef PHYS_BODY_H
 #define PHYS_BODY_H
-#include <map>
+#include <unordered_map>
 #include <memory>
-#include <list>
 
 #include "physics/softbody/BrokenConnection.h"
 #include "physics/softbody/Cell.h"
@@ -24,9 +23,10 @@ namespace aly {
 			int w;
 			float3 spacing;				// The spacing of the particles in the lattice
 			float defaultParticleMass;
-			std::map<int3, std::shared_ptr<LatticeLocation>> lattice;
+			std::unordered_map<int3, std::shared_ptr<LatticeLocation>> lattice;
 			std::vector<std::shared_ptr<LatticeLocation>> latticeLocations;
 			std::vector<LatticeLocation*> latticeLocationsWithExistentRegions;
+			std::unordered_multimap<size_t, LatticeLocation*> existentRegionTable;	// latticeLocationsWithExistentRegions keyed by a hash of their neighborhood, for finding duplicates
 
 			// Fracture
 			bool fracturing;
@@ -37,14 +37,37 @@ namespace aly {
 			// Damping
 			float kRegionDamping;
 
-			// Elements
-			std::list<std::shared_ptr<Particle>> particles;
-			std::list<std::shared_ptr<Region>> regions;
+			// Elements (the Particle/Region/Summation objects hold topology only)
+			std::vector<std::shared_ptr<Particle>> particles;
+			std::vector<std::shared_ptr<Region>> regions;
 			// Intermediate summations
 			std::vector<std::shared_ptr<Summation>> sums[2];	// sums[0] = bars; sums[1] = plates
 
+			// Particle state, indexed by particle->index
+			std::vector<float> masses;
+			std::vector<float> perRegionMasses;		// The amount of mass that goes to each region = mass * (1.0 / numParentRegions)
+			std::vector<int> parentRegionCounts;
+			std::vector<float3> restPositions;
+			std::vector<float3> positions;
+			std::vector<float3> velocities;
+			std::vector<float3> forces;
+			std::vector<float3> goals;
+			std::vector<float3x3> rotations;		// The rotational component of the transformations of its parent regions -- useful in rendering
+
+			// Region state, indexed by region->index
+			std::vector<float> regionMasses;
+			std::vector<float3> regionRestCenters;
+			std::vector<float3> regionCenters;
+			std::vector<float3x3> regionRotations;
+
+			// The summation trees flattened into index lists, rebuilt whenever the topology changes
+			SummationLinks barChildren, plateChildren, regionChildren;		// Particles to regions
+			SummationLinks plateParents, barParents, particleParents;		// Regions to particles
+			std::vector<SumData> particleSums, barSums, plateSums, regionSums;
+
 												// Misc.
 			std::vector<std::shared_ptr<Cell>> cells;	// Useful for rendering - these are cubes centered at each particle with corners that deform appropriately
+			std::vector<float3x3> regionMatrices, regionResults;	// Scratch space for the batched per region rotation and inverse
 			bool invariantsDirty;		// Whether the invariants need to be recalculated -- simply set this to true after changing an invariant (e.g. particle mass) and the appropriate values will be recomputed automatically next time step
 
 										// Generation
@@ -69,6 +92,8 @@ namespace aly {
 			void calculateInvariants();
 			void initializeCells();
 			void rebuildRegions(std::vector<LatticeLocation*> &regen);		// Used in fracturing
+			void updateSummationLinks();	// Re-index the summation trees after they change
+			bool addExistentRegion(LatticeLocation* l);		// Returns false if another region has the same neighborhood
 			LatticeLocation* getLatticeLocation(int3 index);
 		};
 		template <class T> void Remove(std::vector<T> &vec, const T t)
@@ -22,7 +22,7 @@ namespace aly {
 
 				v->owner = this;
 				float3 &spacing = center->body->spacing;
-				v->materialPosition = center->particle->x0 + float3(spacing.x * ((float)vertexOffset[i].x - 0.5f), spacing.y * ((float)vertexOffset[i].y - 0.5f), spacing.z * ((float)vertexOffset[i].z - 0.5f));
+				v->materialPosition = center->body->restPositions[center->particle->index] + float3(spacing.x * ((float)vertexOffset[i].x - 0.5f), spacing.y * ((float)vertexOffset[i].y - 0.5f), spacing.z * ((float)vertexOffset[i].z - 0.5f));
 
 				// Set up the vertex's shareVertexCells
 				// The vertex's index
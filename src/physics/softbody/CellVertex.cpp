@@ -30,7 +30,7 @@ namespace aly {
 			{
 				if (shareVertexCells[i] != nullptr)
 				{
-					if (positionArbiter == nullptr || shareVertexCells[i]->center->particle < positionArbiter)
+					if (positionArbiter == nullptr || shareVertexCells[i]->center->particle->index < positionArbiter->index)
 					{
 						if (shareVertexCells[i] == owner || find(immediateNeighbors.begin(), immediateNeighbors.end(), shareVertexCells[i]->center) != immediateNeighbors.end())
 						{
@@ -38,7 +38,7 @@ namespace aly {
 							positionArbiterCell = shareVertexCells[i];
 							positionArbiter = shareVertexCells[i]->center->particle;
 							//positionArbiterParticleIndex = positionArbiter->particleIndex;
-							materialPositionOffset = positionArbiterVertex->materialPosition - positionArbiter->x0;
+							materialPositionOffset = positionArbiterVertex->materialPosition - owner->center->body->restPositions[positionArbiter->index];
 							materialPosition = positionArbiterVertex->materialPosition;
 							//return;
 						}
@@ -55,10 +55,12 @@ namespace aly {
 
 		void CellVertex::updatePosition()
 		{
+			const Body* body = owner->center->body;
+			int i = positionArbiter->index;
 			if (positionArbiter->parentRegions.size() <= 1)
-				position = positionArbiter->g + materialPositionOffset;	// Position arbiter does not have a rotation defined
+				position = body->goals[i] + materialPositionOffset;	// Position arbiter does not have a rotation defined
 			else
-				position = positionArbiter->g + positionArbiter->R * materialPositionOffset;
+				position = body->goals[i] + body->rotations[i] * materialPositionOffset;
 		}
 	}
 }
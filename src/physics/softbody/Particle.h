@@ -5,22 +5,13 @@
 namespace aly {
 	namespace softbody {
 
-		// The information pertaining to a particle. The dynamic data is stored in a SumData.
+		// The topology of a particle. Its mass, position, velocity, etc. are stored in the
+		//  Body's particle arrays at Summation::index, which never changes once the particle is added.
 		class Particle : public Summation
 		{
 		public:
-			// Properties
-			float mass;
-			float3 x0;
-			float perRegionMass;		// The amount of mass that goes to each region = mass * (1.0 / numParentRegions)
-			// Dynamic values
-			float3 x, v, f;
-			float3 g;
-			float3x3 R;				// The rotational component of the transformations of its parent regions -- useful in rendering
 			// Relations
 			std::vector<LatticeLocation *> parentRegions;
-			// Collision stuff
-			Particle *nextParticleInCollisionCell;	// Used in maintaining a linked list of particles in the collision cell
 		};
 		typedef std::shared_ptr<Particle> ParticlePtr;
 	}
@@ -1,6 +1,6 @@
 #ifndef PHYS_SUMDATA_H
 #define PHYS_SUMDATA_H
-#include <xmmintrin.h>
+#include <vector>
 #include "math/AlloyVecMath.h"
 namespace aly {
 	namespace softbody {
@@ -10,7 +10,6 @@ namespace aly {
 		//  during the shape matching, and (cr - Rrcr) during goal position calculation;
 		//  M will be EpmiT during shape matching but Rr
 		//  during goal position calculation.
-		//(align(16)) 
 		struct SumData
 		{
 			float3 v;
@@ -19,6 +18,25 @@ namespace aly {
 
 			}
 		};
+		static_assert(sizeof(SumData) == 12 * sizeof(float), "SumData must be packed for GatherSums()");
+
+		// One level of the summation hierarchy flattened into compressed rows. Entry n
+		//  sums the elements indexes[offsets[n]] ... indexes[offsets[n+1]-1] of the level below (or above).
+		struct SummationLinks
+		{
+			std::vector<int> offsets;
+			std::vector<int> indexes;
+			SummationLinks() :offsets(1, 0) {
+
+			}
+			size_t size() const {
+				return offsets.size() - 1;
+			}
+			void clear() {
+				offsets.assign(1, 0);
+				indexes.clear();
+			}
+		};
 	}
 }
 #endif
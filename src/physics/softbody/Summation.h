@@ -1,5 +1,6 @@
 #ifndef PHYS_SUMMATION_H
 #define PHYS_SUMMATION_H
+#include <memory>
 #include "physics/softbody/SumData.h"
 namespace aly{
 	namespace softbody {
@@ -10,6 +11,8 @@ namespace aly{
 		// Represents a region of the object that will be summed independently, usually as a
 		//  building block in generating the region sums. Defined principally by the list
 		//  of particles it contains. Will be responsible for generating its own children.
+		// The tree is only used to build and repair the topology; Body flattens it into
+		//  SummationLinks and does the actual sums on packed arrays.
 		class Summation		// Particle, XSum, XYSum, Region
 		{
 		public:
@@ -19,18 +22,16 @@ namespace aly{
 			std::vector<Particle*> particles;
 			std::vector<Summation*> children;
 			std::vector<Summation*> parents;
-			std::vector<Summation*>* connections[2];		// Pointers to above (children, parents)
 			int minDim, maxDim;			// The range along the split dimension
-			SumData sumData;
+			int index;					// Position in the packed arrays of this summation's level
 			Summation();
 			void FindParticleRange(int dimension, int *minDim, int *maxDim);
 			std::vector<std::shared_ptr<Summation>> GenerateChildSums(int childLevel);		// Returns the child summations that were generated
-			void SumFromChildren();
-			void SumFromParents();
-			void PerformSummation(int direction);		// Generalization
 			virtual ~Summation() {}
 		};
 		Summation *FindIdenticalSummation(std::vector<Particle*> &particles, int myLevel);		// myLevel is 0 for XSums, 1 for XYSums
+		// out[n] = sum of in[] over row n of links, computed in parallel over rows.
+		void GatherSums(const std::vector<SumData>& in, const SummationLinks& links, std::vector<SumData>& out);
 		typedef std::shared_ptr<Summation> SummationPtr;
 	}
 }
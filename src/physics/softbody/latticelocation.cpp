@@ -77,25 +77,12 @@ namespace aly {
 				//  become different as a result of fracturing, and it's faster to just generate them all at the start rather than doing
 				//  expensive tests for identicalness every time there is a fracture
 				regionExists = true;
+				body->latticeLocationsWithExistentRegions.push_back(this);
 			}
 			else
 			{
-				regionExists = true;
 				// Check if we are a duplicate
-				for (LatticeLocation* check : body->latticeLocationsWithExistentRegions)
-				{
-					if (check->neighborhood.size() == neighborhood.size() && equal(neighborhood.begin(), neighborhood.end(), check->neighborhood.begin()))
-					{
-						// We ARE a duplicate
-						regionExists = false;
-						break;
-					}
-				}
-			}
-
-			if (regionExists)
-			{
-				body->latticeLocationsWithExistentRegions.push_back(this);
+				regionExists = body->addExistentRegion(this);
 			}
 		}
 	}
@@ -0,0 +1,269 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "system/AlloyDirectoryIndex.h"
+#include <locale>
+namespace aly {
+#ifdef ALY_WINDOWS
+//Paths compare case insensitive on windows, same as AutoComplete.
+static bool PathCharLess(char c1, char c2) {
+	static const std::locale local;
+	return (std::tolower(c1, local) < std::tolower(c2, local));
+}
+static bool PathCharEqual(char c1, char c2) {
+	static const std::locale local;
+	return (std::tolower(c1, local) == std::tolower(c2, local));
+}
+#else
+static bool PathCharLess(char c1, char c2) {
+	return (c1 < c2);
+}
+static bool PathCharEqual(char c1, char c2) {
+	return (c1 == c2);
+}
+#endif
+static bool PathLess(const std::string& a, const std::string& b) {
+	return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), PathCharLess);
+}
+std::vector<FileDescription> DirectoryListing::autoComplete(const std::string& prefix, int maxSuggestions) const {
+	std::vector<FileDescription> suggestions;
+	auto iter = std::lower_bound(files.begin(), files.end(), prefix,
+			[](const FileDescription& fd, const std::string& str) {
+				return PathLess(fd.fileLocation, str);
+			});
+	for (; iter != files.end(); iter++) {
+		const std::string& location = iter->fileLocation;
+		if (location.size() < prefix.size()
+				|| !std::equal(prefix.begin(), prefix.end(), location.begin(), PathCharEqual)) {
+			break;
+		}
+		if (maxSuggestions >= 0 && (int) suggestions.size() >= maxSuggestions) {
+			break;
+		}
+		suggestions.push_back(*iter);
+	}
+	return suggestions;
+}
+std::vector<FileDescription> DirectoryListing::getDescriptions() const {
+	std::vector<FileDescription> descriptions;
+	descriptions.reserve(files.size());
+	for (const FileDescription& fd : files) {
+		if (fd.fileType == FileType::Directory) {
+			descriptions.push_back(fd);
+		}
+	}
+	for (const FileDescription& fd : files) {
+		if (fd.fileType != FileType::Directory) {
+			descriptions.push_back(fd);
+		}
+	}
+	return descriptions;
+}
+std::string DirectoryIndex::GetKey(const std::string& directory) {
+	return RemoveTrailingSlash(directory) + ALY_PATH_SEPARATOR;
+}
+DirectoryIndex::DirectoryIndex(size_t capacity) :
+		running(true), refreshCounter(0), useCounter(0), nextListenerId(0), capacity(capacity), refreshInterval(1.0) {
+	worker = std::thread([this] {
+		run();
+	});
+}
+DirectoryIndex::~DirectoryIndex() {
+	{
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		running = false;
+	}
+	wake.notify_all();
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+void DirectoryIndex::run() {
+	while (true) {
+		std::string directory;
+		uint64_t sequence;
+		{
+			std::unique_lock<std::mutex> lockMe(indexLock);
+			wake.wait(lockMe, [this] {
+				return (!running || queue.size() > 0);
+			});
+			if (!running)
+				return;
+			directory = queue.front();
+			queue.pop_front();
+			sequence = ++refreshCounter;
+		}
+		refresh(directory);
+		{
+			std::lock_guard<std::mutex> lockMe(indexLock);
+			lastRefreshed[directory] = sequence;
+		}
+		wake.notify_all();
+	}
+}
+void DirectoryIndex::refresh(const std::string& directory) {
+	std::string path = (directory.size() > 1) ? RemoveTrailingSlash(directory) : directory;
+	FileDescription dirDescription = GetFileDescription(path);
+	DirectoryListingPtr last;
+	bool stale;
+	{
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		auto iter = listings.find(directory);
+		if (iter != listings.end()) {
+			last = iter->second;
+		}
+		stale = (invalidated.erase(directory) > 0);
+	}
+	//Modification times have one second resolution, a listing taken in the same second as the last change is read again.
+	if (!stale && last.get() != nullptr && !last->partial && last->exists == (dirDescription.fileType == FileType::Directory)
+			&& last->lastModifiedTime == dirDescription.lastModifiedTime
+			&& last->listedTime > dirDescription.lastModifiedTime) {
+		return;
+	}
+	std::shared_ptr<DirectoryListing> listing(new DirectoryListing(directory));
+	listing->lastModifiedTime = dirDescription.lastModifiedTime;
+	listing->listedTime = std::time(nullptr);
+	size_t nextBatch = FIRST_BATCH;
+	std::vector<FileDescription> files;
+	listing->exists = ForEachDirectoryDescription(directory, [&](const FileDescription& fd) {
+		files.push_back(fd);
+		//Partial snapshots are published in doubling batches so copying them stays linear in the directory size.
+		if (files.size() >= nextBatch && last.get() == nullptr) {
+			std::shared_ptr<DirectoryListing> snapshot(new DirectoryListing(*listing));
+			snapshot->partial = true;
+			snapshot->files = files;
+			std::sort(snapshot->files.begin(), snapshot->files.end(),
+					[](const FileDescription& a, const FileDescription& b) {
+						return PathLess(a.fileLocation, b.fileLocation);
+					});
+			publish(snapshot);
+			nextBatch *= 2;
+		}
+		return (bool) running;
+	});
+	std::sort(files.begin(), files.end(), [](const FileDescription& a, const FileDescription& b) {
+		return PathLess(a.fileLocation, b.fileLocation);
+	});
+	listing->files.swap(files);
+	listing->partial = !running;
+	publish(listing);
+}
+void DirectoryIndex::publish(const DirectoryListingPtr& listing) {
+	{
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		listings[listing->directory] = listing;
+		evict();
+	}
+	std::lock_guard<std::mutex> lockMe(listenerLock);
+	for (auto& pr : listeners) {
+		pr.second(listing);
+	}
+}
+void DirectoryIndex::evict() {
+	while (listings.size() > capacity) {
+		auto oldest = listings.begin();
+		uint64_t oldestUse = lastUsed[oldest->first];
+		for (auto iter = listings.begin(); iter != listings.end(); iter++) {
+			uint64_t use = lastUsed[iter->first];
+			if (use < oldestUse) {
+				oldest = iter;
+				oldestUse = use;
+			}
+		}
+		lastUsed.erase(oldest->first);
+		lastChecked.erase(oldest->first);
+		lastRefreshed.erase(oldest->first);
+		invalidated.erase(oldest->first);
+		listings.erase(oldest);
+	}
+}
+DirectoryListingPtr DirectoryIndex::getListing(const std::string& directory) {
+	std::string key = GetKey(directory);
+	DirectoryListingPtr listing;
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		lastUsed[key] = useCounter++;
+		auto iter = listings.find(key);
+		if (iter != listings.end()) {
+			listing = iter->second;
+		}
+		auto checked = lastChecked.find(key);
+		auto now = std::chrono::steady_clock::now();
+		if (checked == lastChecked.end()
+				|| std::chrono::duration<double>(now - checked->second).count() > refreshInterval) {
+			//Most recent request first, it is the one the user is waiting on.
+			queue.remove(key);
+			queue.push_front(key);
+			lastChecked[key] = now;
+			queued = true;
+		}
+	}
+	if (queued) {
+		wake.notify_all();
+	}
+	return listing;
+}
+DirectoryListingPtr DirectoryIndex::waitForListing(const std::string& directory) {
+	std::string key = GetKey(directory);
+	std::unique_lock<std::mutex> lockMe(indexLock);
+	//A refresh of this directory that is already running started before the call, only later ones count.
+	uint64_t started = refreshCounter;
+	lastUsed[key] = useCounter++;
+	queue.remove(key);
+	queue.push_front(key);
+	lastChecked[key] = std::chrono::steady_clock::now();
+	wake.notify_all();
+	wake.wait(lockMe, [this,&key,started] {
+		auto refreshed = lastRefreshed.find(key);
+		return (!running || (refreshed != lastRefreshed.end() && refreshed->second > started));
+	});
+	auto iter = listings.find(key);
+	return (iter != listings.end()) ? iter->second : DirectoryListingPtr();
+}
+void DirectoryIndex::invalidate(const std::string& directory) {
+	std::lock_guard<std::mutex> lockMe(indexLock);
+	std::string key = GetKey(directory);
+	invalidated.insert(key);
+	lastChecked.erase(key);
+}
+void DirectoryIndex::clear() {
+	std::lock_guard<std::mutex> lockMe(indexLock);
+	listings.clear();
+	lastChecked.clear();
+	lastRefreshed.clear();
+	lastUsed.clear();
+	invalidated.clear();
+}
+int DirectoryIndex::addListener(const std::function<void(const DirectoryListingPtr&)>& func) {
+	std::lock_guard<std::mutex> lockMe(listenerLock);
+	int id = nextListenerId++;
+	listeners[id] = func;
+	return id;
+}
+void DirectoryIndex::removeListener(int id) {
+	std::lock_guard<std::mutex> lockMe(listenerLock);
+	listeners.erase(id);
+}
+DirectoryIndexPtr AlloyDirectoryIndex() {
+	static DirectoryIndexPtr index = DirectoryIndexPtr(new DirectoryIndex());
+	return index;
+}
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef ALLOYDIRECTORYINDEX_H_
+#define ALLOYDIRECTORYINDEX_H_
+#include "system/AlloyFileUtil.h"
+#include <memory>
+#include <map>
+#include <set>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+namespace aly {
+bool SANITY_CHECK_DIRECTORY_INDEX();
+/*
+ * Snapshot of a directory. Snapshots are immutable once published, a listing that
+ * is still being read is published as partial snapshots of increasing size.
+ */
+struct DirectoryListing {
+	//Directory with trailing separator.
+	std::string directory;
+	bool exists;
+	bool partial;
+	std::time_t lastModifiedTime;
+	std::time_t listedTime;
+	//Sorted by location, which is the prefix index used for completion.
+	std::vector<FileDescription> files;
+	DirectoryListing(const std::string& directory = "") :
+			directory(directory), exists(false), partial(false), lastModifiedTime(0), listedTime(0) {
+	}
+	//Entries whose location starts with prefix, in sorted order.
+	std::vector<FileDescription> autoComplete(const std::string& prefix, int maxSuggestions = -1) const;
+	//Directories first, then files, as GetDirectoryDescriptionListing orders them.
+	std::vector<FileDescription> getDescriptions() const;
+	size_t size() const {
+		return files.size();
+	}
+};
+typedef std::shared_ptr<const DirectoryListing> DirectoryListingPtr;
+/*
+ * Lists directories on a background thread and caches the result per directory.
+ * getListing() never touches the file system, it returns the cached snapshot and
+ * queues a check of the directory's modification time, the directory is read
+ * again only if it changed. Overwriting a file does not change the directory's
+ * modification time, call invalidate() to read the directory again regardless.
+ * Listeners are called on the worker thread each time a snapshot is published,
+ * so large directories stream in as they are read.
+ */
+class DirectoryIndex {
+public:
+	static const size_t FIRST_BATCH = 256;
+protected:
+	std::mutex indexLock;
+	//Held while listeners run, so no listener is running once removeListener() returns.
+	std::mutex listenerLock;
+	std::condition_variable wake;
+	std::thread worker;
+	std::atomic<bool> running;
+	std::list<std::string> queue;
+	std::map<std::string, DirectoryListingPtr> listings;
+	std::map<std::string, std::chrono::steady_clock::time_point> lastChecked;
+	//Sequence number of the last refresh of each directory, taken when the refresh started.
+	std::map<std::string, uint64_t> lastRefreshed;
+	//Directories to read again on their next refresh even if their modification time is unchanged.
+	std::set<std::string> invalidated;
+	uint64_t refreshCounter;
+	std::map<std::string, uint64_t> lastUsed;
+	std::map<int, std::function<void(const DirectoryListingPtr&)>> listeners;
+	uint64_t useCounter;
+	int nextListenerId;
+	size_t capacity;
+	double refreshInterval;
+	void run();
+	void refresh(const std::string& directory);
+	void publish(const DirectoryListingPtr& listing);
+	void evict();
+public:
+	static std::string GetKey(const std::string& directory);
+	DirectoryIndex(size_t capacity = 64);
+	~DirectoryIndex();
+	//Cached snapshot or nullptr, schedules a refresh if the snapshot is older than the refresh interval.
+	DirectoryListingPtr getListing(const std::string& directory);
+	//Blocks until a refresh that started after the call has completed and returns its listing.
+	DirectoryListingPtr waitForListing(const std::string& directory);
+	//Reads the directory again on its next refresh, the cached snapshot is returned until then.
+	void invalidate(const std::string& directory);
+	void clear();
+	//Minimum time in seconds between modification time checks of the same directory.
+	void setRefreshInterval(double seconds) {
+		refreshInterval = seconds;
+	}
+	//Listeners run on the worker thread and must not add or remove listeners.
+	int addListener(const std::function<void(const DirectoryListingPtr&)>& func);
+	void removeListener(int id);
+};
+typedef std::shared_ptr<DirectoryIndex> DirectoryIndexPtr;
+//Index shared by the file widgets.
+DirectoryIndexPtr AlloyDirectoryIndex();
+}
+#endif
@@ -257,6 +257,20 @@ void WriteBinaryFile(const std::string& str, const char* data, size_t elements)
 	} else
 		throw runtime_error(MakeString() << "Could not write " << str);
 }
+void WriteBinaryString(std::ostream& os, const std::string& str) {
+	uint64_t sz = str.size();
+	os.write((const char*) &sz, sizeof(uint64_t));
+	os.write(str.data(), (std::streamsize) sz);
+}
+std::string ReadBinaryString(std::istream& is) {
+	uint64_t sz = 0;
+	is.read((char*) &sz, sizeof(uint64_t));
+	std::string str(sz, ' ');
+	if (sz > 0) {
+		is.read(&str[0], (std::streamsize) sz);
+	}
+	return str;
+}
 bool FileExists(const std::string& name) {
 	try {
 		return (filesystem::internal::exists(name));
@@ -530,6 +544,48 @@ std::vector<FileDescription> GetDirectoryDescriptionListing(const std::string& d
 	files.insert(files.end(), filesOnly.begin(), filesOnly.end());
 	return files;
 }
+bool ForEachDirectoryDescription(const std::string& dirName,
+		const std::function<bool(const FileDescription& fd)>& visit) {
+	dirent* dp;
+	std::string cleanPath = RemoveTrailingSlash(dirName) + ALY_PATH_SEPARATOR;
+	DIR* dirp = opendir(cleanPath.c_str());
+	if (!dirp) {
+		return false;
+	}
+	while ((dp = readdir(dirp)) != NULL) {
+		string fileName(dp->d_name);
+		if (fileName == ".." || fileName == ".") {
+			continue;
+		}
+		std::string fileLocation = cleanPath + fileName;
+		struct stat attrib;
+		if (stat(fileLocation.c_str(), &attrib) != 0) {
+			continue;
+		}
+		//Resolves links and file systems that do not report d_type.
+		FileType type = FileType::Unknown;
+		if (S_ISREG(attrib.st_mode)) {
+			type = FileType::File;
+		} else if (S_ISDIR(attrib.st_mode)) {
+			type = FileType::Directory;
+		}
+#ifdef ALY_APPLE
+		std::time_t creationTime = attrib.st_ctimespec.tv_sec;
+		std::time_t accessTime = attrib.st_atimespec.tv_sec;
+		std::time_t modifiedTime = attrib.st_mtimespec.tv_sec;
+#else
+		std::time_t creationTime = attrib.st_ctim.tv_sec;
+		std::time_t accessTime = attrib.st_atim.tv_sec;
+		std::time_t modifiedTime = attrib.st_mtim.tv_sec;
+#endif
+		bool readOnly = attrib.st_mode & (S_IRWXU | S_IRWXG | S_IRWXO);
+		if (!visit(FileDescription(fileLocation, type, attrib.st_size, readOnly, creationTime, accessTime, modifiedTime))) {
+			break;
+		}
+	}
+	closedir(dirp);
+	return true;
+}
 std::vector<std::string> GetDirectoryListing(const std::string& dirName) {
 	std::vector<std::string> files;
 	dirent* dp;
@@ -567,6 +623,13 @@ std::string GetDownloadsDirectory() {
 
 	return GetHomeDirectory() + ALY_PATH_SEPARATOR+ "Downloads";
 }
+std::string GetTempDirectory() {
+	const char *tmpdir;
+	if ((tmpdir = getenv("TMPDIR")) == NULL) {
+		tmpdir = "/tmp";
+	}
+	return RemoveTrailingSlash(std::string(tmpdir));
+}
 std::string GetCurrentWorkingDirectory() {
 	char path[4096];
 	memset(path, 0, sizeof(path));
@@ -715,6 +778,44 @@ std::vector<FileDescription> GetDirectoryDescriptionListing(const std::string& d
 	files.insert(files.end(), filesOnly.begin(), filesOnly.end());
 	return files;
 }
+bool ForEachDirectoryDescription(const std::string& dirName,
+		const std::function<bool(const FileDescription& fd)>& visit) {
+	WIN32_FIND_DATAW fd;
+	std::string path = RemoveTrailingSlash(dirName);
+	std::wstring query = ToWString(path + ALY_PATH_SEPARATOR + string("*"));
+	HANDLE h = FindFirstFileW(query.c_str(), &fd);
+	if (h == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	do {
+		std::string fileName = ToString(fd.cFileName);
+		if (fileName != "." && fileName != "..")
+		{
+			std::string fileLocation = path + ALY_PATH_SEPARATOR + fileName;
+			FileType fileType = FileType::Unknown;
+			if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+				fileType = FileType::Directory;
+			}
+			else if (!(fd.dwFileAttributes & FILE_ATTRIBUTE_SYSTEM)) {
+				fileType = FileType::File;
+			}
+			if (fileType != FileType::Unknown) {
+				std::time_t creationTime = FileTimeToTime(fd.ftCreationTime);
+				std::time_t modifiedTime = FileTimeToTime(fd.ftLastWriteTime);
+				std::time_t accessTime = FileTimeToTime(fd.ftLastAccessTime);
+				ULARGE_INTEGER ull;
+				ull.LowPart = fd.nFileSizeLow;
+				ull.HighPart = fd.nFileSizeHigh;
+				size_t fileSize = (size_t)ull.QuadPart;
+				if (!visit(FileDescription(fileLocation, fileType, fileSize, fd.dwFileAttributes&&FILE_ATTRIBUTE_READONLY, creationTime, accessTime, modifiedTime))) {
+					break;
+				}
+			}
+		}
+	}while (FindNextFileW(h, &fd));
+	FindClose(h);
+	return true;
+}
 std::vector<std::string> GetDirectoryListing(const std::string& dirName) {
 	WIN32_FIND_DATAW fd;
 	std::string path = RemoveTrailingSlash(dirName);
@@ -814,6 +915,15 @@ std::string GetDownloadsDirectory()
 	return std::string();
 
 }
+std::string GetTempDirectory()
+{
+	WCHAR wszPath[MAX_PATH + 1];
+	DWORD len = GetTempPathW(MAX_PATH + 1, wszPath);
+	if (len > 0) {
+		return RemoveTrailingSlash(ToString(std::wstring(wszPath, len)));
+	}
+	return std::string();
+}
 std::string GetCurrentWorkingDirectory()
 {
 	wchar_t directory[4096];
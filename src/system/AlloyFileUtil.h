@@ -32,6 +32,7 @@
 #include <cstring>
 #include <iostream>
 #include <sstream>
+#include <functional>
 #include "system/sha1.h"
 #include "system/sha2.h"
 #ifndef _CRT_SECURE_NO_WARNINGS
@@ -111,11 +112,32 @@ namespace aly {
 	std::vector<FileDescription> GetDirectoryDescriptionListing(
 		const std::string& dirName);
 	std::vector<std::string> GetDirectoryListing(const std::string& dirName);
+	//Calls visit for each entry as it is read and stops if visit returns false. Returns false if the directory cannot be opened.
+	bool ForEachDirectoryDescription(const std::string& dirName,
+		const std::function<bool(const FileDescription& fd)>& visit);
 	std::string ReadTextFile(const std::string& str);
 	std::vector<char> ReadBinaryFile(const std::string& str);
 	void WriteTextFile(const std::string& file,const std::string& str);
 	void WriteBinaryFile(const std::string& str, const std::vector<char>& data);
 	void WriteBinaryFile(const std::string& str, const char* data, size_t size);
+	//Length prefixed raw blocks for fast binary caches. Not portable across platforms with different endianness.
+	template<class T> void WriteBinaryBlock(std::ostream& os, const std::vector<T>& data) {
+		uint64_t sz = data.size();
+		os.write((const char*) &sz, sizeof(uint64_t));
+		if (sz > 0) {
+			os.write((const char*) data.data(), (std::streamsize) (sz * sizeof(T)));
+		}
+	}
+	template<class T> void ReadBinaryBlock(std::istream& is, std::vector<T>& data) {
+		uint64_t sz = 0;
+		is.read((char*) &sz, sizeof(uint64_t));
+		data.resize(sz);
+		if (sz > 0) {
+			is.read((char*) data.data(), (std::streamsize) (sz * sizeof(T)));
+		}
+	}
+	void WriteBinaryString(std::ostream& os, const std::string& str);
+	std::string ReadBinaryString(std::istream& is);
 	bool FileExists(const std::string& name);
 	bool IsDirectory(const std::string& file);
 	bool IsFile(const std::string& file);
@@ -133,6 +155,7 @@ namespace aly {
 	std::string GetDesktopDirectory();
 	std::string GetDocumentsDirectory();
 	std::string GetExecutableDirectory();
+	std::string GetTempDirectory();
 	std::string GetUserNameString();
 	bool MakeDirectory(const std::string& dir);
 	std::vector<std::string> GetDrives();
@@ -8,6 +8,7 @@
  */
 #include "system/AlloyMemMappedFile.h"
 #include "system/AlloyFileUtil.h"
+#include "common/AlloyCommon.h"
 #ifdef ALY_WINDOWS
 	#include <windows.h>
 #else
@@ -303,4 +304,41 @@ namespace aly
         return true;
     #endif
     }
+
+    MemMapStreamBuffer::MemMapStreamBuffer(const std::string& path):file_(path)
+    {
+        char* begin = const_cast<char*>(file_.data());
+        if (begin == 0)
+        {
+            static char empty = 0;
+            begin = &empty;
+        }
+        setg(begin, begin, begin + file_.getMappedSize());
+    }
+
+    MemMapStreamBuffer::pos_type MemMapStreamBuffer::seekoff(off_type off,
+        std::ios_base::seekdir dir, std::ios_base::openmode which)
+    {
+        off_type base = 0;
+        if (dir == std::ios_base::cur) base = gptr() - eback();
+        else if (dir == std::ios_base::end) base = egptr() - eback();
+        return seekpos(pos_type(base + off), which);
+    }
+
+    MemMapStreamBuffer::pos_type MemMapStreamBuffer::seekpos(pos_type pos,
+        std::ios_base::openmode which)
+    {
+        off_type off = off_type(pos);
+        if (!(which & std::ios_base::in) || off < 0 || off > egptr() - eback())
+            return pos_type(off_type(-1));
+        setg(eback(), eback() + off, egptr());
+        return pos;
+    }
+
+    MemMapInputStream::MemMapInputStream(const std::string& path):std::istream(0),buffer_(path)
+    {
+        if (!buffer_.isOpen())
+            throw std::runtime_error(MakeString() << "Could not open " << path << " for reading.");
+        rdbuf(&buffer_);
+    }
 }
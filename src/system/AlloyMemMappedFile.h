@@ -109,5 +109,33 @@ namespace aly
         void map(size_t offset = 0, size_t size = 0);
         bool flush();
     };
+
+    // Read only istream over a whole mapped file. Binary archives read
+    // through sgetn, so payloads are copied straight from the mapped pages
+    // into their destination with no intermediate file buffer.
+    class MemMapStreamBuffer: public std::streambuf
+    {
+    public:
+        explicit MemMapStreamBuffer(const std::string& path);
+        // False if the file could not be opened or mapped in full.
+        bool isOpen() const { return file_.isOpen() && file_.getMappedSize() == file_.getFileSize(); }
+        size_t size() const { return file_.getMappedSize(); }
+    protected:
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override;
+        pos_type seekpos(pos_type pos,
+            std::ios_base::openmode which = std::ios_base::in) override;
+    private:
+        ReadableMemMapFile file_;
+    };
+
+    class MemMapInputStream: public std::istream
+    {
+    public:
+        // Throws if the file cannot be opened. Empty files read as empty streams.
+        explicit MemMapInputStream(const std::string& path);
+    private:
+        MemMapStreamBuffer buffer_;
+    };
 }
 #endif // MEMORY_MAPPED_FILE_HPP
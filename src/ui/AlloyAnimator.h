@@ -165,6 +165,9 @@ public:
 	void reset();
 	bool step(double dt);
 	bool firePostEvents();
+	bool isAnimating() const {
+		return (tweens[parity].size() > 0);
+	}
 	template<class A> std::shared_ptr<Tween>& add(AColor& out,
 			const Color& start, const Color& end, double duration, const A& a =
 					Linear()) {
@@ -61,8 +61,7 @@ void Application::initInternal() {
 			[](GLFWwindow * window, double xoffset, double yoffset ) {Application* app = (Application *)(glfwGetWindowUserPointer(window)); try {app->onScroll(xoffset, yoffset);} catch(...) {app->throwException(std::current_exception());}});
 	imageShader = std::shared_ptr<ImageShader>(
 			new ImageShader(ImageShader::Filter::NONE, true, context));
-	//uiFrameBuffer = std::shared_ptr<GLFrameBuffer>(new GLFrameBuffer(true, context));
-	//uiFrameBuffer->initialize(context->viewSize.x, context->viewSize.y);
+	uiFrameBuffer = std::shared_ptr<GLFrameBuffer>(new GLFrameBuffer(true, context));
 }
 std::shared_ptr<GLTextureRGBA> Application::loadTextureRGBA(
 		const std::string& partialFile) {
@@ -120,16 +119,13 @@ void Application::draw() {
 	nvgEndFrame(context->nvgContext);
 }
 void Application::drawUI() {
-	//if (context->dirtyUI) {
+	bool cached = (eventDriven && uiFrameBuffer.get() != nullptr);
+	if (!cached || context->dirtyUI) {
 		context->setCursor(nullptr);
-		/*
-		if (uiFrameBuffer->width() != context->screenSize.x
-				|| uiFrameBuffer->height() != context->screenSize.y) {
-			uiFrameBuffer->initialize(context->screenSize.x,
-					context->screenSize.y);
+		if (cached) {
+			uiFrameBuffer->initialize(context->screenSize.x, context->screenSize.y);
+			uiFrameBuffer->begin();
 		}
-		uiFrameBuffer->begin();
-*/
 		glViewport(0, 0, context->screenSize.x,context->screenSize.y);
 		NVGcontext* nvg = context->nvgContext;
 		nvgBeginFrame(nvg, context->screenSize.x,context->screenSize.y,1.0f); //(float) context->pixelRatio
@@ -141,15 +137,19 @@ void Application::drawUI() {
 			if (onTop->isVisible())
 				onTop->draw(context.get());
 		}
-		const Cursor* cursor = context->getCursor();
-		if (!cursor) {
-			cursor = &Cursor::Normal;
-		}
 		nvgEndFrame(nvg);
-		//uiFrameBuffer->end();
+		if (cached) {
+			uiFrameBuffer->end();
+		}
 		context->dirtyUI = false;
-	//}
-	//imageShader->draw(uiFrameBuffer->getTexture(), pixel2(0, 0),pixel2(context->viewSize));
+	}
+	if (cached) {
+		//NanoVG leaves premultiplied colors in the framebuffer.
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		imageShader->draw(uiFrameBuffer->getTexture(), context->getViewport(), 1.0f, false);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
 }
 void Application::drawDebugUI() {
 	NVGcontext* nvg = context->nvgContext;
@@ -330,8 +330,13 @@ void Application::fireEvent(const InputEvent& event) {
 			&& event.type != InputType::MouseButton
 			&& context->mouseDownRegion->isDragEnabled()) {
 		if (context->mouseDownRegion->onMouseDrag) {
+			uint64_t requests = context->regionPackRequests;
 			consumed |= context->mouseDownRegion->onMouseDrag(context.get(),
 					event);
+			//Handlers that queue their own region, like scroll handles, only need that region re-packed.
+			if (context->regionPackRequests == requests) {
+				context->requestPack();
+			}
 		} else {
 			if (	(context->leftMouseButton&&context->mouseDownRegion->getDragButton()==GLFW_MOUSE_BUTTON_LEFT)||
 					(context->rightMouseButton&&context->mouseDownRegion->getDragButton()==GLFW_MOUSE_BUTTON_RIGHT)||
@@ -340,8 +345,9 @@ void Application::fireEvent(const InputEvent& event) {
 				context->mouseDownRegion->setDragOffset(context->cursorPosition,
 						context->cursorDownPosition);
 			}
+			//Dragging only moves the region, so only the parent extents are affected.
+			context->requestPack(context->mouseDownRegion->parent);
 		}
-		context->requestPack();
 	} else if (context->mouseOverRegion != nullptr) {
 		if (event.type == InputType::MouseButton) {
 			if (event.isDown()) {
@@ -372,8 +378,8 @@ void Application::fireEvent(const InputEvent& event) {
 	if (!consumed) {
 		consumed = context->fireListeners(event);
 	}
-	if (consumed)
-		context->dirtyUI = true;
+	//Hover state can change on unconsumed input too.
+	context->dirtyUI = true;
 }
 
 void Application::onWindowSize(int width, int height) {
@@ -634,6 +640,25 @@ void Application::loadFonts(){
 	context->loadFont(FontType::AwesomeSolid, "solid_icons", "fonts/fa-solid.ttf");
 	context->loadFont(FontType::AwesomeBrands, "brands", "fonts/fa-brands.ttf");
 }
+bool Application::isFrameDirty() const {
+	return (context->dirtyUI || context->dirtyLayout || context->dirtyRegions.size() > 0 || context->redrawRequested || context->hasDeferredTasks()
+			|| context->animator.isAnimating());
+}
+void Application::waitEvents(double timeout) {
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 2)
+	glfwWaitEventsTimeout(timeout);
+#else
+	//No timed wait before GLFW 3.2, so poll in short slices until something is dirty.
+	std::chrono::steady_clock::time_point endWait = std::chrono::steady_clock::now()
+			+ std::chrono::microseconds((int64_t) (timeout * 1E6));
+	do {
+		glfwPollEvents();
+		if (isFrameDirty() || glfwWindowShouldClose(context->window))
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	} while (std::chrono::steady_clock::now() < endWait);
+#endif
+}
 void Application::run(int swapInterval) {
 	const double POLL_INTERVAL_SEC = 0.5f;
 	context->makeCurrent();
@@ -683,25 +708,46 @@ void Application::run(int swapInterval) {
 		context->dirtyLayout = true;
 		context->update(rootRegion);
 	}
+	std::chrono::steady_clock::time_point lastFrameTime = lastFpsTime;
 	do {
 		//Events could have modified layout! Pack before draw to make sure things are correctly positioned.
 		if (context->dirtyLayout) {
 			context->dirtyLayout = false;
 			context->dirtyCursorLocator = true;
 			rootRegion.pack();
+			context->clearDirtyRegions();
+		} else if (context->dirtyRegions.size() > 0) {
+			//Otherwise only pack the regions queued by requestPack(Region*) before drawing.
+			context->updateDirtyRegions(rootRegion);
 		}
-		draw();
-		context->update(rootRegion);
-		double elapsed =
-				std::chrono::duration<double>(endTime - lastFpsTime).count();
-		frameCounter++;
-		if (elapsed > POLL_INTERVAL_SEC) {
-			frameRate = (float) (frameCounter / elapsed);
-			lastFpsTime = endTime;
-			frameCounter = 0;
+		if (eventDriven && std::chrono::duration<double>(std::chrono::steady_clock::now() - lastFrameTime).count() >= idleTimeout) {
+			//Refresh widgets that changed without requesting a redraw.
+			context->dirtyUI = true;
+		}
+		if (!eventDriven || isFrameDirty()) {
+			context->redrawRequested = false;
+			draw();
+			context->update(rootRegion);
+			endTime = lastFrameTime = std::chrono::steady_clock::now();
+			double elapsed =
+					std::chrono::duration<double>(endTime - lastFpsTime).count();
+			frameCounter++;
+			if (elapsed > POLL_INTERVAL_SEC) {
+				frameRate = (float) (frameCounter / elapsed);
+				lastFpsTime = endTime;
+				frameCounter = 0;
+			}
+			glfwSwapBuffers(context->window);
+		} else {
+			context->update(rootRegion);
+		}
+		if (eventDriven && !isFrameDirty()) {
+			//Cursor and locator updates are throttled, so only wait until the next one is due.
+			bool pending = (context->dirtyCursor || context->dirtyCursorLocator);
+			waitEvents(pending ? context->UPDATE_CURSOR_INTERVAL_SEC : idleTimeout);
+		} else {
+			glfwPollEvents();
 		}
-		glfwSwapBuffers(context->window);
-		glfwPollEvents();
 		for (std::exception_ptr e : caughtExceptions) {
 			std::rethrow_exception(e);
 		}
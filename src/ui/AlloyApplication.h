@@ -46,10 +46,14 @@ private:
 	bool forceClose = false;
 	std::shared_ptr<ImageShader> imageShader;
 	std::list<std::exception_ptr> caughtExceptions;
-	//std::shared_ptr<GLFrameBuffer> uiFrameBuffer;
+	std::shared_ptr<GLFrameBuffer> uiFrameBuffer;
+	bool eventDriven = false;
+	double idleTimeout = 0.5;
 	std::function<void(const int2& dimensions)> onResize;
 	std::function<void()> onExit;
 	void initInternal();
+	bool isFrameDirty() const;
+	void waitEvents(double timeout);
 protected:
 	virtual void loadFonts();
 public:
@@ -60,6 +64,19 @@ public:
 	bool isForcedClose() const {
 		return forceClose;
 	}
+	/*
+	 * In event driven mode the main loop blocks until input, a deferred task, an
+	 * animation or AlloyContext::requestRedraw() needs a frame, and redraws at least
+	 * every timeout seconds. The UI layer is cached in a framebuffer and only
+	 * re-rendered when it is dirty.
+	 */
+	void setEventDriven(bool enable, double timeout = 0.5) {
+		eventDriven = enable;
+		idleTimeout = timeout;
+	}
+	bool isEventDriven() const {
+		return eventDriven;
+	}
 	void setOnResize(
 			const std::function<void(const int2& dimensions)>& onResizeEvent) {
 		onResize = onResizeEvent;
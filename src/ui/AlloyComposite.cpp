@@ -108,7 +108,7 @@ bool Composite::onEventHandler(AlloyContext* context, const InputEvent& event) {
 										(float) this->verticalScrollTrack->getBoundsDimensionsY()
 												- (float) this->verticalScrollHandle->getBoundsDimensionsY());
 				updateExtents();
-				context->requestPack();
+				context->requestPack(this);
 				return true;
 			}
 			if (event.scroll.x != 0 && horizontalScrollHandle.get() != nullptr
@@ -122,7 +122,7 @@ bool Composite::onEventHandler(AlloyContext* context, const InputEvent& event) {
 										(float) this->horizontalScrollTrack->getBoundsDimensionsX()
 												- (float) this->horizontalScrollHandle->getBoundsDimensionsX());
 				updateExtents();
-				context->requestPack();
+				context->requestPack(this);
 				return true;
 			}
 		}
@@ -370,7 +370,7 @@ bool Composite::addVerticalScrollPosition(float t) {
 								(float) this->verticalScrollTrack->getBoundsDimensionsY()
 										- (float) this->verticalScrollHandle->getBoundsDimensionsY());
 		updateExtents();
-		AlloyApplicationContext()->requestPack();
+		AlloyApplicationContext()->requestPack(this);
 		return true;
 	}
 	return false;
@@ -416,7 +416,7 @@ bool Composite::addHorizontalScrollPosition(float t) {
 								(float) this->horizontalScrollTrack->getBoundsDimensionsX()
 										- (float) this->horizontalScrollHandle->getBoundsDimensionsX());
 		updateExtents();
-		AlloyApplicationContext()->requestPack();
+		AlloyApplicationContext()->requestPack(this);
 		return true;
 	}
 	return false;
@@ -464,7 +464,7 @@ void Composite::pack(const pixel2& pos, const pixel2& dims, const double2& dpmm,
 							this->scrollPosition.y = (this->verticalScrollHandle->getBoundsPositionY() - this->verticalScrollTrack->getBoundsPositionY()) /
 							std::max(1.0f, (float)this->verticalScrollTrack->getBoundsDimensionsY() - (float)this->verticalScrollHandle->getBoundsDimensionsY());
 							updateExtents();
-							context->requestPack();
+							context->requestPack(this);
 							return false;
 						}
 						else {
@@ -480,6 +480,7 @@ void Composite::pack(const pixel2& pos, const pixel2& dims, const double2& dpmm,
 						this->scrollPosition.y = (this->verticalScrollHandle->getBoundsPositionY() - this->verticalScrollTrack->getBoundsPositionY()) /
 						std::max(1.0f, (float)this->verticalScrollTrack->getBoundsDimensionsY() - (float)this->verticalScrollHandle->getBoundsDimensionsY());
 						updateExtents();
+						context->requestPack(this);
 					}
 					return false;
 				};
@@ -506,7 +507,7 @@ void Composite::pack(const pixel2& pos, const pixel2& dims, const double2& dpmm,
 							this->scrollPosition.x = (this->horizontalScrollHandle->getBoundsPositionX() - this->horizontalScrollTrack->getBoundsPositionX()) /
 							std::max(1.0f, (float)this->horizontalScrollTrack->getBoundsDimensionsX() - (float)this->horizontalScrollHandle->getBoundsDimensionsX());
 							updateExtents();
-							context->requestPack();
+							context->requestPack(this);
 							return false;
 						}
 						else {
@@ -522,6 +523,7 @@ void Composite::pack(const pixel2& pos, const pixel2& dims, const double2& dpmm,
 						this->scrollPosition.x = (this->horizontalScrollHandle->getBoundsPositionX() - this->horizontalScrollTrack->getBoundsPositionX()) /
 						std::max(1.0f, (float)this->horizontalScrollTrack->getBoundsDimensionsX() - (float)this->horizontalScrollHandle->getBoundsDimensionsX());
 						updateExtents();
+						context->requestPack(this);
 					}
 					return false;
 				};
@@ -31,6 +31,7 @@
 
 #include <iostream>
 #include <chrono>
+#include <algorithm>
 
 int printOglError(const char *file, int line) {
 
@@ -580,6 +581,7 @@ void AlloyContext::addDeferredTask(const std::function<void()>& func,
 		bool block) {
 	std::lock_guard<std::mutex> guard(taskLock);
 	deferredTasks.push_back(func);
+	glfwPostEmptyEvent();
 	if (block) {
 		std::thread::id currentThread = std::this_thread::get_id();
 		if (currentThread != threadId) {
@@ -672,6 +674,11 @@ void AlloyContext::clearEvents(Region* region) {
 	if (onTopRegion != nullptr
 			&& (region == onTopRegion || onTopRegion->hasParent(region)))
 		onTopRegion = nullptr;
+	if (region->packRequested) {
+		dirtyRegions.erase(std::remove(dirtyRegions.begin(), dirtyRegions.end(), region), dirtyRegions.end());
+	}
+	//The locator may still reference the region, so incremental updates are not safe until it is rebuilt.
+	dirtyCursorLocator = true;
 }
 Region* AlloyContext::locate(const pixel2& cursor) const {
 	if (onTopRegion != nullptr) {
@@ -745,6 +752,7 @@ void AlloyContext::update(Composite& rootNode) {
 		mouseOverRegion = locate(cursorPosition);
 		dirtyCursor = false;
 		dirtyLayout = true;
+		dirtyUI = true;
 	}
 	if (updateElapsed > UPDATE_LOCATOR_INTERVAL_SEC) {
 		if (dirtyCursorLocator) {
@@ -753,6 +761,7 @@ void AlloyContext::update(Composite& rootNode) {
 			dirtyCursorLocator = false;
 			mouseOverRegion = locate(cursorPosition);
 			dirtyCursor = false;
+			dirtyUI = true;
 		}
 		lastUpdateTime = endTime;
 	}
@@ -760,8 +769,8 @@ void AlloyContext::update(Composite& rootNode) {
 		if (dirtyCursor && !dirtyCursorLocator) {
 			mouseOverRegion = locate(cursorPosition);
 			dirtyCursor = false;
+			dirtyUI = true;
 		}
-		dirtyUI = true;
 		lastCursorTime = endTime;
 	}
 	if (animateElapsed >= ANIMATE_INTERVAL_SEC) { //Dont try to animate faster than 60 fps.
@@ -773,12 +782,85 @@ void AlloyContext::update(Composite& rootNode) {
 	}
 	if (dirtyLayout) {
 		rootNode.pack(this);
+		clearDirtyRegions();
 		animator.firePostEvents();
 		dirtyCursorLocator = true;
 		dirtyLayout = false;
+		dirtyUI = true;
+	} else if (dirtyRegions.size() > 0) {
+		updateDirtyRegions(rootNode);
 	}
 
 }
+void AlloyContext::updateDirtyRegions(Composite& rootNode) {
+	std::vector<Region*> packed;
+	if (packDirtyRegions(packed)) {
+		if (!dirtyCursorLocator) {
+			for (Region* region : packed) {
+				if (!cursorLocator.update(region)) {
+					dirtyCursorLocator = true;
+					break;
+				}
+			}
+			if (!dirtyCursorLocator) {
+				mouseOverRegion = locate(cursorPosition);
+				dirtyCursor = false;
+			}
+		}
+	} else {
+		rootNode.pack(this);
+		dirtyCursorLocator = true;
+	}
+	animator.firePostEvents();
+	dirtyUI = true;
+}
+void AlloyContext::requestPack(Region* region) {
+	if (region == nullptr) {
+		dirtyLayout = true;
+		return;
+	}
+	regionPackRequests++;
+	if (!region->packRequested) {
+		region->packRequested = true;
+		dirtyRegions.push_back(region);
+	}
+}
+void AlloyContext::clearDirtyRegions() {
+	for (Region* region : dirtyRegions) {
+		region->packRequested = false;
+	}
+	dirtyRegions.clear();
+}
+bool AlloyContext::packDirtyRegions(std::vector<Region*>& packed) {
+	std::vector<Region*> roots;
+	for (Region* region : dirtyRegions) {
+		bool covered = false;
+		for (Region* p = region->parent; p != nullptr; p = p->parent) {
+			if (p->packRequested) {
+				covered = true;
+				break;
+			}
+		}
+		if (!covered)
+			roots.push_back(region);
+	}
+	clearDirtyRegions();
+	for (Region* region : roots) {
+		//Climb until the bounds stop changing, every parent above that is unaffected.
+		while (region != nullptr && !region->repack()) {
+			region = region->parent;
+		}
+		if (region == nullptr)
+			return false;
+		if (std::find(packed.begin(), packed.end(), region) == packed.end())
+			packed.push_back(region);
+	}
+	return true;
+}
+void AlloyContext::requestRedraw() {
+	redrawRequested = true;
+	glfwPostEmptyEvent();
+}
 void AlloyContext::makeCurrent() {
 	glfwMakeContextCurrent(window);
 }
@@ -39,6 +39,7 @@
 #endif
 #include <GLFW/glfw3.h>
 #include <mutex>
+#include <atomic>
 #include <memory>
 #include <list>
 #include <map>
@@ -152,9 +153,14 @@ namespace aly {
 		std::vector<std::shared_ptr<Font>> fonts;
 		std::list<GLFWwindow*> windowHistory;
 		bool dirtyLayout = false;
+		//Regions that asked to be re-packed on their own, see requestPack(Region*).
+		std::vector<Region*> dirtyRegions;
+		//Incremented by every requestPack(Region*), even for regions already queued.
+		uint64_t regionPackRequests = 0;
 		bool dirtyUI = true;
 		bool dirtyCursorLocator = false;
 		bool dirtyCursor = false;
+		std::atomic<bool> redrawRequested { false };
 		bool enableDebugInterface = false;
 		Animator animator;
 		CursorLocator cursorLocator;
@@ -181,6 +187,10 @@ namespace aly {
 		int2 viewSize;
 		int2 screenSize;
 		bool firingListeners;
+		bool packDirtyRegions(std::vector<Region*>& packed);
+		//Packs regions queued with requestPack(Region*) and updates the cursor locator for them.
+		void updateDirtyRegions(Composite& rootNode);
+		void clearDirtyRegions();
 		void addListener(EventHandler* region);
 		void removeListener(const EventHandler* region);
 		bool hasListener(EventHandler* region) const;
@@ -296,6 +306,8 @@ namespace aly {
 		void requestPack() {
 			dirtyLayout = true;
 		}
+		//Re-packs only this region and the ancestors whose layout depends on its bounds.
+		void requestPack(Region* region);
 		Region* locate(const pixel2& cursor) const;
 		void requestUpdateCursor() {
 			dirtyCursor = true;
@@ -380,6 +392,8 @@ namespace aly {
 		void repaintUI() {
 			dirtyUI = true;
 		}
+		//Thread safe. Draws at least one more frame and wakes an event driven main loop.
+		void requestRedraw();
 		void makeCurrent();
 		~AlloyContext();
 	};
@@ -20,6 +20,8 @@
  */
 #include "AlloyCursorLocator.h"
 #include "AlloyUI.h"
+#include <algorithm>
+#include <limits>
 namespace aly {
 void CursorLocator::reset(int2 viewportDims) {
 	//std::lock_guard<std::mutex> lockMe(lock);
@@ -30,27 +32,104 @@ void CursorLocator::reset(int2 viewportDims) {
 			grid[i][j].clear();
 		}
 	}
+	counter = 0;
 }
 void CursorLocator::add(Region* region) {
+	if (collecting) {
+		collected.push_back(region);
+		return;
+	}
 	box2px bounds = region->getCursorBounds();
 	if (bounds.dimensions.x * bounds.dimensions.y == 0)
 		return;
+	int order;
+	if (updating) {
+		if (freeIndex >= freeOrders.size()) {
+			overflow = true;
+			return;
+		}
+		order = freeOrders[freeIndex++];
+	} else {
+		order = counter++;
+	}
+	std::pair<int, Region*> entry(order, region);
 	int2 start = clamp(int2(bounds.position / cellSize), lowerBounds,
 			upperBounds);
 	int2 end = clamp(int2((bounds.position + bounds.dimensions) / cellSize),
 			lowerBounds, upperBounds);
 	for (int j = (int) start.y; j <= (int) end.y; j++) {
 		for (int i = (int) start.x; i <= (int) end.x; i++) {
-			grid[i][j].push_front(region);
+			std::vector<std::pair<int, Region*>>& cell = grid[i][j];
+			if (updating) {
+				cell.insert(std::upper_bound(cell.begin(), cell.end(), entry,
+						[](const std::pair<int, Region*>& a, const std::pair<int, Region*>& b) {
+							return a.first < b.first;
+						}), entry);
+			} else {
+				cell.push_back(entry);
+			}
 		}
 	}
 }
+bool CursorLocator::update(Region* root) {
+	//Scroll bars are not children of their composite, so walk the subtree to find what it adds.
+	collected.clear();
+	collecting = true;
+	root->updateCursor(this);
+	collecting = false;
+	std::sort(collected.begin(), collected.end());
+	//A subtree is added contiguously, so its orders span one range. Regions that were removed from the subtree since
+	//it was added are still inside that range, only compare orders and pointers because they may have been deleted.
+	int minOrder = std::numeric_limits<int>::max();
+	int maxOrder = std::numeric_limits<int>::min();
+	for (int j = 0; j < COLS; j++) {
+		for (int i = 0; i < ROWS; i++) {
+			for (const std::pair<int, Region*>& entry : grid[i][j]) {
+				if (std::binary_search(collected.begin(), collected.end(), entry.second)) {
+					minOrder = std::min(minOrder, entry.first);
+					maxOrder = std::max(maxOrder, entry.first);
+				}
+			}
+		}
+	}
+	if (minOrder > maxOrder) {
+		//Nothing of the subtree is in the grid, so there is no range to purge stale entries from.
+		collected.clear();
+		return false;
+	}
+	//Reusing the subtree's orders keeps its place relative to everything else.
+	freeOrders.clear();
+	for (int j = 0; j < COLS; j++) {
+		for (int i = 0; i < ROWS; i++) {
+			std::vector<std::pair<int, Region*>>& cell = grid[i][j];
+			cell.erase(std::remove_if(cell.begin(), cell.end(),
+					[this,minOrder,maxOrder](const std::pair<int, Region*>& entry) {
+						if (entry.first >= minOrder && entry.first <= maxOrder) {
+							freeOrders.push_back(entry.first);
+							return true;
+						}
+						return false;
+					}), cell.end());
+		}
+	}
+	collected.clear();
+	std::sort(freeOrders.begin(), freeOrders.end());
+	freeOrders.erase(std::unique(freeOrders.begin(), freeOrders.end()), freeOrders.end());
+	freeIndex = 0;
+	overflow = false;
+	updating = true;
+	root->updateCursor(this);
+	updating = false;
+	freeOrders.clear();
+	return !overflow;
+}
 Region* CursorLocator::locate(const pixel2& cursor) const {
 	if (cursor.x < 0 || cursor.y < 0)
 		return nullptr;
 	int2 query = clamp(int2(cursor / cellSize), lowerBounds, upperBounds);
-	for (Region* region : grid[(int) query.x][(int) query.y]) {
-		Region* over = region->locate(cursor);
+	const std::vector<std::pair<int, Region*>>& cell = grid[(int) query.x][(int) query.y];
+	for (auto iter = cell.rbegin(); iter != cell.rend(); iter++) {
+		Region* over = iter->second->locate(cursor);
 		if (over != nullptr)
 			return over;
 	}
@@ -58,4 +137,3 @@ Region* CursorLocator::locate(const pixel2& cursor) const {
 }
 
 }
-
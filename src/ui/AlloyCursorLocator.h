@@ -23,6 +23,7 @@
 #define ALLOYLOCATOR_H_
 
 #include <list>
+#include <vector>
 #include <mutex>
 
 #include "common/AlloyUnits.h"
@@ -32,16 +33,28 @@ class Region;
 class CursorLocator {
 	static const int ROWS = 32;
 	static const int COLS = 18;
-	std::list<Region*> grid[ROWS][COLS];
+	//Insertion order and region, sorted by order so the top most region is last.
+	std::vector<std::pair<int, Region*>> grid[ROWS][COLS];
 	const int2 lowerBounds = int2(0, 0);
 	const int2 upperBounds = int2(ROWS - 1, COLS - 1);
 	pixel2 cellSize;
+	int counter = 0;
+	//Orders released by update() and handed out again to the re-added subtree.
+	std::vector<int> freeOrders;
+	size_t freeIndex = 0;
+	std::vector<Region*> collected;
+	bool collecting = false;
+	bool updating = false;
+	bool overflow = false;
 	//std::mutex lock;
 public:
 	CursorLocator() {
 	}
 	void reset(int2 viewportDims);
 	void add(Region* region);
+	//Re-inserts a region and its children after they were re-packed, dropping entries of regions that left the subtree.
+	//Returns false if the subtree gained entries, in which case the locator must be rebuilt.
+	bool update(Region* region);
 	Region* locate(const pixel2& cursor) const;
 };
 }
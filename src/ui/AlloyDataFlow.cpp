@@ -1391,7 +1391,7 @@ namespace aly {
 			bool mouseOver = context->isMouseOver(this, true);
 			if (e.type == InputType::Scroll && mouseOver && !context->isMouseDown()) {
 				setScale(clamp(scale * (1.0f + e.scroll.y * 0.1f), 0.1f, 10.0f), e.cursor);
-				context->requestPack();
+				context->requestPack(this);
 				return true;
 			}
 			if (connectingPort != nullptr && e.type == InputType::MouseButton && e.isUp()) {
@@ -1469,9 +1469,9 @@ namespace aly {
 						pr.first->setDragOffset(e.cursor, pr.second);
 					}
 					dragAction = true;
-					context->requestPack();
+					context->requestPack(this);
 				} else if (e.type == InputType::MouseButton && e.isUp()) {
-					context->requestPack();
+					context->requestPack(this);
 					dragList.clear();
 					mouseDragNode = nullptr;
 					dragAction = false;
@@ -1997,7 +1997,7 @@ namespace aly {
 			forceSim->onStep = [this](float stepSize) {
 				AlloyContext* context = AlloyDefaultContext().get();
 				if (context) {
-					context->requestPack();
+					context->requestPack(this);
 				}
 			};
 			errorMessage = MessageDialogPtr(
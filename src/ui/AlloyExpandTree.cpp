@@ -124,6 +124,12 @@ namespace aly {
 
 		if (isExpanded()) {
 			for (TreeItemPtr& item : children) {
+				//Children are stacked top to bottom, only the one spanning pt can contain it.
+				box2px cbounds = item->getBounds();
+				if (pt.y < cbounds.position.y)
+					break;
+				if (pt.y >= cbounds.position.y + cbounds.dimensions.y)
+					continue;
 				TreeItem* selected = item->locate(context, pt,overArrow);
 				if (selected != nullptr)
 					return selected;
@@ -153,18 +159,20 @@ namespace aly {
 		return bounds;
 	}
 	box2px TreeItem::update(AlloyContext* context, const pixel2& offset) {
-		NVGcontext* nvg = context->nvgContext;
-		nvgTextAlign(nvg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
-		nvgFontSize(nvg, fontSize);
-		nvgFontFaceId(nvg, context->getFontHandle(FontType::Bold));
+		if (textWidth < 0) {
+			NVGcontext* nvg = context->nvgContext;
+			nvgTextAlign(nvg, NVG_ALIGN_LEFT | NVG_ALIGN_TOP);
+			nvgFontSize(nvg, fontSize);
+			nvgFontFaceId(nvg, context->getFontHandle(FontType::Bold));
+			textWidth = nvgTextBounds(nvg, 0, 0, name.c_str(), nullptr, nullptr);
+			nvgFontFaceId(nvg, context->getFontHandle(FontType::Icon));
+			iconWidth =
+				(iconCodeString.length() == 0) ?
+				0 :
+				nvgTextBounds(nvg, 0, 0, iconCodeString.c_str(), nullptr,
+					nullptr) + PADDING * 2;
+		}
 		spaceWidth = fontSize + PADDING * 2;
-		float textWidth = nvgTextBounds(nvg, 0, 0, name.c_str(), nullptr, nullptr);
-		nvgFontFaceId(nvg, context->getFontHandle(FontType::Icon));
-		float iconWidth =
-			(iconCodeString.length() == 0) ?
-			0 :
-			nvgTextBounds(nvg, 0, 0, iconCodeString.c_str(), nullptr,
-				nullptr) + PADDING * 2;
 		float th = (name.length() > 0) ? fontSize + PADDING * 2 : 0;
 		selectionBounds = box2px(offset,
 			pixel2(textWidth + iconWidth + spaceWidth + PADDING, th));
@@ -181,7 +189,7 @@ namespace aly {
 		return bounds;
 	}
 	TreeItem::TreeItem(const std::string& name, int iconCode, float fontSize) :
-		name(name), fontSize(fontSize),spaceWidth(0.0f), expanded(name.length() == 0) {
+		name(name), fontSize(fontSize),spaceWidth(0.0f),textWidth(-1.0f),iconWidth(0.0f), expanded(name.length() == 0) {
 		if (iconCode != 0) {
 			iconCodeString = CodePointToUTF8(iconCode);
 		}
@@ -207,22 +215,25 @@ namespace aly {
 	void TreeItem::draw(ExpandTree* tree, AlloyContext* context,
 		const pixel2& offset) {
 		box2px bounds = getBounds();
+		//Only the part of the tree inside the widget is drawn.
+		box2px view = tree->getBounds();
+		float viewTop = view.position.y;
+		float viewBottom = view.position.y + view.dimensions.y;
 		NVGcontext* nvg = context->nvgContext;
-		nvgFontFaceId(nvg, context->getFontHandle(FontType::Icon));
 		float spaceWidth = fontSize + PADDING * 2;
-		float iconWidth = 0;
 		static const std::string rightArrow = CodePointToUTF8(0xf0da);
 		static const std::string downArrow = CodePointToUTF8(0xf0d7);
 		pixel2 pt = bounds.position + offset;
 		bool selected = (tree->getSelectedItem() == this)&&!tree->isOverArrow();
-		nvgFontSize(nvg, fontSize);
+		bool rowVisible = (pt.y + selectionBounds.dimensions.y >= viewTop && pt.y <= viewBottom);
+		if (rowVisible) {
+			nvgFontFaceId(nvg, context->getFontHandle(FontType::Icon));
+			nvgFontSize(nvg, fontSize);
+		}
 		if(selected&&onSelect){
 			context->setCursor(&Cursor::Hand);
 		}
-		if (iconCodeString.length() > 0) {
-			iconWidth = nvgTextBounds(nvg, 0, 0, iconCodeString.c_str(), nullptr,
-				nullptr) + PADDING * 2;
-
+		if (rowVisible && iconCodeString.length() > 0) {
 			if (children.size() > 0 || onExpand) {
 				nvgTextAlign(nvg, NVG_ALIGN_CENTER | NVG_ALIGN_TOP);
 				if (tree->isOverArrow()) {
@@ -245,7 +256,7 @@ namespace aly {
 			nvgText(nvg, pt.x + spaceWidth, pt.y + PADDING, iconCodeString.c_str(),
 				nullptr);
 		}
-		if (name.length() > 0) {
+		if (rowVisible && name.length() > 0) {
 			if (selected) {
 				nvgFillColor(nvg, context->theme.LIGHTEST);
 			}
@@ -259,6 +270,12 @@ namespace aly {
 		}
 		if (expanded) {
 			for (TreeItemPtr& item : children) {
+				box2px cbounds = item->getBounds();
+				cbounds.position += offset;
+				if (cbounds.position.y > viewBottom)
+					break;
+				if (cbounds.position.y + cbounds.dimensions.y < viewTop)
+					continue;
 				item->draw(tree, context, offset);
 			}
 		}
@@ -31,6 +31,9 @@ namespace aly {
 		std::string iconCodeString;
 		float fontSize = 24;
 		float spaceWidth;
+		//Text and icon widths, measured once since name and icon do not change.
+		float textWidth;
+		float iconWidth;
 		box2px bounds;
 		box2px selectionBounds;
 		bool expanded;
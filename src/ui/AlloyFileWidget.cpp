@@ -22,6 +22,7 @@
 #include "ui/AlloyApplication.h"
 #include "ui/AlloyDrawUtil.h"
 #include <cctype>
+#include <set>
 namespace aly{
 bool ListEntry::onEventHandler(AlloyContext* context, const InputEvent& event) {
 	return Composite::onEventHandler(context, event);
@@ -81,6 +82,9 @@ void ListEntry::setIcon(int icon) {
 }
 bool ListBox::onMouseDown(ListEntry* entry, AlloyContext* context,
 		const InputEvent& e) {
+	if (isVirtual()) {
+		return onVirtualMouseDown(entry, context, e);
+	}
 	if (e.isDown()) {
 		if (e.button == GLFW_MOUSE_BUTTON_LEFT) {
 			if (enableMultiSelection) {
@@ -186,11 +190,27 @@ FileField::FileField(const std::string& name, const AUnit2D& position,
 		AlloyApplicationContext()->removeOnTopRegion(box);
 		std::string path = GetParentDirectory(lastValue);
 		this->setValue(path + box->getSelection(box->getSelectedIndex()));
+		setSuggestionDirectory("");
 		if (onTextEntered) {
 			onTextEntered(this);
 		}
 		return false;
 	};
+	indexListener = AlloyDirectoryIndex()->addListener([this](const DirectoryListingPtr& listing) {
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		if (listing->directory == suggestionDirectory) {
+			indexedListing = listing;
+			AlloyApplicationContext()->requestRedraw();
+		}
+	});
+}
+FileField::~FileField() {
+	AlloyDirectoryIndex()->removeListener(indexListener);
+}
+void FileField::setSuggestionDirectory(const std::string& dir) {
+	std::lock_guard<std::mutex> lockMe(indexLock);
+	suggestionDirectory = dir;
+	indexedListing.reset();
 }
 void FileField::setValue(const std::string& text) {
 
@@ -218,33 +238,39 @@ void FileField::setValue(const std::string& text) {
 void FileField::updateSuggestionBox(AlloyContext* context, bool forceValue) {
 	showCursor = true;
 	std::string root = GetParentDirectory(value);
-	std::vector<std::string> listing = GetDirectoryListing(root);
-	std::vector<std::string> suggestions = AutoComplete(value, listing);
+	//Cached listing from the directory index, if it is not ready yet the suggestions are updated in draw() once it is published.
+	DirectoryListingPtr listing = AlloyDirectoryIndex()->getListing(root);
+	setSuggestionDirectory(DirectoryIndex::GetKey(root));
+	std::vector<FileDescription> suggestions;
+	if (listing.get() != nullptr) {
+		suggestions = listing->autoComplete(value);
+	}
 	if (!autoSuggest) {
 		context->removeOnTopRegion(selectionBox.get());
 		selectionBox->setVisible(false);
 	} else {
 		if (suggestions.size() == 1 && forceValue) {
-			if (IsDirectory(suggestions[0])) {
+			if (suggestions[0].fileType == FileType::Directory) {
 				this->setValue(
-						RemoveTrailingSlash(suggestions[0]) + ALY_PATH_SEPARATOR);
+						RemoveTrailingSlash(suggestions[0].fileLocation) + ALY_PATH_SEPARATOR);
 			}
 			else {
-				this->setValue(suggestions[0]);
+				this->setValue(suggestions[0].fileLocation);
 			}
+			setSuggestionDirectory("");
 			context->removeOnTopRegion(selectionBox.get());
 			selectionBox->setVisible(false);
 		}
 		else {
 			std::vector<std::string>& labels = selectionBox->options;
 			labels.clear();
-			for (std::string f : suggestions) {
-				if (IsDirectory(f)) {
+			for (const FileDescription& fd : suggestions) {
+				if (fd.fileType == FileType::Directory) {
 					labels.push_back(
-							GetFileName(f) + ALY_PATH_SEPARATOR);
+							GetFileName(fd.fileLocation) + ALY_PATH_SEPARATOR);
 				}
 				else {
-					labels.push_back(GetFileName(f));
+					labels.push_back(GetFileName(fd.fileLocation));
 				}
 			}
 			if (labels.size() > 0) {
@@ -293,6 +319,7 @@ bool FileField::onEventHandler(AlloyContext* context, const InputEvent& e) {
 					break;
 				} else if (e.key == GLFW_KEY_ENTER) {
 					selectionBox->setVisible(false);
+					setSuggestionDirectory("");
 					showTimer.reset();
 				}
 			}
@@ -325,6 +352,14 @@ bool FileField::onEventHandler(AlloyContext* context, const InputEvent& e) {
 	return Region::onEventHandler(context, e);
 }
 void FileField::draw(AlloyContext* context) {
+	DirectoryListingPtr listing;
+	{
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		listing.swap(indexedListing);
+	}
+	if (listing.get() != nullptr && context->isFocused(this)) {
+		updateSuggestionBox(context, false);
+	}
 	Region::draw(context);
 	float ascender, descender, lineh;
 	std::vector<NVGglyphPosition> positions(value.size());
@@ -486,19 +521,14 @@ bool FileDialog::updateValidity() {
 	} else if (type == FileDialogType::SelectMultiDirectory) {
 		std::string file = fileLocation->getValue();
 		valid = true;
-		int count = 0;
-		for (std::shared_ptr<ListEntry> entry : directoryList->getEntries()) {
-			if (entry->isSelected()) {
-				count++;
-				std::string file =
-						dynamic_cast<FileEntry*>(entry.get())->fileDescription.fileLocation;
-				if (!IsDirectory(file)) {
-					valid = false;
-					break;
-				}
+		std::vector<std::string> files = getSelectedFiles();
+		for (const std::string& file : files) {
+			if (!IsDirectory(file)) {
+				valid = false;
+				break;
 			}
 		}
-		valid &= (count > 0);
+		valid &= (files.size() > 0);
 		if (valid) {
 			actionButton->backgroundColor = MakeColor(
 					AlloyApplicationContext()->theme.LIGHTER);
@@ -540,21 +570,16 @@ bool FileDialog::updateValidity() {
 			}
 		} else if (type == FileDialogType::OpenMultiFile) {
 			valid = true;
-			int count = 0;
-			for (std::shared_ptr<ListEntry> entry : directoryList->getEntries()) {
-				if (entry->isSelected()) {
-					count++;
-					std::string file =
-							dynamic_cast<FileEntry*>(entry.get())->fileDescription.fileLocation;
-					if (FileExists(file) && IsFile(file)
-							&& (rule == nullptr || rule->accept(file))) {
-					} else {
-						valid = false;
-						break;
-					}
+			std::vector<std::string> files = getSelectedFiles();
+			for (const std::string& file : files) {
+				if (FileExists(file) && IsFile(file)
+						&& (rule == nullptr || rule->accept(file))) {
+				} else {
+					valid = false;
+					break;
 				}
 			}
-			valid &= (count > 0);
+			valid &= (files.size() > 0);
 			if (valid) {
 				actionButton->backgroundColor = MakeColor(
 						AlloyApplicationContext()->theme.LIGHTER);
@@ -646,62 +671,67 @@ void FileDialog::setSelectedFile(const std::string& file,
 		dir = RemoveTrailingSlash(GetParentDirectory(file));
 		select = true;
 	}
-	std::vector<FileDescription> descriptions = GetDirectoryDescriptionListing(
-			dir);
-	int i = 0;
-	if (type == FileDialogType::SelectDirectory
-			|| type == FileDialogType::SelectMultiDirectory) {
-		if (!AlloyApplicationContext()->hasDeferredTasks()) {
-			if (dir != lastDirectory) {
-				directoryList->clearEntries();
-				//Fixes bug in padding out entry width.
-				AlloyApplicationContext()->getGlassPane()->pack();
-				for (FileDescription& fd : descriptions) {
-					if (!aly::IsDirectory(fd.fileLocation)) {
-						continue;
-					}
-					FileEntry* entry = new FileEntry(this,
-							MakeString() << "Entry " << i, fileEntryHeight);
-					directoryList->addEntry(std::shared_ptr<FileEntry>(entry));
-					entry->setValue(fd);
-					if (select && entry->fileDescription.fileLocation == file) {
-						entry->setSelected(true);
-					}
-					i++;
-				}
-			}
-			lastDirectory = dir;
-			updateValidity();
+	//Listing comes from the directory index, entries are rebuilt in draw() when a newer one is published.
+	{
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		indexedDirectory = DirectoryIndex::GetKey(dir);
+		selectedFile = file;
+		selectFile = select;
+	}
+	DirectoryListingPtr listing = AlloyDirectoryIndex()->getListing(dir);
+	if (!AlloyApplicationContext()->hasDeferredTasks()) {
+		if (dir != lastDirectory || listing != lastListing) {
+			updateEntries(listing);
 		}
-	} else {
+		lastDirectory = dir;
+		updateValidity();
+	}
+}
+void FileDialog::updateEntries(const DirectoryListingPtr& listing) {
+	std::set<std::string> selected;
+	if (lastListing.get() != nullptr && listing.get() != nullptr
+			&& lastListing->directory == listing->directory) {
+		std::vector<std::string> files = getSelectedFiles();
+		selected.insert(files.begin(), files.end());
+	}
+	if (selectFile) {
+		selected.insert(selectedFile);
+	}
+	lastListing = listing;
+	listedFiles.clear();
+	if (listing.get() != nullptr) {
 		FileFilterRule* rule =
 				(fileTypeSelect->getSelectedIndex() >= 0) ?
 						filterRules[fileTypeSelect->getSelectedIndex()].get() :
 						nullptr;
-		if (!AlloyApplicationContext()->hasDeferredTasks()) {
-			if (dir != lastDirectory) {
-				directoryList->clearEntries();
-				//Fixes bug in padding out entry width.
-				AlloyApplicationContext()->getGlassPane()->pack();
-				for (FileDescription& fd : descriptions) {
-					if (rule != nullptr && fd.fileType == FileType::File
-							&& !rule->accept(fd.fileLocation)) {
-						continue;
-					}
-					FileEntry* entry = new FileEntry(this,
-							MakeString() << "Entry " << i, fileEntryHeight);
-					directoryList->addEntry(std::shared_ptr<FileEntry>(entry));
-					entry->setValue(fd);
-					if (select && entry->fileDescription.fileLocation == file) {
-						entry->setSelected(true);
-					}
-					i++;
+		bool directoriesOnly = (type == FileDialogType::SelectDirectory
+				|| type == FileDialogType::SelectMultiDirectory);
+		for (const FileDescription& fd : listing->getDescriptions()) {
+			if (directoriesOnly) {
+				if (fd.fileType != FileType::Directory) {
+					continue;
 				}
+			} else if (rule != nullptr && fd.fileType == FileType::File
+					&& !rule->accept(fd.fileLocation)) {
+				continue;
 			}
-			lastDirectory = dir;
-			updateValidity();
+			listedFiles.push_back(fd);
+		}
+	}
+	//Entries are only created for rows in view, a new snapshot just changes the row count.
+	directoryList->setVirtualRowCount(listedFiles.size());
+	for (size_t row = 0; row < listedFiles.size(); row++) {
+		directoryList->setRowSelected(row, selected.find(listedFiles[row].fileLocation) != selected.end());
+	}
+}
+std::vector<std::string> FileDialog::getSelectedFiles() const {
+	std::vector<std::string> files;
+	for (size_t row : directoryList->getSelectedRows()) {
+		if (row < listedFiles.size()) {
+			files.push_back(listedFiles[row].fileLocation);
 		}
 	}
+	return files;
 }
 
 void FileSelector::setTextColor(const AColor& c) {
@@ -780,6 +810,13 @@ FileSelector::FileSelector(const std::string& name, const AUnit2D& pos,
 FileDialog::FileDialog(const std::string& name, const AUnit2D& pos,
 		const AUnit2D& dims, const FileDialogType& type, pixel fileEntryHeight) :
 		Composite(name, pos, dims), type(type), fileEntryHeight(fileEntryHeight) {
+	indexListener = AlloyDirectoryIndex()->addListener([this](const DirectoryListingPtr& listing) {
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		if (listing->directory == indexedDirectory) {
+			indexedListing = listing;
+			AlloyApplicationContext()->requestRedraw();
+		}
+	});
 	containerRegion = std::shared_ptr<BorderComposite>(
 			new BorderComposite("Container", CoordPX(0, 15),
 					CoordPerPX(1.0, 1.0, -15, -15)));
@@ -802,11 +839,7 @@ FileDialog::FileDialog(const std::string& name, const AUnit2D& pos,
 								files.push_back(this->getValue());
 							}
 							else {
-								for (std::shared_ptr<ListEntry> entry : directoryList->getEntries()) {
-									if (entry->isSelected()) {
-										files.push_back(dynamic_cast<FileEntry*>(entry.get())->fileDescription.fileLocation);
-									}
-								}
+								files = getSelectedFiles();
 							}
 							if (files.size() > 0)this->onSelect(files);
 						}
@@ -980,6 +1013,16 @@ FileDialog::FileDialog(const std::string& name, const AUnit2D& pos,
 	directoryList->setEnableMultiSelection(
 			type == FileDialogType::OpenMultiFile
 					|| type == FileDialogType::SelectMultiDirectory);
+	//Rows are the filtered listing, entries are recycled as they scroll out of view.
+	directoryList->setVirtualRows(0, fileEntryHeight,
+			[this](size_t row, const ListEntryPtr& recycled) {
+				std::shared_ptr<FileEntry> entry = std::dynamic_pointer_cast<FileEntry>(recycled);
+				if (entry.get() == nullptr) {
+					entry = std::shared_ptr<FileEntry>(new FileEntry(this, MakeString() << "Entry " << row, this->fileEntryHeight));
+				}
+				entry->setValue(listedFiles[row]);
+				return std::static_pointer_cast<ListEntry>(entry);
+			});
 	directoryList->onSelect =
 			[this](ListEntry* lentry, const InputEvent& e) {
 				if (e.clicks == 2&&this->type!=FileDialogType::SelectMultiDirectory) {
@@ -1016,10 +1059,9 @@ FileDialog::FileDialog(const std::string& name, const AUnit2D& pos,
 					}
 					else {
 						if (this->type != FileDialogType::OpenMultiFile && this->type!=FileDialogType::SelectMultiDirectory) {
-							ListEntry* entry = directoryList->getLastSelected();
-							if (entry != nullptr) {
-								fileLocation->setValue(
-										GetParentDirectory(dynamic_cast<FileEntry*>(entry)->fileDescription.fileLocation));
+							std::vector<std::string> files = getSelectedFiles();
+							if (files.size() > 0) {
+								fileLocation->setValue(GetParentDirectory(files.back()));
 							}
 						}
 						updateValidity();
@@ -1042,11 +1084,7 @@ FileDialog::FileDialog(const std::string& name, const AUnit2D& pos,
 									files.push_back(this->getValue());
 								}
 								else {
-									for (std::shared_ptr<ListEntry> entry : directoryList->getEntries()) {
-										if (entry->isSelected()) {
-											files.push_back(dynamic_cast<FileEntry*>(entry.get())->fileDescription.fileLocation);
-										}
-									}
+									files = getSelectedFiles();
 								}
 								if (files.size() > 0)this->onSelect(files);
 							}
@@ -1135,11 +1173,34 @@ void FileDialog::setValue(const std::string& file) {
 std::string FileDialog::getValue() const {
 	return fileLocation->getValue();
 }
+FileDialog::~FileDialog() {
+	AlloyDirectoryIndex()->removeListener(indexListener);
+}
 void FileDialog::update() {
 	lastDirectory = "";
 	updateDirectoryList();
 }
 void FileDialog::draw(AlloyContext* context) {
+	DirectoryListingPtr listing;
+	{
+		std::lock_guard<std::mutex> lockMe(indexLock);
+		listing.swap(indexedListing);
+	}
+	if (listing.get() != nullptr && listing != lastListing
+			&& listing->directory == DirectoryIndex::GetKey(lastDirectory)) {
+		if (context->hasDeferredTasks()) {
+			//Entries can't be rebuilt while a deferred task may still reference them, try again next frame.
+			std::lock_guard<std::mutex> lockMe(indexLock);
+			if (indexedListing.get() == nullptr) {
+				indexedListing = listing;
+			}
+			context->requestRedraw();
+		} else {
+			updateEntries(listing);
+			updateValidity();
+			context->requestPack();
+		}
+	}
 	NVGcontext* nvg = context->nvgContext;
 	box2px bounds = containerRegion->getBounds();
 
@@ -27,6 +27,7 @@
 #include "ui/AlloyButton.h"
 #include "ui/AlloySelectionBox.h"
 #include "system/AlloyFileUtil.h"
+#include "system/AlloyDirectoryIndex.h"
 namespace aly {
 class FileDialog;
 class FileEntry: public ListEntry {
@@ -48,7 +49,13 @@ protected:
 	bool autoSuggest;
 	bool directoryInput;
 	int preferredFieldSize;
+	//Directory the suggestions come from, listings streamed in by the index for it are picked up in draw().
+	std::mutex indexLock;
+	std::string suggestionDirectory;
+	DirectoryListingPtr indexedListing;
+	int indexListener;
 	void updateSuggestionBox(AlloyContext* context, bool forceValue);
+	void setSuggestionDirectory(const std::string& dir);
 public:
 	void setEnableAutoSugest(bool b) {
 		autoSuggest = b;
@@ -59,11 +66,11 @@ public:
 	AColor textColor = MakeColor(Theme::Default.LIGHTER);
 	virtual bool onEventHandler(AlloyContext* context, const InputEvent& event)
 			override;
-	virtual inline ~FileField() {
-	}
+	virtual ~FileField();
 	void hideDropDown(AlloyContext* context) {
 		selectionBox->setVisible(false);
 		context->removeOnTopRegion(selectionBox.get());
+		setSuggestionDirectory("");
 	}
 	FileField(const std::string& name, const AUnit2D& position,
 			const AUnit2D& dimensions,bool directoryInput=false);
@@ -115,7 +122,19 @@ private:
 	std::shared_ptr<IconButton> cancelButton;
 	std::shared_ptr<BorderComposite> containerRegion;
 	std::string lastDirectory;
+	//Listing shown in directoryList and the one most recently streamed in by the index.
+	std::mutex indexLock;
+	std::string indexedDirectory;
+	DirectoryListingPtr lastListing;
+	DirectoryListingPtr indexedListing;
+	//Rows of directoryList, the filtered descriptions of lastListing.
+	std::vector<FileDescription> listedFiles;
+	int indexListener;
+	std::string selectedFile;
+	bool selectFile = false;
 	void setSelectedFile(const std::string& file,bool changeDirectory=true);
+	void updateEntries(const DirectoryListingPtr& listing);
+	std::vector<std::string> getSelectedFiles() const;
 	const FileDialogType type;
 	pixel fileEntryHeight;
 	bool valid = false;
@@ -131,6 +150,7 @@ public:
 	virtual void draw(AlloyContext* context) override;
 	FileDialog(const std::string& name, const AUnit2D& pos, const AUnit2D& dims,
 			const FileDialogType& type, pixel fileEntryHeight = 30);
+	virtual ~FileDialog();
 	void update();
 	void setValue(const std::string& file);
 	std::string getValue() const;
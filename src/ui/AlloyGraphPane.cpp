@@ -21,6 +21,7 @@
 #include "AlloyGraphPane.h"
 #include "AlloyApplication.h"
 #include "AlloyDrawUtil.h"
+#include <cstring>
 namespace aly {
 	GraphPane::GraphPane(const std::string& name, const AUnit2D& pos, const AUnit2D& dims) :
 		Region(name, pos, dims) {
@@ -119,25 +120,51 @@ namespace aly {
 		}
 		nvgLineCap(nvg, NVG_ROUND);
 		nvgLineJoin(nvg, NVG_ROUND);
+		int columns = std::max(1, (int) std::ceil(gbounds.dimensions.x));
 		for (GraphDataPtr& curve : curves) {
-
 			const std::vector<float2>& points = curve->points;
 			if (points.size() > 1 && graphBounds.dimensions.x > 0.0f
 				&& graphBounds.dimensions.y > 0.0f) {
-				NVGcontext* nvg = context->nvgContext;
-				float2 last = points[0];
-				last = aly::clamp((last - graphBounds.position) / graphBounds.dimensions,0.0f,1.0f);
-				last.y = 1.0f - last.y;
-				last = last * gbounds.dimensions + gbounds.position;
-				nvgBeginPath(nvg);
-				nvgMoveTo(nvg, last.x, last.y);
-				for (int i = 1; i < (int)points.size(); i++) {
+				curve->updateEnvelope();
+				bool first = true;
+				auto lineTo = [&](size_t i) {
 					float2 pt = points[i];
 					pt = aly::clamp((pt - graphBounds.position) / graphBounds.dimensions, 0.0f, 1.0f);
 					pt.y = 1.0f - pt.y;
 					pt = pt * gbounds.dimensions + gbounds.position;
-					nvgLineTo(nvg, pt.x, pt.y);
-					last = pt;
+					if (first) {
+						nvgMoveTo(nvg, pt.x, pt.y);
+						first = false;
+					} else {
+						nvgLineTo(nvg, pt.x, pt.y);
+					}
+				};
+				size_t start = 0;
+				size_t end = points.size();
+				if (curve->isSortedX()) {
+					//Keep one point on each side of the visible range so lines enter and leave the graph.
+					start = curve->lowerBound(graphBounds.position.x);
+					start = (start > 0) ? start - 1 : 0;
+					end = std::min(points.size(), curve->lowerBound(graphBounds.position.x + graphBounds.dimensions.x) + 1);
+				}
+				nvgBeginPath(nvg);
+				if (!curve->isSortedX() || end - start <= (size_t) (2 * columns)) {
+					for (size_t i = start; i < end; i++) {
+						lineTo(i);
+					}
+				} else {
+					//At most the lowest and highest point of each pixel column, in the order they occur.
+					size_t i = start;
+					for (int c = 1; c <= columns && i < end; c++) {
+						size_t next = (c == columns) ? end :
+							std::min(end, std::max(i + 1, curve->lowerBound(graphBounds.position.x + graphBounds.dimensions.x * c / (float) columns)));
+						uint2 ext = curve->getExtrema(i, next);
+						lineTo(std::min(ext.x, ext.y));
+						if (ext.x != ext.y) {
+							lineTo(std::max(ext.x, ext.y));
+						}
+						i = next;
+					}
 				}
 				nvgStrokeWidth(nvg, 2.0f);
 				nvgStrokeColor(nvg, curve->color);
@@ -301,6 +328,114 @@ namespace aly {
 		return graphBounds;
 	}
 	const float GraphData::NO_INTERSECT = std::numeric_limits<float>::max();
+	void GraphData::merge(uint2& ext, uint32_t idx) const {
+		float y = points[idx].y;
+		if (y < points[ext.x].y) {
+			ext.x = idx;
+		}
+		if (y > points[ext.y].y) {
+			ext.y = idx;
+		}
+	}
+	bool GraphData::isEnvelopeStale() const {
+		if (envelopeSize == 0) {
+			return false;
+		}
+		if (points.size() < envelopeSize) {
+			return true;
+		}
+		//Bitwise so NaN points compare equal to themselves.
+		return (std::memcmp(&points[0], &firstCovered, sizeof(float2)) != 0
+				|| std::memcmp(&points[envelopeSize - 1], &lastCovered, sizeof(float2)) != 0);
+	}
+	void GraphData::updateEnvelope() {
+		size_t N = points.size();
+		if (isEnvelopeStale()) {
+			invalidateEnvelope();
+		}
+		if (N == envelopeSize) {
+			return;
+		}
+		if (sortedX) {
+			for (size_t i = std::max((size_t) 1, envelopeSize); i < N; i++) {
+				if (points[i].x < points[i - 1].x) {
+					sortedX = false;
+					break;
+				}
+			}
+		}
+		//Only blocks that contain appended points are recomputed.
+		for (int level = 0;; level++) {
+			int shift = ENVELOPE_SHIFT + level;
+			size_t blocks = ((N - 1) >> shift) + 1;
+			int firstBlock = (int) (envelopeSize >> shift);
+			if ((int) envelope.size() <= level) {
+				envelope.push_back(std::vector<uint2>());
+			}
+			std::vector<uint2>& blockExtrema = envelope[level];
+			blockExtrema.resize(blocks);
+			if (level == 0) {
+#pragma omp parallel for
+				for (int b = firstBlock; b < (int) blocks; b++) {
+					size_t st = (size_t) b << shift;
+					size_t ed = std::min(N, st + ((size_t) 1 << shift));
+					uint2 ext((uint32_t) st, (uint32_t) st);
+					for (size_t i = st + 1; i < ed; i++) {
+						merge(ext, (uint32_t) i);
+					}
+					blockExtrema[b] = ext;
+				}
+			} else {
+				const std::vector<uint2>& children = envelope[level - 1];
+				for (int b = firstBlock; b < (int) blocks; b++) {
+					uint2 ext = children[2 * b];
+					if (2 * b + 1 < (int) children.size()) {
+						merge(ext, children[2 * b + 1].x);
+						merge(ext, children[2 * b + 1].y);
+					}
+					blockExtrema[b] = ext;
+				}
+			}
+			if (blocks == 1) {
+				break;
+			}
+		}
+		envelopeSize = N;
+		firstCovered = points[0];
+		lastCovered = points[N - 1];
+	}
+	uint2 GraphData::getExtrema(size_t start, size_t end) const {
+		uint2 ext((uint32_t) start, (uint32_t) start);
+		size_t i = start + 1;
+		while (i < end) {
+			//Largest complete block that starts at i and ends inside the range.
+			int level = (int) envelope.size() - 1;
+			size_t blockSize = 0;
+			for (; level >= 0; level--) {
+				blockSize = (size_t) 1 << (ENVELOPE_SHIFT + level);
+				if ((i & (blockSize - 1)) == 0 && i + blockSize <= end
+					&& i + blockSize <= envelopeSize) {
+					break;
+				}
+			}
+			if (level >= 0) {
+				uint2 block = envelope[level][i >> (ENVELOPE_SHIFT + level)];
+				merge(ext, block.x);
+				merge(ext, block.y);
+				i += blockSize;
+			} else {
+				merge(ext, (uint32_t) i);
+				i++;
+			}
+		}
+		return ext;
+	}
+	size_t GraphData::lowerBound(float x) const {
+		return std::lower_bound(points.begin(), points.end(), x,
+			[](const float2& pt, float val) {
+			return pt.x < val;
+		}) - points.begin();
+	}
 	float GraphData::interpolate(float x) const {
 		if (points.size() < 2) {
 			return NO_INTERSECT;
@@ -311,16 +446,25 @@ namespace aly {
 		float y = 0;
 		int startX = 0;
 		int endX = (int)points.size() - 1;
-		for (int i = 1; i < (int)points.size(); i++) {
-			if (x < points[i].x) {
-				startX = i - 1;
-				break;
+		if (sortedX && envelopeSize == points.size() && !isEnvelopeStale()) {
+			//Last point not greater than x and first point not less than x.
+			endX = (int) lowerBound(x);
+			startX = (int) (std::upper_bound(points.begin(), points.end(), x,
+				[](float val, const float2& pt) {
+				return val < pt.x;
+			}) - points.begin()) - 1;
+		} else {
+			for (int i = 1; i < (int)points.size(); i++) {
+				if (x < points[i].x) {
+					startX = i - 1;
+					break;
+				}
 			}
-		}
-		for (int i = (int)points.size() - 2; i >= 0; i--) {
-			if (x > points[i].x) {
-				endX = i + 1;
-				break;
+			for (int i = (int)points.size() - 2; i >= 0; i--) {
+				if (x > points[i].x) {
+					endX = i + 1;
+					break;
+				}
 			}
 		}
 		if (startX == endX) {
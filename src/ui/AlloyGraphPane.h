@@ -28,10 +28,40 @@ namespace aly {
 		std::vector<float2> points;
 		std::vector<float2> markers;
 		static const float NO_INTERSECT;
+		//Points per block at the finest envelope level.
+		static const int ENVELOPE_SHIFT = 4;
+	protected:
+		//Index of the lowest and highest point in each block of 2^(ENVELOPE_SHIFT+level) points.
+		std::vector<std::vector<uint2>> envelope;
+		size_t envelopeSize;
+		//First and last point the envelope covers, used to detect points that were replaced rather than appended.
+		float2 firstCovered;
+		float2 lastCovered;
+		bool sortedX;
+		bool isEnvelopeStale() const;
+		void merge(uint2& ext, uint32_t idx) const;
+	public:
 		GraphData(const std::string& name = "", Color color = Color(200, 64, 64)) :
-			name(name), color(color) {
+			name(name), color(color), envelopeSize(0), sortedX(true) {
 
 		}
+		//Extends the envelope over points appended since the last call. The envelope is rebuilt if the
+		//points it covered shrank or their first or last point changed, such as for a sliding window.
+		void updateEnvelope();
+		//Call after points are changed other than by appending, if the first and last point may stay the same.
+		void invalidateEnvelope() {
+			envelope.clear();
+			envelopeSize = 0;
+			sortedX = true;
+		}
+		//Decimation and lookup by x need points in ascending x order.
+		bool isSortedX() const {
+			return sortedX;
+		}
+		//Indices of the lowest and highest point in [start,end), uses the envelope for points it covers.
+		uint2 getExtrema(size_t start, size_t end) const;
+		//First point with x not less than the argument.
+		size_t lowerBound(float x) const;
 		float interpolate(float x) const;
 	};
 	typedef std::shared_ptr<GraphData> GraphDataPtr;
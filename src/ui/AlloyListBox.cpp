@@ -25,6 +25,13 @@
 namespace aly{
 void ListBox::pack(const pixel2& pos, const pixel2& dims, const double2& dpmm,
 		double pixelRatio, bool clamp) {
+	if (isVirtual()) {
+		dirty = false;
+		Region::pack(pos, dims, dpmm, pixelRatio, clamp);
+		bindVirtualRows(getBounds(false));
+		Composite::pack(pos, dims, dpmm, pixelRatio, clamp);
+		return;
+	}
 	if (dirty) {
 		update();
 	}
@@ -48,7 +55,88 @@ void ListBox::pack(const pixel2& pos, const pixel2& dims, const double2& dpmm,
 	}
 	Composite::pack(pos, dims, dpmm, pixelRatio, clamp);
 }
+void ListBox::bindVirtualRows(const box2px& bounds) {
+	size_t rows = virtualRows.getRowCount();
+	float rowHeight = virtualEntryHeight + cellSpacing.y;
+	float extent = (rows > 0) ? 2 * cellPadding.y + rows * rowHeight - cellSpacing.y : 0.0f;
+	float offset = scrollPosition.y * std::max(0.0f, extent - bounds.dimensions.y);
+	size_t first = (size_t) clamp((int64_t) std::floor((offset - cellPadding.y) / rowHeight), (int64_t) 0, (int64_t) rows);
+	size_t last = (size_t) clamp((int64_t) std::ceil((offset + bounds.dimensions.y - cellPadding.y) / rowHeight) + 1,
+			(int64_t) first, (int64_t) rows);
+	virtualRows.bind(first, last, this, children, AlloyApplicationContext().get());
+	for (size_t row = first; row < last; row++) {
+		const ListEntryPtr& entry = virtualRows.getEntries()[row - first];
+		entry->position = CoordPX(cellPadding.x, cellPadding.y + row * rowHeight);
+		entry->dimensions = CoordPX(bounds.dimensions.x, virtualEntryHeight);
+	}
+	//Empty region at the end of the list so the scroll extent covers every row.
+	virtualExtent->position = CoordPX(0.0f, extent);
+	virtualExtent->dimensions = CoordPX(1.0f, 0.0f);
+	virtualExtent->parent = this;
+	children.push_back(virtualExtent);
+}
+void ListBox::setVirtualRows(size_t rows, float entryHeight,
+		const std::function<ListEntryPtr(size_t row, const ListEntryPtr& recycled)>& model) {
+	clearEntries();
+	clear();
+	virtualRows.setModel(model);
+	virtualEntryHeight = entryHeight;
+	if (virtualExtent.get() == nullptr) {
+		virtualExtent = RegionPtr(new Region(name + " Extent"));
+		virtualExtent->setIgnoreCursorEvents(true);
+	}
+	//Rows are placed by index, not stacked.
+	orientation = Orientation::Unspecified;
+	setVirtualRowCount(rows);
+}
+void ListBox::setVirtualRowCount(size_t rows) {
+	virtualRows.setRowCount(rows);
+	AlloyApplicationContext()->requestPack(this);
+}
+int ListBox::getRow(const ListEntry* entry) const {
+	return virtualRows.getRow(entry);
+}
+bool ListBox::isRowSelected(size_t row) const {
+	return virtualRows.isSelected(row);
+}
+void ListBox::setRowSelected(size_t row, bool selected) {
+	virtualRows.setSelected(row, selected);
+}
+std::vector<size_t> ListBox::getSelectedRows() const {
+	return virtualRows.getSelectedRows();
+}
+int ListBox::getEntryIndex(const float2& cursor) const {
+	if (isVirtual()) {
+		const std::vector<ListEntryPtr>& bound = virtualRows.getEntries();
+		for (size_t i = 0; i < bound.size(); i++) {
+			if (bound[i]->getBounds().contains(cursor)) {
+				return (int) (virtualRows.getFirstRow() + i);
+			}
+		}
+	} else {
+		for (size_t i = 0; i < listEntries.size(); i++) {
+			if (listEntries[i]->getBounds().contains(cursor)) {
+				return (int) i;
+			}
+		}
+	}
+	return -1;
+}
+bool ListBox::onVirtualMouseDown(ListEntry* entry, AlloyContext* context,
+		const InputEvent& e) {
+	if (!virtualRows.onMouseDown(entry, e, enableMultiSelection))
+		return false;
+	if (onSelect)
+		onSelect((e.button == GLFW_MOUSE_BUTTON_LEFT) ? entry : nullptr, e);
+	return true;
+}
 void ListBox::update() {
+	if (isVirtual()) {
+		virtualRows.setDirty();
+		dirty = false;
+		AlloyApplicationContext()->requestPack(this);
+		return;
+	}
 	clear();
 	lastSelected.clear();
 	AlloyContext* context = AlloyApplicationContext().get();
@@ -82,6 +170,7 @@ ListBox::ListBox(const std::string& name, const AUnit2D& pos,
 	startItem = -1;
 	endItem = -1;
 	downOffsetPosition = 0;
+	virtualEntryHeight = 30.0f;
 	backgroundColor = MakeColor(AlloyApplicationContext()->theme.LIGHTER);
 	borderColor = MakeColor(AlloyApplicationContext()->theme.DARK);
 	borderWidth = UnitPX(1.0f);
@@ -199,8 +288,9 @@ void ListEntry::draw(AlloyContext* context) {
 }
 
 bool ListBox::addVerticalScrollPosition(int c) {
-	if(listEntries.size()>0){
-		float t=c*(cellSpacing.y+listEntries.front()->entryHeight)*(this->verticalScrollTrack->getBoundsDimensionsY()-this->verticalScrollHandle->getBoundsDimensionsY())/std::max(1E-6f,extents.dimensions.y - bounds.dimensions.y);
+	if(listEntries.size()>0||virtualRows.getRowCount()>0){
+		float entryHeight=(isVirtual())?virtualEntryHeight:listEntries.front()->entryHeight;
+		float t=c*(cellSpacing.y+entryHeight)*(this->verticalScrollTrack->getBoundsDimensionsY()-this->verticalScrollHandle->getBoundsDimensionsY())/std::max(1E-6f,extents.dimensions.y - bounds.dimensions.y);
 		if (verticalScrollHandle->addDragOffset(pixel2(0.0f, t))) {
 			this->scrollPosition.y =
 					(this->verticalScrollHandle->getBoundsPositionY()
@@ -303,6 +393,11 @@ bool ListBox::onEventHandler(AlloyContext* context, const InputEvent& e) {
 	}
 	if (e.type == InputType::Key) {
 		if (e.isDown() && e.isControlDown() && e.key == GLFW_KEY_A
+				&& enableMultiSelection && isVirtual()) {
+			virtualRows.setAllSelected(true);
+			if (onSelect)
+				onSelect(nullptr, e);
+		} else if (e.isDown() && e.isControlDown() && e.key == GLFW_KEY_A
 				&& enableMultiSelection) {
 			for (auto entry : listEntries) {
 				if (!entry->isSelected()) {
@@ -313,7 +408,7 @@ bool ListBox::onEventHandler(AlloyContext* context, const InputEvent& e) {
 				}
 			}
 		}
-		if (e.isUp() && enableDelete && e.key == GLFW_KEY_DELETE) {
+		if (e.isUp() && enableDelete && !isVirtual() && e.key == GLFW_KEY_DELETE) {
 			if(e.isControlDown()){
 				removeAll();
 			} else {
@@ -343,41 +438,30 @@ bool ListBox::onEventHandler(AlloyContext* context, const InputEvent& e) {
 					downOffsetPosition = extents.position.y;
 				}
 				float2 cursorDown = context->getCursorDownPosition();
-				int index = 0;
 				if (startItem < 0) {
-					for (std::shared_ptr<ListEntry> entry : listEntries) {
-						if (entry->getBounds().contains(cursorDown)) {
-							startItem = index;
-							break;
-						}
-						index++;
-					}
+					startItem = getEntryIndex(cursorDown);
 				}
-				index = 0;
-				for (std::shared_ptr<ListEntry> entry : listEntries) {
-					if (entry->getBounds().contains(e.cursor)) {
-						endItem = index;
-						break;
-					}
-					index++;
+				int index = getEntryIndex(e.cursor);
+				if (index >= 0) {
+					endItem = index;
 				}
 
 			}
 		} else if (!context->isMouseDown()
 				&& e.type == InputType::MouseButton) {
 			if (enableMultiSelection) {
-				int index = 0;
-				for (std::shared_ptr<ListEntry> entry : listEntries) {
-					if (entry->getBounds().contains(e.cursor)) {
-						endItem = index;
-						break;
-					}
-					index++;
+				int index = getEntryIndex(e.cursor);
+				if (index >= 0) {
+					endItem = index;
 				}
 				if (endItem < startItem) {
 					std::swap(startItem, endItem);
 				}
-				if (startItem >= 0 && e.button == GLFW_MOUSE_BUTTON_LEFT) {
+				if (startItem >= 0 && e.button == GLFW_MOUSE_BUTTON_LEFT && isVirtual()) {
+					virtualRows.selectRange(startItem, endItem);
+					if (onSelect)
+						onSelect(nullptr, e);
+				} else if (startItem >= 0 && e.button == GLFW_MOUSE_BUTTON_LEFT) {
 					for (int i = startItem; i <= endItem; i++) {
 						std::shared_ptr<ListEntry> entry = listEntries[i];
 						if (!entry->isSelected()) {
@@ -393,6 +477,7 @@ bool ListBox::onEventHandler(AlloyContext* context, const InputEvent& e) {
 				for (std::shared_ptr<ListEntry> entry : listEntries) {
 					entry->setSelected(false);
 				}
+				virtualRows.setAllSelected(false);
 				lastSelected.clear();
 				if (onSelect) {
 					onSelect(nullptr, e);
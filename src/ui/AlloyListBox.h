@@ -27,6 +27,7 @@
 #include "ui/AlloyButton.h"
 #include "ui/AlloySlider.h"
 #include "ui/AlloyBorderComposite.h"
+#include "ui/AlloyVirtualRows.h"
 namespace aly{
 class ListBox;
 class ListEntry: public Composite {
@@ -76,6 +77,13 @@ protected:
 	bool dirty;
 	std::vector<std::shared_ptr<ListEntry>> listEntries;
 	std::list<ListEntry*> lastSelected;
+	VirtualRows<ListEntry> virtualRows;
+	float virtualEntryHeight;
+	RegionPtr virtualExtent;
+	void bindVirtualRows(const box2px& bounds);
+	//Index of the entry under the cursor, a row index in virtual mode.
+	int getEntryIndex(const float2& cursor) const;
+	bool onVirtualMouseDown(ListEntry* entry, AlloyContext* context, const InputEvent& e);
 
 	void addToActiveList(ListEntry* entry) {
 		lastSelected.push_back(entry);
@@ -108,6 +116,27 @@ public:
 		enableDelete=val;
 	}
 	void clearEntries();
+	/*
+	 * Virtual mode for long lists. Rows are not stored as entries, instead model is
+	 * called for each row that scrolls into view and may refill and return the recycled
+	 * entry rather than allocate a new one. Only the rows in the viewport exist as
+	 * widgets, the scroll extent comes from the row count and selection is kept by row.
+	 */
+	void setVirtualRows(size_t rows, float entryHeight,
+			const std::function<std::shared_ptr<ListEntry>(size_t row, const std::shared_ptr<ListEntry>& recycled)>& model);
+	//Call when the model changed. Visible rows are requested again and the selection is cleared if the row count changed.
+	void setVirtualRowCount(size_t rows);
+	bool isVirtual() const {
+		return virtualRows.isEnabled();
+	}
+	size_t getVirtualRowCount() const {
+		return virtualRows.getRowCount();
+	}
+	//Row shown by an entry in virtual mode, or -1 if the entry is not bound.
+	int getRow(const ListEntry* entry) const;
+	bool isRowSelected(size_t row) const;
+	void setRowSelected(size_t row, bool selected);
+	std::vector<size_t> getSelectedRows() const;
 	virtual bool onEventHandler(AlloyContext* context, const InputEvent& e) override;
 	ListEntry* getLastSelected() {
 		if (lastSelected.size() > 0)
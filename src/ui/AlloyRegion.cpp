@@ -47,7 +47,12 @@ void Composite::removeListener() const {
 }
 void Region::pack(const pixel2& pos, const pixel2& dims, const double2& dpmm,
 		double pixelRatio, bool clamp) {
-
+	packPosition = pos;
+	packDimensions = dims;
+	packDpmm = dpmm;
+	packPixelRatio = pixelRatio;
+	packClamp = clamp;
+	packValid = true;
 	pixel2 computedPos = position.toPixels(dims, dpmm, pixelRatio);
 //pixel2 xy = pos + dragOffset + computedPos;
 	pixel2 xy = pos + computedPos;
@@ -123,6 +128,10 @@ bool Region::isVisible() const {
 	return true;
 }
 void Region::setVisible(bool vis) {
+	if (vis && !visible) {
+		//Hidden regions are skipped during pack, so the cached arguments may be stale.
+		packValid = false;
+	}
 	visible = vis;
 	AlloyContext* context = AlloyDefaultContext().get();
 	if (context != nullptr) {
@@ -155,6 +164,13 @@ void Region::pack(AlloyContext* context) {
 void Region::pack() {
 	pack(AlloyApplicationContext().get());
 }
+bool Region::repack() {
+	if (!packValid)
+		return false;
+	box2px last = bounds;
+	pack(packPosition, packDimensions, packDpmm, packPixelRatio, packClamp);
+	return (last == bounds);
+}
 void Region::draw(AlloyContext* context) {
 	NVGcontext* nvg = context->nvgContext;
 	box2px bounds = getBounds();
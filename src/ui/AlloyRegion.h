@@ -46,11 +46,20 @@ protected:
 	bool roundCorners = false;
 	bool detached = false;
 	bool clampToParentBounds = false;
+	//Arguments of the last pack(), so the region can be re-packed without its parent.
+	pixel2 packPosition = pixel2(0, 0);
+	pixel2 packDimensions = pixel2(0, 0);
+	double2 packDpmm = double2(0, 0);
+	double packPixelRatio = 1.0;
+	bool packClamp = false;
+	bool packValid = false;
+	bool packRequested = false;
 public:
 	AUnit2D position = CoordPercent(0.0f, 0.0f);
 	AUnit2D dimensions = CoordPercent(1.0f, 1.0f);
 	friend class Composite;
 	friend class BorderComposite;
+	friend class AlloyContext;
 	const std::string name;
 	void setIgnoreCursorEvents(bool ignore) {
 		ignoreCursorEvents = ignore;
@@ -186,6 +195,8 @@ public:
 			const double2& dpmm, double pixelRatio, bool clamp = false);
 	virtual void pack(AlloyContext* context);
 	virtual void pack();
+	//Packs again with the arguments of the last pack(). Returns false if the region was never packed or its bounds changed, in which case the parent layout is stale too.
+	bool repack();
 	virtual void draw(AlloyContext* context);
 	virtual void updateCursor(CursorLocator* cursorLocator);
 	virtual void drawDebug(AlloyContext* context);
@@ -24,7 +24,7 @@
 namespace aly {
 LazyTableComposite::LazyTableComposite(const std::string& name,
 		const AUnit2D& pos, const AUnit2D& dims, float entryHeight) :
-		Composite(name, pos, dims), entryHeight(entryHeight) {
+		Composite(name, pos, dims), entryHeight(entryHeight), rowCount(0) {
 
 }
 TableRow::TableRow(TablePane* tablePane, const std::string& name) :
@@ -111,7 +111,15 @@ void TablePane::sortSelectedColumn() {
 }
 void TablePane::sortColumn(int c) {
 	int dir = sortDirections[c];
-	if (dir != 0) {
+	if (dir != 0 && isVirtual()) {
+		if (onSortRows) {
+			onSortRows(c, dir);
+			virtualRows.setAllSelected(false);
+			lastSelected.clear();
+			virtualRows.setDirty();
+			AlloyApplicationContext()->requestPack();
+		}
+	} else if (dir != 0) {
 		std::sort(rows.begin(), rows.end(),
 				[this,c,dir](const TableRowPtr& a, const TableRowPtr& b) {
 					return (a->compare(b, c)*dir>0);
@@ -173,8 +181,51 @@ std::shared_ptr<TableRow> TablePane::addRow(const std::string& name) {
 	addRow(row);
 	return row;
 }
+void TablePane::bindVirtualRows(size_t first, size_t last) {
+	virtualRows.bind(first, last, contentRegion.get(), contentRegion->children, AlloyApplicationContext().get());
+}
+void TablePane::setVirtualRows(size_t rows,
+		const std::function<TableRowPtr(size_t row, const TableRowPtr& recycled)>& model) {
+	clearRows();
+	contentRegion->clear();
+	virtualRows.setModel(model);
+	contentRegion->onBindRows = [this](size_t first, size_t last) {
+		bindVirtualRows(first, last);
+	};
+	setVirtualRowCount(rows);
+}
+void TablePane::setVirtualRowCount(size_t rows) {
+	if (virtualRows.setRowCount(rows)) {
+		lastSelected.clear();
+	}
+	contentRegion->setRowCount(rows);
+	AlloyApplicationContext()->requestPack(contentRegion.get());
+}
+int TablePane::getRow(const TableRow* entry) const {
+	return virtualRows.getRow(entry);
+}
+bool TablePane::isRowSelected(size_t row) const {
+	return virtualRows.isSelected(row);
+}
+void TablePane::setRowSelected(size_t row, bool selected) {
+	virtualRows.setSelected(row, selected);
+}
+std::vector<size_t> TablePane::getSelectedRows() const {
+	return virtualRows.getSelectedRows();
+}
+bool TablePane::onVirtualMouseDown(TableRow* entry, AlloyContext* context,
+		const InputEvent& e) {
+	if (!virtualRows.onMouseDown(entry, e, enableMultiSelection))
+		return false;
+	if (onSelect)
+		onSelect((e.button == GLFW_MOUSE_BUTTON_LEFT) ? entry : nullptr, e);
+	return true;
+}
 bool TablePane::onMouseDown(TableRow* entry, AlloyContext* context,
 		const InputEvent& e) {
+	if (isVirtual()) {
+		return onVirtualMouseDown(entry, context, e);
+	}
 	if (e.isDown()) {
 		if (e.button == GLFW_MOUSE_BUTTON_LEFT) {
 			if (enableMultiSelection) {
@@ -217,6 +268,12 @@ bool TablePane::onMouseDown(TableRow* entry, AlloyContext* context,
 }
 
 void TablePane::update() {
+	if (isVirtual()) {
+		virtualRows.setDirty();
+		dirty = false;
+		AlloyApplicationContext()->requestPack(contentRegion.get());
+		return;
+	}
 	contentRegion->clear();
 	lastSelected.clear();
 	AlloyContext* context = AlloyApplicationContext().get();
@@ -236,7 +293,7 @@ bool TablePane::onEventHandler(AlloyContext* context, const InputEvent& e) {
 	if (!context->isMouseOver(this, true))
 		return false;
 	if (e.type == InputType::MouseButton) {
-		for (TableRowPtr row : rows) {
+		for (TableRowPtr row : getBoundRows()) {
 			if (context->isMouseDown(row.get(), true)) {
 				onMouseDown(row.get(), context, e);
 				break;
@@ -244,7 +301,14 @@ bool TablePane::onEventHandler(AlloyContext* context, const InputEvent& e) {
 		}
 	}
 	if (e.type == InputType::Key) {
-		if (e.isDown() && e.isControlDown() && e.key == GLFW_KEY_A&& enableMultiSelection) {
+		if (e.isDown() && e.isControlDown() && e.key == GLFW_KEY_A&& enableMultiSelection&&isVirtual()) {
+			virtualRows.setAllSelected(true);
+			if (onSelect && virtualRows.getEntries().size() > 0)
+				onSelect(virtualRows.getEntries().back().get(), e);
+			dragBox = box2px(float2(0, 0), float2(0, 0));
+			context->requestPack();
+			return true;
+		} else if (e.isDown() && e.isControlDown() && e.key == GLFW_KEY_A&& enableMultiSelection) {
 			TableRow* lastEntry = nullptr;
 			for (std::shared_ptr<TableRow> entry : rows) {
 				if (!entry->isSelected()) {
@@ -291,11 +355,15 @@ bool TablePane::onEventHandler(AlloyContext* context, const InputEvent& e) {
 				&& e.type == InputType::MouseButton) {
 			if (enableMultiSelection) {
 				TableRow* lastEntry = nullptr;
-				for (std::shared_ptr<TableRow> entry : rows) {
+				for (std::shared_ptr<TableRow> entry : getBoundRows()) {
 					if (!entry->isSelected()) {
 						if (dragBox.intersects(entry->getBounds())) {
-							lastSelected.push_back(entry.get());
-							entry->setSelected(true);
+							if (isVirtual()) {
+								setRowSelected(getRow(entry.get()), true);
+							} else {
+								lastSelected.push_back(entry.get());
+								entry->setSelected(true);
+							}
 							lastEntry = entry.get();
 						}
 					}
@@ -380,7 +448,7 @@ void LazyTableComposite::pack(const pixel2& pos, const pixel2& dims,
 							this->scrollPosition.y = (this->verticalScrollHandle->getBoundsPositionY() - this->verticalScrollTrack->getBoundsPositionY()) /
 							std::max(1.0f, (float)this->verticalScrollTrack->getBoundsDimensionsY() - (float)this->verticalScrollHandle->getBoundsDimensionsY());
 							updateExtents();
-							context->requestPack();
+							context->requestPack(this);
 							return false;
 						}
 						else {
@@ -396,6 +464,7 @@ void LazyTableComposite::pack(const pixel2& pos, const pixel2& dims,
 						this->scrollPosition.y = (this->verticalScrollHandle->getBoundsPositionY() - this->verticalScrollTrack->getBoundsPositionY()) /
 						std::max(1.0f, (float)this->verticalScrollTrack->getBoundsDimensionsY() - (float)this->verticalScrollHandle->getBoundsDimensionsY());
 						updateExtents();
+						context->requestPack(this);
 					}
 					return false;
 				};
@@ -422,7 +491,7 @@ void LazyTableComposite::pack(const pixel2& pos, const pixel2& dims,
 							this->scrollPosition.x = (this->horizontalScrollHandle->getBoundsPositionX() - this->horizontalScrollTrack->getBoundsPositionX()) /
 							std::max(1.0f, (float)this->horizontalScrollTrack->getBoundsDimensionsX() - (float)this->horizontalScrollHandle->getBoundsDimensionsX());
 							updateExtents();
-							context->requestPack();
+							context->requestPack(this);
 							return false;
 						}
 						else {
@@ -438,18 +507,20 @@ void LazyTableComposite::pack(const pixel2& pos, const pixel2& dims,
 						this->scrollPosition.x = (this->horizontalScrollHandle->getBoundsPositionX() - this->horizontalScrollTrack->getBoundsPositionX()) /
 						std::max(1.0f, (float)this->horizontalScrollTrack->getBoundsDimensionsX() - (float)this->horizontalScrollHandle->getBoundsDimensionsX());
 						updateExtents();
+						context->requestPack(this);
 					}
 					return false;
 				};
 		Application::addListener(this);
 	}
 	pixel2 offset = cellPadding;
-
+	bool bindRows = (bool) onBindRows;
+	size_t count = (bindRows) ? rowCount : children.size();
 	extents.dimensions = pixel2(bounds.dimensions.x,
 			std::max(bounds.dimensions.y,
 					cellPadding.y
 							+ (entryHeight + cellSpacing.y)
-									* (int) children.size() - cellSpacing.y));
+									* (int) count - cellSpacing.y));
 	extents.position.y = scrollPosition.y
 			* std::max(0.0f, extents.dimensions.y - bounds.dimensions.y);
 
@@ -458,22 +529,29 @@ void LazyTableComposite::pack(const pixel2& pos, const pixel2& dims,
 					(extents.position.y - cellPadding.y)
 							/ (entryHeight + cellSpacing.y)));
 	size_t edIndex = std::max(0,
-			std::min((int) children.size(),
+			std::min((int) count,
 					(int) std::floor(
 							(extents.position.y + bounds.dimensions.y
 									- cellPadding.y)
 									/ (entryHeight + cellSpacing.y)) + 1));
 
-	for (size_t i = 0; i < stIndex; i++) {
-		std::shared_ptr<Region>& region = children[i];
+	stIndex = std::min(stIndex, edIndex);
+	//Row of children[0], bound children only cover the visible rows.
+	size_t base = 0;
+	if (bindRows) {
+		onBindRows(stIndex, edIndex);
+		base = stIndex;
+	}
+	for (size_t i = base; i < stIndex; i++) {
+		std::shared_ptr<Region>& region = children[i - base];
 		region->setVisible(false);
 	}
-	for (size_t i = edIndex; i < children.size(); i++) {
-		std::shared_ptr<Region>& region = children[i];
+	for (size_t i = edIndex; i < base + children.size(); i++) {
+		std::shared_ptr<Region>& region = children[i - base];
 		region->setVisible(false);
 	}
 	for (size_t i = stIndex; i < edIndex; i++) {
-		std::shared_ptr<Region>& region = children[i];
+		std::shared_ptr<Region>& region = children[i - base];
 		region->setVisible(true);
 		offset.y = i * (cellSpacing.y + entryHeight) + cellPadding.y;
 		if (orientation == Orientation::Vertical) {
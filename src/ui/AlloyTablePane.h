@@ -29,6 +29,7 @@
 #include "ui/AlloySelectionBox.h"
 #include "ui/AlloyToggleWidget.h"
 #include "ui/AlloyProgressBar.h"
+#include "ui/AlloyVirtualRows.h"
 #include <string>
 #include <vector>
 namespace aly {
@@ -193,7 +194,14 @@ namespace aly {
 	class LazyTableComposite: public Composite{
 	protected:
 		float entryHeight;
+		size_t rowCount;
 	public:
+		friend class TablePane;
+		//If set, rows are bound on demand. Called with the visible row range [first,last) and must leave exactly those rows as children.
+		std::function<void(size_t first, size_t last)> onBindRows;
+		void setRowCount(size_t count) {
+			rowCount = count;
+		}
 		bool addVerticalScrollPosition(int c);
 		virtual void scrollToTop() override;
 		virtual void scrollToBottom() override;
@@ -226,7 +234,14 @@ namespace aly {
 		std::vector<pixel> columnWidthPixels;
 		std::vector<int> sortDirections;
 		std::vector<bool> sortMask;
+		VirtualRows<TableRow> virtualRows;
 		void sortColumn(int c);
+		void bindVirtualRows(size_t first, size_t last);
+		bool onVirtualMouseDown(TableRow* entry, AlloyContext* context, const InputEvent& e);
+		//Rows that currently exist as widgets.
+		const std::vector<std::shared_ptr<TableRow>>& getBoundRows() const {
+			return (isVirtual()) ? virtualRows.getEntries() : rows;
+		}
 	public:
 		friend class TableRow;
 		box2px getDragBox() const {
@@ -255,6 +270,25 @@ namespace aly {
 			lastSelected.clear();
 			dirty = true;
 		}
+		/*
+		 * Virtual mode for large tables. Rows are requested from model only while they are
+		 * in the viewport, and model may refill and return the recycled row instead of
+		 * allocating one. Selection is kept by row index and sorting is forwarded to onSortRows.
+		 */
+		void setVirtualRows(size_t rows, const std::function<std::shared_ptr<TableRow>(size_t row, const std::shared_ptr<TableRow>& recycled)>& model);
+		//Call when the model changed. Visible rows are requested again and the selection is cleared if the row count changed.
+		void setVirtualRowCount(size_t rows);
+		bool isVirtual() const {
+			return virtualRows.isEnabled();
+		}
+		size_t getVirtualRowCount() const {
+			return virtualRows.getRowCount();
+		}
+		//Row shown by a table row in virtual mode, or -1 if it is not bound.
+		int getRow(const TableRow* entry) const;
+		bool isRowSelected(size_t row) const;
+		void setRowSelected(size_t row, bool selected);
+		std::vector<size_t> getSelectedRows() const;
 		TableRow* getLastSelected() {
 			if (lastSelected.size() > 0)
 				return lastSelected.back();
@@ -275,6 +309,8 @@ namespace aly {
 		}
 		bool onMouseDown(TableRow* entry, AlloyContext* context,const InputEvent& e);
 		std::function<void(TableRow*, const InputEvent&)> onSelect;
+		//Sorts the model in virtual mode, direction is -1 or 1.
+		std::function<void(int column, int direction)> onSortRows;
 	};
 
 	typedef std::shared_ptr<TablePane> TablePanePtr;
@@ -0,0 +1,215 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SRC_UI_ALLOYVIRTUALROWS_H_
+#define SRC_UI_ALLOYVIRTUALROWS_H_
+#include "ui/AlloyContext.h"
+#include "ui/AlloyRegion.h"
+#include "common/AlloyCommon.h"
+#include <functional>
+#include <algorithm>
+#include <vector>
+namespace aly {
+/*
+ * Row model, recycled widgets and selection for list and table views in virtual mode.
+ * Only rows in the viewport exist as widgets. Selection is kept by row index so it
+ * survives rows scrolling out of view. EntryT must provide setSelected(bool).
+ */
+template<class EntryT> class VirtualRows {
+public:
+	typedef std::shared_ptr<EntryT> EntryPtr;
+	typedef std::function<EntryPtr(size_t row, const EntryPtr& recycled)> ModelFunction;
+protected:
+	ModelFunction model;
+	size_t rowCount;
+	size_t firstRow;
+	int lastRow;
+	bool dirty;
+	std::vector<EntryPtr> entries;
+	std::vector<EntryPtr> recycled;
+	std::vector<char> selection;
+public:
+	VirtualRows() :
+			rowCount(0), firstRow(0), lastRow(-1), dirty(false) {
+	}
+	bool isEnabled() const {
+		return (bool) model;
+	}
+	void setModel(const ModelFunction& m) {
+		model = m;
+		entries.clear();
+		recycled.clear();
+		selection.clear();
+		rowCount = 0;
+		lastRow = -1;
+		dirty = true;
+	}
+	//Returns true if the selection was cleared because the row count changed.
+	bool setRowCount(size_t rows) {
+		bool reset = (rows != rowCount || selection.size() != rows);
+		if (reset) {
+			selection.assign(rows, 0);
+			lastRow = -1;
+		}
+		rowCount = rows;
+		dirty = true;
+		return reset;
+	}
+	size_t getRowCount() const {
+		return rowCount;
+	}
+	//Request every visible row from the model again on the next bind.
+	void setDirty() {
+		dirty = true;
+	}
+	//Rows that currently exist as widgets, starting at getFirstRow().
+	const std::vector<EntryPtr>& getEntries() const {
+		return entries;
+	}
+	size_t getFirstRow() const {
+		return firstRow;
+	}
+	/*
+	 * Binds rows [first,last) to widgets and makes them the children of parent. Rows still in
+	 * view keep their widget, the rest are recycled and handed back to the model.
+	 */
+	void bind(size_t first, size_t last, Region* parent, std::vector<RegionPtr>& children, AlloyContext* context) {
+		std::vector<EntryPtr> bound(last - first);
+		for (size_t i = 0; i < entries.size(); i++) {
+			size_t row = firstRow + i;
+			if (!dirty && row >= first && row < last) {
+				bound[row - first] = entries[i];
+			} else {
+				recycled.push_back(entries[i]);
+			}
+		}
+		for (size_t row = first; row < last; row++) {
+			EntryPtr& entry = bound[row - first];
+			if (entry.get() == nullptr) {
+				EntryPtr reuse;
+				if (recycled.size() > 0) {
+					reuse = recycled.back();
+					recycled.pop_back();
+				}
+				entry = model(row, reuse);
+				if (entry.get() == nullptr) {
+					throw std::runtime_error(MakeString() << "[" << parent->getName() << "] model returned no entry for row " << row);
+				}
+				if (reuse.get() != nullptr && reuse != entry) {
+					recycled.push_back(reuse);
+				}
+			}
+			entry->setSelected(selection[row] != 0);
+		}
+		for (EntryPtr& entry : entries) {
+			//Rows that leave the tree must not stay in the cursor locator or hold mouse state.
+			if (std::find(bound.begin(), bound.end(), entry) == bound.end()) {
+				context->clearEvents(entry.get());
+			}
+		}
+		for (RegionPtr& child : children) {
+			child->parent = nullptr;
+		}
+		children.clear();
+		for (EntryPtr& entry : bound) {
+			entry->parent = parent;
+			children.push_back(entry);
+		}
+		entries.swap(bound);
+		firstRow = first;
+		dirty = false;
+	}
+	//Row shown by a widget, or -1 if it is not bound.
+	int getRow(const EntryT* entry) const {
+		for (size_t i = 0; i < entries.size(); i++) {
+			if (entries[i].get() == entry) {
+				return (int) (firstRow + i);
+			}
+		}
+		return -1;
+	}
+	bool isSelected(size_t row) const {
+		return (row < selection.size() && selection[row] != 0);
+	}
+	void setSelected(size_t row, bool selected) {
+		if (row >= selection.size())
+			return;
+		selection[row] = (selected) ? 1 : 0;
+		if (row >= firstRow && row < firstRow + entries.size()) {
+			entries[row - firstRow]->setSelected(selected);
+		}
+	}
+	//Selects rows [start,end] inclusive and makes end the anchor for shift clicks.
+	void selectRange(size_t start, size_t end) {
+		for (size_t row = start; row <= end && row < selection.size(); row++) {
+			setSelected(row, true);
+		}
+		lastRow = (int) end;
+	}
+	void setAllSelected(bool selected) {
+		std::fill(selection.begin(), selection.end(), (selected) ? 1 : 0);
+		for (EntryPtr& entry : entries) {
+			entry->setSelected(selected);
+		}
+		if (!selected)
+			lastRow = -1;
+	}
+	std::vector<size_t> getSelectedRows() const {
+		std::vector<size_t> rows;
+		for (size_t row = 0; row < selection.size(); row++) {
+			if (selection[row])
+				rows.push_back(row);
+		}
+		return rows;
+	}
+	/*
+	 * Mouse down on a bound widget. Left click toggles (multi-selection), extends from the
+	 * last clicked row with shift, or selects a single row. Right click clears the selection.
+	 * Returns true if the event changed the selection.
+	 */
+	bool onMouseDown(const EntryT* entry, const InputEvent& e, bool multiSelection) {
+		int row = getRow(entry);
+		if (row < 0 || !e.isDown())
+			return false;
+		if (e.button == GLFW_MOUSE_BUTTON_LEFT) {
+			if (multiSelection) {
+				if (isSelected(row) && e.clicks == 1) {
+					setSelected(row, false);
+				} else if (e.isShiftDown() && lastRow >= 0) {
+					selectRange(std::min(row, lastRow), std::max(row, lastRow));
+				} else {
+					setSelected(row, true);
+				}
+			} else if (!isSelected(row)) {
+				setAllSelected(false);
+				setSelected(row, true);
+			}
+			lastRow = row;
+			return true;
+		} else if (e.button == GLFW_MOUSE_BUTTON_RIGHT) {
+			setAllSelected(false);
+			return true;
+		}
+		return false;
+	}
+};
+}
+#endif /* SRC_UI_ALLOYVIRTUALROWS_H_ */
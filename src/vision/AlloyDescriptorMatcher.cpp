@@ -0,0 +1,431 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "vision/AlloyDescriptorMatcher.h"
+#include "common/AlloyCommon.h"
+#include <algorithm>
+#include <random>
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define ALY_MATCHER_SSE
+#endif
+namespace aly {
+//Number of query rows processed together by the brute force matcher.
+static const int MATCHER_QUERY_BLOCK = 32;
+//Number of train rows per brute force block, sized so one block of 128-D descriptors stays in L2 cache.
+static const int MATCHER_TRAIN_BLOCK = 256;
+//Maximum number of descriptors in a kd-forest leaf.
+static const int MATCHER_LEAF_SIZE = 16;
+//Number of points sampled to estimate the split dimension of a kd-forest node.
+static const int MATCHER_SAMPLE_SIZE = 100;
+//Number of highest variance dimensions a kd-forest split chooses from.
+static const int MATCHER_SPLIT_CANDIDATES = 5;
+#ifdef ALY_MATCHER_SSE
+static inline float HorizontalSum(__m128 v) {
+	__m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(v, shuf);
+	shuf = _mm_movehl_ps(shuf, sums);
+	sums = _mm_add_ss(sums, shuf);
+	return _mm_cvtss_f32(sums);
+}
+#endif
+/*
+ * Rows are 64 byte aligned and padded to a multiple of 16 floats, so kernels
+ * use aligned loads and have no scalar tail.
+ */
+static inline float MatcherDot(const float* a, const float* b, int stride) {
+#ifdef ALY_MATCHER_SSE
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	for (int i = 0; i < stride; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_load_ps(a + i), _mm_load_ps(b + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_load_ps(a + i + 4), _mm_load_ps(b + i + 4)));
+	}
+	return HorizontalSum(_mm_add_ps(sum0, sum1));
+#else
+	float sum = 0.0f;
+	for (int i = 0; i < stride; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+#endif
+}
+//Dot products of one train row with four query rows, loading the train row once.
+static inline void MatcherDot4(const float* t, const float* q0, const float* q1, const float* q2, const float* q3, int stride,
+		float* out) {
+#ifdef ALY_MATCHER_SSE
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	__m128 sum2 = _mm_setzero_ps();
+	__m128 sum3 = _mm_setzero_ps();
+	for (int i = 0; i < stride; i += 4) {
+		__m128 v = _mm_load_ps(t + i);
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(v, _mm_load_ps(q0 + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(v, _mm_load_ps(q1 + i)));
+		sum2 = _mm_add_ps(sum2, _mm_mul_ps(v, _mm_load_ps(q2 + i)));
+		sum3 = _mm_add_ps(sum3, _mm_mul_ps(v, _mm_load_ps(q3 + i)));
+	}
+	_MM_TRANSPOSE4_PS(sum0, sum1, sum2, sum3);
+	_mm_storeu_ps(out, _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3)));
+#else
+	out[0] = out[1] = out[2] = out[3] = 0.0f;
+	for (int i = 0; i < stride; i++) {
+		float v = t[i];
+		out[0] += v * q0[i];
+		out[1] += v * q1[i];
+		out[2] += v * q2[i];
+		out[3] += v * q3[i];
+	}
+#endif
+}
+/*
+ * Inserts a candidate into a list of k matches sorted by score. Scores are
+ * squared distances for L2 and negated dot products for Dot.
+ */
+static inline void MatcherInsert(DescriptorMatch* best, int k, int train, float score) {
+	if (score >= best[k - 1].distance)
+		return;
+	int n = k - 1;
+	while (n > 0 && best[n - 1].distance > score) {
+		best[n] = best[n - 1];
+		n--;
+	}
+	best[n].train = train;
+	best[n].distance = score;
+}
+static inline float MatcherScore(DescriptorMetric metric, float dot, float normQ, float normT) {
+	return (metric == DescriptorMetric::L2) ? normQ + normT - 2.0f * dot : -dot;
+}
+static inline float MatcherScoreToDistance(DescriptorMetric metric, float score) {
+	return std::sqrt(std::max(0.0f, (metric == DescriptorMetric::L2) ? score : 2.0f + 2.0f * score));
+}
+void DescriptorSet::resize(int r, int d) {
+	rows = r;
+	dimensions = d;
+	stride = (d + 15) & ~15;
+	data.assign((size_t) rows * stride, 0.0f);
+	norms.assign(rows, 0.0f);
+}
+void DescriptorSet::set(const float* values, int r, int d, int rowStride) {
+	if (rowStride <= 0)
+		rowStride = d;
+	resize(r, d);
+#pragma omp parallel for
+	for (int i = 0; i < rows; i++) {
+		std::copy(values + (size_t) i * rowStride, values + (size_t) i * rowStride + d, operator[](i));
+	}
+	computeNorms();
+}
+void DescriptorSet::set(const std::vector<SiftDescriptor>& descriptors) {
+	resize((int) descriptors.size(), 128);
+#pragma omp parallel for
+	for (int i = 0; i < rows; i++) {
+		const SiftDescriptor& desc = descriptors[i];
+		std::copy(desc.data.begin(), desc.data.end(), operator[](i));
+	}
+	computeNorms();
+}
+void DescriptorSet::set(const std::vector<DaisyDescriptor>& descriptors) {
+	int d = (descriptors.size() > 0) ? (int) descriptors.front().size() : 0;
+	for (const DaisyDescriptor& desc : descriptors) {
+		if ((int) desc.size() != d) {
+			throw std::runtime_error(MakeString() << "Descriptor size mismatch " << desc.size() << " != " << d);
+		}
+	}
+	resize((int) descriptors.size(), d);
+#pragma omp parallel for
+	for (int i = 0; i < rows; i++) {
+		std::copy(descriptors[i].begin(), descriptors[i].end(), operator[](i));
+	}
+	computeNorms();
+}
+void DescriptorSet::set(const DaisyDescriptorField& field) {
+	set(field.ptr(), (int) field.size(), field.getDescriptorSize(), (int) field.getStride());
+}
+void DescriptorSet::computeNorms() {
+	norms.resize(rows);
+#pragma omp parallel for
+	for (int i = 0; i < rows; i++) {
+		const float* row = operator[](i);
+		norms[i] = MatcherDot(row, row, stride);
+	}
+}
+void DescriptorMatcher::setTrain(const DescriptorSet& set) {
+	train = &set;
+	forest.clear();
+	if (options.backend == MatcherBackend::KdForest) {
+		buildForest(set, forest);
+	}
+}
+void DescriptorMatcher::setOptions(const DescriptorMatcherOptions& opts) {
+	bool rebuild = (opts.backend != options.backend || opts.trees != options.trees);
+	options = opts;
+	if (rebuild && train != nullptr) {
+		setTrain(*train);
+	}
+}
+/*
+ * Randomized kd-trees as in Silpa-Anan and Hartley, "Optimised KD-trees for
+ * fast image descriptor matching". Each node splits at the mean of a
+ * dimension drawn from the few with highest variance, so the trees in the
+ * forest partition space differently.
+ */
+void DescriptorMatcher::buildForest(const DescriptorSet& set, std::vector<Tree>& trees) const {
+	trees.clear();
+	trees.resize(std::max(1, options.trees));
+	const int N = set.size();
+	const int D = set.getDimensions();
+#pragma omp parallel for
+	for (int t = 0; t < (int) trees.size(); t++) {
+		Tree& tree = trees[t];
+		std::mt19937 rng(7919 * t + 1);
+		tree.indexes.resize(N);
+		for (int i = 0; i < N; i++) {
+			tree.indexes[i] = i;
+		}
+		std::shuffle(tree.indexes.begin(), tree.indexes.end(), rng);
+		tree.nodes.clear();
+		tree.nodes.reserve(2 * N / MATCHER_LEAF_SIZE + 1);
+		std::vector<double> mean(D), var(D);
+		std::vector<int> order(D);
+		std::vector<int> stack;
+		Node root;
+		root.begin = 0;
+		root.end = N;
+		root.child[0] = root.child[1] = -1;
+		root.dimension = 0;
+		root.split = 0.0f;
+		tree.nodes.push_back(root);
+		stack.push_back(0);
+		while (!stack.empty()) {
+			int id = stack.back();
+			stack.pop_back();
+			int begin = tree.nodes[id].begin;
+			int end = tree.nodes[id].end;
+			if (end - begin <= MATCHER_LEAF_SIZE)
+				continue;
+			int count = std::min(end - begin, MATCHER_SAMPLE_SIZE);
+			std::fill(mean.begin(), mean.end(), 0.0);
+			std::fill(var.begin(), var.end(), 0.0);
+			for (int i = begin; i < begin + count; i++) {
+				const float* row = set[tree.indexes[i]];
+				for (int d = 0; d < D; d++) {
+					mean[d] += row[d];
+				}
+			}
+			for (int d = 0; d < D; d++) {
+				mean[d] /= count;
+			}
+			for (int i = begin; i < begin + count; i++) {
+				const float* row = set[tree.indexes[i]];
+				for (int d = 0; d < D; d++) {
+					double diff = row[d] - mean[d];
+					var[d] += diff * diff;
+				}
+			}
+			for (int d = 0; d < D; d++) {
+				order[d] = d;
+			}
+			int candidates = std::min(D, MATCHER_SPLIT_CANDIDATES);
+			std::partial_sort(order.begin(), order.begin() + candidates, order.end(), [&var](int a, int b) {
+				return var[a] > var[b];
+			});
+			int dim = order[std::uniform_int_distribution<int>(0, candidates - 1)(rng)];
+			float split = (float) mean[dim];
+			int* first = tree.indexes.data() + begin;
+			int* last = tree.indexes.data() + end;
+			int* mid = std::partition(first, last, [&set,dim,split](int i) {
+				return set[i][dim] < split;
+			});
+			//All samples on one side of the mean, split at the median instead.
+			if (mid == first || mid == last) {
+				mid = first + (end - begin) / 2;
+				std::nth_element(first, mid, last, [&set,dim](int a, int b) {
+					return set[a][dim] < set[b][dim];
+				});
+				split = set[*mid][dim];
+			}
+			int center = begin + (int) (mid - first);
+			for (int c = 0; c < 2; c++) {
+				Node child;
+				child.begin = (c == 0) ? begin : center;
+				child.end = (c == 0) ? center : end;
+				child.child[0] = child.child[1] = -1;
+				child.dimension = 0;
+				child.split = 0.0f;
+				tree.nodes[id].child[c] = (int) tree.nodes.size();
+				stack.push_back((int) tree.nodes.size());
+				tree.nodes.push_back(child);
+			}
+			tree.nodes[id].dimension = dim;
+			tree.nodes[id].split = split;
+		}
+	}
+}
+void DescriptorMatcher::knnBruteForce(const DescriptorSet& query, const DescriptorSet& set, int k,
+		std::vector<DescriptorMatch>& out) const {
+	const int Q = query.size();
+	const int N = set.size();
+	const int stride = query.getStride();
+	const DescriptorMetric metric = options.metric;
+	int blocks = (Q + MATCHER_QUERY_BLOCK - 1) / MATCHER_QUERY_BLOCK;
+#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < blocks; b++) {
+		int q0 = b * MATCHER_QUERY_BLOCK;
+		int q1 = std::min(q0 + MATCHER_QUERY_BLOCK, Q);
+		float dots[4];
+		for (int t0 = 0; t0 < N; t0 += MATCHER_TRAIN_BLOCK) {
+			int t1 = std::min(t0 + MATCHER_TRAIN_BLOCK, N);
+			int q = q0;
+			for (; q + 4 <= q1; q += 4) {
+				for (int t = t0; t < t1; t++) {
+					MatcherDot4(set[t], query[q], query[q + 1], query[q + 2], query[q + 3], stride, dots);
+					float normT = set.getNormSqr(t);
+					for (int n = 0; n < 4; n++) {
+						MatcherInsert(&out[(size_t) (q + n) * k], k, t, MatcherScore(metric, dots[n], query.getNormSqr(q + n), normT));
+					}
+				}
+			}
+			for (; q < q1; q++) {
+				DescriptorMatch* best = &out[(size_t) q * k];
+				for (int t = t0; t < t1; t++) {
+					MatcherInsert(best, k, t, MatcherScore(metric, MatcherDot(set[t], query[q], stride), query.getNormSqr(q), set.getNormSqr(t)));
+				}
+			}
+		}
+	}
+}
+void DescriptorMatcher::knnForest(const DescriptorSet& query, const DescriptorSet& set, const std::vector<Tree>& trees, int k,
+		std::vector<DescriptorMatch>& out) const {
+	typedef std::pair<float, std::pair<int, int>> Branch;
+	const int Q = query.size();
+	const int stride = query.getStride();
+	const DescriptorMetric metric = options.metric;
+	const int maxChecks = std::max(options.maxChecks, k);
+#pragma omp parallel
+	{
+		//Scratch shared by all queries handled by this thread. Points are marked visited with the query index.
+		std::vector<int> visited(set.size(), -1);
+		std::vector<Branch> heap;
+		std::greater<Branch> order;
+#pragma omp for schedule(dynamic,16)
+		for (int q = 0; q < Q; q++) {
+			const float* pt = query[q];
+			float normQ = query.getNormSqr(q);
+			DescriptorMatch* best = &out[(size_t) q * k];
+			int checks = 0;
+			heap.clear();
+			for (int t = 0; t < (int) trees.size(); t++) {
+				heap.push_back(Branch(0.0f, std::pair<int, int>(t, 0)));
+			}
+			std::make_heap(heap.begin(), heap.end(), order);
+			while (!heap.empty() && checks < maxChecks) {
+				std::pop_heap(heap.begin(), heap.end(), order);
+				Branch branch = heap.back();
+				heap.pop_back();
+				//Bounds are squared Euclidean distances, compare against the worst match in the same units.
+				if (best[k - 1].train >= 0) {
+					float worst = (metric == DescriptorMetric::L2) ? best[k - 1].distance : 2.0f + 2.0f * best[k - 1].distance;
+					if (branch.first >= worst)
+						break;
+				}
+				const Tree& tree = trees[branch.second.first];
+				int id = branch.second.second;
+				float bound = branch.first;
+				while (tree.nodes[id].child[0] >= 0) {
+					const Node& node = tree.nodes[id];
+					float diff = pt[node.dimension] - node.split;
+					int near = (diff < 0.0f) ? 0 : 1;
+					heap.push_back(Branch(bound + diff * diff, std::pair<int, int>(branch.second.first, node.child[1 - near])));
+					std::push_heap(heap.begin(), heap.end(), order);
+					id = node.child[near];
+				}
+				const Node& leaf = tree.nodes[id];
+				for (int i = leaf.begin; i < leaf.end; i++) {
+					int t = tree.indexes[i];
+					if (visited[t] == q)
+						continue;
+					visited[t] = q;
+					MatcherInsert(best, k, t, MatcherScore(metric, MatcherDot(set[t], pt, stride), normQ, set.getNormSqr(t)));
+					checks++;
+				}
+			}
+		}
+	}
+}
+void DescriptorMatcher::knnMatch(const DescriptorSet& query, const DescriptorSet& set, const std::vector<Tree>& trees, int k,
+		std::vector<DescriptorMatch>& out) const {
+	if (query.size() > 0 && set.size() > 0 && query.getDimensions() != set.getDimensions()) {
+		throw std::runtime_error(MakeString() << "Descriptor dimensions do not match " << query.getDimensions() << " != " << set.getDimensions());
+	}
+	out.assign((size_t) query.size() * k, DescriptorMatch());
+	for (int q = 0; q < query.size(); q++) {
+		for (int n = 0; n < k; n++) {
+			out[(size_t) q * k + n].query = q;
+		}
+	}
+	if (set.size() == 0 || k <= 0)
+		return;
+	if (trees.size() > 0) {
+		knnForest(query, set, trees, k, out);
+	} else {
+		knnBruteForce(query, set, k, out);
+	}
+#pragma omp parallel for
+	for (int i = 0; i < (int) out.size(); i++) {
+		DescriptorMatch& m = out[i];
+		m.distance = (m.train >= 0) ? MatcherScoreToDistance(options.metric, m.distance) : std::numeric_limits<float>::max();
+	}
+}
+void DescriptorMatcher::knnMatch(const DescriptorSet& query, int k, std::vector<DescriptorMatch>& out) const {
+	if (train == nullptr) {
+		throw std::runtime_error("Descriptor matcher has no train set.");
+	}
+	knnMatch(query, *train, forest, k, out);
+}
+void DescriptorMatcher::match(const DescriptorSet& query, std::vector<DescriptorMatch>& matches) const {
+	if (train == nullptr) {
+		throw std::runtime_error("Descriptor matcher has no train set.");
+	}
+	int k = (options.ratio < 1.0f) ? 2 : 1;
+	std::vector<DescriptorMatch> forward;
+	knnMatch(query, *train, forest, k, forward);
+	std::vector<DescriptorMatch> backward;
+	if (options.crossCheck) {
+		std::vector<Tree> queryForest;
+		if (options.backend == MatcherBackend::KdForest) {
+			buildForest(query, queryForest);
+		}
+		knnMatch(*train, query, queryForest, 1, backward);
+	}
+	matches.clear();
+	matches.reserve(query.size());
+	for (int q = 0; q < query.size(); q++) {
+		const DescriptorMatch& m = forward[(size_t) q * k];
+		if (m.train < 0 || m.distance > options.maxDistance)
+			continue;
+		if (k > 1 && forward[(size_t) q * k + 1].train >= 0 && m.distance >= options.ratio * forward[(size_t) q * k + 1].distance)
+			continue;
+		if (options.crossCheck && backward[m.train].train != q)
+			continue;
+		matches.push_back(m);
+	}
+}
+}
@@ -0,0 +1,185 @@
+/*
+ * Copyright(C) 2018, Blake C. Lucas, Ph.D. (img.science@gmail.com)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef INCLUDE_ALLOYDESCRIPTORMATCHER_H_
+#define INCLUDE_ALLOYDESCRIPTORMATCHER_H_
+#include "vision/AlloyImageFeatures.h"
+#include "vision/Sift.h"
+#include "system/AlignedAllocator.h"
+#include <vector>
+#include <limits>
+namespace aly {
+bool SANITY_CHECK_DESCRIPTOR_MATCHER();
+/*
+ * L2 ranks candidates by Euclidean distance. Dot ranks them by largest dot
+ * product, which skips the norm terms and is exact for unit length
+ * descriptors such as SIFT. Its reported distance is sqrt(2 - 2 dot), the
+ * Euclidean distance between unit vectors, so ratio tests work for both.
+ */
+enum class DescriptorMetric {
+	L2 = 0, Dot = 1
+};
+/*
+ * BruteForce is exact. KdForest searches several randomized kd-trees at once
+ * and stops after a fixed number of distance evaluations.
+ */
+enum class MatcherBackend {
+	BruteForce = 0, KdForest = 1
+};
+struct DescriptorMatch {
+	int query;
+	int train;
+	float distance;
+	DescriptorMatch(int query = -1, int train = -1, float distance = std::numeric_limits<float>::max()) :
+			query(query), train(train), distance(distance) {
+	}
+};
+struct DescriptorMatcherOptions {
+	DescriptorMetric metric;
+	MatcherBackend backend;
+	//Matches whose best distance is not below ratio * second best distance are rejected. Values >= 1 disable the test.
+	float ratio;
+	//Only keep matches that are also the best match from train to query.
+	bool crossCheck;
+	//Matches farther than this are rejected.
+	float maxDistance;
+	//Number of randomized trees in the kd-forest.
+	int trees;
+	//Maximum number of leaf points the kd-forest compares per query.
+	int maxChecks;
+	DescriptorMatcherOptions() :
+			metric(DescriptorMetric::L2), backend(MatcherBackend::BruteForce), ratio(0.8f), crossCheck(false), maxDistance(
+					std::numeric_limits<float>::max()), trees(4), maxChecks(256) {
+	}
+};
+/*
+ * Descriptor set stored row major in one aligned buffer. Rows are padded to a
+ * multiple of 16 floats with zeros so distance kernels never need a tail.
+ */
+class DescriptorSet {
+protected:
+	std::vector<float, aligned_allocator<float, 64>> data;
+	std::vector<float> norms;
+	int rows;
+	int dimensions;
+	int stride;
+	void computeNorms();
+public:
+	DescriptorSet() :
+			rows(0), dimensions(0), stride(0) {
+	}
+	DescriptorSet(const float* values, int rows, int dimensions, int rowStride = 0) :
+			DescriptorSet() {
+		set(values, rows, dimensions, rowStride);
+	}
+	DescriptorSet(const std::vector<SiftDescriptor>& descriptors) :
+			DescriptorSet() {
+		set(descriptors);
+	}
+	DescriptorSet(const std::vector<DaisyDescriptor>& descriptors) :
+			DescriptorSet() {
+		set(descriptors);
+	}
+	DescriptorSet(const DaisyDescriptorField& field) :
+			DescriptorSet() {
+		set(field);
+	}
+	void resize(int rows, int dimensions);
+	void set(const float* values, int rows, int dimensions, int rowStride = 0);
+	void set(const std::vector<SiftDescriptor>& descriptors);
+	void set(const std::vector<DaisyDescriptor>& descriptors);
+	void set(const DaisyDescriptorField& field);
+	//Call after writing rows through operator[] so norms used by the L2 metric are up to date.
+	void update() {
+		computeNorms();
+	}
+	int size() const {
+		return rows;
+	}
+	int getDimensions() const {
+		return dimensions;
+	}
+	int getStride() const {
+		return stride;
+	}
+	float getNormSqr(int i) const {
+		return norms[i];
+	}
+	float* operator[](int i) {
+		return &data[(size_t) i * stride];
+	}
+	const float* operator[](int i) const {
+		return &data[(size_t) i * stride];
+	}
+	void clear() {
+		data.clear();
+		norms.clear();
+		rows = 0;
+	}
+};
+class DescriptorMatcher {
+protected:
+	struct Node {
+		int dimension;
+		float split;
+		int child[2];
+		int begin, end;
+	};
+	struct Tree {
+		std::vector<Node> nodes;
+		std::vector<int> indexes;
+	};
+	DescriptorMatcherOptions options;
+	const DescriptorSet* train;
+	std::vector<Tree> forest;
+	void buildForest(const DescriptorSet& set, std::vector<Tree>& trees) const;
+	void knnBruteForce(const DescriptorSet& query, const DescriptorSet& set, int k, std::vector<DescriptorMatch>& out) const;
+	void knnForest(const DescriptorSet& query, const DescriptorSet& set, const std::vector<Tree>& trees, int k,
+			std::vector<DescriptorMatch>& out) const;
+	void knnMatch(const DescriptorSet& query, const DescriptorSet& set, const std::vector<Tree>& trees, int k,
+			std::vector<DescriptorMatch>& out) const;
+public:
+	DescriptorMatcher(const DescriptorMatcherOptions& options = DescriptorMatcherOptions()) :
+			options(options), train(nullptr) {
+	}
+	DescriptorMatcher(const DescriptorSet& train, const DescriptorMatcherOptions& options = DescriptorMatcherOptions()) :
+			options(options), train(nullptr) {
+		setTrain(train);
+	}
+	//The matcher keeps a pointer to the set, which must outlive it.
+	void setTrain(const DescriptorSet& train);
+	const DescriptorMatcherOptions& getOptions() const {
+		return options;
+	}
+	void setOptions(const DescriptorMatcherOptions& opts);
+	/*
+	 * Finds the k nearest train descriptors for every query descriptor.
+	 * Results are stored query major in out[q * k + n], sorted by distance.
+	 * Slots without a neighbor have train = -1.
+	 */
+	void knnMatch(const DescriptorSet& query, int k, std::vector<DescriptorMatch>& out) const;
+	/*
+	 * Best match for every query descriptor that passes the ratio test,
+	 * distance threshold and cross check, ordered by query index.
+	 */
+	void match(const DescriptorSet& query, std::vector<DescriptorMatch>& matches) const;
+};
+}
+#endif
@@ -1,5 +1,9 @@
 #include "vision/AlloyImageFeatures.h"
 #include "image/AlloyImageProcessing.h"
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define ALY_DAISY_SSE
+#endif
 namespace aly {
 const float Daisy::sigma_0 = 1.0f;
 const float Daisy::sigma_1 = std::sqrt(2.0f);
@@ -199,18 +203,18 @@ void Daisy::getHistogram(float* histogram, float x, float y,
 }
 void Daisy::getDescriptors(DaisyDescriptorField& field,
 		DaisyNormalization normalizationType) {
-	field.resize(width, height);
+	field.resize(width, height, descriptorSize);
 #pragma omp parallel for
 	for (int j = 0; j < height; j++) {
 		for (int i = 0; i < width; i++) {
-			getDescriptor(i, j, field(i, j), normalizationType, true);
-			//std::cout<<i<<","<<j<<": Descriptor "<<field(i,j)<<std::endl;
+			float* descriptor = field(i, j).data();
+			getDescriptor(i, j, descriptor);
+			normalizeDescriptor(descriptor, normalizationType);
 		}
 	}
 }
-void Daisy::getDescriptor(float x, float y, DaisyDescriptor& descriptor) const {
-	descriptor.resize(descriptorSize);
-	getHistogram(descriptor.data(), x, y, smoothLayers[selectedCubes[0]]);
+void Daisy::getDescriptor(float x, float y, float* descriptor) const {
+	getHistogram(descriptor, x, y, smoothLayers[selectedCubes[0]]);
 	int r, rdt, region;
 	for (r = 0; r < radiusBins; r++) {
 		rdt = r * angleBins + 1;
@@ -222,9 +226,8 @@ void Daisy::getDescriptor(float x, float y, DaisyDescriptor& descriptor) const {
 		}
 	}
 }
-void Daisy::getDescriptor(int x, int y, DaisyDescriptor& descriptor) const {
-	descriptor.resize(descriptorSize);
-	getHistogram(descriptor.data(), x, y, smoothLayers[selectedCubes[0]]);
+void Daisy::getDescriptor(int x, int y, float* descriptor) const {
+	getHistogram(descriptor, x, y, smoothLayers[selectedCubes[0]]);
 	int r, rdt, region;
 	for (r = 0; r < radiusBins; r++) {
 		rdt = r * angleBins + 1;
@@ -379,7 +382,7 @@ void Daisy::initialize(const Image1f& image, bool smoothFirstLayer) {
 		//WriteOrientationImagesToFile(MakeString()<<GetDesktopDirectory()<<ALY_PATH_SEPARATOR<<"smoothed"<<i<<".xml",smoothLayers[i]);
 	}
 }
-void Daisy::normalizeDescriptor(DaisyDescriptor& desc,
+void Daisy::normalizeDescriptor(float* desc,
 		DaisyNormalization nrm_type) const {
 	if (nrm_type == DaisyNormalization::Partial)
 		normalizePartial(desc);
@@ -389,7 +392,7 @@ void Daisy::normalizeDescriptor(DaisyDescriptor& desc,
 		normalizeSiftWay(desc);
 }
 
-void Daisy::normalizePartial(DaisyDescriptor& desc) const {
+void Daisy::normalizePartial(float* desc) const {
 	float norm;
 	for (int h = 0; h < numberOfGridPoints; h++) {
 		norm = 0.0f;
@@ -405,20 +408,20 @@ void Daisy::normalizePartial(DaisyDescriptor& desc) const {
 		}
 	}
 }
-void Daisy::normalizeFull(DaisyDescriptor& desc) const {
+void Daisy::normalizeFull(float* desc) const {
 	float norm = 0.0f;
-	for (int i = 0; i < (int) desc.size(); i++) {
+	for (int i = 0; i < descriptorSize; i++) {
 		float val = desc[i];
 		norm += val * val;
 	}
 	if (norm != 0.0) {
 		norm = std::sqrt(norm);
-		for (int i = 0; i < (int) desc.size(); i++) {
+		for (int i = 0; i < descriptorSize; i++) {
 			desc[i] /= norm;
 		}
 	}
 }
-void Daisy::normalizeSiftWay(DaisyDescriptor& desc) const {
+void Daisy::normalizeSiftWay(float* desc) const {
 	bool changed = true;
 	int iter = 0;
 	float norm;
@@ -429,17 +432,17 @@ void Daisy::normalizeSiftWay(DaisyDescriptor& desc) const {
 		iter++;
 		changed = false;
 		norm = 0.0f;
-		for (int i = 0; i < (int) desc.size(); i++) {
+		for (int i = 0; i < descriptorSize; i++) {
 			float val = desc[i];
 			norm += val * val;
 		}
 		norm = std::sqrt(norm);
 		if (norm > 1e-5) {
-			for (int i = 0; i < (int) desc.size(); i++) {
+			for (int i = 0; i < descriptorSize; i++) {
 				desc[i] /= norm;
 			}
 		}
-		for (h = 0; h < (int) desc.size(); h++) {
+		for (h = 0; h < descriptorSize; h++) {
 			if (desc[h] > m_descriptor_normalization_threshold) {
 				desc[h] = m_descriptor_normalization_threshold;
 				changed = true;
@@ -449,12 +452,13 @@ void Daisy::normalizeSiftWay(DaisyDescriptor& desc) const {
 }
 void Daisy::getDescriptor(float x, float y, DaisyDescriptor& descriptor,
 		DaisyNormalization normalizationType, bool disableInterpolation) const {
+	descriptor.resize(descriptorSize);
 	if (disableInterpolation) {
-		getDescriptor(int(x), int(y), descriptor);
+		getDescriptor(int(x), int(y), descriptor.data());
 	} else {
-		getDescriptor(x, y, descriptor);
+		getDescriptor(x, y, descriptor.data());
 	}
-	normalizeDescriptor(descriptor, normalizationType);
+	normalizeDescriptor(descriptor.data(), normalizationType);
 }
 void Daisy::updateSelectedCubes() {
 	selectedCubes.resize(radiusBins);
@@ -472,32 +476,113 @@ void Daisy::computeCubeSigmas() {
 	updateSelectedCubes();
 }
 
-inline double lengthL2(const DaisyDescriptor& a) {
-	double ret = 0.0;
-	int N = (int) a.size();
-	for (int i = 0; i < N; i++) {
-		ret += a[i] * a[i];
+#ifdef ALY_DAISY_SSE
+static inline float HorizontalSum(__m128 v) {
+	__m128 shuf = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+	__m128 sums = _mm_add_ps(v, shuf);
+	shuf = _mm_movehl_ps(shuf, sums);
+	sums = _mm_add_ss(sums, shuf);
+	return _mm_cvtss_f32(sums);
+}
+#endif
+double dot(ConstDaisyDescriptorView a, ConstDaisyDescriptorView b) {
+	int N = (int) std::min(a.size(), b.size());
+	const float* pa = a.data();
+	const float* pb = b.data();
+	int i = 0;
+	float ret = 0.0f;
+#ifdef ALY_DAISY_SSE
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	for (; i + 8 <= N; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(pa + i), _mm_loadu_ps(pb + i)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(pa + i + 4), _mm_loadu_ps(pb + i + 4)));
+	}
+	ret = HorizontalSum(_mm_add_ps(sum0, sum1));
+#endif
+	for (; i < N; i++) {
+		ret += pa[i] * pb[i];
 	}
-	return std::sqrt(ret);
+	return ret;
 }
-double lengthSqr(const DaisyDescriptor& a) {
-	double ret = 0.0;
-	int N = (int) a.size();
-	for (int i = 0; i < N; i++) {
-		ret += a[i] * a[i];
+double distanceSqr(ConstDaisyDescriptorView a, ConstDaisyDescriptorView b) {
+	int N = (int) std::min(a.size(), b.size());
+	const float* pa = a.data();
+	const float* pb = b.data();
+	int i = 0;
+	float ret = 0.0f;
+#ifdef ALY_DAISY_SSE
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	for (; i + 8 <= N; i += 8) {
+		__m128 d0 = _mm_sub_ps(_mm_loadu_ps(pa + i), _mm_loadu_ps(pb + i));
+		__m128 d1 = _mm_sub_ps(_mm_loadu_ps(pa + i + 4), _mm_loadu_ps(pb + i + 4));
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(d0, d0));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(d1, d1));
+	}
+	ret = HorizontalSum(_mm_add_ps(sum0, sum1));
+#endif
+	for (; i < N; i++) {
+		float d = pa[i] - pb[i];
+		ret += d * d;
 	}
 	return ret;
 }
-double lengthL1(const DaisyDescriptor& a) {
-	double ret = 0.0;
+double distance(ConstDaisyDescriptorView a, ConstDaisyDescriptorView b) {
+	return std::sqrt(distanceSqr(a, b));
+}
+double lengthSqr(ConstDaisyDescriptorView a) {
+	return dot(a, a);
+}
+double lengthL2(ConstDaisyDescriptorView a) {
+	return std::sqrt(dot(a, a));
+}
+double lengthL1(ConstDaisyDescriptorView a) {
 	int N = (int) a.size();
-	for (int i = 0; i < N; i++) {
-		ret += std::abs(a[i]);
+	const float* pa = a.data();
+	int i = 0;
+	float ret = 0.0f;
+#ifdef ALY_DAISY_SSE
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	__m128 sum = _mm_setzero_ps();
+	for (; i + 4 <= N; i += 4) {
+		sum = _mm_add_ps(sum, _mm_andnot_ps(signMask, _mm_loadu_ps(pa + i)));
+	}
+	ret = HorizontalSum(sum);
+#endif
+	for (; i < N; i++) {
+		ret += std::abs(pa[i]);
 	}
 	return ret;
 }
-double angle(const DaisyDescriptor& a, const DaisyDescriptor& b) {
-	return std::acos(dot(a, b) / (lengthL2(a) * lengthL2(b)));
+double angle(ConstDaisyDescriptorView a, ConstDaisyDescriptorView b) {
+	int N = (int) std::min(a.size(), b.size());
+	const float* pa = a.data();
+	const float* pb = b.data();
+	int i = 0;
+	float ab = 0.0f, aa = 0.0f, bb = 0.0f;
+#ifdef ALY_DAISY_SSE
+	__m128 sumAB = _mm_setzero_ps();
+	__m128 sumAA = _mm_setzero_ps();
+	__m128 sumBB = _mm_setzero_ps();
+	for (; i + 4 <= N; i += 4) {
+		__m128 va = _mm_loadu_ps(pa + i);
+		__m128 vb = _mm_loadu_ps(pb + i);
+		sumAB = _mm_add_ps(sumAB, _mm_mul_ps(va, vb));
+		sumAA = _mm_add_ps(sumAA, _mm_mul_ps(va, va));
+		sumBB = _mm_add_ps(sumBB, _mm_mul_ps(vb, vb));
+	}
+	ab = HorizontalSum(sumAB);
+	aa = HorizontalSum(sumAA);
+	bb = HorizontalSum(sumBB);
+#endif
+	for (; i < N; i++) {
+		ab += pa[i] * pb[i];
+		aa += pa[i] * pa[i];
+		bb += pb[i] * pb[i];
+	}
+	//Rounding can push the cosine of identical descriptors just past 1.
+	return std::acos(clamp(ab / std::sqrt((double) aa * (double) bb), -1.0, 1.0));
 }
 void Daisy::computeGridPoints() {
 	double r_step = descriptorRadius / radiusBins;
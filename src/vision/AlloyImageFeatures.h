@@ -1,8 +1,10 @@
 #ifndef _IMAGEFEATURES_H
 #define _IMAGEFEATURES_H
 #include "image/AlloyImage.h"
+#include "system/AlignedAllocator.h"
 #include <array>
 #include <vector>
+#include <type_traits>
 namespace aly {
 enum class DaisyNormalization {UnNormalized = -1, Partial = 0, Full = 1, Sift = 2};
 inline void cartesian2polar(const float2& pt, float &r, float &th) {
@@ -22,6 +24,40 @@ public:
 		std::vector<float>::assign(data.begin(), data.end());
 	}
 };
+//Non-owning view of one descriptor, usually a row of a DaisyDescriptorField.
+template<class T> class DaisyDescriptorRef {
+protected:
+	T* values;
+	int length;
+public:
+	DaisyDescriptorRef(T* values = nullptr, int length = 0) :
+			values(values), length(length) {
+	}
+	template<class U> DaisyDescriptorRef(const DaisyDescriptorRef<U>& ref) :
+			values(ref.data()), length((int) ref.size()) {
+	}
+	//Mutable views need a mutable descriptor, const views accept either.
+	DaisyDescriptorRef(typename std::conditional<std::is_const<T>::value, const DaisyDescriptor&, DaisyDescriptor&>::type desc) :
+			values(desc.data()), length((int) desc.size()) {
+	}
+	size_t size() const {
+		return (size_t) length;
+	}
+	T* data() const {
+		return values;
+	}
+	T* begin() const {
+		return values;
+	}
+	T* end() const {
+		return values + length;
+	}
+	T& operator[](const size_t i) const {
+		return values[i];
+	}
+};
+typedef DaisyDescriptorRef<float> DaisyDescriptorView;
+typedef DaisyDescriptorRef<const float> ConstDaisyDescriptorView;
 class ImageLayer {
 protected:
 	std::vector<float> data;
@@ -115,108 +151,130 @@ typedef std::vector<ImageLayer> OrientationImages;
 void WriteOrientationImagesToFile(const std::string& file,
 		const OrientationImages& img);
 
+//Vectorized descriptor kernels. They read the descriptor storage in place, so field rows need no copy.
+double dot(ConstDaisyDescriptorView a, ConstDaisyDescriptorView b);
+double lengthL2(ConstDaisyDescriptorView a);
+double lengthSqr(ConstDaisyDescriptorView a);
+double lengthL1(ConstDaisyDescriptorView a);
+double distance(ConstDaisyDescriptorView a, ConstDaisyDescriptorView b);
+double distanceSqr(ConstDaisyDescriptorView a, ConstDaisyDescriptorView b);
+double angle(ConstDaisyDescriptorView a, ConstDaisyDescriptorView b);
 inline double dot(const DaisyDescriptor& a, const DaisyDescriptor& b) {
-	double ret = 0.0;
-	int N = (int) std::min(a.size(), b.size());
-	for (int i = 0; i < N; i++) {
-		ret += a[i] * b[i];
-	}
-	return ret;
+	return dot(ConstDaisyDescriptorView(a), ConstDaisyDescriptorView(b));
+}
+inline double lengthL2(const DaisyDescriptor& a) {
+	return lengthL2(ConstDaisyDescriptorView(a));
+}
+inline double lengthSqr(const DaisyDescriptor& a) {
+	return lengthSqr(ConstDaisyDescriptorView(a));
+}
+inline double lengthL1(const DaisyDescriptor& a) {
+	return lengthL1(ConstDaisyDescriptorView(a));
+}
+inline double distance(const DaisyDescriptor& a, const DaisyDescriptor& b) {
+	return distance(ConstDaisyDescriptorView(a), ConstDaisyDescriptorView(b));
+}
+inline double distanceSqr(const DaisyDescriptor& a, const DaisyDescriptor& b) {
+	return distanceSqr(ConstDaisyDescriptorView(a), ConstDaisyDescriptorView(b));
+}
+inline double angle(const DaisyDescriptor& a, const DaisyDescriptor& b) {
+	return angle(ConstDaisyDescriptorView(a), ConstDaisyDescriptorView(b));
 }
-inline double lengthL2(const DaisyDescriptor& a);
-inline double lengthSqr(const DaisyDescriptor& a);
-inline double lengthL1(const DaisyDescriptor& a);
-inline double angle(const DaisyDescriptor& a, const DaisyDescriptor& b);
 void Smooth(const ImageLayer & image, ImageLayer & B, float sigma);
 void Convolve(const ImageLayer& image, ImageLayer& out,
 		const std::vector<float>& filter, int M, int N);
 void ConvolveHorizontal(const ImageLayer& input, ImageLayer& output,const std::vector<float>& filter);
 void ConvolveVertical(const ImageLayer& input, ImageLayer& output,const std::vector<float>& filter);
+/*
+ * Dense descriptor field stored as one 64-byte aligned buffer. Each pixel's descriptor starts on its own
+ * aligned row of getStride() floats, of which the first getDescriptorSize() are used.
+ */
 class DaisyDescriptorField {
 protected:
-	std::vector<DaisyDescriptor> data;
+	std::vector<float, aligned_allocator<float, 64>> data;
+	int descriptorSize;
+	size_t stride;
+	void interpolate(float x, float y, float* out) const {
+		int i = static_cast<int>(std::floor(x));
+		int j = static_cast<int>(std::floor(y));
+		ConstDaisyDescriptorView rgb00 = operator()(i, j);
+		ConstDaisyDescriptorView rgb10 = operator()(i + 1, j);
+		ConstDaisyDescriptorView rgb11 = operator()(i + 1, j + 1);
+		ConstDaisyDescriptorView rgb01 = operator()(i, j + 1);
+		float dx = x - i;
+		float dy = y - j;
+		for (int n = 0; n < descriptorSize; n++) {
+			out[n] = ((rgb00[n] * (1.0f - dx) + rgb10[n] * dx) * (1.0f - dy)
+					+ (rgb01[n] * (1.0f - dx) + rgb11[n] * dx) * dy);
+		}
+	}
 public:
 	int width, height;
-	DaisyDescriptorField(int w = 0, int h = 0) :
-			data(w * h), width(w), height(h) {
-
+	DaisyDescriptorField(int w = 0, int h = 0, int descriptorSize = 0) :
+			descriptorSize(0), stride(0), width(0), height(0) {
+		resize(w, h, descriptorSize);
 	}
 	size_t size() const {
-		return data.size();
+		return (size_t) width * (size_t) height;
 	}
-	void resize(int w, int h) {
-		data.resize(w * h);
+	int getDescriptorSize() const {
+		return descriptorSize;
+	}
+	size_t getStride() const {
+		return stride;
+	}
+	void resize(int w, int h, int descSize) {
+		descriptorSize = descSize;
+		stride = ((size_t) descSize + 15) & ~((size_t) 15);
+		data.resize((size_t) w * (size_t) h * stride);
 		data.shrink_to_fit();
 		width = w;
 		height = h;
 	}
+	void resize(int w, int h) {
+		resize(w, h, descriptorSize);
+	}
 	inline void clear() {
 		data.clear();
 		data.shrink_to_fit();
 		width = 0;
 		height = 0;
 	}
-	DaisyDescriptor* ptr() {
+	float* ptr() {
 		if (data.size() == 0)
 			return nullptr;
 		return data.data();
 	}
-	const DaisyDescriptor* ptr() const {
+	const float* ptr() const {
 		if (data.size() == 0)
 			return nullptr;
 		return data.data();
 	}
-	const DaisyDescriptor& operator[](const size_t i) const {
-		return data[i];
+	ConstDaisyDescriptorView operator[](const size_t i) const {
+		return ConstDaisyDescriptorView(data.data() + i * stride, descriptorSize);
 	}
-	DaisyDescriptor& operator[](const size_t i) {
-		return data[i];
+	DaisyDescriptorView operator[](const size_t i) {
+		return DaisyDescriptorView(data.data() + i * stride, descriptorSize);
 	}
-	DaisyDescriptor& operator()(int i, int j) {
-		return data[clamp(i, 0, width - 1) + clamp(j, 0, height - 1) * width];
+	DaisyDescriptorView operator()(int i, int j) {
+		return operator[](clamp(i, 0, width - 1) + clamp(j, 0, height - 1) * (size_t) width);
 	}
-	DaisyDescriptor& operator()(const int2 ij) {
-		return data[clamp(ij.x, 0, width - 1)
-				+ clamp(ij.y, 0, height - 1) * width];
+	DaisyDescriptorView operator()(const int2 ij) {
+		return operator()(ij.x, ij.y);
 	}
-	const DaisyDescriptor& operator()(int i, int j) const {
-		return data[clamp(i, 0, width - 1) + clamp(j, 0, height - 1) * width];
+	ConstDaisyDescriptorView operator()(int i, int j) const {
+		return operator[](clamp(i, 0, width - 1) + clamp(j, 0, height - 1) * (size_t) width);
 	}
-	const DaisyDescriptor& operator()(const int2 ij) const {
-		return data[clamp(ij.x, 0, width - 1)
-				+ clamp(ij.y, 0, height - 1) * width];
+	ConstDaisyDescriptorView operator()(const int2 ij) const {
+		return operator()(ij.x, ij.y);
 	}
 	void get(float x, float y, DaisyDescriptor& out) const {
-		int i = static_cast<int>(std::floor(x));
-		int j = static_cast<int>(std::floor(y));
-		const DaisyDescriptor& rgb00 = operator()(i, j);
-		const DaisyDescriptor& rgb10 = operator()(i + 1, j);
-		const DaisyDescriptor& rgb11 = operator()(i + 1, j + 1);
-		const DaisyDescriptor& rgb01 = operator()(i, j + 1);
-		float dx = x - i;
-		float dy = y - j;
-		int N = (int) rgb00.size();
-		out.resize(N);
-		for (int i = 0; i < N; i++) {
-			out[i] = ((rgb00[i] * (1.0f - dx) + rgb10[i] * dx) * (1.0f - dy)
-					+ (rgb01[i] * (1.0f - dx) + rgb11[i] * dx) * dy);
-		}
+		out.resize(descriptorSize);
+		interpolate(x, y, out.data());
 	}
 	DaisyDescriptor operator()(float x, float y) const {
-		int i = static_cast<int>(std::floor(x));
-		int j = static_cast<int>(std::floor(y));
-		const DaisyDescriptor& rgb00 = operator()(i, j);
-		const DaisyDescriptor& rgb10 = operator()(i + 1, j);
-		const DaisyDescriptor& rgb11 = operator()(i + 1, j + 1);
-		const DaisyDescriptor& rgb01 = operator()(i, j + 1);
-		float dx = x - i;
-		float dy = y - j;
-		int N = (int) rgb00.size();
-		DaisyDescriptor out(N);
-		for (int i = 0; i < N; i++) {
-			out[i] = ((rgb00[i] * (1.0f - dx) + rgb10[i] * dx) * (1.0f - dy)
-					+ (rgb01[i] * (1.0f - dx) + rgb11[i] * dx) * dy);
-		}
+		DaisyDescriptor out(descriptorSize);
+		interpolate(x, y, out.data());
 		return out;
 	}
 };
@@ -261,13 +319,13 @@ protected:
 	void layeredGradient(const Image1f& image, OrientationImages& layers,
 			int layer_no = 8) const;
 	int quantizeRadius(float rad);
-	void normalizeSiftWay(DaisyDescriptor& desc) const;
-	void normalizePartial(DaisyDescriptor& desc) const;
-	void normalizeFull(DaisyDescriptor& desc) const;
-	void normalizeDescriptor(DaisyDescriptor& desc,
+	void normalizeSiftWay(float* desc) const;
+	void normalizePartial(float* desc) const;
+	void normalizeFull(float* desc) const;
+	void normalizeDescriptor(float* desc,
 			DaisyNormalization nrm_type) const;
-	void getDescriptor(float x, float y, DaisyDescriptor& descriptor) const;
-	void getDescriptor(int x, int y, DaisyDescriptor& descriptor) const;
+	void getDescriptor(float x, float y, float* descriptor) const;
+	void getDescriptor(int x, int y, float* descriptor) const;
 	void getHistogram(float* histogram, int x, int y,
 			const std::vector<ImageLayer>& hcube) const;
 	void getHistogram(float* histogram, float x, float y,
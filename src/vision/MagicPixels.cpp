@@ -5,6 +5,8 @@
 #include "image/AlloyDistanceField.h"
 #include "image/AlloyGradientVectorFlow.h"
 #include "image/AlloyVolume.h"
+#include "image/AlloyConnectedComponents.h"
+#include "image/AlloyPyramid.h"
 #include "math/AlloySparseMatrix.h"
 #include "math/AlloySparseSolve.h"
 #include "graphics/AlloyLocator.h"
@@ -12,6 +14,7 @@
 #include "vision/MagicPixels.h"
 #include <queue>
 #include <set>
+#include <map>
 namespace aly {
 MagicPixels::MagicPixels(bool upsample):upsample(upsample) {
 	numLabels = 0;
@@ -239,110 +242,70 @@ void MagicPixels::clusterCenterRefinement(Vector2f& pts, int offset,
 }
 int MagicPixels::computeConnectedComponents(const Image1i& labels,
 		Image1i& outLabels, std::vector<int> &compCounts) {
-	const int xShift[8] = { -1, 1, 0, 0, 1, -1, -1, 1 };
-	const int yShift[8] = { 0, 0, -1, 1, -1, 1, -1, 1 };
-	outLabels.resize(labels.width, labels.height);
-	outLabels.set(int1(-1));
-	std::list<int2> queue;
-	int2 pivot(0, 0);
-	int cc = 0;
-	int ccCount = 0;
-	int pivotLabel = 0;
-	compCounts.clear();
-	for (int j = 1; j < labels.height - 1; j++) {
-		for (int i = 1; i < labels.width - 1; i++) {
-			if (labels(i, j).x >= 0) {
-				pivot = int2(i, j);
-				break;
-			}
-		}
+	std::vector<ConnectedComponent2D> components;
+	ConnectedComponents(labels, outLabels, components, 8, true);
+	compCounts.resize(components.size());
+	for (size_t n = 0; n < components.size(); n++) {
+		compCounts[n] = components[n].size;
 	}
-	do {
-		queue.clear();
-		outLabels(pivot) = int1(cc);
-		pivotLabel = labels(pivot).x;
-		ccCount = 1;
-		queue.push_back(pivot);
-		while (queue.size() > 0) {
-			int2 v = queue.front();
-			queue.pop_front();
-			for (int s = 0; s < 8; s++) {
-				int2 nbr = int2(v.x + xShift[s], v.y + yShift[s]);
-				if (nbr.x >= 0 && nbr.y >= 0 && nbr.x < outLabels.width
-						&& nbr.y < outLabels.height) {
-					if (outLabels(nbr).x < 0 && labels(nbr).x == pivotLabel) {
-						outLabels(nbr).x = cc;
-						ccCount++;
-						queue.push_back(nbr);
-					}
-				}
-			}
-		}
-		compCounts.push_back(ccCount);
-		pivot = int2(-1, -1);
-		for (int t = 0; t < 16; t++) {
-			int i = RandomUniform(0, labels.width - 1);
-			int j = RandomUniform(0, labels.height - 1);
-			if (outLabels(i, j).x < 0 && labels(i, j).x >= 0) {
-				pivot = int2(i, j);
-				break;
-			}
-		}
-		if (pivot.x < 0) {
-			for (int j = 1; j < labels.height - 1; j++) {
-				for (int i = 1; i < labels.width - 1; i++) {
-					if (outLabels(i, j).x < 0 && labels(i, j).x >= 0) {
-						pivot = int2(i, j);
-						break;
-					}
-				}
-			}
-		}
-		cc++;
-	} while (pivot.x >= 0);
 	return (int) compCounts.size();
 }
 int MagicPixels::makeLabelsUnique(Image1i& outImage) {
-	std::map<int, int> lookup;
+	int maxLabel = -1;
+	for (const int1& l : outImage.data) {
+		maxLabel = std::max(maxLabel, l.x);
+	}
+	//Labels are renumbered in order of first appearance, negative labels stay -1.
 	int counter = 0;
-	lookup[-1] = -1;
-	for (int j = 0; j < outImage.height; j++) {
-		for (int i = 0; i < outImage.width; i++) {
-			int l = outImage(i, j).x;
-			if (l >= 0) {
-				if (lookup.find(l) == lookup.end()) {
-					lookup[l] = counter++;
+	if ((int64_t) maxLabel + 1 > 4 * (int64_t) outImage.size()) {
+		//Sparse labels would make a flat table huge, so map them instead.
+		std::map<int, int> lookup;
+		for (int1& l : outImage.data) {
+			if (l.x >= 0) {
+				auto result = lookup.insert(std::pair<int, int>(l.x, counter));
+				if (result.second) {
+					counter++;
 				}
+				l.x = result.first->second;
+			} else {
+				l.x = -1;
 			}
 		}
+		return counter;
 	}
-	for (int j = 0; j < outImage.height; j++) {
-		for (int i = 0; i < outImage.width; i++) {
-			outImage(i, j).x = lookup[outImage(i, j).x];
+	std::vector<int> lookup((size_t) maxLabel + 1, -1);
+	for (const int1& l : outImage.data) {
+		if (l.x >= 0 && lookup[l.x] < 0) {
+			lookup[l.x] = counter++;
 		}
 	}
+#pragma omp parallel for
+	for (int n = 0; n < (int) outImage.size(); n++) {
+		int l = outImage.data[n].x;
+		outImage.data[n].x = (l >= 0) ? lookup[l] : -1;
+	}
 	return counter;
 }
 int MagicPixels::removeSmallConnectedComponents(const Image1i& labelImage,
 		Image1i& outImage, int minSize) {
 	std::vector<int> compCounts;
-	std::vector<int> labels;
-	std::set<int> removeList;
 	computeConnectedComponents(labelImage, outImage, compCounts);
+	std::vector<char> removeList(compCounts.size(), 0);
+	int removeCount = 0;
 	for (int l = 0; l < (int) compCounts.size(); l++) {
 		if (compCounts[l] < minSize) {
-			removeList.insert(l);
+			removeList[l] = 1;
+			removeCount++;
 		}
 	}
-	for (int j = 0; j < outImage.height; j++) {
-		for (int i = 0; i < outImage.width; i++) {
-			int l = outImage(i, j).x;
-			if (removeList.find(l) != removeList.end()) {
-				outImage(i, j).x = -1;
-			}
+#pragma omp parallel for
+	for (int n = 0; n < (int) outImage.size(); n++) {
+		int l = outImage.data[n].x;
+		if (l >= 0 && removeList[l]) {
+			outImage.data[n].x = -1;
 		}
 	}
-	return (int) removeList.size();
+	return removeCount;
 }
 int MagicPixels::fill(Image1i& labelImage, float spacing, float Tile,
 		float colorThreshold) {
@@ -444,8 +407,8 @@ void MagicPixels::set(const ImageRGBA& image, int smoothIterations,int diffuseIt
 		edgeFilter(tmp3, tmp1);
 		std::cout << "Gradient Flow Filter ..." << std::endl;
 		SolveGradientVectorFlow(tmp1, tmp2, 0.1f,diffuseIterations, true);
-		DownSample3x3(tmp1,edges);
-		DownSample3x3(tmp2,vecFieldImage);
+		Pyramid1f(tmp1, 2, PyramidFilter::Gaussian3x3).getGaussian(1, edges);
+		Pyramid2f(tmp2, 2, PyramidFilter::Gaussian3x3).getGaussian(1, vecFieldImage);
 	} else {
 		edgeFilter(filtered,edges);
 		std::cout << "Gradient Flow Filter ..." << std::endl;
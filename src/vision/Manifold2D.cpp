@@ -219,6 +219,17 @@ void Manifold2D::updateNormals() {
 		normals[i / 2] = float2(-norm.y, norm.x);
 	}
 }
+template<class T, int C, ImageType I> static void WriteBinaryImage(std::ostream& os, const Image<T, C, I>& img) {
+	int32_t dims[2] = { img.width, img.height };
+	os.write((const char*) dims, sizeof(dims));
+	WriteBinaryBlock(os, img.data);
+}
+template<class T, int C, ImageType I> static void ReadBinaryImage(std::istream& is, Image<T, C, I>& img) {
+	int32_t dims[2] = { 0, 0 };
+	is.read((char*) dims, sizeof(dims));
+	img.resize(dims[0], dims[1]);
+	ReadBinaryBlock(is, img.data);
+}
 void ReadContourFromFile(const std::string& file, Manifold2D& params) {
 	std::string ext = GetFileExtension(file);
 	if (ext == "json") {
@@ -253,5 +264,72 @@ void WriteContourToFile(const std::string& file, Manifold2D& params) {
 	}
 	params.setFile(file);
 }
+static const uint32_t MANIFOLD2D_BINARY_MAGIC = 0x4432464D;
+static const uint32_t MANIFOLD2D_BINARY_VERSION = 1;
+void WriteContourToBinaryFile(const std::string& file, const Manifold2D& params) {
+	std::ofstream os(file, std::ios::binary);
+	if (!os.is_open()) {
+		throw std::runtime_error(MakeString() << "Could not open " << file << " for writing.");
+	}
+	uint32_t header[2] = { MANIFOLD2D_BINARY_MAGIC, MANIFOLD2D_BINARY_VERSION };
+	os.write((const char*) header, sizeof(header));
+	WriteBinaryString(os, params.getFile());
+	uint64_t curves = params.indexes.size();
+	os.write((const char*) &curves, sizeof(uint64_t));
+	for (const std::vector<uint32_t>& curve : params.indexes) {
+		WriteBinaryBlock(os, curve);
+	}
+	WriteBinaryBlock(os, params.vertexLocations.data);
+	WriteBinaryBlock(os, params.particles.data);
+	WriteBinaryBlock(os, params.vertexes.data);
+	WriteBinaryBlock(os, params.normals.data);
+	WriteBinaryBlock(os, params.vertexLabels);
+	WriteBinaryBlock(os, params.particleTracking);
+	WriteBinaryBlock(os, params.particleLabels);
+	WriteBinaryBlock(os, params.correspondence.data);
+	WriteBinaryBlock(os, params.clusterCenters.data);
+	WriteBinaryBlock(os, params.clusterColors.data);
+	WriteBinaryImage(os, params.overlay);
+	const FluidParticles2D& fluid = params.fluidParticles;
+	os.write((const char*) &fluid.radius, sizeof(float));
+	WriteBinaryBlock(os, fluid.particles.data);
+	WriteBinaryBlock(os, fluid.velocities.data);
+	WriteBinaryImage(os, fluid.velocityImage);
+}
+void ReadContourFromBinaryFile(const std::string& file, Manifold2D& params) {
+	std::ifstream is(file, std::ios::binary);
+	uint32_t header[2] = { 0, 0 };
+	is.read((char*) header, sizeof(header));
+	if (header[0] != MANIFOLD2D_BINARY_MAGIC || header[1] != MANIFOLD2D_BINARY_VERSION) {
+		throw std::runtime_error(MakeString() << "Could not read " << file << ", not a manifold binary file.");
+	}
+	params.setFile(ReadBinaryString(is));
+	uint64_t curves = 0;
+	is.read((char*) &curves, sizeof(uint64_t));
+	params.indexes.resize(curves);
+	for (std::vector<uint32_t>& curve : params.indexes) {
+		ReadBinaryBlock(is, curve);
+	}
+	ReadBinaryBlock(is, params.vertexLocations.data);
+	ReadBinaryBlock(is, params.particles.data);
+	ReadBinaryBlock(is, params.vertexes.data);
+	ReadBinaryBlock(is, params.normals.data);
+	ReadBinaryBlock(is, params.vertexLabels);
+	ReadBinaryBlock(is, params.particleTracking);
+	ReadBinaryBlock(is, params.particleLabels);
+	ReadBinaryBlock(is, params.correspondence.data);
+	ReadBinaryBlock(is, params.clusterCenters.data);
+	ReadBinaryBlock(is, params.clusterColors.data);
+	ReadBinaryImage(is, params.overlay);
+	FluidParticles2D& fluid = params.fluidParticles;
+	is.read((char*) &fluid.radius, sizeof(float));
+	ReadBinaryBlock(is, fluid.particles.data);
+	ReadBinaryBlock(is, fluid.velocities.data);
+	ReadBinaryImage(is, fluid.velocityImage);
+	fluid.updateBounds();
+	if (!is) {
+		throw std::runtime_error(MakeString() << "Could not read " << file << ", file is truncated.");
+	}
+}
 
 }
@@ -21,6 +21,7 @@
 #include "ui/AlloyContext.h"
 #include "vision/Manifold3D.h"
 #include "system/AlloyFileUtil.h"
+#include "system/AlloyMemMappedFile.h"
 #include "common/cereal/archives/xml.hpp"
 #include "common/cereal/archives/json.hpp"
 #include "common/cereal/archives/portable_binary.hpp"
@@ -38,7 +39,7 @@ void ReadContourFromFile(const std::string& file, Manifold3D& params) {
 		cereal::XMLInputArchive archive(os);
 		archive(cereal::make_nvp("surface", params));
 	} else {
-		std::ifstream os(file, std::ios::binary);
+		MemMapInputStream os(file);
 		cereal::PortableBinaryInputArchive archive(os);
 		archive(cereal::make_nvp("surface", params));
 	}
@@ -62,6 +63,64 @@ void WriteContourToFile(const std::string& file, Manifold3D& params) {
 	}
 	params.setFile(file);
 }
+static const uint32_t MANIFOLD3D_BINARY_MAGIC = 0x4433464D;
+static const uint32_t MANIFOLD3D_BINARY_VERSION = 1;
+void WriteContourToBinaryFile(const std::string& file, const Manifold3D& params) {
+	std::ofstream os(file, std::ios::binary);
+	if (!os.is_open()) {
+		throw std::runtime_error(MakeString() << "Could not open " << file << " for writing.");
+	}
+	uint32_t header[2] = { MANIFOLD3D_BINARY_MAGIC, MANIFOLD3D_BINARY_VERSION };
+	os.write((const char*) header, sizeof(header));
+	WriteBinaryString(os, params.getFile());
+	int32_t meshType = (int32_t) params.meshType;
+	os.write((const char*) &meshType, sizeof(int32_t));
+	WriteBinaryBlock(os, params.vertexes.data);
+	WriteBinaryBlock(os, params.normals.data);
+	WriteBinaryBlock(os, params.colors.data);
+	WriteBinaryBlock(os, params.particles.data);
+	WriteBinaryBlock(os, params.particleTracking);
+	WriteBinaryBlock(os, params.vertexLocations.data);
+	WriteBinaryBlock(os, params.vertexNormals.data);
+	WriteBinaryBlock(os, params.triIndexes.data);
+	WriteBinaryBlock(os, params.quadIndexes.data);
+	WriteBinaryBlock(os, params.vertexLabels);
+	WriteBinaryBlock(os, params.particleLabels);
+	WriteBinaryBlock(os, params.correspondence.data);
+	for (const Vector3f& velocity : params.velocities) {
+		WriteBinaryBlock(os, velocity.data);
+	}
+}
+void ReadContourFromBinaryFile(const std::string& file, Manifold3D& params) {
+	MemMapInputStream is(file);
+	uint32_t header[2] = { 0, 0 };
+	is.read((char*) header, sizeof(header));
+	if (header[0] != MANIFOLD3D_BINARY_MAGIC || header[1] != MANIFOLD3D_BINARY_VERSION) {
+		throw std::runtime_error(MakeString() << "Could not read " << file << ", not a manifold binary file.");
+	}
+	params.setFile(ReadBinaryString(is));
+	int32_t meshType = 0;
+	is.read((char*) &meshType, sizeof(int32_t));
+	params.meshType = (MeshType) meshType;
+	ReadBinaryBlock(is, params.vertexes.data);
+	ReadBinaryBlock(is, params.normals.data);
+	ReadBinaryBlock(is, params.colors.data);
+	ReadBinaryBlock(is, params.particles.data);
+	ReadBinaryBlock(is, params.particleTracking);
+	ReadBinaryBlock(is, params.vertexLocations.data);
+	ReadBinaryBlock(is, params.vertexNormals.data);
+	ReadBinaryBlock(is, params.triIndexes.data);
+	ReadBinaryBlock(is, params.quadIndexes.data);
+	ReadBinaryBlock(is, params.vertexLabels);
+	ReadBinaryBlock(is, params.particleLabels);
+	ReadBinaryBlock(is, params.correspondence.data);
+	for (Vector3f& velocity : params.velocities) {
+		ReadBinaryBlock(is, velocity.data);
+	}
+	if (!is) {
+		throw std::runtime_error(MakeString() << "Could not read " << file << ", file is truncated.");
+	}
+}
 const float3i& Breadcrumbs3D::operator()(const size_t t,const size_t i) const {
 	return history[t][i];
 }
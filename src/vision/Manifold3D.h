@@ -118,6 +118,9 @@ namespace aly {
 	};
 	void ReadContourFromFile(const std::string& file, Manifold3D& contour);
 	void WriteContourToFile(const std::string& file, Manifold3D& contour);
+	//Raw binary layout (no per-element encoding) for fast caching of simulation frames. Not portable across platforms with different endianness.
+	void ReadContourFromBinaryFile(const std::string& file, Manifold3D& contour);
+	void WriteContourToBinaryFile(const std::string& file, const Manifold3D& contour);
 
 }
 #endif
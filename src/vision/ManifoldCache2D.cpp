@@ -21,97 +21,337 @@
 #include "vision/ManifoldCache2D.h"
 #include "system/AlloyFileUtil.h"
 namespace aly {
+static size_t MemorySize(const Manifold2D& contour) {
+	size_t bytes = sizeof(Manifold2D);
+	for (const std::vector<uint32_t>& curve : contour.indexes) {
+		bytes += curve.size() * sizeof(uint32_t);
+	}
+	bytes += contour.vertexLocations.size() * sizeof(float2);
+	bytes += contour.particles.size() * sizeof(float2);
+	bytes += contour.vertexes.size() * sizeof(float2);
+	bytes += contour.normals.size() * sizeof(float2);
+	bytes += contour.particleLabels.size() * sizeof(int);
+	bytes += contour.vertexLabels.size() * sizeof(int);
+	bytes += contour.particleTracking.size() * sizeof(int);
+	bytes += contour.overlay.size() * contour.overlay.typeSize();
+	bytes += contour.fluidParticles.particles.size() * sizeof(float2);
+	bytes += contour.fluidParticles.velocities.size() * sizeof(float2);
+	bytes += contour.fluidParticles.velocityImage.size() * contour.fluidParticles.velocityImage.typeSize();
+	for (const Vector2f& velocity : contour.velocities) {
+		bytes += velocity.size() * sizeof(float2);
+	}
+	bytes += contour.correspondence.size() * sizeof(float2);
+	bytes += contour.clusterCenters.size() * sizeof(float2);
+	bytes += contour.clusterColors.size() * sizeof(float3);
+	return bytes;
+}
 void CacheElement2D::load() {
 	std::lock_guard<std::mutex> lockMe(accessLock);
 	if (!loaded) {
-		contour.reset(new Manifold2D());
-		ReadContourFromFile(contourFile, *contour);
-		//std::cout << "Load: " << contour->getFile() << std::endl;
+		contour = evicted.lock();
+		if (contour.get() == nullptr) {
+			contour.reset(new Manifold2D());
+			ReadContourFromBinaryFile(cacheFile, *contour);
+		}
+		evicted.reset();
+		memorySize = MemorySize(*contour);
 		loaded = true;
 	}
 }
 void CacheElement2D::unload() {
+	bool dirty = false;
+	std::shared_ptr<Manifold2D> released = evict(dirty);
+	if (dirty) {
+		WriteContourToBinaryFile(cacheFile, *released);
+	}
+}
+std::shared_ptr<Manifold2D> CacheElement2D::evict(bool& dirty) {
 	std::lock_guard<std::mutex> lockMe(accessLock);
+	std::shared_ptr<Manifold2D> released;
+	dirty = false;
 	if (loaded) {
 		if (writeOnce) {
-			WriteContourToFile(contour->getFile(), *contour);
-			//std::cout<<"Unload: "<<contour->getFile()<<std::endl;
+			dirty = true;
 			writeOnce = false;
 		}
+		released = contour;
+		evicted = contour;
 		contour.reset();
 		loaded = false;
 	}
+	return released;
 }
 void CacheElement2D::set(const Manifold2D& springl) {
+	std::lock_guard<std::mutex> lockMe(accessLock);
 	contour.reset(new Manifold2D());
 	*contour = springl;
 	contourFile = springl.getFile();
+	evicted.reset();
+	memorySize = MemorySize(*contour);
+	writeOnce = true;
 	loaded = true;
 }
 std::shared_ptr<Manifold2D> CacheElement2D::getManifold() {
 	load();
 	return contour;
 }
+ManifoldCache2D::ManifoldCache2D() :
+		ManifoldCache2D(-1) {
+}
+ManifoldCache2D::ManifoldCache2D(int maxElements) :
+		maxMemory(DEFAULT_MAX_MEMORY), maxElements(maxElements), loadedMemory(0), counter(0), prefetchCount(2), lastFrame(-1), pendingMemory(0), busy(false), running(true) {
+	cacheDirectory = ConcatPath(GetTempDirectory(), MakeString() << "alloy_manifold2d_" << std::time(nullptr) << "_" << (size_t) this);
+	MakeDirectory(cacheDirectory);
+	worker = std::thread(&ManifoldCache2D::work, this);
+}
+ManifoldCache2D::~ManifoldCache2D() {
+	{
+		std::lock_guard<std::mutex> lockMe(queueLock);
+		running = false;
+	}
+	queueCondition.notify_all();
+	worker.join();
+	retired.clear();
+	cache.clear();
+	if (FileExists(cacheDirectory)) {
+		RemoveDirectoryRecursive(cacheDirectory);
+	}
+}
+void ManifoldCache2D::work() {
+	std::unique_lock<std::mutex> lockMe(queueLock);
+	while (true) {
+		queueCondition.wait(lockMe, [this] {
+			return !running || !writeQueue.empty() || !prefetchQueue.empty();
+		});
+		if (!running) {
+			prefetchQueue.clear();
+		}
+		if (!writeQueue.empty()) {
+			WriteJob job = writeQueue.front();
+			writeQueue.pop_front();
+			busy = true;
+			lockMe.unlock();
+			try {
+				WriteContourToBinaryFile(job.file, *job.contour);
+			} catch (std::exception& e) {
+				std::cerr << "Manifold cache write-back failed: " << e.what() << std::endl;
+			}
+			lockMe.lock();
+			pendingMemory -= job.memorySize;
+			//Destroyed later on a caller's thread, same as a synchronous eviction.
+			retired.push_back(job.contour);
+			busy = false;
+			queueCondition.notify_all();
+		} else if (!prefetchQueue.empty()) {
+			int frame = prefetchQueue.front();
+			prefetchQueue.pop_front();
+			busy = true;
+			lockMe.unlock();
+			try {
+				prefetch(frame);
+			} catch (std::exception& e) {
+				std::cerr << "Manifold cache prefetch failed: " << e.what() << std::endl;
+			}
+			lockMe.lock();
+			busy = false;
+			queueCondition.notify_all();
+		} else if (!running) {
+			break;
+		}
+	}
+}
+void ManifoldCache2D::prefetch(int frame) {
+	std::shared_ptr<CacheElement2D> elem;
+	{
+		std::lock_guard<std::mutex> lockMe(accessLock);
+		auto iter = cache.find(frame);
+		if (iter == cache.end() || accessTimes.find(frame) != accessTimes.end()) {
+			return;
+		}
+		elem = iter->second;
+	}
+	elem->load();
+	std::lock_guard<std::mutex> lockMe(accessLock);
+	auto iter = cache.find(frame);
+	if (iter != cache.end() && iter->second == elem && accessTimes.find(frame) == accessTimes.end() && elem->isLoaded()) {
+		touch(frame, elem);
+		enforceBudget();
+	}
+}
+void ManifoldCache2D::touch(int frame, const std::shared_ptr<CacheElement2D>& elem) {
+	auto time = accessTimes.find(frame);
+	if (time != accessTimes.end()) {
+		loadedList.erase(std::pair<uint64_t, int>(time->second, frame));
+	} else {
+		loadedMemory += elem->getMemorySize();
+	}
+	accessTimes[frame] = counter;
+	loadedList.insert(std::pair<uint64_t, int>(counter++, frame));
+}
+void ManifoldCache2D::evict(int frame) {
+	auto time = accessTimes.find(frame);
+	if (time == accessTimes.end()) {
+		return;
+	}
+	loadedList.erase(std::pair<uint64_t, int>(time->second, frame));
+	accessTimes.erase(time);
+	std::shared_ptr<CacheElement2D> elem = cache[frame];
+	size_t bytes = elem->getMemorySize();
+	loadedMemory -= bytes;
+	bool dirty = false;
+	std::shared_ptr<Manifold2D> released = elem->evict(dirty);
+	if (dirty) {
+		WriteJob job;
+		job.file = elem->getCacheFile();
+		job.contour = released;
+		job.memorySize = bytes;
+		{
+			std::lock_guard<std::mutex> lockMe(queueLock);
+			pendingMemory += bytes;
+			writeQueue.push_back(job);
+		}
+		queueCondition.notify_all();
+	} else if (released.get() != nullptr) {
+		//Eviction can run on the worker during a prefetch, the manifold owns GL buffers and has to be released by a caller.
+		std::lock_guard<std::mutex> lockMe(queueLock);
+		retired.push_back(released);
+	}
+}
+void ManifoldCache2D::enforceBudget() {
+	//Always keep the most recently used frame, even if it alone exceeds the budget.
+	while ((loadedMemory > maxMemory || (maxElements > 0 && (int) loadedList.size() > maxElements))
+			&& loadedList.size() > 1) {
+		evict(loadedList.begin()->second);
+	}
+}
+void ManifoldCache2D::releaseRetired() {
+	std::vector<std::shared_ptr<Manifold2D>> released;
+	{
+		std::lock_guard<std::mutex> lockMe(queueLock);
+		released.swap(retired);
+	}
+}
+void ManifoldCache2D::setMaxMemory(uint64_t bytes) {
+	{
+		std::lock_guard<std::mutex> lockMe(accessLock);
+		{
+			//Also read by set() while it waits on the write-back queue.
+			std::lock_guard<std::mutex> queueLockMe(queueLock);
+			maxMemory = bytes;
+		}
+		enforceBudget();
+	}
+	queueCondition.notify_all();
+	releaseRetired();
+}
 std::shared_ptr<CacheElement2D> ManifoldCache2D::set(int frame,
 		const Manifold2D& springl) {
+	releaseRetired();
+	{
+		//Only stall the simulation if the disk falls a full budget behind.
+		std::unique_lock<std::mutex> lockMe(queueLock);
+		queueCondition.wait(lockMe, [this] {
+			return pendingMemory <= maxMemory;
+		});
+	}
 	std::lock_guard<std::mutex> lockMe(accessLock);
 	auto iter = cache.find(frame);
 	std::shared_ptr<CacheElement2D> elem;
 	if (iter != cache.end()) {
 		elem = iter->second;
+		auto time = accessTimes.find(frame);
+		if (time != accessTimes.end()) {
+			loadedList.erase(std::pair<uint64_t, int>(time->second, frame));
+			accessTimes.erase(time);
+			loadedMemory -= elem->getMemorySize();
+		}
 	} else {
 		elem = std::shared_ptr<CacheElement2D>(new CacheElement2D());
+		elem->setCacheFile(ConcatPath(cacheDirectory, MakeString() << "frame" << frame << ".mf2"));
 		cache[frame] = elem;
 	}
 	elem->set(springl);
-	if (elem->isLoaded()) {
-		while ((int) loadedList.size() >= maxElements) {
-			cache[loadedList.begin()->second]->unload();
-			loadedList.erase(loadedList.begin());
-		}
-		loadedList.insert(std::pair<uint64_t, int>(counter++, frame));
-	}
+	touch(frame, elem);
+	enforceBudget();
 	return elem;
 }
+void ManifoldCache2D::flush() {
+	std::unique_lock<std::mutex> lockMe(queueLock);
+	queueCondition.wait(lockMe, [this] {
+		return writeQueue.empty() && !busy;
+	});
+}
 int ManifoldCache2D::unload() {
-	int sz = (int)loadedList.size();
-	for(auto pr:loadedList){
-		cache[pr.second]->unload();
+	int sz;
+	{
+		std::lock_guard<std::mutex> lockMe(accessLock);
+		sz = (int) loadedList.size();
+		while (loadedList.size() > 0) {
+			evict(loadedList.begin()->second);
+		}
 	}
-	loadedList.clear();
+	flush();
+	releaseRetired();
 	return sz;
 }
 std::shared_ptr<CacheElement2D> ManifoldCache2D::get(int frame) {
-	std::lock_guard<std::mutex> lockMe(accessLock);
-	auto iter = cache.find(frame);
-	if (iter != cache.end()) {
-		std::shared_ptr<CacheElement2D> elem = iter->second;
-		if (!elem->isLoaded()) {
-			while ((int) loadedList.size() >= maxElements) {
-				cache[loadedList.begin()->second]->unload();
-				loadedList.erase(loadedList.begin());
+	releaseRetired();
+	std::shared_ptr<CacheElement2D> elem;
+	int direction = 0;
+	{
+		std::lock_guard<std::mutex> lockMe(accessLock);
+		auto iter = cache.find(frame);
+		if (iter == cache.end()) {
+			return std::shared_ptr<CacheElement2D>();
+		}
+		elem = iter->second;
+		elem->load();
+		touch(frame, elem);
+		enforceBudget();
+		if (frame != lastFrame) {
+			direction = (lastFrame >= 0 && frame < lastFrame) ? -1 : 1;
+			lastFrame = frame;
+		}
+	}
+	if (direction != 0 && prefetchCount > 0) {
+		{
+			//Frames queued for an earlier position on the timeline are no longer useful.
+			std::lock_guard<std::mutex> lockMe(queueLock);
+			prefetchQueue.clear();
+			for (int n = 1; n <= prefetchCount; n++) {
+				prefetchQueue.push_back(frame + direction * n);
 			}
-			elem->load();
-			loadedList.insert(std::pair<uint64_t, int>(counter++, frame));
 		}
-		return elem;
-	} else {
-		return std::shared_ptr<CacheElement2D>();
+		queueCondition.notify_all();
 	}
+	return elem;
 }
 CacheElement2D::~CacheElement2D() {
-	if (FileExists(contourFile)) {
-		RemoveFile(contourFile);
-		std::string imageFile = GetFileWithoutExtension(contourFile) + ".png";
-		if (FileExists(imageFile))
-			RemoveFile(imageFile);
+	if (cacheFile.size() > 0 && FileExists(cacheFile)) {
+		RemoveFile(cacheFile);
 	}
 }
 void ManifoldCache2D::clear() {
+	{
+		//Pending write-backs belong to frames that are about to be deleted.
+		std::unique_lock<std::mutex> lockMe(queueLock);
+		for (const WriteJob& job : writeQueue) {
+			pendingMemory -= job.memorySize;
+		}
+		writeQueue.clear();
+		prefetchQueue.clear();
+		queueCondition.wait(lockMe, [this] {
+			return !busy;
+		});
+	}
+	queueCondition.notify_all();
+	releaseRetired();
 	std::lock_guard<std::mutex> lockMe(accessLock);
 	counter = 0;
+	loadedMemory = 0;
+	lastFrame = -1;
 	loadedList.clear();
+	accessTimes.clear();
 	cache.clear();
-
 }
 }
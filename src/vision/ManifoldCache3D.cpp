@@ -21,97 +21,332 @@
 #include "vision/ManifoldCache3D.h"
 #include "system/AlloyFileUtil.h"
 namespace aly {
+static size_t MemorySize(const Manifold3D& contour) {
+	size_t bytes = sizeof(Manifold3D);
+	bytes += contour.vertexes.size() * sizeof(float3);
+	bytes += contour.normals.size() * sizeof(float3);
+	bytes += contour.colors.size() * sizeof(float4);
+	bytes += contour.particles.size() * sizeof(float3);
+	bytes += contour.quadIndexes.size() * sizeof(uint4);
+	bytes += contour.triIndexes.size() * sizeof(uint3);
+	bytes += contour.vertexLocations.size() * sizeof(float3);
+	bytes += contour.vertexNormals.size() * sizeof(float3);
+	bytes += contour.particleLabels.size() * sizeof(int);
+	bytes += contour.vertexLabels.size() * sizeof(int);
+	bytes += contour.particleTracking.size() * sizeof(int);
+	bytes += contour.correspondence.size() * sizeof(float3);
+	for (const Vector3f& velocity : contour.velocities) {
+		bytes += velocity.size() * sizeof(float3);
+	}
+	return bytes;
+}
 void CacheElement3D::load() {
 	std::lock_guard<std::mutex> lockMe(accessLock);
 	if (!loaded) {
-		contour.reset(new Manifold3D());
-		ReadContourFromFile(contourFile, *contour);
-		//std::cout << "Load: " << contour->getFile() << std::endl;
+		contour = evicted.lock();
+		if (contour.get() == nullptr) {
+			contour.reset(new Manifold3D());
+			ReadContourFromBinaryFile(cacheFile, *contour);
+		}
+		evicted.reset();
+		memorySize = MemorySize(*contour);
 		loaded = true;
 	}
 }
 void CacheElement3D::unload() {
+	bool dirty = false;
+	std::shared_ptr<Manifold3D> released = evict(dirty);
+	if (dirty) {
+		WriteContourToBinaryFile(cacheFile, *released);
+	}
+}
+std::shared_ptr<Manifold3D> CacheElement3D::evict(bool& dirty) {
 	std::lock_guard<std::mutex> lockMe(accessLock);
+	std::shared_ptr<Manifold3D> released;
+	dirty = false;
 	if (loaded) {
 		if (writeOnce) {
-			WriteContourToFile(contour->getFile(), *contour);
-			//std::cout<<"Unload: "<<contour->getFile()<<std::endl;
+			dirty = true;
 			writeOnce = false;
 		}
+		released = contour;
+		evicted = contour;
 		contour.reset();
 		loaded = false;
 	}
+	return released;
 }
 void CacheElement3D::set(const Manifold3D& springl) {
+	std::lock_guard<std::mutex> lockMe(accessLock);
 	contour.reset(new Manifold3D());
 	*contour = springl;
 	contourFile = springl.getFile();
+	evicted.reset();
+	memorySize = MemorySize(*contour);
+	writeOnce = true;
 	loaded = true;
 }
 std::shared_ptr<Manifold3D> CacheElement3D::getContour() {
 	load();
 	return contour;
 }
+ManifoldCache3D::ManifoldCache3D() :
+		ManifoldCache3D(-1) {
+}
+ManifoldCache3D::ManifoldCache3D(int maxElements) :
+		maxMemory(DEFAULT_MAX_MEMORY), maxElements(maxElements), loadedMemory(0), counter(0), prefetchCount(2), lastFrame(-1), pendingMemory(0), busy(false), running(true) {
+	cacheDirectory = ConcatPath(GetTempDirectory(), MakeString() << "alloy_manifold3d_" << std::time(nullptr) << "_" << (size_t) this);
+	MakeDirectory(cacheDirectory);
+	worker = std::thread(&ManifoldCache3D::work, this);
+}
+ManifoldCache3D::~ManifoldCache3D() {
+	{
+		std::lock_guard<std::mutex> lockMe(queueLock);
+		running = false;
+	}
+	queueCondition.notify_all();
+	worker.join();
+	retired.clear();
+	cache.clear();
+	if (FileExists(cacheDirectory)) {
+		RemoveDirectoryRecursive(cacheDirectory);
+	}
+}
+void ManifoldCache3D::work() {
+	std::unique_lock<std::mutex> lockMe(queueLock);
+	while (true) {
+		queueCondition.wait(lockMe, [this] {
+			return !running || !writeQueue.empty() || !prefetchQueue.empty();
+		});
+		if (!running) {
+			prefetchQueue.clear();
+		}
+		if (!writeQueue.empty()) {
+			WriteJob job = writeQueue.front();
+			writeQueue.pop_front();
+			busy = true;
+			lockMe.unlock();
+			try {
+				WriteContourToBinaryFile(job.file, *job.contour);
+			} catch (std::exception& e) {
+				std::cerr << "Manifold cache write-back failed: " << e.what() << std::endl;
+			}
+			lockMe.lock();
+			pendingMemory -= job.memorySize;
+			//Destroyed later on a caller's thread, same as a synchronous eviction.
+			retired.push_back(job.contour);
+			busy = false;
+			queueCondition.notify_all();
+		} else if (!prefetchQueue.empty()) {
+			int frame = prefetchQueue.front();
+			prefetchQueue.pop_front();
+			busy = true;
+			lockMe.unlock();
+			try {
+				prefetch(frame);
+			} catch (std::exception& e) {
+				std::cerr << "Manifold cache prefetch failed: " << e.what() << std::endl;
+			}
+			lockMe.lock();
+			busy = false;
+			queueCondition.notify_all();
+		} else if (!running) {
+			break;
+		}
+	}
+}
+void ManifoldCache3D::prefetch(int frame) {
+	std::shared_ptr<CacheElement3D> elem;
+	{
+		std::lock_guard<std::mutex> lockMe(accessLock);
+		auto iter = cache.find(frame);
+		if (iter == cache.end() || accessTimes.find(frame) != accessTimes.end()) {
+			return;
+		}
+		elem = iter->second;
+	}
+	elem->load();
+	std::lock_guard<std::mutex> lockMe(accessLock);
+	auto iter = cache.find(frame);
+	if (iter != cache.end() && iter->second == elem && accessTimes.find(frame) == accessTimes.end() && elem->isLoaded()) {
+		touch(frame, elem);
+		enforceBudget();
+	}
+}
+void ManifoldCache3D::touch(int frame, const std::shared_ptr<CacheElement3D>& elem) {
+	auto time = accessTimes.find(frame);
+	if (time != accessTimes.end()) {
+		loadedList.erase(std::pair<uint64_t, int>(time->second, frame));
+	} else {
+		loadedMemory += elem->getMemorySize();
+	}
+	accessTimes[frame] = counter;
+	loadedList.insert(std::pair<uint64_t, int>(counter++, frame));
+}
+void ManifoldCache3D::evict(int frame) {
+	auto time = accessTimes.find(frame);
+	if (time == accessTimes.end()) {
+		return;
+	}
+	loadedList.erase(std::pair<uint64_t, int>(time->second, frame));
+	accessTimes.erase(time);
+	std::shared_ptr<CacheElement3D> elem = cache[frame];
+	size_t bytes = elem->getMemorySize();
+	loadedMemory -= bytes;
+	bool dirty = false;
+	std::shared_ptr<Manifold3D> released = elem->evict(dirty);
+	if (dirty) {
+		WriteJob job;
+		job.file = elem->getCacheFile();
+		job.contour = released;
+		job.memorySize = bytes;
+		{
+			std::lock_guard<std::mutex> lockMe(queueLock);
+			pendingMemory += bytes;
+			writeQueue.push_back(job);
+		}
+		queueCondition.notify_all();
+	} else if (released.get() != nullptr) {
+		//Eviction can run on the worker during a prefetch, the manifold owns GL buffers and has to be released by a caller.
+		std::lock_guard<std::mutex> lockMe(queueLock);
+		retired.push_back(released);
+	}
+}
+void ManifoldCache3D::enforceBudget() {
+	//Always keep the most recently used frame, even if it alone exceeds the budget.
+	while ((loadedMemory > maxMemory || (maxElements > 0 && (int) loadedList.size() > maxElements))
+			&& loadedList.size() > 1) {
+		evict(loadedList.begin()->second);
+	}
+}
+void ManifoldCache3D::releaseRetired() {
+	std::vector<std::shared_ptr<Manifold3D>> released;
+	{
+		std::lock_guard<std::mutex> lockMe(queueLock);
+		released.swap(retired);
+	}
+}
+void ManifoldCache3D::setMaxMemory(uint64_t bytes) {
+	{
+		std::lock_guard<std::mutex> lockMe(accessLock);
+		{
+			//Also read by set() while it waits on the write-back queue.
+			std::lock_guard<std::mutex> queueLockMe(queueLock);
+			maxMemory = bytes;
+		}
+		enforceBudget();
+	}
+	queueCondition.notify_all();
+	releaseRetired();
+}
 std::shared_ptr<CacheElement3D> ManifoldCache3D::set(int frame,
 		const Manifold3D& springl) {
+	releaseRetired();
+	{
+		//Only stall the simulation if the disk falls a full budget behind.
+		std::unique_lock<std::mutex> lockMe(queueLock);
+		queueCondition.wait(lockMe, [this] {
+			return pendingMemory <= maxMemory;
+		});
+	}
 	std::lock_guard<std::mutex> lockMe(accessLock);
 	auto iter = cache.find(frame);
 	std::shared_ptr<CacheElement3D> elem;
 	if (iter != cache.end()) {
 		elem = iter->second;
+		auto time = accessTimes.find(frame);
+		if (time != accessTimes.end()) {
+			loadedList.erase(std::pair<uint64_t, int>(time->second, frame));
+			accessTimes.erase(time);
+			loadedMemory -= elem->getMemorySize();
+		}
 	} else {
 		elem = std::shared_ptr<CacheElement3D>(new CacheElement3D());
+		elem->setCacheFile(ConcatPath(cacheDirectory, MakeString() << "frame" << frame << ".mf3"));
 		cache[frame] = elem;
 	}
 	elem->set(springl);
-	if (elem->isLoaded()) {
-		while ((int) loadedList.size() >= maxElements) {
-			cache[loadedList.begin()->second]->unload();
-			loadedList.erase(loadedList.begin());
-		}
-		loadedList.insert(std::pair<uint64_t, int>(counter++, frame));
-	}
+	touch(frame, elem);
+	enforceBudget();
 	return elem;
 }
+void ManifoldCache3D::flush() {
+	std::unique_lock<std::mutex> lockMe(queueLock);
+	queueCondition.wait(lockMe, [this] {
+		return writeQueue.empty() && !busy;
+	});
+}
 int ManifoldCache3D::unload() {
-	int sz = (int)loadedList.size();
-	for(auto pr:loadedList){
-		cache[pr.second]->unload();
+	int sz;
+	{
+		std::lock_guard<std::mutex> lockMe(accessLock);
+		sz = (int) loadedList.size();
+		while (loadedList.size() > 0) {
+			evict(loadedList.begin()->second);
+		}
 	}
-	loadedList.clear();
+	flush();
+	releaseRetired();
 	return sz;
 }
 std::shared_ptr<CacheElement3D> ManifoldCache3D::get(int frame) {
-	std::lock_guard<std::mutex> lockMe(accessLock);
-	auto iter = cache.find(frame);
-	if (iter != cache.end()) {
-		std::shared_ptr<CacheElement3D> elem = iter->second;
-		if (!elem->isLoaded()) {
-			while ((int) loadedList.size() >= maxElements) {
-				cache[loadedList.begin()->second]->unload();
-				loadedList.erase(loadedList.begin());
+	releaseRetired();
+	std::shared_ptr<CacheElement3D> elem;
+	int direction = 0;
+	{
+		std::lock_guard<std::mutex> lockMe(accessLock);
+		auto iter = cache.find(frame);
+		if (iter == cache.end()) {
+			return std::shared_ptr<CacheElement3D>();
+		}
+		elem = iter->second;
+		elem->load();
+		touch(frame, elem);
+		enforceBudget();
+		if (frame != lastFrame) {
+			direction = (lastFrame >= 0 && frame < lastFrame) ? -1 : 1;
+			lastFrame = frame;
+		}
+	}
+	if (direction != 0 && prefetchCount > 0) {
+		{
+			//Frames queued for an earlier position on the timeline are no longer useful.
+			std::lock_guard<std::mutex> lockMe(queueLock);
+			prefetchQueue.clear();
+			for (int n = 1; n <= prefetchCount; n++) {
+				prefetchQueue.push_back(frame + direction * n);
 			}
-			elem->load();
-			loadedList.insert(std::pair<uint64_t, int>(counter++, frame));
 		}
-		return elem;
-	} else {
-		return std::shared_ptr<CacheElement3D>();
+		queueCondition.notify_all();
 	}
+	return elem;
 }
 CacheElement3D::~CacheElement3D() {
-	if (FileExists(contourFile)) {
-		RemoveFile(contourFile);
-		std::string imageFile = GetFileWithoutExtension(contourFile) + ".png";
-		if (FileExists(imageFile))
-			RemoveFile(imageFile);
+	if (cacheFile.size() > 0 && FileExists(cacheFile)) {
+		RemoveFile(cacheFile);
 	}
 }
 void ManifoldCache3D::clear() {
+	{
+		//Pending write-backs belong to frames that are about to be deleted.
+		std::unique_lock<std::mutex> lockMe(queueLock);
+		for (const WriteJob& job : writeQueue) {
+			pendingMemory -= job.memorySize;
+		}
+		writeQueue.clear();
+		prefetchQueue.clear();
+		queueCondition.wait(lockMe, [this] {
+			return !busy;
+		});
+	}
+	queueCondition.notify_all();
+	releaseRetired();
 	std::lock_guard<std::mutex> lockMe(accessLock);
 	counter = 0;
+	loadedMemory = 0;
+	lastFrame = -1;
 	loadedList.clear();
+	accessTimes.clear();
 	cache.clear();
-
 }
 }
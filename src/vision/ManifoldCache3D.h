@@ -23,6 +23,9 @@
 #define INCLUDE_MANIFOLDCACHE3D_H_
 #include "Manifold3D.h"
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
 #include <map>
 #include <set>
 namespace aly {
@@ -31,22 +34,38 @@ namespace aly {
 		bool loaded;
 		bool writeOnce;
 		std::string contourFile;
+		//Where the cache keeps this frame on disk, separate from the manifold's own file.
+		std::string cacheFile;
 		std::shared_ptr<Manifold3D> contour;
-
+		//Contour handed to the write-back queue. It can be revived without touching disk until the write completes.
+		std::weak_ptr<Manifold3D> evicted;
+		size_t memorySize;
 		std::mutex accessLock;
 	public:
 		bool isLoaded() {
 			std::lock_guard<std::mutex> lockMe(accessLock);
 			return loaded;
 		}
-		CacheElement3D():loaded(false), writeOnce(true){
+		CacheElement3D():loaded(false), writeOnce(true),memorySize(0){
 		}
 		~CacheElement3D();
 		std::string getFile() const {
 			return contourFile;
 		}
+		std::string getCacheFile() const {
+			return cacheFile;
+		}
+		void setCacheFile(const std::string& file) {
+			cacheFile = file;
+		}
+		size_t getMemorySize() {
+			std::lock_guard<std::mutex> lockMe(accessLock);
+			return memorySize;
+		}
 		void load();
 		void unload();
+		//Releases the in-memory contour and returns it, dirty is set if it still has to be written to disk.
+		std::shared_ptr<Manifold3D> evict(bool& dirty);
 		void set(const Manifold3D& springl);
 		std::shared_ptr<Manifold3D> getContour();
 	};
@@ -55,20 +74,70 @@ namespace aly {
 			return lhs.first < rhs.first;
 		}
 	};
+	/*
+	 * Keeps recent simulation frames in memory up to a byte budget. Evicted frames are written to disk
+	 * on a background thread and frames adjacent to the last requested one are prefetched in the direction
+	 * the timeline is moving. Frames are written to a private directory under GetTempDirectory() that is
+	 * removed with the cache. Manifolds are only released on threads that call into the cache, never on the worker.
+	 */
 	class ManifoldCache3D {
 	protected:
+		struct WriteJob {
+			std::string file;
+			std::shared_ptr<Manifold3D> contour;
+			size_t memorySize;
+		};
 		std::map<int, std::shared_ptr<CacheElement3D>> cache;
 		std::set<std::pair<uint64_t, int>, CacheCompare3D> loadedList;
+		std::map<int, uint64_t> accessTimes;
 		std::mutex accessLock;
+		uint64_t maxMemory;
 		int maxElements;
+		uint64_t loadedMemory;
 		uint64_t counter;
-	public:
-		ManifoldCache3D(int elem=32):maxElements(elem),counter(0){
+		int prefetchCount;
+		int lastFrame;
+		std::string cacheDirectory;
 
+		std::thread worker;
+		std::mutex queueLock;
+		std::condition_variable queueCondition;
+		std::deque<WriteJob> writeQueue;
+		std::deque<int> prefetchQueue;
+		std::vector<std::shared_ptr<Manifold3D>> retired;
+		uint64_t pendingMemory;
+		bool busy;
+		bool running;
+		void work();
+		void touch(int frame, const std::shared_ptr<CacheElement3D>& elem);
+		void evict(int frame);
+		void enforceBudget();
+		void releaseRetired();
+		void prefetch(int frame);
+	public:
+		static const uint64_t DEFAULT_MAX_MEMORY = 1024ULL * 1024ULL * 1024ULL;
+		//Limited to DEFAULT_MAX_MEMORY bytes, see setMaxMemory().
+		ManifoldCache3D();
+		//Keeps at most maxElements frames in memory, in addition to the byte budget.
+		ManifoldCache3D(int maxElements);
+		~ManifoldCache3D();
+		void setMaxMemory(uint64_t bytes);
+		uint64_t getMaxMemory() {
+			std::lock_guard<std::mutex> lockMe(accessLock);
+			return maxMemory;
+		}
+		uint64_t getLoadedMemory() {
+			std::lock_guard<std::mutex> lockMe(accessLock);
+			return loadedMemory;
+		}
+		//Number of frames to load ahead of the last frame requested with get().
+		void setPrefetchCount(int count) {
+			prefetchCount = count;
 		}
-
 		std::shared_ptr<CacheElement3D> set(int frame, const Manifold3D& springl);
 		std::shared_ptr<CacheElement3D> get(int frame);
+		//Blocks until all pending write-backs are on disk.
+		void flush();
 		int unload();
 		void clear();
 	};
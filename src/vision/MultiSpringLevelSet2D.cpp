@@ -29,7 +29,7 @@ namespace aly {
 	float MultiSpringLevelSet2D::SPRING_CONSTANT = 0.3f;
 	float MultiSpringLevelSet2D::EXTENT = 0.5f;
 	float MultiSpringLevelSet2D::SHARPNESS = 5.0f;
-	MultiSpringLevelSet2D::MultiSpringLevelSet2D(const std::shared_ptr<ManifoldCache2D>& cache) :MultiActiveContour2D("Multi Spring Level Set 2D", cache), resampleEnabled(true) {
+	MultiSpringLevelSet2D::MultiSpringLevelSet2D(const std::shared_ptr<ManifoldCache2D>& cache) :MultiActiveContour2D("Multi Spring Level Set 2D", cache), locatorBackend(LocatorBackend::HashGrid), resampleEnabled(true) {
 	}
 	void MultiSpringLevelSet2D::setSpringls(const Vector2f& particles, const Vector2f& points) {
 		contour.particles = particles;
@@ -188,7 +188,7 @@ namespace aly {
 		return pt;
 	}
 	void MultiSpringLevelSet2D::updateNearestNeighbors(float maxDistance) {
-		locator.reset(new Locator2f(contour.vertexes));
+		locator = MakePointLocator(contour.vertexes, maxDistance, locatorBackend);
 		nearestNeighbors.clear();
 		nearestNeighbors.resize(contour.vertexes.size(), std::vector<uint32_t>());
 		int N = (int)contour.vertexes.size();
@@ -278,7 +278,7 @@ namespace aly {
 		const float planeThreshold=std::cos(ToRadians(80.0f));
 		//do {
 			//invalid = 0;
-			locator.reset(new Locator2f(oldVertexes));
+			locator = MakePointLocator(oldVertexes, maxDistance, locatorBackend);
 			std::vector<int> retrack;
 			for (size_t i = 0; i < contour.particles.size(); i++) {
 				if (std::isinf(contour.correspondence[i].x)
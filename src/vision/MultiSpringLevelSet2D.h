@@ -37,7 +37,8 @@ namespace aly {
 		static float SPRING_CONSTANT;
 		static float SHARPNESS;
 	protected:
-		std::shared_ptr<Locator2f> locator;
+		std::shared_ptr<PointLocator2f> locator;
+		LocatorBackend locatorBackend;
 		aly::Vector2f oldCorrespondences;
 		std::array<Vector2f, 4> oldVelocities;
 		aly::Vector2f oldVertexes;
@@ -69,7 +70,9 @@ namespace aly {
 		bool resampleEnabled;
 
 	public:
-
+		void setLocatorBackend(const LocatorBackend& backend) {
+			locatorBackend = backend;
+		}
 		MultiSpringLevelSet2D(const std::shared_ptr<ManifoldCache2D>& cache = nullptr);
 		void setSpringls(const Vector2f& particles, const Vector2f& points);
 		virtual bool init() override;
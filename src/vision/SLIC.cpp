@@ -20,86 +20,56 @@
 */
 #include "vision/SLIC.h"
 #include "image/AlloyImageProcessing.h"
+#include "image/AlloyConnectedComponents.h"
 #include <set>
+#include <map>
 namespace aly {
 	SuperPixels::SuperPixels() :perturbSeeds(true), numLabels(0), bonusThreshold(10.0f), bonus(1.5f), errorThreshold(0.01f){
 	}
 	int SuperPixels::computeConnectedComponents(const Image1i& labels, Image1i& outLabels, std::vector<int> &compCounts) {
-		const int xShift[4] = { -1, 1, 0, 0 };
-		const int yShift[4] = { 0, 0,-1, 1 };
-		outLabels.resize(labels.width, labels.height);
-		outLabels.set(int1(-1));
-		std::list<int2> queue;
-		int2 pivot(0, 0);
-		int cc = 0;
-		int ccCount = 0;
-		int pivotLabel = 0;
-		compCounts.clear();
-		do
-		{
-			queue.clear();
-			outLabels(pivot) = int1(cc);
-			pivotLabel = labels(pivot).x;
-			ccCount = 1;
-			queue.push_back(pivot);
-			while (queue.size() > 0)
-			{
-				int2 v = queue.front();
-				queue.pop_front();
-				for (int s = 0; s < 4; s++)
-				{
-					int2 nbr = int2(v.x + xShift[s], v.y + yShift[s]);
-					if (nbr.x >= 0 && nbr.y >= 0 && nbr.x < outLabels.width&&nbr.y < outLabels.height) {
-						if (outLabels(nbr).x < 0 && labels(nbr).x == pivotLabel) {
-							outLabels(nbr).x = cc;
-							ccCount++;
-							queue.push_back(nbr);
-						}
-					}
-				}
-			}
-			compCounts.push_back(ccCount);
-
-			pivot = int2(-1, -1);
-			for (int t = 0;t < 16;t++) {
-				int i = RandomUniform(0, labels.width - 1);
-				int j = RandomUniform(0, labels.height - 1);
-				if (outLabels(i, j).x < 0)
-				{
-					pivot = int2(i, j);
-					break;
-				}
-			}
-			if (pivot.x < 0) {
-				for (int j = 1; j < labels.height-1; j++) {
-					for (int i = 1; i < labels.width-1; i++) {
-						if (outLabels(i, j).x < 0) {
-							pivot = int2(i, j);
-							break;
-						}
-					}
-				}
-			}
-			cc++;
-		} while (pivot.x >= 0);
+		std::vector<ConnectedComponent2D> components;
+		ConnectedComponents(labels, outLabels, components, 4);
+		compCounts.resize(components.size());
+		for (size_t n = 0; n < components.size(); n++) {
+			compCounts[n] = components[n].size;
+		}
 		return (int)compCounts.size();
 	}
 	int SuperPixels::makeLabelsUnique(Image1i& outImage) {
-		std::map<int, int> lookup;
-		int counter=0;
-		for (int j = 0;j < outImage.height;j++) {
-			for (int i = 0;i < outImage.width;i++) {
-				int l = outImage(i, j).x;
-				if (lookup.find(l) == lookup.end()) {
-					lookup[l] =counter++;
+		if (outImage.size() == 0)
+			return 0;
+		int minLabel = std::numeric_limits<int>::max();
+		int maxLabel = std::numeric_limits<int>::min();
+		for (const int1& l : outImage.data) {
+			minLabel = std::min(minLabel, l.x);
+			maxLabel = std::max(maxLabel, l.x);
+		}
+		//Labels are renumbered in order of first appearance.
+		int counter = 0;
+		int64_t span = (int64_t) maxLabel - (int64_t) minLabel + 1;
+		if (span > 4 * (int64_t) outImage.size()) {
+			//Sparse labels would make a flat table huge, so map them instead.
+			std::map<int, int> lookup;
+			for (int1& l : outImage.data) {
+				auto result = lookup.insert(std::pair<int, int>(l.x, counter));
+				if (result.second) {
+					counter++;
 				}
+				l.x = result.first->second;
 			}
+			return counter;
 		}
-		for (int j = 0;j < outImage.height;j++) {
-			for (int i = 0;i < outImage.width;i++) {
-				outImage(i, j).x = lookup[outImage(i, j).x];
+		std::vector<int> lookup((size_t) span, -1);
+		for (const int1& l : outImage.data) {
+			int& id = lookup[(size_t) ((int64_t) l.x - minLabel)];
+			if (id < 0) {
+				id = counter++;
 			}
 		}
+#pragma omp parallel for
+		for (int n = 0; n < (int)outImage.size(); n++) {
+			outImage.data[n].x = lookup[(size_t) ((int64_t) outImage.data[n].x - minLabel)];
+		}
 		return counter;
 	}
 	int SuperPixels::removeSmallConnectedComponents(const Image1i& labelImage, Image1i& outImage, int minSize)
@@ -107,20 +77,20 @@ namespace aly {
 		const int xShift[4] = { -1, 1, 0, 0 };
 		const int yShift[4] = { 0, 0,-1, 1 };
 		std::vector<int> compCounts;
-		std::vector<int> labels;
-		std::set<int> removeList;
 		computeConnectedComponents(labelImage,outImage, compCounts);
+		std::vector<char> removeList(compCounts.size(), 0);
+		int removeCount = 0;
 		for (int l = 0;l < (int)compCounts.size();l++) {
 			if (compCounts[l] < minSize) {
-				removeList.insert(l);
+				removeList[l] = 1;
+				removeCount++;
 			}
 		}
-		for (int j = 0;j < outImage.height;j++) {
-			for (int i = 0;i < outImage.width;i++) {
-				int l = outImage(i, j).x;
-				if (removeList.find(l) != removeList.end()) {
-					outImage(i, j).x = -1;
-				}
+#pragma omp parallel for
+		for (int n = 0; n < (int)outImage.size(); n++) {
+			int l = outImage.data[n].x;
+			if (removeList[l]) {
+				outImage.data[n].x = -1;
 			}
 		}
 		bool change = false;
@@ -143,7 +113,7 @@ namespace aly {
 				}
 			}
 		}while (change);
-		return (int)removeList.size();
+		return removeCount;
 	}
 
 	void SuperPixels::initializeSeeds(int K) {
@@ -297,72 +267,158 @@ namespace aly {
 		colorMean.resize(numk);
 		pixelMean.resize(numk);
 		clustersize.resize(numk, 0);
-		Image2f distImage(labImage.width, labImage.height);
 		Image1f scoreImage(labImage.width, labImage.height);
 		labelImage.set(int1(-1));
-		distImage.set(float2(1E10f));
-		scoreImage.set(float1(1E10f));
 		maxlab.resize(numk, 0.0f);
 		float invxywt = 1.0f / (S*S);//NOTE: this is different from how usual SLIC/LKM works, but in original code implementation
+		//Clusters are binned into tiles at least as wide as their search windows. Windows of clusters in tiles
+		//two apart never overlap, so the four checkerboard phases of tiles can each be processed in parallel.
+		int tileSize = (int)std::ceil(2.0f * offset) + 2;
+		int tilesX = (labImage.width + tileSize - 1) / tileSize;
+		int tilesY = (labImage.height + tileSize - 1) / tileSize;
+		std::vector<int> tileStart(tilesX * tilesY + 1);
+		std::vector<int> tileClusters(numk);
+		std::vector<int> clusterTile(numk);
+		std::vector<int> phaseTiles[4];
+		for (int ty = 0; ty < tilesY; ty++) {
+			for (int tx = 0; tx < tilesX; tx++) {
+				phaseTiles[(tx & 1) + 2 * (ty & 1)].push_back(tx + ty * tilesX);
+			}
+		}
+		const float3* lab = labImage.vecPtr();
+		float* score = scoreImage.ptr();
+		int* labels = labelImage.ptr();
+		int width = labImage.width;
 		for (int iter = 0;iter < iterations;iter++)
 		{
 			scoreImage.set(float1(1E10f));
 			if (iter > 0) {
 				updateMaxColor(labelImage);
 			}
-			for (int n = 0; n < numk; n++)
-			{
-				float2 pixelCenter = pixelCenters[n];
-				float3 colorCenter = colorCenters[n];
-				int xMin = std::max(0, (int)std::floor(pixelCenter.x - offset));
-				int xMax = std::min(labImage.width - 1, (int)std::ceil(pixelCenter.x + offset));
-				int yMin = std::max(0, (int)std::floor(pixelCenter.y - offset));
-				int yMax = std::min(labImage.height - 1, (int)std::ceil(pixelCenter.y + offset));
-				float ml = (maxlab[n] > 0.0f) ? 1.0f / maxlab[n] : 0.0f;
-				for (int y = yMin; y <= yMax; y++) {
-					for (int x = xMin; x <= xMax; x++) {
-						float3 c = labImage(x, y);
-						float distLab = lengthSqr(c - colorCenter);
-						float distPixel = lengthSqr(float2((float)x, (float)y) - pixelCenter);
-						float dist = distLab*ml + distPixel * invxywt;
-						float last = scoreImage(x, y).x;
-						distImage(x, y) = float2(distLab, distPixel);
-						if (dist < last)
-						{
-							scoreImage(x, y).x = dist;
-							labelImage(x, y).x = n;
-						}
-						else if (dist == last&&n < labelImage(x, y).x) {//Tie breaker, use smaller label id
-							scoreImage(x, y).x = dist;
-							labelImage(x, y).x = n;
+			//Counting sort of the clusters by tile, in increasing cluster order.
+			tileStart.assign(tileStart.size(), 0);
+			for (int n = 0; n < numk; n++) {
+				int tx = clamp((int)(pixelCenters[n].x / tileSize), 0, tilesX - 1);
+				int ty = clamp((int)(pixelCenters[n].y / tileSize), 0, tilesY - 1);
+				clusterTile[n] = tx + ty * tilesX;
+				tileStart[clusterTile[n] + 1]++;
+			}
+			for (int t = 0; t < tilesX * tilesY; t++) {
+				tileStart[t + 1] += tileStart[t];
+			}
+			for (int n = 0; n < numk; n++) {
+				tileClusters[tileStart[clusterTile[n]]++] = n;
+			}
+			for (int t = tilesX * tilesY; t > 0; t--) {
+				tileStart[t] = tileStart[t - 1];
+			}
+			tileStart[0] = 0;
+			//Each pixel ends up with the closest cluster, ties going to the smaller label id, regardless of the order clusters are visited in.
+			for (int phase = 0; phase < 4; phase++) {
+				const std::vector<int>& tiles = phaseTiles[phase];
+#pragma omp parallel for
+				for (int t = 0; t < (int)tiles.size(); t++) {
+					for (int c = tileStart[tiles[t]]; c < tileStart[tiles[t] + 1]; c++) {
+						int n = tileClusters[c];
+						float2 pixelCenter = pixelCenters[n];
+						float3 colorCenter = colorCenters[n];
+						int xMin = std::max(0, (int)std::floor(pixelCenter.x - offset));
+						int xMax = std::min(labImage.width - 1, (int)std::ceil(pixelCenter.x + offset));
+						int yMin = std::max(0, (int)std::floor(pixelCenter.y - offset));
+						int yMax = std::min(labImage.height - 1, (int)std::ceil(pixelCenter.y + offset));
+						float ml = (maxlab[n] > 0.0f) ? 1.0f / maxlab[n] : 0.0f;
+						for (int y = yMin; y <= yMax; y++) {
+							for (int x = xMin; x <= xMax; x++) {
+								int idx = x + y * width;
+								float distLab = lengthSqr(lab[idx] - colorCenter);
+								float distPixel = lengthSqr(float2((float)x, (float)y) - pixelCenter);
+								float dist = distLab*ml + distPixel * invxywt;
+								float last = score[idx];
+								if (dist < last || (dist == last && n < labels[idx]))//Tie breaker, use smaller label id
+								{
+									score[idx] = dist;
+									labels[idx] = n;
+								}
+							}
 						}
 					}
 				}
 			}
+			//Stop once the centers have stopped moving
 			float E = updateClusters(labelImage);
 			if (E < errorThreshold)break;
 		}
 	}
+	//Rows are split into a fixed number of bands that are reduced in parallel. Partial results are combined in band order,
+	//so the reductions come out the same for any number of threads.
+	static const int SUPERPIXEL_BANDS = 16;
+	//Finds the rows and the range of valid labels covered by each band. Returns false if a label exceeds maxLabel.
+	static bool FindLabelBands(const Image1i& labelImage, int labelOffset, int maxLabel, std::vector<int>& rows, std::vector<int2>& ranges) {
+		int B = std::max(1, std::min(SUPERPIXEL_BANDS, labelImage.height));
+		rows.resize(B + 1);
+		ranges.resize(B);
+		for (int b = 0; b <= B; b++) {
+			rows[b] = (labelImage.height * b) / B;
+		}
+		std::vector<char> valid(B, 1);
+#pragma omp parallel for
+		for (int b = 0; b < B; b++) {
+			int2 range(std::numeric_limits<int>::max(), -1);
+			for (int j = rows[b]; j < rows[b + 1]; j++) {
+				for (int i = 0; i < labelImage.width; i++) {
+					int idx = labelImage(i, j).x + labelOffset;
+					if (idx >= 0) {
+						if (idx >= maxLabel) {
+							valid[b] = 0;
+						}
+						range.x = std::min(range.x, idx);
+						range.y = std::max(range.y, idx);
+					}
+				}
+			}
+			ranges[b] = range;
+		}
+		return std::find(valid.begin(), valid.end(), 0) == valid.end();
+	}
 	float SuperPixels::updateMaxColor(const Image1i& labelImage, int labelOffset) {
 		maxlab.resize(numLabels);
 		maxlab.assign(numLabels, 1.0f);
-		float maxx = 0.0f;
-		for (int j = 0;j < labImage.height;j++) {
-			for (int i = 0; i < labImage.width; i++) {
-				int idx = labelImage(i, j).x+labelOffset;
-				if (idx >= 0) {
-					if (idx >= numLabels) {
-						std::cout << "Index exceeds max" << idx << std::endl;
-					}
-					float3 c = labImage(i, j);
-					float3 colorCenter = colorCenters[idx];
-					float distLab = lengthSqr(c - colorCenter);
-					maxx = std::max(distLab, maxx);
-					if (distLab > maxlab[idx]) {
-						maxlab[idx] = distLab;
+		std::vector<int> rows;
+		std::vector<int2> ranges;
+		if (!FindLabelBands(labelImage, labelOffset, numLabels, rows, ranges)) {
+			throw std::runtime_error(MakeString() << "Invalid cluster id. Labels exceed " << numLabels);
+		}
+		int B = (int)ranges.size();
+		std::vector<std::vector<float>> bandMax(B);
+		std::vector<float> bandMaxx(B, 0.0f);
+#pragma omp parallel for
+		for (int b = 0; b < B; b++) {
+			int2 range = ranges[b];
+			if (range.y < range.x)
+				continue;
+			std::vector<float>& localMax = bandMax[b];
+			localMax.assign(range.y - range.x + 1, 1.0f);
+			float maxx = 0.0f;
+			for (int j = rows[b]; j < rows[b + 1]; j++) {
+				for (int i = 0; i < labImage.width; i++) {
+					int idx = labelImage(i, j).x + labelOffset;
+					if (idx >= 0) {
+						float distLab = lengthSqr(labImage(i, j) - colorCenters[idx]);
+						maxx = std::max(distLab, maxx);
+						float& m = localMax[idx - range.x];
+						m = std::max(m, distLab);
 					}
 				}
 			}
+			bandMaxx[b] = maxx;
+		}
+		float maxx = 0.0f;
+		for (int b = 0; b < B; b++) {
+			maxx = std::max(maxx, bandMaxx[b]);
+			for (int k = 0; k < (int)bandMax[b].size(); k++) {
+				float& m = maxlab[ranges[b].x + k];
+				m = std::max(m, bandMax[b][k]);
+			}
 		}
 		maxx=std::sqrt(maxx);
 		return maxx;
@@ -376,22 +432,49 @@ namespace aly {
 		colorMean.set(float3(0.0f));
 		pixelMean.set(float2(0.0f));
 		clustersize.assign(clustersize.size(), 0);
-		for (int j = 0;j < labImage.height;j++) {
-			for (int i = 0; i < labImage.width; i++) {
-				int idx = labelImage(i, j).x+ labelOffset;
-				if (idx >= 0) {
-					if (idx >= numLabels) {
-						throw std::runtime_error(MakeString()<<"Invalid cluster id. "<<idx<<"/"<<numLabels);
+		std::vector<int> rows;
+		std::vector<int2> ranges;
+		if (!FindLabelBands(labelImage, labelOffset, numLabels, rows, ranges)) {
+			throw std::runtime_error(MakeString() << "Invalid cluster id. Labels exceed " << numLabels);
+		}
+		int B = (int)ranges.size();
+		std::vector<std::vector<float3>> bandColor(B);
+		std::vector<std::vector<float2>> bandPixel(B);
+		std::vector<std::vector<int>> bandSize(B);
+#pragma omp parallel for
+		for (int b = 0; b < B; b++) {
+			int2 range = ranges[b];
+			if (range.y < range.x)
+				continue;
+			int R = range.y - range.x + 1;
+			std::vector<float3>& color = bandColor[b];
+			std::vector<float2>& pixel = bandPixel[b];
+			std::vector<int>& size = bandSize[b];
+			color.assign(R, float3(0.0f));
+			pixel.assign(R, float2(0.0f));
+			size.assign(R, 0);
+			for (int j = rows[b]; j < rows[b + 1]; j++) {
+				for (int i = 0; i < labImage.width; i++) {
+					int idx = labelImage(i, j).x + labelOffset;
+					if (idx >= 0) {
+						idx -= range.x;
+						color[idx] += labImage(i, j);
+						pixel[idx] += float2((float)i, (float)j);
+						size[idx]++;
 					}
-					colorMean[idx] += labImage(i, j);
-					pixelMean[idx] += float2((float)i, (float)j);
-					clustersize[idx]++;
 				}
 			}
 		}
-		//Recalculate centers
+		for (int b = 0; b < B; b++) {
+			for (int k = 0; k < (int)bandSize[b].size(); k++) {
+				int idx = ranges[b].x + k;
+				colorMean[idx] += bandColor[b][k];
+				pixelMean[idx] += bandPixel[b][k];
+				clustersize[idx] += bandSize[b][k];
+			}
+		}
+		//Recalculate centers, summing the movement in a fixed order so the stopping test is deterministic
 		float E = 0.0f;
-#pragma omp parallel for reduction(+:E)
 		for (int k = 0; k < numLabels; k++) {
 			if (clustersize[k] <= 0) clustersize[k] = 1;
 			float inv = 1.0f / (float)(clustersize[k]);
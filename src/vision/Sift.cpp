@@ -11,6 +11,7 @@
 #include <fstream>
 #include <stdexcept>
 #include "image/AlloyImageProcessing.h"
+#include "image/AlloyPyramid.h"
 #include <omp.h>
 #include "vision/Sift.h"
 #define MATH_POW2(x) ((x)*(x))
@@ -33,6 +34,128 @@ inline double gaussian_xx(double const& xx, double const& sigma) {
 	return std::exp(-(xx / (2 * sigma * sigma)));
 }
 namespace aly{
+/*
+ * Number of image rows handled by one parallel task during scale space
+ * construction and extrema detection.
+ */
+static const int SIFT_BLOCK_ROWS = 32;
+/*
+ * Number of keypoints handled by one parallel task during descriptor
+ * generation.
+ */
+static const int SIFT_BLOCK_KEYPOINTS = 64;
+
+/*
+ * One row block of a separable Gaussian blur of src into dst. If dog is set,
+ * the vertical pass also writes the difference dst - src into it.
+ */
+struct SiftBlurTask {
+	const aly::Image1f* src;
+	aly::Image1f* tmp;
+	aly::Image1f* dst;
+	aly::Image1f* dog;
+	const std::vector<float>* kernel;
+	int y0, y1;
+};
+
+/*
+ * 1D version of the kernel used by aly::Smooth(image,out,sigma). Its outer
+ * product is the same 2D kernel, so blurring rows then columns with clamped
+ * borders gives the same image at a fraction of the cost.
+ */
+static void SiftGaussianKernel(std::vector<float>& kernel, float sigma) {
+	int fsz = (int) (5 * sigma);
+	if (fsz % 2 == 0)
+		fsz++;
+	if (fsz < 3)
+		fsz = 3;
+	aly::GaussianKernel(kernel, fsz, sigma);
+}
+static void SiftBlurRows(const SiftBlurTask& task) {
+	const aly::Image1f& src = *task.src;
+	aly::Image1f& tmp = *task.tmp;
+	const std::vector<float>& kernel = *task.kernel;
+	const int w = src.width;
+	const int r = (int) kernel.size() / 2;
+	for (int j = task.y0; j < task.y1; j++) {
+		const float1* in = &src.data[j * (size_t) w];
+		float1* out = &tmp.data[j * (size_t) w];
+		for (int i = 0; i < w; i++) {
+			float sum = 0.0f;
+			if (i >= r && i + r < w) {
+				const float1* ptr = in + i - r;
+				for (int k = 0; k <= 2 * r; k++) {
+					sum += kernel[k] * ptr[k].x;
+				}
+			} else {
+				for (int k = 0; k <= 2 * r; k++) {
+					sum += kernel[k] * in[aly::clamp(i + k - r, 0, w - 1)].x;
+				}
+			}
+			out[i].x = sum;
+		}
+	}
+}
+static void SiftBlurColumns(const SiftBlurTask& task) {
+	const aly::Image1f& tmp = *task.tmp;
+	aly::Image1f& dst = *task.dst;
+	const std::vector<float>& kernel = *task.kernel;
+	const int w = tmp.width;
+	const int h = tmp.height;
+	const int r = (int) kernel.size() / 2;
+	for (int j = task.y0; j < task.y1; j++) {
+		float1* out = &dst.data[j * (size_t) w];
+		std::fill(out, out + w, float1(0.0f));
+		for (int k = 0; k <= 2 * r; k++) {
+			const float1* in = &tmp.data[aly::clamp(j + k - r, 0, h - 1) * (size_t) w];
+			const float kk = kernel[k];
+			for (int i = 0; i < w; i++) {
+				out[i].x += kk * in[i].x;
+			}
+		}
+		if (task.dog != nullptr) {
+			const float1* prev = &task.src->data[j * (size_t) w];
+			float1* diff = &task.dog->data[j * (size_t) w];
+			for (int i = 0; i < w; i++) {
+				diff[i].x = out[i].x - prev[i].x;
+			}
+		}
+	}
+}
+/*
+ * Runs all blur tasks, which may belong to different octaves. Every row
+ * pass has to finish before the column pass reads its output.
+ */
+static void SiftBlur(const std::vector<SiftBlurTask>& tasks) {
+#pragma omp parallel for schedule(dynamic)
+	for (int n = 0; n < (int) tasks.size(); n++) {
+		SiftBlurRows(tasks[n]);
+	}
+#pragma omp parallel for schedule(dynamic)
+	for (int n = 0; n < (int) tasks.size(); n++) {
+		SiftBlurColumns(tasks[n]);
+	}
+}
+static void SiftAddBlurTasks(std::vector<SiftBlurTask>& tasks,
+		const aly::Image1f& src, aly::Image1f& tmp, aly::Image1f& dst,
+		aly::Image1f* dog, const std::vector<float>& kernel) {
+	tmp.resize(src.width, src.height);
+	dst.resize(src.width, src.height);
+	if (dog != nullptr)
+		dog->resize(src.width, src.height);
+	for (int y = 0; y < src.height; y += SIFT_BLOCK_ROWS) {
+		SiftBlurTask task;
+		task.src = &src;
+		task.tmp = &tmp;
+		task.dst = &dst;
+		task.dog = dog;
+		task.kernel = &kernel;
+		task.y0 = y;
+		task.y1 = std::min(y + SIFT_BLOCK_ROWS, src.height);
+		tasks.push_back(task);
+	}
+}
+
 Sift::Sift(	SiftOptions options):options(options) {
 }
 
@@ -54,96 +177,137 @@ void Sift::solve(bool generateDescriptors) {
 /* ---------------------------------------------------------------- */
 
 void Sift::create(void) {
-	this->octaves.clear();
-	this->octaves.reserve(options.maxOctave-options.minOctave);
+	/*
+	 * Base images for positive octaves are successive 3x3 down samples of
+	 * the original, so take them from a pyramid built once.
+	 */
+	aly::Pyramid1f pyramid(this->orig, this->options.maxOctave + 1, aly::PyramidFilter::Gaussian3x3);
+	int first = std::max(0, this->options.minOctave);
+	int last = std::min(this->options.maxOctave, pyramid.size() - 1);
+	int offset = (this->options.minOctave < 0) ? 1 : 0;
+	int numOctaves = offset + std::max(0, last - first + 1);
+	this->octaveBases.resize(numOctaves);
+	this->blurScratch.resize(numOctaves);
+	std::vector<float> baseSigmas(numOctaves);
 	/*
 	 * Create octave -1. The original image is assumed to have blur
 	 * sigma = 0.5. The double size image therefore has sigma = 1.
 	 */
-	if (this->options.minOctave < 0) {
-		aly::Image1f img;
-		aly::UpSample(orig, img);
-		this->add(img, this->options.inherentBlurSigma * 2.0f,
-				this->options.baseBlurSigma);
+	if (offset) {
+		aly::UpSample(orig, this->octaveBases[0]);
+		baseSigmas[0] = this->options.inherentBlurSigma * 2.0f;
 	}
-
 	/*
-	 * Prepare image for the first positive octave by downsampling.
-	 * This code is executed only if min_octave > 0.
+	 * Create new octave from each level, where sigma is doubled
+	 * relative to the previous level's base image.
 	 */
-	aly::Image1f img = this->orig;
-	aly::Image1f tmp;
-	for (int i = 0; i < this->options.minOctave; ++i) {
-		aly::DownSample3x3(img, tmp);
-		img = tmp;
+	for (int i = first; i <= last; ++i) {
+		pyramid.getGaussian(i, this->octaveBases[offset + i - first]);
+		baseSigmas[offset + i - first] = (i == first) ? this->options.inherentBlurSigma : this->options.baseBlurSigma;
 	}
 	/*
-	 * Create new octave from 'img', then subsample octave image where
-	 * sigma is doubled to get a new base image for the next octave.
+	 * Octaves are kept between calls so their images can be reused, unless
+	 * the caller still holds on to one from a previous result.
 	 */
-	float img_sigma = this->options.inherentBlurSigma;
-	for (int i = std::max(0, this->options.minOctave);i <= this->options.maxOctave; ++i) {
-		this->add(img, img_sigma, this->options.baseBlurSigma);
-		aly::DownSample3x3(img, tmp);
-		img = tmp;
-		img_sigma = this->options.baseBlurSigma;
+	this->octaves.resize(numOctaves);
+	for (OctavePtr& oct : this->octaves) {
+		if (oct.get() == nullptr || oct.use_count() > 1) {
+			oct = OctavePtr(new Octave());
+		}
+		oct->gray.resize(this->options.samplesPerOctave + 3);
+		oct->dog.resize(this->options.samplesPerOctave + 2);
 	}
-}
-
-/* ---------------------------------------------------------------- */
-
-void Sift::add(const Image1f& image, float has_sigma, float target_sigma) {
-	aly::Image1f base;
-	float sigma = std::sqrt(MATH_POW2(target_sigma) - MATH_POW2(has_sigma));
-	this->octaves.push_back(std::shared_ptr<Octave>(new Octave()));
-	OctavePtr oct = this->octaves.back();
-	oct->gray.resize(this->options.samplesPerOctave + 3);
-	oct->dog.resize(this->options.samplesPerOctave + 2);
-	if (target_sigma > has_sigma) {
-		aly::Smooth(image, base, target_sigma);
-	} else {
-		base = image;
+	/*
+	 * Levels within an octave depend on each other, but octaves do not.
+	 * Each level is therefore built for all octaves at once, split into
+	 * row blocks so the large octaves do not serialize the work.
+	 */
+	float const target_sigma = this->options.baseBlurSigma;
+	std::vector<SiftBlurTask> tasks;
+	std::vector<float> kernel;
+	std::vector<std::vector<float>> baseKernels(numOctaves);
+	for (int n = 0; n < numOctaves; n++) {
+		if (target_sigma > baseSigmas[n]) {
+			SiftGaussianKernel(baseKernels[n], target_sigma);
+			SiftAddBlurTasks(tasks, this->octaveBases[n], this->blurScratch[n], this->octaves[n]->gray[0], nullptr, baseKernels[n]);
+		} else {
+			this->octaves[n]->gray[0] = this->octaveBases[n];
+		}
 	}
-	oct->gray[0]=base;
+	SiftBlur(tasks);
 	float const k = std::pow(2.0f, 1.0f / this->options.samplesPerOctave);
-	sigma = target_sigma;
+	float sigma = target_sigma;
 	for (int i = 1; i < this->options.samplesPerOctave + 3; ++i) {
 		/* Calculate the blur sigma the image will get. */
 		float sigmak = sigma * k;
 		float blur_sigma = std::sqrt(MATH_POW2(sigmak) - MATH_POW2(sigma));
-		aly::Smooth(base, oct->gray[i], blur_sigma);
-		oct->dog[i-1]=oct->gray[i] - base;
-		base = oct->gray[i];
+		SiftGaussianKernel(kernel, blur_sigma);
+		tasks.clear();
+		for (int n = 0; n < numOctaves; n++) {
+			Octave* oct = this->octaves[n].get();
+			SiftAddBlurTasks(tasks, oct->gray[i - 1], this->blurScratch[n], oct->gray[i], &oct->dog[i - 1], kernel);
+		}
+		SiftBlur(tasks);
 		sigma = sigmak;
-		//WriteImageToFile(MakeString()<<GetDesktopDirectory()<<ALY_PATH_SEPARATOR<<"sift_dog"<<this->octaves.size()<<"_"<<i-1<<".xml",oct->dog[i-1]);
 	}
 }
 
 /* ---------------------------------------------------------------- */
 
 void Sift::extremaDetection(void) {
-	/* Delete previous keypoints. */
-	this->keypoints.clear();
-	/* Detect keypoints in each octave... */
+	/*
+	 * Every (octave, sample, row block) triple is detected independently into
+	 * its own buffer. Buffers are concatenated in task order, so keypoints
+	 * come out in the same order as a serial scan.
+	 */
+	struct ExtremaTask {
+		int octave, sample, y0, y1;
+	};
+	std::vector<ExtremaTask> tasks;
 	for (std::size_t i = 0; i < this->octaves.size(); ++i) {
 		OctavePtr oct=this->octaves[i];
 		/* In each octave, take three subsequent DoG images and detect. */
 		for (int s = 0; s < (int) oct->dog.size() - 2; ++s) {
-			const aly::Image1f* samples[3] = { &oct->dog[s + 0], &oct->dog[s + 1],&oct->dog[s + 2] };
-			this->extremaDetection(samples,static_cast<int>(i) + this->options.minOctave, s);
+			int const h = oct->dog[s + 1].height;
+			for (int y = 1; y < h - 1; y += SIFT_BLOCK_ROWS) {
+				ExtremaTask task;
+				task.octave = static_cast<int>(i);
+				task.sample = s;
+				task.y0 = y;
+				task.y1 = std::min(y + SIFT_BLOCK_ROWS, h - 1);
+				tasks.push_back(task);
+			}
 		}
 	}
+	if (this->keypointBlocks.size() < tasks.size())
+		this->keypointBlocks.resize(tasks.size());
+#pragma omp parallel for schedule(dynamic)
+	for (int n = 0; n < (int) tasks.size(); n++) {
+		const ExtremaTask& task = tasks[n];
+		Octave* oct = this->octaves[task.octave].get();
+		const aly::Image1f* samples[3] = { &oct->dog[task.sample + 0], &oct->dog[task.sample + 1],&oct->dog[task.sample + 2] };
+		this->keypointBlocks[n].clear();
+		this->extremaDetection(samples, task.octave + this->options.minOctave, task.sample, task.y0, task.y1, this->keypointBlocks[n]);
+	}
+	std::size_t total = 0;
+	for (std::size_t n = 0; n < tasks.size(); n++) {
+		total += this->keypointBlocks[n].size();
+	}
+	this->keypoints.clear();
+	this->keypoints.reserve(total);
+	for (std::size_t n = 0; n < tasks.size(); n++) {
+		this->keypoints.insert(this->keypoints.end(), this->keypointBlocks[n].begin(), this->keypointBlocks[n].end());
+	}
 }
 
 /* ---------------------------------------------------------------- */
 
-std::size_t Sift::extremaDetection(const aly::Image1f* s[3], int oi, int si) {
+std::size_t Sift::extremaDetection(const aly::Image1f* s[3], int oi, int si, int y0, int y1, Keypoints& out) {
 	int const w = s[1]->width;
-	int const h = s[1]->height;
 	const int noff[9] = { -1 - w, 0 - w, 1 - w, -1, 0, 1, -1 + w, 0 + w, 1 + w };
 	int detected = 0;
-	int off = w;
-	for (int y = 1; y < h - 1; ++y, off += w){
+	int off = y0 * w;
+	for (int y = y0; y < y1; ++y, off += w){
 		for (int x = 1; x < w - 1; ++x) {
 			int idx = off + x;
 			bool largest = true;
@@ -168,7 +332,7 @@ std::size_t Sift::extremaDetection(const aly::Image1f* s[3], int oi, int si) {
 			kp.x = static_cast<float>(x);
 			kp.y = static_cast<float>(y);
 			kp.sample = static_cast<float>(si);
-			this->keypoints.push_back(kp);
+			out.push_back(kp);
 			detected += 1;
 		}
 	}
@@ -184,9 +348,13 @@ void Sift::keypointLocalization(void) {
 	 * around the keypoint.
 	 */
 
-	int num_singular = 0;
-	int num_keypoints = 0; // Write iterator
-	for (std::size_t i = 0; i < this->keypoints.size(); ++i) {
+	/*
+	 * Keypoints are refined independently. Accepted ones are flagged and
+	 * compacted afterwards, which keeps their order.
+	 */
+	std::vector<char> accepted(this->keypoints.size(), 0);
+#pragma omp parallel for schedule(dynamic,256)
+	for (int i = 0; i < (int)this->keypoints.size(); ++i) {
 		SiftKeypoint kp=this->keypoints[i];
 		OctavePtr oct=this->octaves[kp.octave - this->options.minOctave];
 		int sample = static_cast<int>(kp.sample);
@@ -234,7 +402,6 @@ void Sift::keypointLocalization(void) {
 				fy = b[1];
 				fs = b[2];
 			} catch (...) {
-				num_singular += 1;
 				fx = fy = fs = 0.0f; // FIXME: Handle this case?
 				break;
 			}
@@ -288,9 +455,16 @@ void Sift::keypointLocalization(void) {
 				|| kp.y > (float) (h - 1)) {
 			continue;
 		}
-		/* Keypoint is accepted, copy to write iter and advance. */
-		this->keypoints[num_keypoints] = kp;
-		num_keypoints += 1;
+		/* Keypoint is accepted, store the refined location. */
+		this->keypoints[i] = kp;
+		accepted[i] = 1;
+	}
+	std::size_t num_keypoints = 0; // Write iterator
+	for (std::size_t i = 0; i < this->keypoints.size(); ++i) {
+		if (accepted[i]) {
+			this->keypoints[num_keypoints] = this->keypoints[i];
+			num_keypoints += 1;
+		}
 	}
 	this->keypoints.erase(this->keypoints.begin()+num_keypoints,this->keypoints.end());//resize(num_keypoints);
 }
@@ -304,43 +478,56 @@ void Sift::descriptorGeneration(void) {
 		throw std::runtime_error("Octaves not available!");
 	if (this->keypoints.empty())
 		return;
-	this->descriptors.clear();
-	this->descriptors.reserve(this->keypoints.size() * 3 / 2);
 	/*
-	 * Keep a buffer of S+3 gradient and orientation images for the current
-	 * octave. Once the octave is changed, these images are recomputed.
-	 * To ensure efficiency, the octave index must always increase, never
-	 * decrease, which is enforced during the algorithm.
+	 * Gradient and orientation images are computed up front for every
+	 * octave, so keypoints can be processed in any order.
 	 */
-	//int octave_index = this->keypoints[0].octave;
 	for(int n=0;n<(int)octaves.size();n++){
 		this->generateFeatureImages(octaves[n].get());
 	}
-	/* Walk over all keypoints and compute descriptors. */
-#pragma omp parallel for
-	for (int i = 0; i < this->keypoints.size(); ++i) {
-		const SiftKeypoint& kp=this->keypoints[i];
-		Octave* octave = this->octaves[kp.octave - this->options.minOctave].get();
+	/*
+	 * Walk over all keypoints and compute descriptors. Each block of
+	 * keypoints writes into its own buffer, and buffers are appended in
+	 * block order so the output does not depend on thread scheduling.
+	 */
+	int numBlocks = ((int)this->keypoints.size() + SIFT_BLOCK_KEYPOINTS - 1) / SIFT_BLOCK_KEYPOINTS;
+	if ((int)this->descriptorBlocks.size() < numBlocks)
+		this->descriptorBlocks.resize(numBlocks);
+#pragma omp parallel for schedule(dynamic)
+	for (int b = 0; b < numBlocks; ++b) {
+		SiftDescriptors& block = this->descriptorBlocks[b];
+		block.clear();
 		std::vector<float> orientations;
 		orientations.reserve(8);
-		this->orientationAssignment(kp, octave, orientations);
-		/* Feature vector extraction. */
-		for (std::size_t j = 0; j < orientations.size(); ++j) {
-			SiftDescriptor desc;
-			float const scale_factor = std::pow(2.0f, kp.octave);
-			desc.x = scale_factor * (kp.x + 0.5f) - 0.5f;
-			desc.y = scale_factor * (kp.y + 0.5f) - 0.5f;
-			desc.scale = this->keypointAbsoluteScale(kp);
-			desc.orientation = orientations[j];
-			//std::cout<<"Descriptor "<<desc.x<<" "<<desc.y<<" "<<desc.scale<<" "<<desc.orientation<<std::endl;
-			if (this->descriptorAssignment(kp, desc, octave)){
-#pragma omp critical
-				{
-					this->descriptors.push_back(desc);
+		int end = std::min((b + 1) * SIFT_BLOCK_KEYPOINTS, (int)this->keypoints.size());
+		for (int i = b * SIFT_BLOCK_KEYPOINTS; i < end; ++i) {
+			const SiftKeypoint& kp=this->keypoints[i];
+			Octave* octave = this->octaves[kp.octave - this->options.minOctave].get();
+			orientations.clear();
+			this->orientationAssignment(kp, octave, orientations);
+			/* Feature vector extraction. */
+			for (std::size_t j = 0; j < orientations.size(); ++j) {
+				SiftDescriptor desc;
+				float const scale_factor = std::pow(2.0f, kp.octave);
+				desc.x = scale_factor * (kp.x + 0.5f) - 0.5f;
+				desc.y = scale_factor * (kp.y + 0.5f) - 0.5f;
+				desc.scale = this->keypointAbsoluteScale(kp);
+				desc.orientation = orientations[j];
+				if (this->descriptorAssignment(kp, desc, octave)){
+					block.push_back(desc);
 				}
 			}
 		}
 	}
+	std::size_t total = 0;
+	for (int b = 0; b < numBlocks; ++b) {
+		total += this->descriptorBlocks[b].size();
+	}
+	this->descriptors.clear();
+	this->descriptors.reserve(total);
+	for (int b = 0; b < numBlocks; ++b) {
+		this->descriptors.insert(this->descriptors.end(), this->descriptorBlocks[b].begin(), this->descriptorBlocks[b].end());
+	}
 }
 
 /* ---------------------------------------------------------------- */
@@ -348,26 +535,45 @@ void Sift::descriptorGeneration(void) {
 void Sift::generateFeatureImages(Octave* octave) {
 	int const width = octave->gray[0].width;
 	int const height = octave->gray[0].height;
-	octave->gradient.resize(octave->gray.size(),Image1f(width,height));
-	octave->orientation.resize(octave->gray.size(),Image1f(width,height));
-	//std::cout << "Generating gradient and orientation images..." << std::endl;
-	for (std::size_t i = 0; i < octave->gray.size(); ++i) {
+	int const levels = (int)octave->gray.size();
+	octave->gradient.resize(levels);
+	octave->orientation.resize(levels);
+	/*
+	 * Images may be reused from a previous call, so the border pixels that
+	 * are not computed below have to be cleared explicitly.
+	 */
+	for (int i = 0; i < levels; ++i) {
+		aly::Image1f& grad=octave->gradient[i];
+		aly::Image1f& ori=octave->orientation[i];
+		grad.resize(width, height);
+		ori.resize(width, height);
+		std::fill(grad.data.begin(), grad.data.begin() + width, float1(0.0f));
+		std::fill(ori.data.begin(), ori.data.begin() + width, float1(0.0f));
+		std::fill(grad.data.end() - width, grad.data.end(), float1(0.0f));
+		std::fill(ori.data.end() - width, ori.data.end(), float1(0.0f));
+	}
+	/* Process rows of all levels in one parallel loop. */
+#pragma omp parallel for
+	for (int n = 0; n < levels * (height - 2); ++n) {
+		int const i = n / (height - 2);
+		int const y = 1 + n % (height - 2);
 		aly::Image1f& img = octave->gray[i];
 		aly::Image1f& grad=octave->gradient[i];
 		aly::Image1f& ori=octave->orientation[i];
-		int image_iter = width + 1;
-		for (int y = 1; y < height - 1; ++y, image_iter += 2){
-			for (int x = 1; x < width - 1; ++x, ++image_iter) {
-				float m1x = img[image_iter - 1];
-				float p1x = img[image_iter + 1];
-				float m1y = img[image_iter - width];
-				float p1y = img[image_iter + width];
-				float dx = 0.5f * (p1x - m1x);
-				float dy = 0.5f * (p1y - m1y);
-				float atan2f = std::atan2(dy, dx);
-				grad[image_iter].x = std::sqrt(dx * dx + dy * dy);
-				ori[image_iter].x =atan2f < 0.0f ? atan2f + ALY_PI * 2.0f : atan2f;
-			}
+		int image_iter = y * width;
+		grad[image_iter].x = ori[image_iter].x = 0.0f;
+		grad[image_iter + width - 1].x = ori[image_iter + width - 1].x = 0.0f;
+		image_iter++;
+		for (int x = 1; x < width - 1; ++x, ++image_iter) {
+			float m1x = img[image_iter - 1];
+			float p1x = img[image_iter + 1];
+			float m1y = img[image_iter - width];
+			float p1y = img[image_iter + width];
+			float dx = 0.5f * (p1x - m1x);
+			float dy = 0.5f * (p1y - m1y);
+			float atan2f = std::atan2(dy, dx);
+			grad[image_iter].x = std::sqrt(dx * dx + dy * dy);
+			ori[image_iter].x =atan2f < 0.0f ? atan2f + ALY_PI * 2.0f : atan2f;
 		}
 	}
 }
@@ -231,9 +231,8 @@ public:
 
 protected:
 	void create(void);
-	void add(const aly::Image1f& image, float has_sigma, float target_sigma);
 	void extremaDetection(void);
-	std::size_t extremaDetection(const aly::Image1f* s[3], int oi, int si);
+	std::size_t extremaDetection(const aly::Image1f* s[3], int oi, int si, int y0, int y1, Keypoints& out);
 	void keypointLocalization(void);
 
 	void descriptorGeneration(void);
@@ -251,6 +250,11 @@ private:
 	Octaves octaves; // The image pyramid (the octaves)
 	Keypoints keypoints; // Detected keypoints
 	SiftDescriptors descriptors; // Final SIFT descriptors
+	/* Scratch buffers kept between calls to solve(). */
+	std::vector<aly::Image1f> octaveBases; // Unblurred base image of each octave
+	std::vector<aly::Image1f> blurScratch; // Row pass output of each octave
+	std::vector<Keypoints> keypointBlocks; // Extrema found in each row block
+	std::vector<SiftDescriptors> descriptorBlocks; // Descriptors of each keypoint block
 };
 
 }
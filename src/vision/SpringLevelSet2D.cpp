@@ -100,7 +100,7 @@ float2x2 Compose(const float& theta, const float& phi, const float& sx,
 }
 SpringLevelSet2D::SpringLevelSet2D(
 		const std::shared_ptr<ManifoldCache2D>& cache) :
-		ActiveManifold2D("Spring Level Set 2D", cache), resampleEnabled(true) {
+		ActiveManifold2D("Spring Level Set 2D", cache), locatorBackend(LocatorBackend::HashGrid), resampleEnabled(true) {
 	clampSpeed=true;
 }
 void SpringLevelSet2D::setSpringls(const Vector2f& particles,
@@ -165,7 +165,7 @@ void SpringLevelSet2D::refineContour(int iterations, float proximity,
 	int N = (int) contour.vertexLocations.size();
 	Vector2f delta(N);
 	const float planeThreshold = std::cos(ToRadians(80.0f));
-	Locator2f particleLocator(contour.particles);
+	std::shared_ptr<PointLocator2f> particleLocator = MakePointLocator(contour.particles, proximity, locatorBackend);
 	for (int iter = 0; iter < iterations; iter++) {
 		for (std::vector<uint32_t> curve : contour.indexes) {
 			uint32_t cur = 0, prev = 0, next = 0;
@@ -194,7 +194,7 @@ void SpringLevelSet2D::refineContour(int iterations, float proximity,
 					float w = 0.0f;
 					float d = 0;
 					delta[cur] = float2(0.0f);
-					particleLocator.closest(curPt, proximity, result);
+					particleLocator->closest(curPt, proximity, result);
 					if (result.size() > 0) {
 						float2 closest = curPt;
 						float2 closestNorm = norm;
@@ -279,7 +279,7 @@ float2 SpringLevelSet2D::traceInitial(float2 pt) {
 	return pt;
 }
 void SpringLevelSet2D::updateNearestNeighbors(float maxDistance) {
-	locator.reset(new Locator2f(contour.vertexes));
+	locator = MakePointLocator(contour.vertexes, maxDistance, locatorBackend);
 	nearestNeighbors.clear();
 	nearestNeighbors.resize(contour.vertexes.size(), std::list<uint32_t>());
 	int N = (int) contour.vertexes.size();
@@ -360,7 +360,7 @@ void SpringLevelSet2D::updateTracking(float maxDistance) {
 	const float planeThreshold = std::cos(ToRadians(80.0f));
 	//do {
 	//invalid = 0;
-	locator.reset(new Locator2f(oldVertexes));
+	locator = MakePointLocator(oldVertexes, maxDistance, locatorBackend);
 	std::vector<int> retrack;
 	for (size_t i = 0; i < contour.particles.size(); i++) {
 		if (std::isinf(contour.correspondence[i].x)
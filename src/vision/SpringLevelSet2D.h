@@ -42,7 +42,8 @@ namespace aly {
 		static float SHARPNESS;
 	protected:
 		std::list<Orphan2D> orphans;
-		std::shared_ptr<Locator2f> locator;
+		std::shared_ptr<PointLocator2f> locator;
+		LocatorBackend locatorBackend;
 		aly::Vector2f oldCorrespondences;
 		std::array<Vector2f, 4> oldVelocities;
 		aly::Vector2f oldVertexes;
@@ -77,6 +78,9 @@ namespace aly {
 		void setResamplingEnabled(bool e){
 			resampleEnabled=e;
 		}
+		void setLocatorBackend(const LocatorBackend& backend) {
+			locatorBackend = backend;
+		}
 		SpringLevelSet2D(const std::shared_ptr<ManifoldCache2D>& cache = nullptr);
 		void setSpringls(const Vector2f& particles, const Vector2f& points);
 		virtual bool init() override;
@@ -53,7 +53,7 @@ const std::function<double3(double3, double, double)> SpringLevelSet3D::ENRIGHT_
 		};
 SpringLevelSet3D::SpringLevelSet3D(
 		const std::shared_ptr<ManifoldCache3D>& cache) :
-		ActiveManifold3D("Spring Level Set 3D", cache), resampleEnabled(true) {
+		ActiveManifold3D("Spring Level Set 3D", cache), locatorBackend(LocatorBackend::HashGrid), resampleEnabled(true) {
 	contour.meshType = MeshType::Quad;
 	clampSpeed = true;
 	simulationTimeStep = 1.0f;
@@ -184,7 +184,7 @@ void SpringLevelSet3D::updateNearestNeighbors(float maxDistance) {
 	nearestNeighbors.clear();
 	if (contour.vertexes.size() == 0)
 		return;
-	locator.reset(new Locator3f(contour.vertexes));
+	locator = MakePointLocator(contour.vertexes, maxDistance, locatorBackend);
 	nearestNeighbors.resize(contour.vertexes.size(),
 			std::vector<SpringlEdge>());
 	int N = (int) contour.particles.size();
@@ -244,7 +244,7 @@ void SpringLevelSet3D::refineContour(aly::Mesh& isosurf, int iterations,
 	int N = isosurf.vertexLocations.size();
 	Vector3f& points = isosurf.vertexLocations;
 	Vector3f& normals = isosurf.vertexNormals;
-	Locator3f matcher(contour.particles);
+	std::shared_ptr<PointLocator3f> matcher = MakePointLocator(contour.particles, proximity, locatorBackend);
 	Vector3f newPoints = points;
 	const float planeThreshold = std::cos(ToRadians(80.0f));
 	std::vector < std::unordered_set < uint32_t >> nbrTable;
@@ -259,7 +259,7 @@ void SpringLevelSet3D::refineContour(aly::Mesh& isosurf, int iterations,
 			float w = 0.0f;
 			float d;
 			newPoints[n] = pt;
-			matcher.closest(pt, proximity, result);
+			matcher->closest(pt, proximity, result);
 			if (result.size() > 0) {
 				float3 closest = pt;
 				float3 closestNorm = norm;
@@ -312,7 +312,7 @@ int SpringLevelSet3D::fill() {
 	//std::vector<int> histogram(11, 0);
 	int fillCount = 0;
 	float d;
-	Locator3f matcher(contour.vertexes);
+	std::shared_ptr<PointLocator3f> matcher = MakePointLocator(contour.vertexes, NEAREST_NEIGHBOR_DISTANCE, locatorBackend);
 	if (contour.meshType == MeshType::Triangle) {
 		for (int n = 0; n < contour.triIndexes.size(); n++) {
 			uint3 tri = contour.triIndexes[n];
@@ -321,7 +321,7 @@ int SpringLevelSet3D::fill() {
 							+ contour.vertexLocations[tri.y]
 							+ contour.vertexLocations[tri.z]);
 			std::vector<float3i> result;
-			matcher.closest(p, NEAREST_NEIGHBOR_DISTANCE, result);
+			matcher->closest(p, NEAREST_NEIGHBOR_DISTANCE, result);
 			d = 1E30f;
 			float3 q;
 			for (auto pr : result) {
@@ -364,7 +364,7 @@ int SpringLevelSet3D::fill() {
 			float3 v4 = contour.vertexLocations[quad.w];
 			float3 p = 0.25f * (v1 + v2 + v3 + v4);
 			std::vector<float3i> result;
-			matcher.closest(p, NEAREST_NEIGHBOR_DISTANCE, result);
+			matcher->closest(p, NEAREST_NEIGHBOR_DISTANCE, result);
 			d = 1E30f;
 			float3 q;
 			for (auto pr : result) {
@@ -409,7 +409,7 @@ void SpringLevelSet3D::updateTracking(float maxDistance) {
 	const float planeThreshold = std::cos(ToRadians(80.0f));
 	//do {
 	//invalid = 0;
-	locator.reset(new Locator3f(oldVertexes));
+	locator = MakePointLocator(oldVertexes, maxDistance, locatorBackend);
 	std::vector<int> retrack;
 	for (size_t i = 0; i < contour.particles.size(); i++) {
 		if (std::isinf(contour.correspondence[i].x)
@@ -418,6 +418,8 @@ void SpringLevelSet3D::updateTracking(float maxDistance) {
 		}
 	}
 	int N = (int) retrack.size();
+	//Each iteration only writes the entries of its own particle.
+#pragma omp parallel for
 	for (int i = 0; i < N; i++) {
 		int pid = retrack[i];
 		float d;
@@ -61,7 +61,8 @@ namespace aly {
 		static double ENRIGHT_PERIOD;
 		static const std::function<double3(double3,double,double)> ENRIGHT_FUNCTION;
 	protected:
-		std::shared_ptr<Locator3f> locator;
+		std::shared_ptr<PointLocator3f> locator;
+		LocatorBackend locatorBackend;
 		aly::Vector3f oldCorrespondences;
 		aly::Vector3f oldParticles;
 		aly::Vector3f oldNormals;
@@ -96,6 +97,9 @@ namespace aly {
 		void setResamplingEnabled(bool e){
 			resampleEnabled=e;
 		}
+		void setLocatorBackend(const LocatorBackend& backend) {
+			locatorBackend = backend;
+		}
 		void setAdvection(const std::function<aly::double3(aly::double3,double,double)>& func);
 		SpringLevelSet3D(const std::shared_ptr<ManifoldCache3D>& cache = nullptr);
 		void setSpringls(const Vector3f& particles, const Vector3f& points);